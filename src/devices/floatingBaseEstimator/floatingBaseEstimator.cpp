@@ -12,6 +12,7 @@
 #include <iDynTree/yarp/YARPConversions.h>
 #include <iDynTree/Core/Utils.h>
 
+#include <algorithm>
 #include <cassert>
 #include <cmath>
 
@@ -26,7 +27,8 @@ floatingBaseEstimator::floatingBaseEstimator(): RateThread(10),
                                                 portPrefix("/floatingBaseEstimator"),
                                                 correctlyConfigured(false),
                                                 sensorReadCorrectly(false),
-                                                estimationWentWell(false)
+                                                estimationWentWell(false),
+                                                estimationStateSource(0)
 {
 }
 
@@ -271,12 +273,91 @@ bool floatingBaseEstimator::attachAllControlBoard(const PolyDriverList& p)
     return true;
 }
 
+bool floatingBaseEstimator::attachEstimationStateSource(const PolyDriverList& p)
+{
+    wholeBodyDynamics::IEstimationStateSource * source = 0;
+    for(size_t devIdx = 0; devIdx < (size_t) p.size(); devIdx++)
+    {
+        if( estimationStateSourceName == p[devIdx]->key.c_str() )
+        {
+            if( !p[devIdx]->poly->view(source) )
+            {
+                source = 0;
+            }
+            break;
+        }
+    }
+
+    if( !source )
+    {
+        yError() << "floatingBaseEstimator : no device " << estimationStateSourceName
+                 << " implementing the IEstimationStateSource interface was passed to attachAll";
+        return false;
+    }
+
+    std::vector<std::string> sourceJointNames;
+    bool ok = source->getEstimationStateJointNames(sourceJointNames);
+
+    if( !ok )
+    {
+        yError() << "floatingBaseEstimator : impossible to get the joint names from the estimation state source";
+        return false;
+    }
+
+    // Map the joints used by the odometry in the joints provided by the source
+    estimationStateSourceJointIndices.resize(estimationJointNames.size());
+    for(size_t jnt=0; jnt < estimationJointNames.size(); jnt++)
+    {
+        std::vector<std::string>::iterator it = std::find(sourceJointNames.begin(),sourceJointNames.end(),estimationJointNames[jnt]);
+
+        if( it == sourceJointNames.end() )
+        {
+            yError() << "floatingBaseEstimator : joint " << estimationJointNames[jnt] << " is not provided by the estimation state source";
+            return false;
+        }
+
+        estimationStateSourceJointIndices[jnt] = it - sourceJointNames.begin();
+    }
+
+    // Allocate the buffers before the source starts writing them
+    wholeBodyDynamics::EstimationState initialState;
+    initialState.sequenceNumber = 0;
+    initialState.timestamp = 0.0;
+    initialState.sensorReadCorrectly = false;
+    initialState.jointPos.resize(estimator.model());
+    estimationStateBuffer.reset(initialState);
+
+    estimationStateSource = source;
+
+    return true;
+}
+
 bool floatingBaseEstimator::attachAll(const PolyDriverList& p)
 {
     yarp::os::LockGuard guard(this->deviceMutex);
 
     bool ok = true;
-    ok = ok && this->attachAllControlBoard(p);
+
+    if( !estimationStateSourceName.empty() )
+    {
+        ok = ok && this->attachEstimationStateSource(p);
+
+        // onNewEstimationState does not lock the deviceMutex, so it can be registered while holding it
+        ok = ok && estimationStateSource->addEstimationStateListener(this);
+
+        if( ok )
+        {
+            yInfo() << "floatingBaseEstimator : running in composite mode, using the joint positions read by " << estimationStateSourceName;
+        }
+        else
+        {
+            estimationStateSource = 0;
+        }
+    }
+    else
+    {
+        ok = ok && this->attachAllControlBoard(p);
+    }
 
     if( ok )
     {
@@ -312,6 +393,24 @@ void floatingBaseEstimator::readSensors()
     jointVelSetToZero.zero();
 }
 
+bool floatingBaseEstimator::readEstimationState()
+{
+    if( !estimationStateBuffer.update() )
+    {
+        return false;
+    }
+
+    const wholeBodyDynamics::EstimationState & state = estimationStateBuffer.readBuffer();
+
+    // The joint positions are already in radians
+    jointPos = state.jointPos;
+    sensorReadCorrectly = state.sensorReadCorrectly;
+
+    jointVelSetToZero.zero();
+
+    return true;
+}
+
 void floatingBaseEstimator::updateKinematics()
 {
     estimationWentWell = estimator.updateKinematics(jointPos);
@@ -394,9 +493,43 @@ void floatingBaseEstimator::run()
 {
     yarp::os::LockGuard guard(this->deviceMutex);
 
-    // Read sensor readings
-    this->readSensors();
+    if( estimationStateSource )
+    {
+        // Composite mode: nothing to do until the source sends a new state
+        if( !this->readEstimationState() )
+        {
+            return;
+        }
+    }
+    else
+    {
+        // Read sensor readings
+        this->readSensors();
+    }
+
+    this->estimateAndPublish();
+}
+
+void floatingBaseEstimator::onNewEstimationState(const wholeBodyDynamics::EstimationState& state)
+{
+    // Called in the thread of the source: only copy the joint positions, the
+    // estimation runs in the thread of this device. The estimationStateSourceJointIndices
+    // do not change while the listener is registered, so no lock is needed.
+    wholeBodyDynamics::EstimationState & buffer = estimationStateBuffer.writeBuffer();
+
+    buffer.sequenceNumber = state.sequenceNumber;
+    buffer.timestamp = state.timestamp;
+    buffer.sensorReadCorrectly = state.sensorReadCorrectly;
+    for(size_t jnt=0; jnt < estimationStateSourceJointIndices.size(); jnt++)
+    {
+        buffer.jointPos(jnt) = state.jointPos(estimationStateSourceJointIndices[jnt]);
+    }
+
+    estimationStateBuffer.publish();
+}
 
+void floatingBaseEstimator::estimateAndPublish()
+{
     if( sensorReadCorrectly )
     {
         if( !correctlyConfigured )
@@ -423,16 +556,26 @@ void floatingBaseEstimator::run()
 
 bool floatingBaseEstimator::detachAll()
 {
+    // The thread is stopped before locking the deviceMutex, as run locks it
+    if (isRunning())
+    {
+        stop();
+    }
+
     yarp::os::LockGuard guard(this->deviceMutex);
 
     correctlyConfigured = false;
 
-    if (isRunning())
+    if( estimationStateSource )
     {
-        stop();
+        // When this returns, the source is not calling onNewEstimationState anymore
+        estimationStateSource->removeEstimationStateListener(this);
+        estimationStateSource = 0;
+    }
+    else
+    {
+        this->remappedControlBoardInterfaces.multwrap->detachAll();
     }
-
-    this->remappedControlBoardInterfaces.multwrap->detachAll();
 
     closePorts();
 
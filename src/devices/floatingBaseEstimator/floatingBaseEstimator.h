@@ -15,6 +15,10 @@
 
 #include <codyco/floatingBaseEstimatorRPC.h>
 
+#include "WholeBodyEstimationState.h"
+
+#include <ctrlLibRT/tripleBuffer.h>
+
 
 #include <vector>
 
@@ -33,10 +37,20 @@ namespace dev {
  * | modelFile      |      -         | path to file      |   -   | model.urdf    | No       | Path to the URDF file used for the kinematic and dynamic model.   |       |
  * | initialFixedFrame  | string | - | - | Yes | Name of a frame attached to the link that is assumed to be fixed at start | - |
  * | initialWorldFrame | string | - | Equal to initialFixedFrame | No | Name of the frame of the model that is supposed to be coincident with the world/inertial frame at start | - |
+ * | estimationStateSource | string | - | - | No | Key of the device passed to attachAll from which the joint positions are taken (composite mode) | The device must implement wholeBodyDynamics::IEstimationStateSource |
  *
  * The axes contained in the axesNames parameter are then mapped to the wrapped controlboard in the attachAll method, using controlBoardRemapper class.
  * Furthermore are also used to match the yarp axes to the joint names found in the passed URDF file.
  *
+ * If the estimationStateSource parameter is given, the device runs in composite mode: the device with that
+ * key in the list passed to attachAll (for example a wholeBodyDynamics device) is viewed as a
+ * wholeBodyDynamics::IEstimationStateSource, and the controlboards are not attached.
+ * At each cycle the source hands over the joint positions it has already read, that are copied in
+ * a lock-free buffer without blocking its thread. The odometry is then updated and published in the
+ * thread of this device, using the last positions received, so the encoders are read only once and the
+ * floating base estimate is computed on the same samples used for the joint torques and external wrenches
+ * estimation. The odometry only depends on the current joint positions, so a skipped sample is not an issue.
+ *
  *
  * \subsection ConfigurationExamples
  *
@@ -57,7 +71,8 @@ namespace dev {
 class floatingBaseEstimator :  public yarp::dev::DeviceDriver,
                                public yarp::dev::IMultipleWrapper,
                                public yarp::os::RateThread,
-                               public codyco::floatingBaseEstimatorRPC
+                               public codyco::floatingBaseEstimatorRPC,
+                               public wholeBodyDynamics::IEstimationStateListener
 {
 private:
     /**
@@ -96,6 +111,28 @@ private:
     } remappedControlBoardInterfaces;
 
 
+    /**
+     * Key of the device used as source of the joint positions in composite mode, empty otherwise.
+     */
+    std::string estimationStateSourceName;
+
+    /**
+     * Source of the joint positions in composite mode, 0 otherwise.
+     */
+    wholeBodyDynamics::IEstimationStateSource * estimationStateSource;
+
+    /**
+     * Joint positions (ordered as estimationJointNames) written by onNewEstimationState,
+     * in the thread of the source, and read by run.
+     */
+    iCub::ctrl::realTime::TripleBuffer<wholeBodyDynamics::EstimationState> estimationStateBuffer;
+
+    /**
+     * estimationStateSourceJointIndices[i] is the index in the EstimationState::jointPos
+     * vector of the i-th joint in estimationJointNames.
+     */
+    std::vector<size_t> estimationStateSourceJointIndices;
+
     /**
      * Mutex to protect the settings data structure, and all the data in
      * the class that is accessed by the run method, the attachAll methods
@@ -127,6 +164,12 @@ private:
      */
     bool attachAllControlBoard(const PolyDriverList& p);
 
+    /**
+     * Attach to the device with key estimationStateSourceName, that
+     * must implement the IEstimationStateSource interface (composite mode).
+     */
+    bool attachEstimationStateSource(const PolyDriverList& p);
+
     /**
      * Run-related methods.
      */
@@ -136,8 +179,19 @@ private:
      * the internal buffers, false otherwise.
      */
     void readSensors();
+
+    /**
+     * Copy in jointPos the last state received in composite mode.
+     * @return true if a new state was received since the previous call, false otherwise.
+     */
+    bool readEstimationState();
     void updateKinematics();
 
+    /**
+     * Update the odometry with the current jointPos and publish the estimates.
+     */
+    void estimateAndPublish();
+
     // Publish related methods
     void publishEstimatedQuantities();
     void publishFloatingBasePosInWBIFormat();
@@ -215,6 +269,9 @@ public:
 
     // RATE THREAD
     virtual void run();
+
+    // IESTIMATIONSTATELISTENER
+    virtual void onNewEstimationState(const wholeBodyDynamics::EstimationState & state);
 };
 
 }
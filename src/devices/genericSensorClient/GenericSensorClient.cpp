@@ -12,15 +12,19 @@
 #include <yarp/os/LogStream.h>
 #include <yarp/os/LockGuard.h>
 
+#include <ctrlLibRT/atomics.h>
+
+#include <algorithm>
 
 const int GS_ANALOG_TIMEOUT=100; //ms
 
 using namespace yarp::os;
+using namespace iCub::ctrl::realTime;
 
 inline void GSInputPortProcessor::resetStat()
 {
-    yarp::os::LockGuard guard(mutex);
-
+    // Statistics are accessed only by the port callback,
+    // this is called before the callback is started
     dataAvailable = false;
     count=0;
     deltaT=0;
@@ -30,7 +34,8 @@ inline void GSInputPortProcessor::resetStat()
     prev=now;
 }
 
-GSInputPortProcessor::GSInputPortProcessor()
+GSInputPortProcessor::GSInputPortProcessor(): latestSequenceNumber(0),
+                                              nrOfWaiters(0)
 {
     resetStat();
 }
@@ -39,8 +44,6 @@ void GSInputPortProcessor::onRead(yarp::sig::Vector &v)
 {
     now=Time::now();
 
-    yarp::os::LockGuard guard(mutex);
-
     if (count>0)
     {
         double tmpDT=now-prev;
@@ -76,59 +79,169 @@ void GSInputPortProcessor::onRead(yarp::sig::Vector &v)
     prev=now;
     count++;
 
-    lastVector=v;
     lastStamp.update();
 
+    // Fill the slot owned by the callback
+    GSSample & sample = lastSample.writeBuffer();
+    sample.vector = v;
+    sample.stamp = lastStamp;
+    sample.sequenceNumber = (unsigned long)count;
+    sample.receiveTime = now;
+    sample.dataAvailable = dataAvailable;
+    sample.count = count;
+    sample.deltaT = deltaT;
+    sample.deltaTMax = deltaTMax;
+    sample.deltaTMin = deltaTMin;
+
+    lastSample.publish();
+
+    atomicStore(&latestSequenceNumber,count);
+
+    // Wake up the consumers waiting for a new sample
+    if( atomicLoad(&nrOfWaiters) > 0 )
+    {
+        yarp::os::LockGuard guard(waitersMutex);
+
+        for(size_t i=0; i < waiters.size(); i++)
+        {
+            waiters[i]->post();
+        }
+    }
 }
 
 inline bool GSInputPortProcessor::getLast(yarp::sig::Vector &data, Stamp &stmp)
 {
-    yarp::os::LockGuard guard(mutex);
+    unsigned long sequenceNumber;
+    double receiveTime;
+    return getLast(data,stmp,sequenceNumber,receiveTime);
+}
+
+bool GSInputPortProcessor::getLast(yarp::sig::Vector& data, Stamp& stmp,
+                                   unsigned long& sequenceNumber, double& receiveTime)
+{
+    yarp::os::LockGuard guard(readersMutex);
+
+    lastSample.update();
 
-    if (dataAvailable)
+    const GSSample & sample = lastSample.readBuffer();
+
+    if (sample.dataAvailable)
     {
-        data=lastVector;
-        stmp = lastStamp;
+        data=sample.vector;
+        stmp = sample.stamp;
+        sequenceNumber = sample.sequenceNumber;
+        receiveTime = sample.receiveTime;
     }
 
-    return dataAvailable;
+    return sample.dataAvailable;
 }
 
-inline int GSInputPortProcessor::getIterations()
+unsigned long GSInputPortProcessor::getLatestSequenceNumber()
 {
-    yarp::os::LockGuard guard(mutex);
+    return (unsigned long)atomicLoad(&latestSequenceNumber);
+}
 
-    int ret=count;
-    return ret;
+bool GSInputPortProcessor::waitForNextSample(const unsigned long lastSequenceNumber, const double timeoutInSeconds)
+{
+    double deadline = Time::now()+timeoutInSeconds;
+    bool received = false;
+
+    // Semaphore posted by the callback for each sample received while it is registered:
+    // a post after the registration implies a new sample, so it never wakes up a later call
+    yarp::os::Semaphore newSampleSemaphore(0);
+
+    {
+        yarp::os::LockGuard guard(waitersMutex);
+        waiters.push_back(&newSampleSemaphore);
+        atomicIncrement(&nrOfWaiters);
+    }
+
+    while( true )
+    {
+        if( getLatestSequenceNumber() > lastSequenceNumber )
+        {
+            received = true;
+            break;
+        }
+
+        double remaining = deadline-Time::now();
+        if( remaining <= 0.0 )
+        {
+            break;
+        }
+
+        newSampleSemaphore.waitWithTimeout(remaining);
+    }
+
+    {
+        yarp::os::LockGuard guard(waitersMutex);
+        waiters.erase(std::find(waiters.begin(),waiters.end(),&newSampleSemaphore));
+        atomicAdd(&nrOfWaiters,-1);
+    }
+
+    return received;
+}
+
+double GSInputPortProcessor::getLastSampleAge()
+{
+    yarp::os::LockGuard guard(readersMutex);
+
+    lastSample.update();
+
+    const GSSample & sample = lastSample.readBuffer();
+
+    if( sample.sequenceNumber == 0 )
+    {
+        return -1.0;
+    }
+
+    return Time::now()-sample.receiveTime;
+}
+
+inline int GSInputPortProcessor::getIterations()
+{
+    return (int)getLatestSequenceNumber();
 }
 
 // time is in ms
 void GSInputPortProcessor::getEstFrequency(int &ite, double &av, double &min, double &max)
 {
-    yarp::os::LockGuard guard(mutex);
+    yarp::os::LockGuard guard(readersMutex);
 
-    ite=count;
-    min=deltaTMin*1000;
-    max=deltaTMax*1000;
-    if (count<1)
+    lastSample.update();
+
+    const GSSample & sample = lastSample.readBuffer();
+
+    ite=sample.count;
+    min=sample.deltaTMin*1000;
+    max=sample.deltaTMax*1000;
+    if (sample.count<1)
     {
         av=0;
     }
     else
     {
-        av=deltaT/count;
+        av=sample.deltaT/sample.count;
     }
     av=av*1000;
 }
 
 bool GSInputPortProcessor::getState()
 {
-    return dataAvailable;
+    yarp::os::LockGuard guard(readersMutex);
+
+    lastSample.update();
+
+    return lastSample.readBuffer().dataAvailable;
 }
 
 int GSInputPortProcessor::getChannels()
 {
-    return (int)lastVector.size();
+    yarp::os::LockGuard guard(readersMutex);
+
+    lastSample.update();
+
+    return (int)lastSample.readBuffer().vector.size();
 }
 
 
@@ -198,4 +311,19 @@ bool yarp::dev::GenericSensorClient::getChannels(int* nc)
 Stamp yarp::dev::GenericSensorClient::getLastInputStamp()
 {
     return lastTs;
-}
\ No newline at end of file
+}
+
+bool yarp::dev::GenericSensorClient::read(yarp::sig::Vector &out, unsigned long & sequenceNumber, double & receiveTime)
+{
+    return inputPort.getLast(out, lastTs, sequenceNumber, receiveTime);
+}
+
+bool yarp::dev::GenericSensorClient::waitForNextSample(const unsigned long lastSequenceNumber, const double timeoutInSeconds)
+{
+    return inputPort.waitForNextSample(lastSequenceNumber, timeoutInSeconds);
+}
+
+double yarp::dev::GenericSensorClient::getLastSampleAge()
+{
+    return inputPort.getLastSampleAge();
+}
@@ -13,28 +13,82 @@
 #include <yarp/dev/PreciselyTimed.h>
 #include <yarp/dev/GenericSensorInterfaces.h>
 #include <yarp/sig/Vector.h>
+#include <yarp/os/Mutex.h>
 #include <yarp/os/Semaphore.h>
 #include <yarp/os/Time.h>
 #include <yarp/dev/PolyDriver.h>
 
+#include <ctrlLibRT/tripleBuffer.h>
+
+#include <vector>
+
+/**
+ * Sample stored in the GSInputPortProcessor, together with the
+ * statistics of the port at the time in which the sample was received.
+ */
+struct GSSample
+{
+    yarp::sig::Vector vector;
+    yarp::os::Stamp stamp;
+
+    /**
+     * Monotonic sequence number of the sample (the first sample received is 1).
+     */
+    unsigned long sequenceNumber;
+
+    /**
+     * Time (as returned by yarp::os::Time::now) at which the sample was received.
+     */
+    double receiveTime;
+
+    bool dataAvailable;
+    int count;
+    double deltaT;
+    double deltaTMax;
+    double deltaTMin;
+
+    GSSample(): sequenceNumber(0), receiveTime(0.0), dataAvailable(false),
+                count(0), deltaT(0.0), deltaTMax(0.0), deltaTMin(1e22) {}
+};
+
 /**
  * Class copied from the InputPortProcessor class in AnalogSensorClient.
  * Once we port this in YARP we can merge this two classes.
+ *
+ * The last sample is exchanged between the port callback and the readers
+ * using a triple buffer: the callback never waits for the readers, and
+ * the readers never copy the sample while holding a lock shared with it. The statistics
+ * are computed in the callback and stored in the sample, so they are always consistent with it.
  */
 class GSInputPortProcessor : public yarp::os::BufferedPort<yarp::sig::Vector>
 {
-    yarp::os::Mutex mutex;
-    yarp::sig::Vector lastVector;
-    yarp::os::Stamp lastStamp;
+    /**
+     * Last sample: written by the port callback and read by the readers
+     * (serialized by readersMutex).
+     */
+    iCub::ctrl::realTime::TripleBuffer<GSSample> lastSample;
+    yarp::os::Mutex readersMutex;
+
+    // Statistics, accessed only by the port callback
     double deltaT;
     double deltaTMax;
     double deltaTMin;
     double prev;
     double now;
-
     bool dataAvailable;
-
     int count;
+    yarp::os::Stamp lastStamp;
+
+    volatile long latestSequenceNumber;
+
+    /**
+     * Semaphores of the threads blocked in waitForNextSample, each one posted once
+     * for each sample received while it is registered.
+     * nrOfWaiters is the size of waiters, read by the callback without locking waitersMutex.
+     */
+    std::vector<yarp::os::Semaphore *> waiters;
+    volatile long nrOfWaiters;
+    yarp::os::Mutex waitersMutex;
 
 public:
     inline void resetStat();
@@ -46,6 +100,30 @@ public:
 
     inline bool getLast(yarp::sig::Vector &data, yarp::os::Stamp &stmp);
 
+    /**
+     * Get the last sample, with its sequence number and receive time.
+     */
+    bool getLast(yarp::sig::Vector &data, yarp::os::Stamp &stmp,
+                 unsigned long & sequenceNumber, double & receiveTime);
+
+    /**
+     * Sequence number of the last sample received (0 if no sample was received),
+     * this method does not take any lock.
+     */
+    unsigned long getLatestSequenceNumber();
+
+    /**
+     * Wait until a sample with sequence number greater than lastSequenceNumber is received.
+     * @return true if the sample was received, false if the timeout (in seconds) expired.
+     */
+    bool waitForNextSample(const unsigned long lastSequenceNumber, const double timeoutInSeconds);
+
+    /**
+     * Time elapsed (in seconds) since the last sample was received, or a negative value if no
+     * sample was ever received.
+     */
+    double getLastSampleAge();
+
     inline int getIterations();
 
     // time is in ms
@@ -108,6 +186,24 @@ public:
 
     /* IPreciselyTimed methods */
     yarp::os::Stamp getLastInputStamp();
+
+    /**
+     * Read the last sample, with its sequence number and the time at which it was received.
+     */
+    bool read(yarp::sig::Vector &out, unsigned long & sequenceNumber, double & receiveTime);
+
+    /**
+     * Wait until a sample more recent than the one with sequence number lastSequenceNumber
+     * is received, for synchronizing a consumer to the arrival of the sensor samples.
+     * @return true if a new sample was received, false if the timeout (in seconds) expired.
+     */
+    bool waitForNextSample(const unsigned long lastSequenceNumber, const double timeoutInSeconds);
+
+    /**
+     * Time elapsed (in seconds) since the last sample was received, or a negative value if no
+     * sample was ever received.
+     */
+    double getLastSampleAge();
 };
 
 }
@@ -20,8 +20,12 @@
 
 #include <yarp/os/all.h>
 
+#include "ctrlLibRT/atomics.h"
+
 using namespace std;
 using namespace yarp::os;
+using iCub::ctrl::realTime::atomicExchange;
+using iCub::ctrl::realTime::atomicLoad;
 
 namespace yarp {
 namespace dev {
@@ -47,27 +51,59 @@ int findAndReturnIndex(std::vector<T>  &v, T &x)
 }
 
 
+// Called with controlModeMutex locked
 void JointTorqueControl::startHijackingTorqueControlIfNecessary(int j)
 {
-    if( !this->hijackingTorqueControl[j] )
+    if( !this->isHijackingTorqueControl(j) )
     {
-        desiredJointTorques(j) = measuredJointTorques(j);
-        this->hijackingTorqueControl[j] = true;
+        // Start from the measured torque, to avoid jumps in the control output.
+        // The reference is published before the flag, so the control
+        // loop sees both of them in the same cycle
+        double measuredJointTorque = 0.0;
+        this->PassThroughControlBoard::getTorque(j,&measuredJointTorque);
+        {
+            yarp::os::LockGuard guard(parametersMutex);
+            clientParameters.desiredJointTorques(j) = measuredJointTorque;
+            this->publishClientParameters();
+        }
+        atomicExchange(&(this->hijackingTorqueControl[j]),1);
     }
 }
 
+// Called with controlModeMutex locked
 void JointTorqueControl::stopHijackingTorqueControlIfNecessary(int j)
 {
 
-    if( this->hijackingTorqueControl[j] )
+    if( this->isHijackingTorqueControl(j) )
     {
-        this->hijackingTorqueControl[j] = false;
+        atomicExchange(&(this->hijackingTorqueControl[j]),0);
     }
 }
 
 bool JointTorqueControl::isHijackingTorqueControl(int j)
 {
-    return this->hijackingTorqueControl[j];
+    return atomicLoad(&(this->hijackingTorqueControl[j])) != 0;
+}
+
+// Called with parametersMutex locked
+void JointTorqueControl::publishClientParameters()
+{
+    parametersBuffer.writeBuffer() = clientParameters;
+    parametersBuffer.publish();
+}
+
+// Called by the control loop at the beginning of each cycle
+void JointTorqueControl::updateParametersFromClients()
+{
+    if( !parametersBuffer.update() )
+    {
+        return;
+    }
+
+    const JointTorqueControlParameters & parameters = parametersBuffer.readBuffer();
+    desiredJointTorques  = parameters.desiredJointTorques;
+    jointTorqueLoopGains = parameters.jointTorqueLoopGains;
+    motorParameters      = parameters.motorParameters;
 }
 
 
@@ -269,7 +305,8 @@ bool JointTorqueControl::open(yarp::os::Searchable& config)
     pass_through_controlboard_config.put("writeStrict","on");
     PassThroughControlBoard::open(pass_through_controlboard_config);
     this->getAxes(&axes);
-    hijackingTorqueControl.assign(axes,false);
+    hijackingTorqueControl.assign(axes,0);
+    hijackingTorqueControlInThisCycle.assign(axes,false);
     controlModesBuffer.resize(axes);
     motorParameters.resize(axes);
     jointTorqueLoopGains.resize(axes);
@@ -279,6 +316,7 @@ bool JointTorqueControl::open(yarp::os::Searchable& config)
     desiredJointTorques.resize(axes,0.0);
     measuredJointTorques.resize(axes,0.0);
     measuredJointPositionsTimestamps.resize(axes,0.0);
+    encodersInThisCycle.resize(encodersSnapshotAxes);
     jointControlOutput.resize(axes,0.0);
     jointTorquesError.resize(axes,0.0);
     oldJointTorquesError.resize(axes,0.0);
@@ -290,9 +328,23 @@ bool JointTorqueControl::open(yarp::os::Searchable& config)
     //Start control thread
     this->setRate(config.check("controlPeriod",10,"update period of the torque control thread (ms)").asInt());
 
+    //The encoder getters are served from the snapshot taken by the control loop at each cycle,
+    //unless the loop is late by more than one cycle
+    if( !config.check("encodersSnapshotMaxAge") )
+    {
+        this->setEncodersSnapshotMaxAge(2.0*this->getRate()*0.001);
+    }
+
     //Load Gains configurations
     bool ret = this->loadGains(config);
 
+    //The clients start from the loaded parameters
+    clientParameters.resize(axes);
+    clientParameters.desiredJointTorques  = desiredJointTorques;
+    clientParameters.jointTorqueLoopGains = jointTorqueLoopGains;
+    clientParameters.motorParameters      = motorParameters;
+    parametersBuffer.reset(clientParameters);
+
 
     //Load coupling matrices
     couplingMatrices.reset(this->axes);
@@ -362,10 +414,7 @@ bool JointTorqueControl::getControlMode(int j, int *mode)
     {
         return false;
     }
-    
-    yarp::os::LockGuard lock(globalMutex);
 
-    
     if( isHijackingTorqueControl(j) )
     {
         *mode = VOCAB_CM_TORQUE;
@@ -388,9 +437,7 @@ bool JointTorqueControl::getControlModes(int *modes)
     {
         return false;
     }
-    
-    yarp::os::LockGuard lock(globalMutex);
-    
+
     bool ret = proxyIControlMode2->getControlModes(modes);
     for(int j=0; j < this->axes; j++ )
     {
@@ -428,8 +475,6 @@ bool JointTorqueControl::getControlModes(const int n_joint, const int *joints, i
         return false;
     }
     
-    yarp::os::LockGuard lock(globalMutex);
-
     bool ret = proxyIControlMode2->getControlModes(n_joint,joints,modes);
 
     for(int i=0; i < n_joint; i++ )
@@ -454,7 +499,8 @@ bool JointTorqueControl::setControlMode(const int j, const int mode)
         return false;
     }
 
-    yarp::os::LockGuard lock(globalMutex);
+    // Only the mode transitions are serialized, the control loop reads the hijacking flags atomically
+    yarp::os::LockGuard lock(controlModeMutex);
 
     int new_mode = mode;
     if( new_mode == VOCAB_CM_TORQUE )
@@ -499,7 +545,7 @@ bool JointTorqueControl::setControlModes(const int n_joint, const int *joints, i
         return false;
     }
 
-    yarp::os::LockGuard lock(globalMutex);
+    yarp::os::LockGuard lock(controlModeMutex);
 
     for(int i=0; i < n_joint; i++ )
     {
@@ -537,8 +583,8 @@ bool JointTorqueControl::setControlModes(int *modes)
     {
         return false;
     }
-    
-    yarp::os::LockGuard lock(globalMutex);
+
+    yarp::os::LockGuard lock(controlModeMutex);
 
     for(int j=0; j < this->axes; j++ )
     {
@@ -596,102 +642,107 @@ bool JointTorqueControl::setVelocityMode()
 //TORQUE CONTROL
 bool JointTorqueControl::setRefTorque(int j, double t)
 {
-    yarp::os::LockGuard(this->globalMutex);
-    desiredJointTorques[j] = t;
+    yarp::os::LockGuard guard(this->parametersMutex);
+    clientParameters.desiredJointTorques[j] = t;
+    this->publishClientParameters();
     return true;
 }
 
 bool JointTorqueControl::setRefTorques(const double *t)
 {
-    yarp::os::LockGuard(this->globalMutex);
-    ::memcpy(desiredJointTorques.data(),t,this->axes*sizeof(double));
+    yarp::os::LockGuard guard(this->parametersMutex);
+    ::memcpy(clientParameters.desiredJointTorques.data(),t,this->axes*sizeof(double));
+    this->publishClientParameters();
     return true;
 }
 
 
 bool JointTorqueControl::getRefTorque(int j, double *t)
 {
-    yarp::os::LockGuard(this->globalMutex);
-    *t = desiredJointTorques[j];
+    yarp::os::LockGuard guard(this->parametersMutex);
+    *t = clientParameters.desiredJointTorques[j];
     return true;
 }
 
 bool JointTorqueControl::getRefTorques(double *t)
 {
-    yarp::os::LockGuard(this->globalMutex);
-    memcpy(t,desiredJointTorques.data(),this->axes*sizeof(double));
+    yarp::os::LockGuard guard(this->parametersMutex);
+    memcpy(t,clientParameters.desiredJointTorques.data(),this->axes*sizeof(double));
     return true;
 }
 
 bool JointTorqueControl::getTorque(int j, double *t)
 {
-    yarp::os::LockGuard(this->globalMutex);
-    *t = measuredJointTorques[j];
-    return true;
+    // The measured torques are read directly from the proxied control board,
+    // so that the clients do not access the buffers of the control loop
+    return this->PassThroughControlBoard::getTorque(j,t);
 }
 
 bool JointTorqueControl::getTorques(double *t)
 {
-    yarp::os::LockGuard(this->globalMutex);
-    memcpy(t,measuredJointTorques.data(),this->axes*sizeof(double));
-    return true;
+    return this->PassThroughControlBoard::getTorques(t);
 }
 
 bool JointTorqueControl::getBemfParam(int j, double *bemf)
 {
-    yarp::os::LockGuard(this->globalMutex);
-    *bemf = motorParameters[j].kv;
+    yarp::os::LockGuard guard(this->parametersMutex);
+    *bemf = clientParameters.motorParameters[j].kv;
     return true;
 }
 
 bool JointTorqueControl::setBemfParam(int j, double bemf)
 {
-    yarp::os::LockGuard(this->globalMutex);
-    motorParameters[j].kv = bemf;
+    yarp::os::LockGuard guard(this->parametersMutex);
+    clientParameters.motorParameters[j].kv = bemf;
+    this->publishClientParameters();
     return true;
 }
 
-bool JointTorqueControl::setTorquePid(int j, const Pid &pid)
+// Called with parametersMutex locked
+void JointTorqueControl::setClientTorquePid(int j, const Pid &pid)
 {
     //WARNING: the PID structure mixes up motor and joint information
     //WARNING: THIS COULD MAPPING COULD CHANGE AT ANY TIME
-    yarp::os::LockGuard(this->globalMutex);
     // Joint level torque loop gains
-    jointTorqueLoopGains[j].kp      = pid.kp;
-    jointTorqueLoopGains[j].kd      = pid.kd;
-    jointTorqueLoopGains[j].ki      = pid.ki;
-    jointTorqueLoopGains[j].max_int = pid.max_int;
+    clientParameters.jointTorqueLoopGains[j].kp      = pid.kp;
+    clientParameters.jointTorqueLoopGains[j].kd      = pid.kd;
+    clientParameters.jointTorqueLoopGains[j].ki      = pid.ki;
+    clientParameters.jointTorqueLoopGains[j].max_int = pid.max_int;
 
     // Motor level friction compensation parameters
-    motorParameters[j].kcp = pid.stiction_up_val;
-    motorParameters[j].kcn = pid.stiction_down_val;
-    motorParameters[j].kff = pid.kff;
+    clientParameters.motorParameters[j].kcp = pid.stiction_up_val;
+    clientParameters.motorParameters[j].kcn = pid.stiction_down_val;
+    clientParameters.motorParameters[j].kff = pid.kff;
+}
 
+bool JointTorqueControl::setTorquePid(int j, const Pid &pid)
+{
+    yarp::os::LockGuard guard(this->parametersMutex);
+    this->setClientTorquePid(j,pid);
+    this->publishClientParameters();
     return true;
 }
 
 bool JointTorqueControl::getTorqueRange(int j, double *min, double *max)
 {
-    yarp::os::LockGuard(this->globalMutex);
     return false;
 }
 
 bool JointTorqueControl::getTorqueRanges(double *min, double *max)
 {
-    yarp::os::LockGuard(this->globalMutex);
     return false;
 }
 
 bool JointTorqueControl::setTorquePids(const Pid *pids)
 {
-    yarp::os::LockGuard lock(globalMutex);
-
-    bool ret = true;
+    // All the gains are published together, so the control loop never uses a partially updated set
+    yarp::os::LockGuard guard(this->parametersMutex);
     for(int j=0; j < this->axes; j++)
     {
-        ret = ret && this->setTorquePid(j,pids[j]);
+        this->setClientTorquePid(j,pids[j]);
     }
-    return ret;
+    this->publishClientParameters();
+    return true;
 }
 
 bool JointTorqueControl::setTorqueErrorLimit(int j, double limit)
@@ -702,55 +753,46 @@ bool JointTorqueControl::setTorqueErrorLimit(int j, double limit)
 
 bool JointTorqueControl::setTorqueErrorLimits(const double *limits)
 {
-    yarp::os::LockGuard(this->globalMutex);
     return false;
 }
 
 bool JointTorqueControl::getTorqueError(int j, double *err)
 {
-    yarp::os::LockGuard(this->globalMutex);
     return false;
 }
 
 bool JointTorqueControl::getTorqueErrors(double *errs)
 {
-    yarp::os::LockGuard(this->globalMutex);
     return false;
 }
 
 bool JointTorqueControl::getTorquePidOutput(int j, double *out)
 {
-    yarp::os::LockGuard(this->globalMutex);
     return false;
 }
 
 bool JointTorqueControl::getTorquePidOutputs(double *outs)
 {
-    yarp::os::LockGuard(this->globalMutex);
     return false;
 }
 
 bool JointTorqueControl::getTorquePid(int j, Pid *pid)
 {
-    yarp::os::LockGuard(this->globalMutex);
     return false;
 }
 
 bool JointTorqueControl::getTorquePids(Pid *pids)
 {
-    yarp::os::LockGuard(this->globalMutex);
     return false;
 }
 
 bool JointTorqueControl::getTorqueErrorLimit(int j, double *limit)
 {
-    yarp::os::LockGuard(this->globalMutex);
     return false;
 }
 
 bool JointTorqueControl::getTorqueErrorLimits(double *limits)
 {
-    yarp::os::LockGuard(this->globalMutex);
     return false;
 }
 
@@ -790,8 +832,15 @@ bool JointTorqueControl::threadInit()
 
 void JointTorqueControl::readStatus()
 {
-    this->PassThroughControlBoard::getEncodersTimed(measuredJointPositions.data(),measuredJointPositionsTimestamps.data());
-    this->PassThroughControlBoard::getEncoderSpeeds(measuredJointVelocities.data());
+    // A single read of all the encoder quantities for each cycle, shared with the clients
+    this->refreshEncodersSnapshot(encodersInThisCycle);
+    const int encodersAxes = std::min(this->axes,static_cast<int>(encodersInThisCycle.positions.size()));
+    for(int j=0; j < encodersAxes; j++)
+    {
+        measuredJointPositions[j]           = encodersInThisCycle.positions[j];
+        measuredJointPositionsTimestamps[j] = encodersInThisCycle.timestamps[j];
+        measuredJointVelocities[j]          = encodersInThisCycle.speeds[j];
+    }
     this->PassThroughControlBoard::getTorques(measuredJointTorques.data());
 }
 
@@ -808,7 +857,6 @@ double JointTorqueControl::sign(double x)
 
 void JointTorqueControl::threadRelease()
 {
-    yarp::os::LockGuard guard(globalMutex);
 }
 
 inline Eigen::Map<Eigen::MatrixXd> toEigen(yarp::sig::Vector & vec)
@@ -891,10 +939,14 @@ void JointTorqueControl::computeOutputMotorTorques()
 
 void JointTorqueControl::run()
 {
-    // The control mutex protect concurrent access also to the
-    // hijacked control board methods, so it should protect also
-    // the readStatus method
-    yarp::os::LockGuard lock(globalMutex);
+    // The loop does not take any lock shared with the clients: the hijacking
+    // flags are read atomically, and the parameters modified by the clients
+    // are taken from the triple buffer at the beginning of the cycle
+    for(int j=0; j < this->axes; j++)
+    {
+        hijackingTorqueControlInThisCycle[j] = this->isHijackingTorqueControl(j);
+    }
+    this->updateParametersFromClients();
 
     //Read status (position, velocity, torque) from the controlboard
     this->readStatus();
@@ -902,7 +954,7 @@ void JointTorqueControl::run()
     if (!streamingOutput)
     {
         bool true_value = true;
-        if (!contains(hijackingTorqueControl,true_value) )
+        if (!contains(hijackingTorqueControlInThisCycle,true_value) )
         {
             return;
         }
@@ -929,7 +981,7 @@ void JointTorqueControl::run()
 
         //Send resulting output
         bool false_value = false;
-        if( !contains(hijackingTorqueControl,false_value) )
+        if( !contains(hijackingTorqueControlInThisCycle,false_value) )
         {
             this->setRefOutputs(jointControlOutput.data());
         }
@@ -937,7 +989,7 @@ void JointTorqueControl::run()
         {
             for(int j=0; j < this->axes; j++)
             {
-                if( hijackingTorqueControl[j] )
+                if( hijackingTorqueControlInThisCycle[j] )
                 {
                     this->setRefOutput(j,jointControlOutput[j]);
                 }
@@ -15,6 +15,7 @@
 #include <yarp/sig/Vector.h>
 
 #include "PassThroughControlBoard.h"
+#include "ctrlLibRT/tripleBuffer.h"
 #include <Eigen/Core>
 #include <vector>
 
@@ -134,18 +135,42 @@ struct JointTorqueLoopGains
     }
 };
 
+/**
+ * Parameters of the torque loop that can be modified by the clients of the device.
+ */
+struct JointTorqueControlParameters
+{
+    yarp::sig::Vector                 desiredJointTorques;
+    std::vector<JointTorqueLoopGains> jointTorqueLoopGains;
+    std::vector<MotorParameters>      motorParameters;
+
+    void resize(int NDOF)
+    {
+        desiredJointTorques.resize(NDOF,0.0);
+        jointTorqueLoopGains.resize(NDOF);
+        motorParameters.resize(NDOF);
+    }
+};
+
 class yarp::dev::JointTorqueControl :  public yarp::dev::PassThroughControlBoard,
                                        public yarp::os::RateThread
 {
 private:
     /**
      *  vector of getAxes() size.
-     *  For each axis contains true if we are hijacking the torque control
-     *  for this joint, or false otherwise.
+     *  For each axis contains 1 if we are hijacking the torque control
+     *  for this joint, or 0 otherwise.
+     *  The elements are read and written only with atomic operations,
+     *  so the control loop never waits for the clients changing the control mode.
      */
-    std::vector<bool> hijackingTorqueControl;
+    std::vector<long> hijackingTorqueControl;
     int axes;
 
+    /**
+     * Copy of hijackingTorqueControl taken by the control loop at the beginning of each cycle.
+     */
+    std::vector<bool> hijackingTorqueControlInThisCycle;
+
     std::vector<int>  controlModesBuffer;
 
     // if true, do not hijack and stream the PWMs on port
@@ -165,12 +190,27 @@ private:
     CouplingMatrices couplingMatricesFirmware;
 
     //joint torque loop methods & attributes
-    yarp::os::Mutex globalMutex; ///< mutex protecting control variables & proxy interface methods
+    yarp::os::Mutex controlModeMutex; ///< mutex serializing the control mode transitions (never taken by the control loop)
+    yarp::os::Mutex parametersMutex;  ///< mutex serializing the clients modifying the parameters (never taken by the control loop)
+
+    /**
+     * Parameters modified by the clients, protected by parametersMutex.
+     * After each modification they are published in parametersBuffer,
+     * that the control loop updates at the beginning of each cycle.
+     */
+    JointTorqueControlParameters                     clientParameters;
+    iCub::ctrl::realTime::TripleBuffer<JointTorqueControlParameters> parametersBuffer;
+
+    void publishClientParameters();
+    void updateParametersFromClients();
+    void setClientTorquePid(int j, const yarp::dev::Pid &pid);
 
+    // Parameters used by the control loop
     std::vector<JointTorqueLoopGains>                jointTorqueLoopGains;
     std::vector<MotorParameters> 		             motorParameters;
     yarp::sig::Vector                                desiredJointTorques;
     yarp::sig::Vector                                measuredJointTorques;
+    EncodersSnapshot                                 encodersInThisCycle; ///< encoders read by the control loop and shared with the clients
     yarp::sig::Vector                                measuredJointPositionsTimestamps;
     yarp::sig::Vector                                measuredJointPositions;
     yarp::sig::Vector                                measuredJointVelocities;
@@ -1,9 +1,24 @@
 #include "PassThroughControlBoard.h"
 #include <yarp/os/Property.h>
+#include <yarp/os/LockGuard.h>
+#include <yarp/os/Time.h>
+
+#include <algorithm>
 
 namespace yarp {
 namespace dev {
 
+void PassThroughControlBoard::EncodersSnapshot::resize(const int axes)
+{
+    positions.assign(axes,0.0);
+    timestamps.assign(axes,0.0);
+    speeds.assign(axes,0.0);
+    accelerations.assign(axes,0.0);
+    readTime = 0.0;
+    valid = false;
+    hasAccelerations = false;
+}
+
 PassThroughControlBoard::PassThroughControlBoard()
     : proxyIEncodersTimed(0)
     , proxyIPositionControl2(0)
@@ -15,6 +30,9 @@ PassThroughControlBoard::PassThroughControlBoard()
     , proxyIInteractionMode(0)
     , proxyIAxisInfo(0)
     , proxyIPidControl(0)
+    , encodersSnapshotAxes(0)
+    , encodersSnapshotAccelerations(false)
+    , encodersSnapshotMaxAge(0.0)
 {
 }
 
@@ -55,9 +73,93 @@ bool PassThroughControlBoard::open(yarp::os::Searchable& config)
     proxyDevice.view(proxyIInteractionMode);
     proxyDevice.view(proxyIAxisInfo);
 
+    // The getters are served from the snapshot only if someone refreshes it
+    encodersSnapshotMaxAge = config.check("encodersSnapshotMaxAge",yarp::os::Value(0.0)).asDouble();
+    encodersSnapshotAccelerations = config.check("encodersSnapshotAccelerations",yarp::os::Value(false)).asBool();
+    encodersSnapshotAxes = 0;
+    if( proxyIPositionControl2 )
+    {
+        proxyIPositionControl2->getAxes(&encodersSnapshotAxes);
+    }
+    EncodersSnapshot emptySnapshot;
+    emptySnapshot.resize(encodersSnapshotAxes);
+    encodersSnapshot.reset(emptySnapshot);
+
     return true;
 }
 
+bool PassThroughControlBoard::readEncodersSnapshot(EncodersSnapshot & snapshot)
+{
+    if( static_cast<int>(snapshot.positions.size()) != encodersSnapshotAxes )
+    {
+        snapshot.resize(encodersSnapshotAxes);
+    }
+
+    bool ok = proxyIEncodersTimed->getEncodersTimed(&(snapshot.positions[0]),&(snapshot.timestamps[0]));
+    ok = proxyIEncodersTimed->getEncoderSpeeds(&(snapshot.speeds[0])) && ok;
+    snapshot.hasAccelerations = encodersSnapshotAccelerations;
+    if( encodersSnapshotAccelerations )
+    {
+        ok = proxyIEncodersTimed->getEncoderAccelerations(&(snapshot.accelerations[0])) && ok;
+    }
+    snapshot.readTime = yarp::os::Time::now();
+    snapshot.valid = ok;
+
+    return ok;
+}
+
+bool PassThroughControlBoard::refreshEncodersSnapshot()
+{
+    if( !proxyIEncodersTimed || encodersSnapshotAxes <= 0 )
+    {
+        return false;
+    }
+
+    yarp::os::LockGuard guard(encodersSnapshotWriterMutex);
+
+    bool ok = readEncodersSnapshot(encodersSnapshot.writeBuffer());
+    encodersSnapshot.publish();
+
+    return ok;
+}
+
+bool PassThroughControlBoard::refreshEncodersSnapshot(EncodersSnapshot & snapshot)
+{
+    if( !proxyIEncodersTimed || encodersSnapshotAxes <= 0 )
+    {
+        return false;
+    }
+
+    // The snapshot is owned by the caller, so it is read without lock
+    bool ok = readEncodersSnapshot(snapshot);
+
+    yarp::os::LockGuard guard(encodersSnapshotWriterMutex);
+    encodersSnapshot.writeBuffer() = snapshot;
+    encodersSnapshot.publish();
+
+    return ok;
+}
+
+void PassThroughControlBoard::setEncodersSnapshotMaxAge(const double maxAge)
+{
+    yarp::os::LockGuard guard(encodersSnapshotReadersMutex);
+    encodersSnapshotMaxAge = maxAge;
+}
+
+// Called with encodersSnapshotReadersMutex locked
+bool PassThroughControlBoard::acquireEncodersSnapshot()
+{
+    if( encodersSnapshotMaxAge <= 0.0 )
+    {
+        return false;
+    }
+
+    encodersSnapshot.update();
+
+    const EncodersSnapshot & snapshot = encodersSnapshot.readBuffer();
+    return snapshot.valid && (yarp::os::Time::now() - snapshot.readTime <= encodersSnapshotMaxAge);
+}
+
 bool PassThroughControlBoard::close()
 {
     return proxyDevice.close();
@@ -65,6 +167,16 @@ bool PassThroughControlBoard::close()
 
 bool PassThroughControlBoard::getEncoder(int j, double* v)
 {
+    if( j >= 0 && j < encodersSnapshotAxes )
+    {
+        yarp::os::LockGuard guard(encodersSnapshotReadersMutex);
+        if( acquireEncodersSnapshot() )
+        {
+            *v = encodersSnapshot.readBuffer().positions[j];
+            return true;
+        }
+    }
+
     if( !proxyIEncodersTimed )
     {
         return false;
@@ -74,6 +186,16 @@ bool PassThroughControlBoard::getEncoder(int j, double* v)
 
 bool PassThroughControlBoard::getEncoders(double* encs)
 {
+    {
+        yarp::os::LockGuard guard(encodersSnapshotReadersMutex);
+        if( acquireEncodersSnapshot() )
+        {
+            const std::vector<double> & positions = encodersSnapshot.readBuffer().positions;
+            std::copy(positions.begin(),positions.end(),encs);
+            return true;
+        }
+    }
+
     if( !proxyIEncodersTimed )
     {
         return false;
@@ -119,6 +241,16 @@ bool PassThroughControlBoard::setEncoders(const double* vals)
 
 bool PassThroughControlBoard::getEncoderSpeed(int j, double* sp)
 {
+    if( j >= 0 && j < encodersSnapshotAxes )
+    {
+        yarp::os::LockGuard guard(encodersSnapshotReadersMutex);
+        if( acquireEncodersSnapshot() )
+        {
+            *sp = encodersSnapshot.readBuffer().speeds[j];
+            return true;
+        }
+    }
+
     if( !proxyIEncodersTimed )
     {
         return false;
@@ -128,6 +260,16 @@ bool PassThroughControlBoard::getEncoderSpeed(int j, double* sp)
 
 bool PassThroughControlBoard::getEncoderSpeeds(double* spds)
 {
+    {
+        yarp::os::LockGuard guard(encodersSnapshotReadersMutex);
+        if( acquireEncodersSnapshot() )
+        {
+            const std::vector<double> & speeds = encodersSnapshot.readBuffer().speeds;
+            std::copy(speeds.begin(),speeds.end(),spds);
+            return true;
+        }
+    }
+
     if( !proxyIEncodersTimed )
     {
         return false;
@@ -137,6 +279,16 @@ bool PassThroughControlBoard::getEncoderSpeeds(double* spds)
 
 bool PassThroughControlBoard::getEncoderAcceleration(int j, double* spds)
 {
+    if( j >= 0 && j < encodersSnapshotAxes )
+    {
+        yarp::os::LockGuard guard(encodersSnapshotReadersMutex);
+        if( acquireEncodersSnapshot() && encodersSnapshot.readBuffer().hasAccelerations )
+        {
+            *spds = encodersSnapshot.readBuffer().accelerations[j];
+            return true;
+        }
+    }
+
     if( !proxyIEncodersTimed )
     {
         return false;
@@ -146,6 +298,16 @@ bool PassThroughControlBoard::getEncoderAcceleration(int j, double* spds)
 
 bool PassThroughControlBoard::getEncoderAccelerations(double* accs)
 {
+    {
+        yarp::os::LockGuard guard(encodersSnapshotReadersMutex);
+        if( acquireEncodersSnapshot() && encodersSnapshot.readBuffer().hasAccelerations )
+        {
+            const std::vector<double> & accelerations = encodersSnapshot.readBuffer().accelerations;
+            std::copy(accelerations.begin(),accelerations.end(),accs);
+            return true;
+        }
+    }
+
     if( !proxyIEncodersTimed )
     {
         return false;
@@ -156,6 +318,17 @@ bool PassThroughControlBoard::getEncoderAccelerations(double* accs)
     // ENCODERS TIMED
 bool PassThroughControlBoard::getEncodersTimed(double* encs, double* time)
 {
+    {
+        yarp::os::LockGuard guard(encodersSnapshotReadersMutex);
+        if( acquireEncodersSnapshot() )
+        {
+            const EncodersSnapshot & snapshot = encodersSnapshot.readBuffer();
+            std::copy(snapshot.positions.begin(),snapshot.positions.end(),encs);
+            std::copy(snapshot.timestamps.begin(),snapshot.timestamps.end(),time);
+            return true;
+        }
+    }
+
     if( !proxyIEncodersTimed )
     {
         return false;
@@ -165,6 +338,18 @@ bool PassThroughControlBoard::getEncodersTimed(double* encs, double* time)
 
 bool PassThroughControlBoard::getEncoderTimed(int j, double* encs, double* time)
 {
+    if( j >= 0 && j < encodersSnapshotAxes )
+    {
+        yarp::os::LockGuard guard(encodersSnapshotReadersMutex);
+        if( acquireEncodersSnapshot() )
+        {
+            const EncodersSnapshot & snapshot = encodersSnapshot.readBuffer();
+            *encs = snapshot.positions[j];
+            *time = snapshot.timestamps[j];
+            return true;
+        }
+    }
+
     if( !proxyIEncodersTimed )
     {
         return false;
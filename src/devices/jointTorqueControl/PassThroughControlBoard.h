@@ -11,7 +11,11 @@
 #include <yarp/dev/IOpenLoopControl.h>
 #include <yarp/dev/IControlLimits2.h>
 #include <yarp/dev/PolyDriver.h>
+#include <yarp/os/Mutex.h>
 
+#include "ctrlLibRT/tripleBuffer.h"
+
+#include <vector>
 
 namespace yarp {
     namespace dev {
@@ -30,6 +34,24 @@ class yarp::dev::PassThroughControlBoard :  public DeviceDriver,
                                             public IAxisInfo,
                                             public IPidControl
 {
+public:
+    /**
+     * Encoder quantities of all the axes, read together from the proxied device.
+     */
+    struct EncodersSnapshot
+    {
+        std::vector<double> positions;
+        std::vector<double> timestamps;    ///< timestamps of the positions, as returned by getEncodersTimed
+        std::vector<double> speeds;
+        std::vector<double> accelerations;
+        double readTime;                   ///< yarp::os::Time::now() at the end of the read
+        bool valid;                        ///< true if all the quantities were read correctly
+        bool hasAccelerations;             ///< true if the accelerations were read (see encodersSnapshotAccelerations)
+
+        EncodersSnapshot(): readTime(0.0), valid(false), hasAccelerations(false) {}
+        void resize(const int axes);
+    };
+
 protected:
     yarp::dev::PolyDriver proxyDevice;
     yarp::dev::IEncodersTimed * proxyIEncodersTimed;
@@ -43,6 +65,42 @@ protected:
     yarp::dev::IAxisInfo *        proxyIAxisInfo;
     yarp::dev::IPidControl *      proxyIPidControl;
 
+    /**
+     * Last snapshot of the encoders, exchanged without locks between the thread
+     * calling refreshEncodersSnapshot (the writer) and the clients calling the
+     * encoder getters (the readers), through a triple buffer. The readers are
+     * serialized by encodersSnapshotReadersMutex, the writers by encodersSnapshotWriterMutex.
+     */
+    iCub::ctrl::realTime::TripleBuffer<EncodersSnapshot> encodersSnapshot;
+    yarp::os::Mutex  encodersSnapshotWriterMutex;
+    yarp::os::Mutex  encodersSnapshotReadersMutex;
+    int              encodersSnapshotAxes;
+
+    /**
+     * If true the snapshot also contains the accelerations, otherwise
+     * the acceleration getters are always forwarded to the proxied device.
+     */
+    bool             encodersSnapshotAccelerations;
+
+    /**
+     * The encoder getters are served from the snapshot if it is younger than
+     * encodersSnapshotMaxAge seconds, otherwise they are forwarded to the proxied device.
+     * A non-positive value disables the snapshot.
+     */
+    double           encodersSnapshotMaxAge;
+
+    /**
+     * Take the last published snapshot, if any.
+     * Called with encodersSnapshotReadersMutex locked.
+     * @return true if the snapshot can be used to serve the getters, false otherwise.
+     */
+    bool acquireEncodersSnapshot();
+
+    /**
+     * Read the encoder quantities of all the axes from the proxied device.
+     */
+    bool readEncodersSnapshot(EncodersSnapshot & snapshot);
+
 public:
     //CONSTRUCTOR
     PassThroughControlBoard();
@@ -52,6 +110,33 @@ public:
     virtual bool open(yarp::os::Searchable& config);
     virtual bool close();
 
+    //ENCODERS SNAPSHOT
+    /**
+     * Read positions (with their timestamps), speeds and, if encodersSnapshotAccelerations
+     * is set in the configuration, accelerations of all the axes from the proxied device,
+     * and publish them as the new snapshot
+     * used to serve the encoder getters.
+     * Typically called once for each control cycle by a single thread, for
+     * example the JointTorqueControl loop. Can be called by any thread to force a fresh read.
+     * @return true if all the quantities were read correctly, false otherwise.
+     */
+    bool refreshEncodersSnapshot();
+
+    /**
+     * Same as refreshEncodersSnapshot(), also returning the snapshot that has been published.
+     * @param snapshot buffer owned by the caller, in which the quantities are read.
+     *                 It is resized only if its size is not the number of axes.
+     * @return true if all the quantities were read correctly, false otherwise.
+     */
+    bool refreshEncodersSnapshot(EncodersSnapshot & snapshot);
+
+    /**
+     * Set the maximum age of the snapshot used to serve the encoder getters.
+     * @param maxAge maximum age in seconds. A non-positive value disables the snapshot,
+     *               so that all the getters are forwarded to the proxied device.
+     */
+    void setEncodersSnapshotMaxAge(const double maxAge);
+
     //ENCODERS
     virtual bool getEncoder(int j, double* v);
     virtual bool getEncoders(double* encs);
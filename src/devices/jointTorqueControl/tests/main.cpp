@@ -0,0 +1,439 @@
+/*
+ * Copyright (C) 2016 Fondazione Istituto Italiano di Tecnologia
+ * CopyPolicy: Released under the terms of the LGPLv2.1 or later, see LGPL.TXT
+ */
+
+/*
+ * Jitter test of the JointTorqueControl loop.
+ *
+ * The JointTorqueControl device is opened on top of a fake control board (served by a
+ * controlboardwrapper2 on local ports, so no yarpserver is needed), with all the joints in
+ * torque mode. The period of the control loop is measured first without clients, and then while
+ * several threads continuously call the methods of the device (reference torques, gains,
+ * control modes, with the last joint going back and forth between torque and position mode).
+ * The test fails if the loop does not use the last reference torque set by the clients.
+ * The period statistics depend on the load of the machine, so by default they are only
+ * reported; with --checkTiming the test also fails if the clients increase the average period
+ * or its standard deviation more than the specified thresholds.
+ *
+ * Parameters: --axes (default 6), --controlPeriod (ms, default 10), --duration (s, default 4.0),
+ *             --clients (default 4), --checkTiming, --maxPeriodIncrease (ms, default 2.0),
+ *             --maxPeriodStdDev (ms, default 3.0)
+ */
+
+#include "JointTorqueControl.h"
+
+#include <yarp/os/Network.h>
+#include <yarp/os/LogStream.h>
+#include <yarp/os/Mutex.h>
+#include <yarp/os/LockGuard.h>
+#include <yarp/os/Property.h>
+#include <yarp/os/Thread.h>
+#include <yarp/os/Time.h>
+#include <yarp/dev/Drivers.h>
+#include <yarp/dev/PolyDriver.h>
+#include <yarp/dev/ControlBoardInterfaces.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+    /* Control board keeping the last control modes and outputs in memory, with zero measured torques */
+    class FakeTorqueControlBoard : public yarp::dev::DeviceDriver,
+                                   public yarp::dev::IEncodersTimed,
+                                   public yarp::dev::IPositionControl,
+                                   public yarp::dev::IVelocityControl,
+                                   public yarp::dev::IControlMode2,
+                                   public yarp::dev::ITorqueControl,
+                                   public yarp::dev::IOpenLoopControl
+    {
+        int m_axes;
+        std::vector<int> m_modes;
+        std::vector<double> m_outputs;
+        std::vector<double> m_refTorques;
+        yarp::os::Mutex m_mutex;
+
+        bool setMode(int j, int mode)
+        {
+            if (j < 0 || j >= m_axes) return false;
+            yarp::os::LockGuard guard(m_mutex);
+            m_modes[j] = mode;
+            return true;
+        }
+
+        bool fill(double *v, double value)
+        {
+            for (int j = 0; j < m_axes; j++) v[j] = value;
+            return true;
+        }
+
+    public:
+        FakeTorqueControlBoard(): m_axes(0) {}
+
+        /* DeviceDriver methods */
+        virtual bool open(yarp::os::Searchable& config)
+        {
+            m_axes = config.check("axes", yarp::os::Value(6)).asInt();
+            m_modes.assign(m_axes, VOCAB_CM_POSITION);
+            m_outputs.assign(m_axes, 0.0);
+            m_refTorques.assign(m_axes, 0.0);
+            return m_axes > 0;
+        }
+        virtual bool close() { return true; }
+
+        /* IEncodersTimed methods */
+        virtual bool getAxes(int *ax) { *ax = m_axes; return true; }
+        virtual bool resetEncoder(int j) { return true; }
+        virtual bool resetEncoders() { return true; }
+        virtual bool setEncoder(int j, double val) { return true; }
+        virtual bool setEncoders(const double *vals) { return true; }
+        virtual bool getEncoder(int j, double *v) { *v = 0.0; return true; }
+        virtual bool getEncoders(double *encs) { return fill(encs, 0.0); }
+        virtual bool getEncoderSpeed(int j, double *sp) { *sp = 0.0; return true; }
+        virtual bool getEncoderSpeeds(double *spds) { return fill(spds, 0.0); }
+        virtual bool getEncoderAcceleration(int j, double *spds) { *spds = 0.0; return true; }
+        virtual bool getEncoderAccelerations(double *accs) { return fill(accs, 0.0); }
+        virtual bool getEncodersTimed(double *encs, double *time)
+        {
+            fill(time, yarp::os::Time::now());
+            return fill(encs, 0.0);
+        }
+        virtual bool getEncoderTimed(int j, double *encs, double *time)
+        {
+            *time = yarp::os::Time::now();
+            *encs = 0.0;
+            return true;
+        }
+
+        /* IPositionControl and IVelocityControl methods */
+        virtual bool setPositionMode() { return true; }
+        virtual bool positionMove(int j, double ref) { return true; }
+        virtual bool positionMove(const double *refs) { return true; }
+        virtual bool relativeMove(int j, double delta) { return true; }
+        virtual bool relativeMove(const double *deltas) { return true; }
+        virtual bool checkMotionDone(int j, bool *flag) { *flag = true; return true; }
+        virtual bool checkMotionDone(bool *flag) { *flag = true; return true; }
+        virtual bool setRefSpeed(int j, double sp) { return true; }
+        virtual bool setRefSpeeds(const double *spds) { return true; }
+        virtual bool setRefAcceleration(int j, double acc) { return true; }
+        virtual bool setRefAccelerations(const double *accs) { return true; }
+        virtual bool getRefSpeed(int j, double *ref) { *ref = 0.0; return true; }
+        virtual bool getRefSpeeds(double *spds) { return fill(spds, 0.0); }
+        virtual bool getRefAcceleration(int j, double *acc) { *acc = 0.0; return true; }
+        virtual bool getRefAccelerations(double *accs) { return fill(accs, 0.0); }
+        virtual bool stop(int j) { return true; }
+        virtual bool stop() { return true; }
+        virtual bool setVelocityMode() { return true; }
+        virtual bool velocityMove(int j, double sp) { return true; }
+        virtual bool velocityMove(const double *sp) { return true; }
+
+        /* IControlMode2 methods */
+        virtual bool setPositionMode(int j) { return setMode(j, VOCAB_CM_POSITION); }
+        virtual bool setVelocityMode(int j) { return setMode(j, VOCAB_CM_VELOCITY); }
+        virtual bool setTorqueMode(int j) { return setMode(j, VOCAB_CM_TORQUE); }
+        virtual bool setImpedancePositionMode(int j) { return setMode(j, VOCAB_CM_IMPEDANCE_POS); }
+        virtual bool setImpedanceVelocityMode(int j) { return setMode(j, VOCAB_CM_IMPEDANCE_VEL); }
+        virtual bool setOpenLoopMode(int j) { return setMode(j, VOCAB_CM_OPENLOOP); }
+        virtual bool getControlMode(int j, int *mode)
+        {
+            if (j < 0 || j >= m_axes) return false;
+            yarp::os::LockGuard guard(m_mutex);
+            *mode = m_modes[j];
+            return true;
+        }
+        virtual bool getControlModes(int *modes)
+        {
+            yarp::os::LockGuard guard(m_mutex);
+            for (int j = 0; j < m_axes; j++) modes[j] = m_modes[j];
+            return true;
+        }
+        virtual bool getControlModes(const int n_joint, const int *joints, int *modes)
+        {
+            bool ok = true;
+            for (int i = 0; i < n_joint; i++) ok = getControlMode(joints[i], &modes[i]) && ok;
+            return ok;
+        }
+        virtual bool setControlMode(const int j, const int mode) { return setMode(j, mode); }
+        virtual bool setControlModes(const int n_joint, const int *joints, int *modes)
+        {
+            bool ok = true;
+            for (int i = 0; i < n_joint; i++) ok = setMode(joints[i], modes[i]) && ok;
+            return ok;
+        }
+        virtual bool setControlModes(int *modes)
+        {
+            bool ok = true;
+            for (int j = 0; j < m_axes; j++) ok = setMode(j, modes[j]) && ok;
+            return ok;
+        }
+
+        /* ITorqueControl methods */
+        virtual bool setTorqueMode() { return true; }
+        virtual bool setRefTorque(int j, double t)
+        {
+            yarp::os::LockGuard guard(m_mutex);
+            m_refTorques[j] = t;
+            return true;
+        }
+        virtual bool setRefTorques(const double *t)
+        {
+            yarp::os::LockGuard guard(m_mutex);
+            for (int j = 0; j < m_axes; j++) m_refTorques[j] = t[j];
+            return true;
+        }
+        virtual bool getRefTorque(int j, double *t)
+        {
+            yarp::os::LockGuard guard(m_mutex);
+            *t = m_refTorques[j];
+            return true;
+        }
+        virtual bool getRefTorques(double *t)
+        {
+            yarp::os::LockGuard guard(m_mutex);
+            for (int j = 0; j < m_axes; j++) t[j] = m_refTorques[j];
+            return true;
+        }
+        virtual bool getTorque(int j, double *t) { *t = 0.0; return true; }
+        virtual bool getTorques(double *t) { return fill(t, 0.0); }
+        virtual bool getBemfParam(int j, double *bemf) { *bemf = 0.0; return true; }
+        virtual bool setBemfParam(int j, double bemf) { return true; }
+        virtual bool setTorquePid(int j, const yarp::dev::Pid &pid) { return true; }
+        virtual bool getTorqueRange(int j, double *min, double *max) { *min = -100.0; *max = 100.0; return true; }
+        virtual bool getTorqueRanges(double *min, double *max) { fill(min, -100.0); return fill(max, 100.0); }
+        virtual bool setTorquePids(const yarp::dev::Pid *pids) { return true; }
+        virtual bool setTorqueErrorLimit(int j, double limit) { return true; }
+        virtual bool setTorqueErrorLimits(const double *limits) { return true; }
+        virtual bool getTorqueError(int j, double *err) { *err = 0.0; return true; }
+        virtual bool getTorqueErrors(double *errs) { return fill(errs, 0.0); }
+        virtual bool getTorquePidOutput(int j, double *out) { *out = 0.0; return true; }
+        virtual bool getTorquePidOutputs(double *outs) { return fill(outs, 0.0); }
+        virtual bool getTorquePid(int j, yarp::dev::Pid *pid) { return true; }
+        virtual bool getTorquePids(yarp::dev::Pid *pids) { return true; }
+        virtual bool getTorqueErrorLimit(int j, double *limit) { *limit = 0.0; return true; }
+        virtual bool getTorqueErrorLimits(double *limits) { return fill(limits, 0.0); }
+        virtual bool resetTorquePid(int j) { return true; }
+        virtual bool disableTorquePid(int j) { return true; }
+        virtual bool enableTorquePid(int j) { return true; }
+        virtual bool setTorqueOffset(int j, double v) { return true; }
+
+        /* IOpenLoopControl methods */
+        virtual bool setRefOutput(int j, double v)
+        {
+            yarp::os::LockGuard guard(m_mutex);
+            m_outputs[j] = v;
+            return true;
+        }
+        virtual bool setRefOutputs(const double *v)
+        {
+            yarp::os::LockGuard guard(m_mutex);
+            for (int j = 0; j < m_axes; j++) m_outputs[j] = v[j];
+            return true;
+        }
+        virtual bool getRefOutput(int j, double *v)
+        {
+            yarp::os::LockGuard guard(m_mutex);
+            *v = m_outputs[j];
+            return true;
+        }
+        virtual bool getRefOutputs(double *v)
+        {
+            yarp::os::LockGuard guard(m_mutex);
+            for (int j = 0; j < m_axes; j++) v[j] = m_outputs[j];
+            return true;
+        }
+        virtual bool getOutput(int j, double *v) { return getRefOutput(j, v); }
+        virtual bool getOutputs(double *v) { return getRefOutputs(v); }
+        virtual bool setOpenLoopMode() { return true; }
+    };
+
+    /* Client continuously calling the methods of the JointTorqueControl device */
+    class Client : public yarp::os::Thread
+    {
+        yarp::dev::JointTorqueControl & m_device;
+        int m_axes;
+        bool m_doModeTransitions;
+        long m_nrOfCalls;
+
+    public:
+        Client(yarp::dev::JointTorqueControl & device, int axes, bool doModeTransitions)
+        : m_device(device)
+        , m_axes(axes)
+        , m_doModeTransitions(doModeTransitions)
+        , m_nrOfCalls(0) {}
+
+        long nrOfCalls() const { return m_nrOfCalls; }
+
+        virtual void run()
+        {
+            std::vector<double> torques(m_axes);
+            std::vector<int> modes(m_axes);
+            yarp::dev::Pid pid(1.0, 0.0, 0.0, 100.0, 10.0, 100.0);
+            pid.kff = 1.0;
+            int iteration = 0;
+
+            while (!isStopping()) {
+                for (int j = 0; j < m_axes; j++) {
+                    torques[j] = std::sin(0.01 * iteration + j);
+                }
+                m_device.setRefTorques(&torques[0]);
+                m_device.getRefTorques(&torques[0]);
+                m_device.setTorquePid(iteration % m_axes, pid);
+                m_device.getControlModes(&modes[0]);
+                m_nrOfCalls += 4;
+
+                if (m_doModeTransitions && m_axes > 1) {
+                    //Genuine transitions only on the last joint, the others stay in torque mode
+                    m_device.setControlMode(m_axes - 1, iteration % 2 ? VOCAB_CM_TORQUE : VOCAB_CM_POSITION);
+                    m_nrOfCalls++;
+                }
+                iteration++;
+            }
+        }
+    };
+
+    void measurePeriod(yarp::dev::JointTorqueControl & device, double duration,
+                       double & average, double & stdDeviation)
+    {
+        device.resetStat();
+        yarp::os::Time::delay(duration);
+        device.getEstPeriod(average, stdDeviation);
+    }
+
+    std::string listOf(int size, double value)
+    {
+        std::ostringstream list;
+        list << "(";
+        for (int j = 0; j < size; j++) {
+            list << (j ? " " : "") << value;
+        }
+        list << ")";
+        return list.str();
+    }
+}
+
+int main(int argc, char **argv)
+{
+    // The test does not need a yarpserver: all the ports are local
+    yarp::os::Network::setLocalMode(true);
+    yarp::os::Network yarpNetwork;
+
+    yarp::os::Property options;
+    options.fromCommand(argc, argv);
+
+    const int axes = options.check("axes", yarp::os::Value(6)).asInt();
+    const int controlPeriod = options.check("controlPeriod", yarp::os::Value(10)).asInt();
+    const double duration = options.check("duration", yarp::os::Value(4.0)).asDouble();
+    const int nrOfClients = options.check("clients", yarp::os::Value(4)).asInt();
+    const double maxPeriodIncrease = options.check("maxPeriodIncrease", yarp::os::Value(2.0)).asDouble();
+    const double maxPeriodStdDev = options.check("maxPeriodStdDev", yarp::os::Value(3.0)).asDouble();
+    const bool checkTiming = options.check("checkTiming");
+
+    if (axes <= 0 || controlPeriod <= 0 || duration <= 0 || nrOfClients <= 0) {
+        yError("Invalid parameters");
+        return EXIT_FAILURE;
+    }
+
+    yarp::dev::Drivers::factory().add(new yarp::dev::DriverCreatorOf<FakeTorqueControlBoard>("fakeTorqueControlBoard",
+                                                                                             "controlboardwrapper2",
+                                                                                             "FakeTorqueControlBoard"));
+
+    yarp::os::Property wrapperOptions;
+    wrapperOptions.put("device", "controlboardwrapper2");
+    wrapperOptions.put("subdevice", "fakeTorqueControlBoard");
+    wrapperOptions.put("name", "/jitterTest/fakeBoard");
+    wrapperOptions.put("axes", axes);
+    wrapperOptions.put("period", 5);
+
+    yarp::dev::PolyDriver wrapper;
+    if (!wrapper.open(wrapperOptions)) {
+        yError("Impossible to open the fake control board");
+        return EXIT_FAILURE;
+    }
+
+    std::ostringstream config;
+    config << "(proxy_remote /jitterTest/fakeBoard) (proxy_local /jitterTest/jointTorqueControl) "
+           << "(controlPeriod " << controlPeriod << ") "
+           << "(TRQ_PIDS (kff " << listOf(axes, 1.0) << ") (kp " << listOf(axes, 1.0) << ") "
+           << "(ki " << listOf(axes, 0.0) << ") (maxPwm " << listOf(axes, 100.0) << ") "
+           << "(maxInt " << listOf(axes, 10.0) << ") (stictionUp " << listOf(axes, 0.0) << ") "
+           << "(stictionDown " << listOf(axes, 0.0) << ") (bemf " << listOf(axes, 0.0) << ") "
+           << "(coulombVelThr " << listOf(axes, 1.0) << ") (frictionCompensation " << listOf(axes, 0.0) << "))";
+    yarp::os::Property jointTorqueControlOptions;
+    jointTorqueControlOptions.fromString(config.str());
+
+    yarp::dev::JointTorqueControl device;
+    if (!device.open(jointTorqueControlOptions)) {
+        yError("Impossible to open the jointTorqueControl device");
+        wrapper.close();
+        return EXIT_FAILURE;
+    }
+
+    std::vector<int> modes(axes, VOCAB_CM_TORQUE);
+    device.setControlModes(&modes[0]);
+
+    //Loop period without clients
+    double idleAverage = 0, idleStdDeviation = 0;
+    yarp::os::Time::delay(0.5);
+    measurePeriod(device, duration / 2, idleAverage, idleStdDeviation);
+
+    //Loop period with the clients
+    std::vector<Client *> clients;
+    for (int i = 0; i < nrOfClients; i++) {
+        clients.push_back(new Client(device, axes, i == 0));
+        clients.back()->start();
+    }
+    double loadedAverage = 0, loadedStdDeviation = 0;
+    measurePeriod(device, duration / 2, loadedAverage, loadedStdDeviation);
+
+    long nrOfCalls = 0;
+    for (int i = 0; i < nrOfClients; i++) {
+        clients[i]->stop();
+        nrOfCalls += clients[i]->nrOfCalls();
+        delete clients[i];
+    }
+
+    //The loop must use the last reference set by the clients
+    device.setControlModes(&modes[0]);
+    device.setRefTorque(0, 5.0);
+    yarp::os::Time::delay(10 * controlPeriod * 0.001);
+    double refTorque = 0, output = 0;
+    device.getRefTorque(0, &refTorque);
+    device.getRefOutput(0, &output);
+
+    device.close();
+    wrapper.close();
+
+    printf("%-30s %12s %12s\n", "jointTorqueControl loop", "period (ms)", "std dev (ms)");
+    printf("%-30s %12.3f %12.3f\n", "without clients", idleAverage, idleStdDeviation);
+    printf("%-30s %12.3f %12.3f\n", "with clients", loadedAverage, loadedStdDeviation);
+    printf("%d clients, %ld calls (%.0f calls/s)\n", nrOfClients, nrOfCalls, nrOfCalls / (duration / 2));
+
+    bool ok = true;
+    if (loadedAverage - idleAverage > maxPeriodIncrease) {
+        if (checkTiming) {
+            yError("The clients increased the loop period by %g ms (max %g ms)", loadedAverage - idleAverage, maxPeriodIncrease);
+            ok = false;
+        } else {
+            yWarning("The clients increased the loop period by %g ms (max %g ms)", loadedAverage - idleAverage, maxPeriodIncrease);
+        }
+    }
+    if (loadedStdDeviation > maxPeriodStdDev) {
+        if (checkTiming) {
+            yError("Standard deviation of the loop period with clients %g ms (max %g ms)", loadedStdDeviation, maxPeriodStdDev);
+            ok = false;
+        } else {
+            yWarning("Standard deviation of the loop period with clients %g ms (max %g ms)", loadedStdDeviation, maxPeriodStdDev);
+        }
+    }
+    // With zero measured torque and unitary gains the output is twice the reference
+    if (refTorque != 5.0 || std::fabs(output - 10.0) > 1e-6) {
+        yError("Reference torque %g and control output %g, expected 5 and 10", refTorque, output);
+        ok = false;
+    }
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,370 @@
+#include "FTCalibrationWorker.h"
+
+#include <yarp/os/LockGuard.h>
+#include <yarp/os/LogStream.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace wholeBodyDynamics
+{
+
+const size_t ftCalibrationWorker_nrOfChannelsOfFTSensor = 6;
+
+FTCalibrationWorker::FTCalibrationWorker(): m_nrOfFTSensors(0),
+                                            m_queueHead(0),
+                                            m_queueTail(0),
+                                            m_queueCount(0),
+                                            m_nrOfDroppedSamples(0),
+                                            m_acceptingSamples(false),
+                                            m_acceptedCalibrationId(0),
+                                            m_newSampleAvailable(0),
+                                            m_newCalibrationRequested(false),
+                                            m_requestedCalibrationId(0),
+                                            m_requestedNrOfSamples(0),
+                                            m_resultsAvailable(false),
+                                            m_offsetEstimator(FT_OFFSET_MEAN),
+                                            m_trimFraction(0.0),
+                                            m_activeCalibrationId(0),
+                                            m_activeCalibrationFinished(true),
+                                            m_nrOfSamplesToUse(0),
+                                            m_nrOfSamplesUsedUntilNow(0)
+{
+}
+
+FTCalibrationWorker::~FTCalibrationWorker()
+{
+}
+
+bool FTCalibrationWorker::init(const iDynTree::Model& model,
+                               const iDynTree::SensorsList& sensors,
+                               const size_t queueSize,
+                               const FTOffsetEstimator offsetEstimator,
+                               const double trimFraction)
+{
+    if( queueSize == 0 )
+    {
+        yError() << "wholeBodyDynamics : FTCalibrationWorker the queue size should be positive";
+        return false;
+    }
+
+    if( trimFraction < 0.0 || trimFraction >= 0.5 )
+    {
+        yError() << "wholeBodyDynamics : FTCalibrationWorker the trim fraction should be in [0,0.5)";
+        return false;
+    }
+
+    bool ok = m_estimator.setModelAndSensors(model,sensors);
+    if( !ok )
+    {
+        yError() << "wholeBodyDynamics : FTCalibrationWorker error in loading the model";
+        return false;
+    }
+
+    m_offsetEstimator = offsetEstimator;
+    m_trimFraction = trimFraction;
+    m_nrOfFTSensors = sensors.getNrOfSensors(iDynTree::SIX_AXIS_FORCE_TORQUE);
+
+    iDynTree::Wrench zeroWrench;
+    zeroWrench.zero();
+
+    m_queue.resize(queueSize);
+    for(size_t i=0; i < queueSize; i++)
+    {
+        m_queue[i].jointPos.resize(model);
+        m_queue[i].jointVel.resize(model);
+        m_queue[i].jointAcc.resize(model);
+        m_queue[i].measuredFT.resize(m_nrOfFTSensors,zeroWrench);
+    }
+    m_queueHead = m_queueTail = m_queueCount = 0;
+
+    m_requestedCalibratingFTsensor.resize(m_nrOfFTSensors,false);
+    m_requestedContactLocations.resize(model);
+    m_offsets.resize(m_nrOfFTSensors,zeroWrench);
+
+    m_calibratingFTsensor.resize(m_nrOfFTSensors,false);
+    m_assumedContactLocations.resize(model);
+    m_offsetSamples.resize(m_nrOfFTSensors,std::vector< std::vector<double> >(ftCalibrationWorker_nrOfChannelsOfFTSensor));
+    m_measurementSumBuffer.resize(m_nrOfFTSensors,zeroWrench.asVector());
+    m_estimationSumBuffer.resize(m_nrOfFTSensors,zeroWrench.asVector());
+    m_computedOffsets.resize(m_nrOfFTSensors,zeroWrench);
+
+    m_predictedSensorMeasurements.resize(sensors);
+    m_predictedJointTorques.resize(model);
+    m_predictedExternalContactWrenches.resize(model);
+
+    return true;
+}
+
+void FTCalibrationWorker::startCalibration(const iDynTree::LinkUnknownWrenchContacts& assumedContactLocations,
+                                           const std::vector<bool>& calibratingFTsensor,
+                                           const size_t nrOfSamples)
+{
+    unsigned long calibrationId;
+
+    {
+        yarp::os::LockGuard guard(m_calibrationMutex);
+        m_requestedContactLocations = assumedContactLocations;
+        m_requestedCalibratingFTsensor = calibratingFTsensor;
+        m_requestedNrOfSamples = nrOfSamples;
+        m_requestedCalibrationId++;
+        m_newCalibrationRequested = true;
+        m_resultsAvailable = false;
+        calibrationId = m_requestedCalibrationId;
+    }
+
+    {
+        yarp::os::LockGuard guard(m_queueMutex);
+        m_acceptedCalibrationId = calibrationId;
+        m_acceptingSamples = true;
+    }
+}
+
+FTCalibrationSample* FTCalibrationWorker::beginPush()
+{
+    yarp::os::LockGuard guard(m_queueMutex);
+
+    if( !m_acceptingSamples )
+    {
+        return 0;
+    }
+
+    if( m_queueCount == m_queue.size() )
+    {
+        m_nrOfDroppedSamples++;
+        return 0;
+    }
+
+    FTCalibrationSample * sample = &(m_queue[m_queueTail]);
+    sample->calibrationId = m_acceptedCalibrationId;
+    return sample;
+}
+
+void FTCalibrationWorker::endPush()
+{
+    {
+        yarp::os::LockGuard guard(m_queueMutex);
+        m_queueTail = (m_queueTail+1) % m_queue.size();
+        m_queueCount++;
+    }
+
+    m_newSampleAvailable.post();
+}
+
+bool FTCalibrationWorker::getCalibrationResults(std::vector<iDynTree::Wrench>& offsets)
+{
+    yarp::os::LockGuard guard(m_calibrationMutex);
+
+    if( !m_resultsAvailable )
+    {
+        return false;
+    }
+
+    offsets = m_offsets;
+    m_resultsAvailable = false;
+    return true;
+}
+
+size_t FTCalibrationWorker::getNrOfDroppedSamples()
+{
+    yarp::os::LockGuard guard(m_queueMutex);
+
+    return m_nrOfDroppedSamples;
+}
+
+void FTCalibrationWorker::activateRequestedCalibration()
+{
+    yarp::os::LockGuard guard(m_calibrationMutex);
+
+    if( !m_newCalibrationRequested )
+    {
+        return;
+    }
+
+    m_newCalibrationRequested = false;
+    m_activeCalibrationId = m_requestedCalibrationId;
+    m_activeCalibrationFinished = false;
+    m_nrOfSamplesToUse = m_requestedNrOfSamples;
+    m_nrOfSamplesUsedUntilNow = 0;
+    m_calibratingFTsensor = m_requestedCalibratingFTsensor;
+    m_assumedContactLocations = m_requestedContactLocations;
+
+    for(size_t ft = 0; ft < m_nrOfFTSensors; ft++)
+    {
+        for(size_t ch = 0; ch < ftCalibrationWorker_nrOfChannelsOfFTSensor; ch++)
+        {
+            m_offsetSamples[ft][ch].clear();
+            m_offsetSamples[ft][ch].reserve(m_nrOfSamplesToUse);
+        }
+        m_measurementSumBuffer[ft].zero();
+        m_estimationSumBuffer[ft].zero();
+    }
+    m_sortBuffer.reserve(m_nrOfSamplesToUse);
+}
+
+void FTCalibrationWorker::processSample(const FTCalibrationSample& sample)
+{
+    activateRequestedCalibration();
+
+    // Samples of a calibration that was replaced or that already ended are discarded
+    if( m_activeCalibrationFinished || sample.calibrationId != m_activeCalibrationId )
+    {
+        return;
+    }
+
+    bool ok;
+    if( sample.useFixedFrame )
+    {
+        ok = m_estimator.updateKinematicsFromFixedBase(sample.jointPos,sample.jointVel,sample.jointAcc,
+                                                       sample.kinematicFrame,sample.fixedFrameGravity);
+    }
+    else
+    {
+        ok = m_estimator.updateKinematicsFromFloatingBase(sample.jointPos,sample.jointVel,sample.jointAcc,
+                                                          sample.kinematicFrame,sample.imuLinProperAcc,
+                                                          sample.imuAngularVel,sample.imuAngularAcc);
+    }
+
+    ok = ok && m_estimator.computeExpectedFTSensorsMeasurements(m_assumedContactLocations,
+                                                                m_predictedSensorMeasurements,
+                                                                m_predictedExternalContactWrenches,
+                                                                m_predictedJointTorques);
+
+    if( !ok )
+    {
+        yWarning() << "wholeBodyDynamics : FTCalibrationWorker error in computing the expected F/T measurements, sample discarded";
+        return;
+    }
+
+    for(size_t ft = 0; ft < m_nrOfFTSensors; ft++)
+    {
+        if( m_calibratingFTsensor[ft] )
+        {
+            iDynTree::Wrench estimatedFT;
+            m_predictedSensorMeasurements.getMeasurement(iDynTree::SIX_AXIS_FORCE_TORQUE,ft,estimatedFT);
+            const iDynTree::Wrench & measuredFT = sample.measuredFT[ft];
+
+            for(size_t ch = 0; ch < ftCalibrationWorker_nrOfChannelsOfFTSensor; ch++)
+            {
+                m_offsetSamples[ft][ch].push_back(measuredFT(ch)-estimatedFT(ch));
+                m_measurementSumBuffer[ft](ch) += measuredFT(ch);
+                m_estimationSumBuffer[ft](ch) += estimatedFT(ch);
+            }
+        }
+    }
+
+    m_nrOfSamplesUsedUntilNow++;
+
+    if( m_nrOfSamplesUsedUntilNow >= m_nrOfSamplesToUse )
+    {
+        m_activeCalibrationFinished = true;
+
+        // Stop collecting samples, unless a new calibration was started in the meanwhile
+        {
+            yarp::os::LockGuard guard(m_queueMutex);
+            if( m_acceptedCalibrationId == m_activeCalibrationId )
+            {
+                m_acceptingSamples = false;
+            }
+        }
+
+        this->computeOffsetsAndPublish();
+    }
+}
+
+double FTCalibrationWorker::estimateChannelOffset(const std::vector<double>& samples)
+{
+    size_t nrOfSamples = samples.size();
+    size_t nrOfDiscardedSamples = 0;
+
+    m_sortBuffer = samples;
+
+    if( m_offsetEstimator == FT_OFFSET_TRIMMED_MEAN )
+    {
+        nrOfDiscardedSamples = (size_t) std::floor(m_trimFraction*nrOfSamples);
+        std::sort(m_sortBuffer.begin(),m_sortBuffer.end());
+    }
+
+    double sum = 0.0;
+    for(size_t i = nrOfDiscardedSamples; i < nrOfSamples-nrOfDiscardedSamples; i++)
+    {
+        sum += m_sortBuffer[i];
+    }
+
+    return sum/(nrOfSamples-2*nrOfDiscardedSamples);
+}
+
+void FTCalibrationWorker::computeOffsetsAndPublish()
+{
+    for(size_t ft = 0; ft < m_nrOfFTSensors; ft++)
+    {
+        if( m_calibratingFTsensor[ft] )
+        {
+            iDynTree::Wrench measurementMean, estimationMean;
+            for(size_t ch = 0; ch < ftCalibrationWorker_nrOfChannelsOfFTSensor; ch++)
+            {
+                m_computedOffsets[ft](ch) = estimateChannelOffset(m_offsetSamples[ft][ch]);
+                measurementMean(ch) = m_measurementSumBuffer[ft](ch)/m_nrOfSamplesUsedUntilNow;
+                estimationMean(ch) = m_estimationSumBuffer[ft](ch)/m_nrOfSamplesUsedUntilNow;
+            }
+
+            yInfo() << "wholeBodyDynamics: Offset for sensor " << m_estimator.sensors().getSensor(iDynTree::SIX_AXIS_FORCE_TORQUE,ft)->getName() << " " << m_computedOffsets[ft].toString();
+            yInfo() << "wholeBodyDynamics: obtained assuming a measurement of " << measurementMean.asVector().toString() << " and an estimated ft of " << estimationMean.asVector().toString();
+        }
+    }
+
+    yarp::os::LockGuard guard(m_calibrationMutex);
+
+    // If a new calibration was requested while computing, these results are obsolete
+    if( m_newCalibrationRequested )
+    {
+        return;
+    }
+
+    m_offsets = m_computedOffsets;
+    m_resultsAvailable = true;
+}
+
+void FTCalibrationWorker::run()
+{
+    while( !isStopping() )
+    {
+        m_newSampleAvailable.wait();
+
+        if( isStopping() )
+        {
+            break;
+        }
+
+        FTCalibrationSample * sample = 0;
+        {
+            yarp::os::LockGuard guard(m_queueMutex);
+            if( m_queueCount > 0 )
+            {
+                sample = &(m_queue[m_queueHead]);
+            }
+        }
+
+        if( sample == 0 )
+        {
+            continue;
+        }
+
+        // The slot is released only after the processing, so the producer can not overwrite it
+        this->processSample(*sample);
+
+        {
+            yarp::os::LockGuard guard(m_queueMutex);
+            m_queueHead = (m_queueHead+1) % m_queue.size();
+            m_queueCount--;
+        }
+    }
+}
+
+void FTCalibrationWorker::onStop()
+{
+    // Wake up the thread if it is waiting for samples
+    m_newSampleAvailable.post();
+}
+
+}
@@ -0,0 +1,215 @@
+#ifndef CODYCO_FT_CALIBRATION_WORKER_H
+#define CODYCO_FT_CALIBRATION_WORKER_H
+
+// YARP includes
+#include <yarp/os/Mutex.h>
+#include <yarp/os/Semaphore.h>
+#include <yarp/os/Thread.h>
+
+// iDynTree includes
+#include <iDynTree/Estimation/ExtWrenchesAndJointTorquesEstimator.h>
+
+#include <vector>
+
+namespace wholeBodyDynamics
+{
+
+/**
+ * Snapshot of the quantities used for computing the offset
+ * of the F/T sensors in a single estimation cycle.
+ */
+struct FTCalibrationSample
+{
+    /**
+     * If true the kinematics is given by the gravity on a fixed frame,
+     * otherwise by the IMU measurements on the IMU frame.
+     */
+    bool useFixedFrame;
+    iDynTree::FrameIndex kinematicFrame;
+    iDynTree::Vector3 fixedFrameGravity;
+    iDynTree::Vector3 imuLinProperAcc;
+    iDynTree::Vector3 imuAngularVel;
+    iDynTree::Vector3 imuAngularAcc;
+
+    iDynTree::JointPosDoubleArray  jointPos;
+    iDynTree::JointDOFsDoubleArray jointVel;
+    iDynTree::JointDOFsDoubleArray jointAcc;
+
+    /**
+     * Raw F/T measurements, with only the secondary calibration matrix applied.
+     */
+    std::vector<iDynTree::Wrench> measuredFT;
+
+    /**
+     * Calibration to which the sample belongs.
+     */
+    unsigned long calibrationId;
+};
+
+/**
+ * Estimator used to compute the offset from the collected samples.
+ */
+enum FTOffsetEstimator
+{
+    /**
+     * Mean of the offset samples.
+     */
+    FT_OFFSET_MEAN,
+    /**
+     * For each channel, mean of the offset samples after discarding
+     * the trimFraction lowest and the trimFraction highest values.
+     * Robust to the outliers due to the robot being bumped or moved during calibration.
+     */
+    FT_OFFSET_TRIMMED_MEAN
+};
+
+/**
+ * Thread computing the offset of the F/T sensors out of the estimation loop.
+ *
+ * The estimation loop only copies the snapshot of the current state in a
+ * bounded queue (beginPush/endPush, that never block and never allocate),
+ * while the expected F/T measurements are computed by this thread with its
+ * own estimator, so the calibration never extends the estimation cycle.
+ * If the queue is full the snapshot is dropped, and the calibration just
+ * uses a later sample.
+ *
+ * The worker needs its own estimator, and so its own copy of the model:
+ * iDynTree::ExtWrenchesAndJointTorquesEstimator owns the model and keeps the
+ * kinematic state of the last update, so it cannot be shared with the estimation
+ * loop that runs concurrently. The copy is allocated once in init().
+ */
+class FTCalibrationWorker : public yarp::os::Thread
+{
+private:
+    iDynTree::ExtWrenchesAndJointTorquesEstimator m_estimator;
+    size_t m_nrOfFTSensors;
+
+    /**
+     * Ring buffer of samples: the producer writes m_queue[m_queueTail],
+     * the worker reads m_queue[m_queueHead]. The indices are protected by m_queueMutex,
+     * while the slots are accessed without lock (each slot is owned either by
+     * the producer or by the worker).
+     * m_queueMutex is never held during computations, so that beginPush and endPush
+     * do not wait for the worker.
+     */
+    std::vector<FTCalibrationSample> m_queue;
+    size_t m_queueHead;
+    size_t m_queueTail;
+    size_t m_queueCount;
+    size_t m_nrOfDroppedSamples;
+    bool m_acceptingSamples;
+    unsigned long m_acceptedCalibrationId;
+    yarp::os::Mutex m_queueMutex;
+    yarp::os::Semaphore m_newSampleAvailable;
+
+    /**
+     * Calibration requested by startCalibration and results of the
+     * last calibration, protected by m_calibrationMutex.
+     */
+    yarp::os::Mutex m_calibrationMutex;
+    bool m_newCalibrationRequested;
+    unsigned long m_requestedCalibrationId;
+    size_t m_requestedNrOfSamples;
+    std::vector<bool> m_requestedCalibratingFTsensor;
+    iDynTree::LinkUnknownWrenchContacts m_requestedContactLocations;
+    bool m_resultsAvailable;
+    std::vector<iDynTree::Wrench> m_offsets;
+
+    FTOffsetEstimator m_offsetEstimator;
+    double m_trimFraction;
+
+    /**
+     * Calibration in progress, accessed only by the worker thread.
+     */
+    unsigned long m_activeCalibrationId;
+    bool m_activeCalibrationFinished;
+    size_t m_nrOfSamplesToUse;
+    size_t m_nrOfSamplesUsedUntilNow;
+    std::vector<bool> m_calibratingFTsensor;
+    iDynTree::LinkUnknownWrenchContacts m_assumedContactLocations;
+
+    /**
+     * m_offsetSamples[ft][channel] contains the offset samples of the channel of the sensor.
+     */
+    std::vector< std::vector< std::vector<double> > > m_offsetSamples;
+    std::vector<iDynTree::Vector6> m_measurementSumBuffer;
+    std::vector<iDynTree::Vector6> m_estimationSumBuffer;
+    std::vector<iDynTree::Wrench> m_computedOffsets;
+
+    /**
+     * Buffers used by the worker thread.
+     */
+    iDynTree::SensorsMeasurements  m_predictedSensorMeasurements;
+    iDynTree::JointDOFsDoubleArray m_predictedJointTorques;
+    iDynTree::LinkContactWrenches  m_predictedExternalContactWrenches;
+    std::vector<double> m_sortBuffer;
+
+    void activateRequestedCalibration();
+    void processSample(const FTCalibrationSample & sample);
+    void computeOffsetsAndPublish();
+    double estimateChannelOffset(const std::vector<double> & samples);
+
+public:
+    FTCalibrationWorker();
+    virtual ~FTCalibrationWorker();
+
+    /**
+     * Allocate the worker.
+     * Must be called before starting the thread.
+     *
+     * @param[in] model model used by the estimation.
+     * @param[in] sensors sensors used by the estimation.
+     * @param[in] queueSize maximum number of samples waiting to be processed.
+     * @param[in] offsetEstimator estimator used to compute the offset from the samples.
+     * @param[in] trimFraction fraction of samples discarded at each side when FT_OFFSET_TRIMMED_MEAN is used (in [0,0.5) ).
+     */
+    bool init(const iDynTree::Model & model,
+              const iDynTree::SensorsList & sensors,
+              const size_t queueSize,
+              const FTOffsetEstimator offsetEstimator,
+              const double trimFraction);
+
+    /**
+     * Start a new calibration, discarding the one in progress (if any).
+     *
+     * @param[in] assumedContactLocations contacts assumed to be acting on the robot during the calibration.
+     * @param[in] calibratingFTsensor calibratingFTsensor[ft] is true if the offset of sensor ft is computed.
+     * @param[in] nrOfSamples number of samples used to compute the offset.
+     */
+    void startCalibration(const iDynTree::LinkUnknownWrenchContacts & assumedContactLocations,
+                          const std::vector<bool> & calibratingFTsensor,
+                          const size_t nrOfSamples);
+
+    /**
+     * Get a free slot of the queue, to be filled with the current state and
+     * then committed with endPush.
+     * Never blocks: returns 0 if the queue is full or there is no calibration in progress.
+     */
+    FTCalibrationSample * beginPush();
+
+    /**
+     * Make the slot returned by the last beginPush available to the worker.
+     */
+    void endPush();
+
+    /**
+     * If a calibration has finished since the last call, get the computed offsets.
+     * Only the elements of the sensors that were calibrated are meaningful.
+     *
+     * @return true if the offsets are available, false otherwise.
+     */
+    bool getCalibrationResults(std::vector<iDynTree::Wrench> & offsets);
+
+    /**
+     * Number of samples dropped because the queue was full.
+     */
+    size_t getNrOfDroppedSamples();
+
+    // THREAD
+    virtual void run();
+    virtual void onStop();
+};
+
+}
+
+#endif
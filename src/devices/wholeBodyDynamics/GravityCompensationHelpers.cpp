@@ -12,12 +12,15 @@ using namespace iDynTree;
 namespace wholeBodyDynamics
 {
 
-GravityCompensationHelper::GravityCompensationHelper(): m_model(),
+GravityCompensationHelper::GravityCompensationHelper(): m_model(0),
                                                         m_isModelValid(false),
                                                         m_isKinematicsUpdated(false),
+                                                        m_isKinematicsPropagated(false),
+                                                        m_floatingFrame(FRAME_INVALID_INDEX),
+                                                        m_properClassicalLinearAcceleration(),
                                                         m_dynamicTraversal(),
                                                         m_kinematicTraversals(),
-                                                        m_jointPos(),
+                                                        m_jointPos(0),
                                                         m_linkVels(),
                                                         m_linkProperAccs(),
                                                         m_linkIntWrenches(),
@@ -53,12 +56,13 @@ void GravityCompensationHelper::freeKinematicTraversals()
 
 bool GravityCompensationHelper::loadModel(const Model& _model, const std::string dynamicBase)
 {
-    m_model = _model;
+    m_model = &_model;
+    m_jointPos = 0;
 
     // resize the data structures
-    iDynTree::LinkIndex dynamicBaseIndex = m_model.getLinkIndex(dynamicBase);
+    iDynTree::LinkIndex dynamicBaseIndex = m_model->getLinkIndex(dynamicBase);
 
-    bool ok = m_model.computeFullTreeTraversal(m_dynamicTraversal,dynamicBaseIndex);
+    bool ok = m_model->computeFullTreeTraversal(m_dynamicTraversal,dynamicBaseIndex);
 
     if( !ok )
     {
@@ -67,19 +71,22 @@ bool GravityCompensationHelper::loadModel(const Model& _model, const std::string
     }
 
     freeKinematicTraversals();
-    allocKinematicTraversals(m_model.getNrOfLinks());
+    allocKinematicTraversals(m_model->getNrOfLinks());
 
-    m_jointPos.resize(m_model);
-    m_jointDofsZero.resize(m_model);
+    m_jointDofsZero.resize(*m_model);
     m_jointDofsZero.zero();
-    m_linkVels.resize(m_model);
-    m_linkProperAccs.resize(m_model);
-    m_linkIntWrenches.resize(m_model);
-    m_linkNetExternalWrenchesZero.resize(m_model);
-    m_generalizedTorques.resize(m_model);
+    m_linkVels.resize(*m_model);
+    m_linkProperAccs.resize(*m_model);
+    m_linkIntWrenches.resize(*m_model);
+    m_linkNetExternalWrenchesZero.resize(*m_model);
+    m_generalizedTorques.resize(*m_model);
 
     // set that the model is valid
     m_isModelValid = true;
+    m_isKinematicsUpdated = false;
+    m_isKinematicsPropagated = false;
+
+    return true;
 }
 
 
@@ -116,24 +123,37 @@ bool GravityCompensationHelper::updateKinematicsFromProperAcceleration(const Joi
     }
 
     if( floatingFrame == FRAME_INVALID_INDEX ||
-        floatingFrame < 0 || floatingFrame >= m_model.getNrOfFrames() )
+        floatingFrame < 0 || floatingFrame >= m_model->getNrOfFrames() )
     {
         reportError("ExtWrenchesAndJointTorquesEstimator","updateKinematicsFromProperAcceleration","Unknown frame index specified.");
         return false;
     }
 
+    // Store the kinematic information, it will be propagated only if the torques are requested
+    m_jointPos = &jointPos;
+    m_floatingFrame = floatingFrame;
+    m_properClassicalLinearAcceleration = properClassicalLinearAcceleration;
+
+    m_isKinematicsUpdated = true;
+    m_isKinematicsPropagated = false;
+
+    return true;
+}
+
+bool GravityCompensationHelper::propagateKinematics()
+{
     // Get link of the specified frame
-    LinkIndex floatingLinkIndex = m_model.getFrameLink(floatingFrame);
+    LinkIndex floatingLinkIndex = m_model->getFrameLink(m_floatingFrame);
 
     // Build the traversal if it is not present
     if( m_kinematicTraversals[floatingLinkIndex]->getNrOfVisitedLinks() == 0 )
     {
-        m_model.computeFullTreeTraversal(*m_kinematicTraversals[floatingLinkIndex],floatingLinkIndex);
+        m_model->computeFullTreeTraversal(*m_kinematicTraversals[floatingLinkIndex],floatingLinkIndex);
     }
 
     // To initialize the kinematic propagation, we should first convert the kinematics
     // information from the frame in which they are specified to the main frame of the link
-    Transform link_H_frame = m_model.getFrameTransform(floatingFrame);
+    Transform link_H_frame = m_model->getFrameTransform(m_floatingFrame);
 
     Twist      base_vel_frame, base_vel_link;
     SpatialAcc base_acc_frame, base_acc_link;
@@ -147,7 +167,7 @@ bool GravityCompensationHelper::updateKinematicsFromProperAcceleration(const Joi
 
     base_vel_link = link_H_frame*base_vel_frame;
 
-    base_acc_frame.setLinearVec3(properClassicalLinearAcceleration);
+    base_acc_frame.setLinearVec3(m_properClassicalLinearAcceleration);
     base_acc_frame.setAngularVec3(zero3);
 
     base_acc_link = link_H_frame*base_acc_frame;
@@ -155,25 +175,16 @@ bool GravityCompensationHelper::updateKinematicsFromProperAcceleration(const Joi
     base_classical_acc_link.fromSpatial(base_acc_link,base_vel_link);
 
     // Propagate the kinematics information
-    bool ok = dynamicsEstimationForwardVelAccKinematics(m_model,*(m_kinematicTraversals[floatingLinkIndex]),
+    bool ok = dynamicsEstimationForwardVelAccKinematics(*m_model,*(m_kinematicTraversals[floatingLinkIndex]),
                                                      base_classical_acc_link.getLinearVec3(),
                                                      base_vel_link.getAngularVec3(),
                                                      base_classical_acc_link.getAngularVec3(),
-                                                     jointPos,m_jointDofsZero,m_jointDofsZero,
+                                                     *m_jointPos,m_jointDofsZero,m_jointDofsZero,
                                                      m_linkVels,m_linkProperAccs);
 
-    // Store joint positions
-    m_jointPos = jointPos;
+    m_isKinematicsPropagated = ok;
 
-    if( !ok )
-    {
-        return false;
-    }
-    else
-    {
-        m_isKinematicsUpdated = true;
-        return true;
-    }
+    return ok;
 }
 
 bool GravityCompensationHelper::getGravityCompensationTorques(JointDOFsDoubleArray & jointTrqs)
@@ -192,10 +203,20 @@ bool GravityCompensationHelper::getGravityCompensationTorques(JointDOFsDoubleArr
         return false;
     }
 
+    /**
+     * Propagate the kinematics, if it was not already done for the current kinematic information
+     */
+    if( !m_isKinematicsPropagated && !propagateKinematics() )
+    {
+        reportError("GravityCompensationHelper","getGravityCompensationTorques",
+                    "Error in propagating the kinematic information.");
+        return false;
+    }
+
     /**
      * Compute joint torques
      */
-    bool ok = RNEADynamicPhase(m_model,m_dynamicTraversal,m_jointPos,m_linkVels,m_linkProperAccs,
+    bool ok = RNEADynamicPhase(*m_model,m_dynamicTraversal,*m_jointPos,m_linkVels,m_linkProperAccs,
                                 m_linkNetExternalWrenchesZero,m_linkIntWrenches,m_generalizedTorques);
 
     if( !ok )
@@ -19,14 +19,35 @@ namespace wholeBodyDynamics
  * as negligible the non-gravitational acceleration
  * measured by the IMU accelerometer.
  *
+ * The helper does not copy the model and the joint positions: it refers to
+ * the ones of the estimator, so only the (velocity-free) accelerations of the
+ * links are computed again.
  */
 class GravityCompensationHelper
 {
 private:
-    iDynTree::Model m_model;
+    /**
+     * Model of the estimator, it must outlive the helper (or the next loadModel).
+     */
+    const iDynTree::Model * m_model;
     bool m_isModelValid;
     bool m_isKinematicsUpdated;
 
+    /**
+     * The kinematic information passed in updateKinematics* is just stored,
+     * and it is propagated to the links only when the gravity compensation
+     * torques are actually requested. m_isKinematicsPropagated is true if
+     * m_linkVels and m_linkProperAccs are consistent with the stored information.
+     */
+    bool m_isKinematicsPropagated;
+    iDynTree::FrameIndex m_floatingFrame;
+    iDynTree::Vector3 m_properClassicalLinearAcceleration;
+
+    /**
+     * Propagate the stored kinematic information to all the links.
+     */
+    bool propagateKinematics();
+
     /**< Traveral used for the dynamics computations */
     iDynTree::Traversal m_dynamicTraversal;
 
@@ -42,7 +63,10 @@ private:
     void allocKinematicTraversals(const size_t nrOfLinks);
     void freeKinematicTraversals();
 
-    iDynTree::JointPosDoubleArray m_jointPos;
+    /**
+     * Joint positions passed to the last updateKinematics* call (not copied).
+     */
+    const iDynTree::JointPosDoubleArray * m_jointPos;
     iDynTree::JointDOFsDoubleArray m_jointDofsZero;
     iDynTree::LinkVelArray m_linkVels;
     iDynTree::LinkAccArray m_linkProperAccs;
@@ -59,7 +83,8 @@ public:
     ~GravityCompensationHelper();
 
     /**
-     * Load model
+     * Use the model, that is referenced and not copied:
+     * it must not be modified or destroyed while the helper uses it.
      */
     bool loadModel(const iDynTree::Model & _model , const std::string dynamicBase);
 
@@ -67,6 +92,12 @@ public:
      * Set the kinematic information necessary for the gravity torques estimation using the
      * proper acceleration coming from an acceleromter.
      *
+     * The information is only stored, the propagation over the model is
+     * performed only when getGravityCompensationTorques is called, so
+     * it is cheap to call this method at every estimation cycle.
+     * jointPos is not copied: it must not be modified or destroyed until
+     * getGravityCompensationTorques is called.
+     *
      * NOTE : the estimation of the gravity disregards
      * as negligible the non-gravitational acceleration
      * measured by the IMU accelerometer.
@@ -102,6 +133,9 @@ public:
 
     /**
      * Get the gravity compensation torques.
+     *
+     * This propagates the kinematic information set by the last updateKinematics* call
+     * (only once for each call to updateKinematics*) and computes the torques.
      */
     bool getGravityCompensationTorques(iDynTree::JointDOFsDoubleArray & jointTrqs);
 
@@ -0,0 +1,85 @@
+#include "LoopTimingReporter.h"
+
+#include <yarp/os/LockGuard.h>
+#include <yarp/os/LogStream.h>
+
+namespace wholeBodyDynamics
+{
+
+LoopTimingReporter::LoopTimingReporter(iCub::ctrl::realTime::LoopTimingRecorder & recorder,
+                                       const std::string & loopName): yarp::os::RateThread(1000),
+                                                                      m_recorder(recorder),
+                                                                      m_loopName(loopName)
+{
+}
+
+LoopTimingReporter::~LoopTimingReporter()
+{
+    close();
+}
+
+bool LoopTimingReporter::open(const std::string & portName, const double reportPeriodInSeconds)
+{
+    int periodInMs = static_cast<int>(reportPeriodInSeconds*1000.0);
+    if( periodInMs <= 0 )
+    {
+        yError() << "wholeBodyDynamics : LoopTimingReporter the report period should be at least 1 ms";
+        return false;
+    }
+
+    if( !m_port.open(portName) )
+    {
+        yError() << "wholeBodyDynamics : LoopTimingReporter impossible to open port " << portName;
+        return false;
+    }
+
+    this->setRate(periodInMs);
+
+    if( !this->start() )
+    {
+        yError() << "wholeBodyDynamics : LoopTimingReporter impossible to start the thread";
+        m_port.close();
+        return false;
+    }
+
+    return true;
+}
+
+void LoopTimingReporter::close()
+{
+    if( this->isRunning() )
+    {
+        this->stop();
+    }
+
+    m_port.close();
+}
+
+void LoopTimingReporter::getLastStatistics(iCub::ctrl::realTime::LoopTimingStatistics & stats)
+{
+    yarp::os::LockGuard guard(m_statisticsMutex);
+    stats = m_lastStatistics;
+}
+
+void LoopTimingReporter::run()
+{
+    iCub::ctrl::realTime::LoopTimingStatistics stats;
+    m_recorder.getStatistics(stats);
+
+    {
+        yarp::os::LockGuard guard(m_statisticsMutex);
+        m_lastStatistics = stats;
+    }
+
+    yarp::os::Bottle & bot = m_port.prepare();
+    bot.clear();
+    stats.toBottle(bot);
+    m_port.write();
+
+    if( stats.lateTicks > 0 || stats.overruns > 0 )
+    {
+        yWarning() << "wholeBodyDynamics :" << m_loopName << "missed its deadline. " << stats.toString();
+    }
+}
+
+}
@@ -0,0 +1,72 @@
+#ifndef CODYCO_LOOP_TIMING_REPORTER_H
+#define CODYCO_LOOP_TIMING_REPORTER_H
+
+// YARP includes
+#include <yarp/os/Bottle.h>
+#include <yarp/os/BufferedPort.h>
+#include <yarp/os/Mutex.h>
+#include <yarp/os/RateThread.h>
+
+#include "ctrlLibRT/loopTiming.h"
+
+#include <string>
+
+namespace wholeBodyDynamics
+{
+
+/**
+ * Thread reporting the timing statistics of the estimation loop.
+ *
+ * Once every report period it computes the statistics of the ticks recorded
+ * since the previous report, writes them on a port (see LoopTimingStatistics::toBottle)
+ * and prints a warning if the loop missed its deadline.
+ * The estimation loop only records the beginning and the end of its ticks,
+ * so the port writes and the logging never extend the estimation cycle.
+ */
+class LoopTimingReporter : public yarp::os::RateThread
+{
+private:
+    iCub::ctrl::realTime::LoopTimingRecorder & m_recorder;
+    std::string m_loopName;
+
+    yarp::os::BufferedPort<yarp::os::Bottle> m_port;
+
+    /**
+     * Statistics of the last report period, protected by m_statisticsMutex.
+     */
+    iCub::ctrl::realTime::LoopTimingStatistics m_lastStatistics;
+    yarp::os::Mutex m_statisticsMutex;
+
+public:
+    /**
+     * @param recorder recorder of the loop, getStatistics is called only by this thread.
+     * @param loopName name of the loop, used in the warnings.
+     */
+    LoopTimingReporter(iCub::ctrl::realTime::LoopTimingRecorder & recorder,
+                       const std::string & loopName);
+    virtual ~LoopTimingReporter();
+
+    /**
+     * Open the port and start the thread.
+     *
+     * @param portName name of the port streaming the statistics.
+     * @param reportPeriodInSeconds period of the reports.
+     */
+    bool open(const std::string & portName, const double reportPeriodInSeconds);
+
+    /**
+     * Stop the thread and close the port.
+     */
+    void close();
+
+    /**
+     * Get the statistics of the last report period.
+     */
+    void getLastStatistics(iCub::ctrl::realTime::LoopTimingStatistics & stats);
+
+    virtual void run();
+};
+
+}
+
+#endif
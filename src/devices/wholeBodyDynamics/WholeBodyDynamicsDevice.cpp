@@ -12,6 +12,7 @@
 #include <iDynTree/yarp/YARPConversions.h>
 #include <iDynTree/Core/Utils.h>
 
+#include <algorithm>
 #include <cassert>
 #include <cmath>
 
@@ -30,17 +31,23 @@ WholeBodyDynamicsDevice::WholeBodyDynamicsDevice(): RateThread(10),
                                                     sensorReadCorrectly(false),
                                                     estimationWentWell(false),
                                                     validOffsetAvailable(false),
-                                                    settingsEditor(settings)
+                                                    measuredContactLocationsUpToDate(false),
+                                                    enableEstimationThread(true),
+                                                    lastStageDurations(NR_OF_ESTIMATION_STAGES,0.0),
+                                                    loopTiming(getRate()/1000.0),
+                                                    loopTimingReportPeriod(1.0),
+                                                    loopTimingReporter(loopTiming,"estimation loop"),
+                                                    settingsEditor(settings),
+                                                    imuFrameIndex(iDynTree::FRAME_INVALID_INDEX),
+                                                    fixedFrameIndex(iDynTree::FRAME_INVALID_INDEX)
 {
     // Calibration quantities
     calibrationBuffers.ongoingCalibration = false;
     calibrationBuffers.calibratingFTsensor.resize(0);
-    calibrationBuffers.offsetSumBuffer.resize(0);
+    calibrationBuffers.offsets.resize(0);
+    calibrationBuffers.queueSize = 100;
+    calibrationBuffers.trimFraction = 0.0;
     ftProcessors.resize(0);
-    calibrationBuffers.estimationSumBuffer.resize(0);
-    calibrationBuffers.measurementSumBuffer.resize(0);
-    calibrationBuffers.nrOfSamplesToUseForCalibration = 0;
-    calibrationBuffers.nrOfSamplesUsedUntilNowForCalibration = 0;
 
 }
 
@@ -80,6 +87,19 @@ bool WholeBodyDynamicsDevice::openRPCPort()
     return true;
 }
 
+bool WholeBodyDynamicsDevice::openLoopTimingPort()
+{
+    bool ok = loopTimingReporter.open(portPrefix+"/timing:o",loopTimingReportPeriod);
+
+    if( !ok )
+    {
+        yError() << "WholeBodyDynamicsDevice: Impossible to start the publication of the timing on port " << portPrefix+"/timing:o";
+        return false;
+    }
+
+    return true;
+}
+
 bool WholeBodyDynamicsDevice::closeSettingsPort()
 {
     settingsPort.close();
@@ -92,6 +112,12 @@ bool WholeBodyDynamicsDevice::closeRPCPort()
     return true;
 }
 
+bool WholeBodyDynamicsDevice::closeLoopTimingPort()
+{
+    loopTimingReporter.close();
+    return true;
+}
+
 bool WholeBodyDynamicsDevice::closeSkinContactListsPorts()
 {
     this->portContactsInput.close();
@@ -417,7 +443,8 @@ bool WholeBodyDynamicsDevice::openExternalWrenchesPorts(os::Searchable& config)
     {
         outputWrenchPortInformation wrench_port_struct;
         yarp::os::Bottle *wrench_port = output_wrench_bot.get(output_wrench_port).asList();
-        if( wrench_port == NULL || wrench_port->isNull() || wrench_port->size() != 2
+        if( wrench_port == NULL || wrench_port->isNull()
+            || !(wrench_port->size() == 2 || (wrench_port->size() == 3 && wrench_port->get(2).isInt() && wrench_port->get(2).asInt() > 0))
             || wrench_port->get(1).asList() == NULL
             || !(wrench_port->get(1).asList()->size() == 2 || wrench_port->get(1).asList()->size() == 3 ) )
         {
@@ -453,6 +480,15 @@ bool WholeBodyDynamicsDevice::openExternalWrenchesPorts(os::Searchable& config)
             wrench_port_struct.orientation_frame = wrench_port->get(1).asList()->get(2).asString();
         }
 
+        // Optional decimation of the publishing rate
+        wrench_port_struct.publish_decimation = 1;
+        if( wrench_port->size() == 3 )
+        {
+            wrench_port_struct.publish_decimation = wrench_port->get(2).asInt();
+        }
+        wrench_port_struct.cycles_since_last_publish = 0;
+        wrench_port_struct.publish_in_this_cycle = false;
+
         outputWrenchPorts.push_back(wrench_port_struct);
 
     }
@@ -487,6 +523,10 @@ bool WholeBodyDynamicsDevice::openExternalWrenchesPorts(os::Searchable& config)
         }
     }
 
+    // Allocate the buffers for the transforms of the frames used by the ports
+    outputWrenchFramesWorldTransforms.resize(kinDynComp.getRobotModel().getNrOfFrames(),iDynTree::Transform::Identity());
+    outputWrenchFramesToUpdate.resize(kinDynComp.getRobotModel().getNrOfFrames(),false);
+
     // Open ports
     bool ok = true;
     for(unsigned int i = 0; i < outputWrenchPorts.size(); i++ )
@@ -513,6 +553,11 @@ void WholeBodyDynamicsDevice::resizeBuffers()
     this->jointVel.resize(estimator.model());
     this->jointAcc.resize(estimator.model());
     this->measuredContactLocations.resize(estimator.model());
+    this->measuredContactLocationsUpToDate = false;
+    this->estimationState.jointPos.resize(estimator.model());
+    this->estimationState.sequenceNumber = 0;
+    this->estimationState.timestamp = 0.0;
+    this->estimationState.sensorReadCorrectly = false;
     this->ftMeasurement.resize(wholeBodyDynamics_nrOfChannelsOfYARPFTSensor);
     this->imuMeasurement.resize(wholeBodyDynamics_nrOfChannelsOfAYARPIMUSensor);
     this->rawSensorsMeasurements.resize(estimator.sensors());
@@ -526,13 +571,8 @@ void WholeBodyDynamicsDevice::resizeBuffers()
     calibrationBuffers.calibratingFTsensor.resize(nrOfFTSensors,false);
     iDynTree::Wrench zeroWrench;
     zeroWrench.zero();
-    calibrationBuffers.offsetSumBuffer.resize(nrOfFTSensors,zeroWrench.asVector());
-    calibrationBuffers.measurementSumBuffer.resize(nrOfFTSensors,zeroWrench.asVector());
-    calibrationBuffers.estimationSumBuffer.resize(nrOfFTSensors,zeroWrench.asVector());
+    calibrationBuffers.offsets.resize(nrOfFTSensors,zeroWrench);
     calibrationBuffers.assumedContactLocationsForCalibration.resize(estimator.model());
-    calibrationBuffers.predictedExternalContactWrenchesForCalibration.resize(estimator.model());
-    calibrationBuffers.predictedJointTorquesForCalibration.resize(estimator.model());
-    calibrationBuffers.predictedSensorMeasurementsForCalibration.resize(estimator.sensors());
 
     ftProcessors.resize(nrOfFTSensors);
 
@@ -570,6 +610,44 @@ bool WholeBodyDynamicsDevice::loadSettingsFromConfig(os::Searchable& config)
     yarp::os::Property prop;
     prop.fromString(config.toString().c_str());
 
+    // Check if the periodic thread should be started in attachAll
+    enableEstimationThread = true;
+    if( prop.check("enableEstimationThread") )
+    {
+        if( !prop.find("enableEstimationThread").isBool() )
+        {
+            yError() << "wholeBodyDynamics : enableEstimationThread is present, but it is not a bool";
+            return false;
+        }
+
+        enableEstimationThread = prop.find("enableEstimationThread").asBool();
+    }
+
+    // Check the prefix of the ports
+    if( prop.check("portPrefix") )
+    {
+        if( !prop.find("portPrefix").isString() )
+        {
+            yError() << "wholeBodyDynamics : portPrefix is present, but it is not a string";
+            return false;
+        }
+
+        portPrefix = prop.find("portPrefix").asString();
+    }
+
+    // Check the period of the timing reports
+    if( prop.check("loopTimingReportPeriod") )
+    {
+        if( !prop.find("loopTimingReportPeriod").isDouble() ||
+            prop.find("loopTimingReportPeriod").asDouble() <= 0.0 )
+        {
+            yError() << "wholeBodyDynamics : loopTimingReportPeriod is present, but it is not a positive double";
+            return false;
+        }
+
+        loopTimingReportPeriod = prop.find("loopTimingReportPeriod").asDouble();
+    }
+
     // Check the assumeFixed parameter
     if( prop.check("assume_fixed") )
     {
@@ -633,6 +711,51 @@ bool WholeBodyDynamicsDevice::loadSettingsFromConfig(os::Searchable& config)
     return true;
 }
 
+bool WholeBodyDynamicsDevice::openCalibrationWorker(os::Searchable& config)
+{
+    yarp::os::Property prop;
+    prop.fromString(config.toString().c_str());
+
+    calibrationBuffers.queueSize = 100;
+    if( prop.check("calibrationQueueSize") )
+    {
+        if( !prop.find("calibrationQueueSize").isInt() || prop.find("calibrationQueueSize").asInt() <= 0 )
+        {
+            yError() << "wholeBodyDynamics : calibrationQueueSize is present, but it is not a positive integer";
+            return false;
+        }
+
+        calibrationBuffers.queueSize = (size_t) prop.find("calibrationQueueSize").asInt();
+    }
+
+    calibrationBuffers.trimFraction = 0.0;
+    if( prop.check("calibrationTrimFraction") )
+    {
+        if( !prop.find("calibrationTrimFraction").isDouble() )
+        {
+            yError() << "wholeBodyDynamics : calibrationTrimFraction is present, but it is not a double";
+            return false;
+        }
+
+        calibrationBuffers.trimFraction = prop.find("calibrationTrimFraction").asDouble();
+    }
+
+    wholeBodyDynamics::FTOffsetEstimator offsetEstimator = wholeBodyDynamics::FT_OFFSET_MEAN;
+    if( calibrationBuffers.trimFraction > 0.0 )
+    {
+        offsetEstimator = wholeBodyDynamics::FT_OFFSET_TRIMMED_MEAN;
+    }
+
+    bool ok = calibrationWorker.init(estimator.model(),estimator.sensors(),
+                                     calibrationBuffers.queueSize,offsetEstimator,calibrationBuffers.trimFraction);
+    if( !ok )
+    {
+        return false;
+    }
+
+    return calibrationWorker.start();
+}
+
 bool WholeBodyDynamicsDevice::loadSecondaryCalibrationSettingsFromConfig(os::Searchable& config)
 {
    bool ret;
@@ -761,6 +884,7 @@ bool WholeBodyDynamicsDevice::loadGravityCompensationSettingsFromConfig(os::Sear
 
             m_gravityCompesationJoints.push_back(dofOffset);
         }
+        m_gravityCompensationJointsToPublish.reserve(m_gravityCompesationJoints.size());
 
         // We use the kinDynComp class that was opened together with the estimator
         std::string gravityCompensationBaseLink = propGravComp.find("gravityCompensationBaseLink").asString().c_str();
@@ -806,6 +930,8 @@ bool WholeBodyDynamicsDevice::open(os::Searchable& config)
         return false;
     } 
 
+    this->resolveKinematicSourceFrames();
+
     // Open settings related to gravity compensation (we need the estimator to be open)
     ok = this->loadGravityCompensationSettingsFromConfig(config);
     if( !ok ) 
@@ -822,6 +948,14 @@ bool WholeBodyDynamicsDevice::open(os::Searchable& config)
         return false;
     } 
 
+    // Start the thread computing the F/T offsets (we need the estimator to be open)
+    ok = this->openCalibrationWorker(config);
+    if( !ok )
+    {
+        yError() << "wholeBodyDynamics: Problem in starting the calibration thread.";
+        return false;
+    }
+
     // Open rpc port
     ok = this->openRPCPort();
     if( !ok ) 
@@ -838,6 +972,14 @@ bool WholeBodyDynamicsDevice::open(os::Searchable& config)
         return false;
     } 
 
+    // Open the port streaming the timing statistics
+    ok = this->openLoopTimingPort();
+    if( !ok )
+    {
+        yError() << "wholeBodyDynamics: Problem in opening timing port.";
+        return false;
+    }
+
     // Open the controlboard remapper
     ok = this->openRemapperControlBoard(config);
     if( !ok ) 
@@ -1052,7 +1194,10 @@ bool WholeBodyDynamicsDevice::attachAll(const PolyDriverList& p)
     if( ok )
     {
         correctlyConfigured = true;
-        this->start();
+        if( enableEstimationThread )
+        {
+            this->start();
+        }
     }
 
     return ok;
@@ -1266,14 +1411,23 @@ void WholeBodyDynamicsDevice::filterSensorsAndRemoveSensorOffsets()
     }
 }
 
+void WholeBodyDynamicsDevice::resolveKinematicSourceFrames()
+{
+    imuFrameIndex = estimator.model().getFrameIndex(settings.imuFrameName);
+    fixedFrameIndex = estimator.model().getFrameIndex(settings.fixedFrameName);
+}
+
 void WholeBodyDynamicsDevice::updateKinematics()
 {
+    // The frame names are looked up only if they were changed through the settings port
+    if( settingsEditor.checkKinematicSourceFramesChanged() )
+    {
+        this->resolveKinematicSourceFrames();
+    }
+
     // Read IMU Sensor and update the kinematics in the model
     if( settings.kinematicSource == IMU )
     {
-        // Hardcode for the meanwhile
-        iDynTree::FrameIndex imuFrameIndex = estimator.model().getFrameIndex(settings.imuFrameName);
-
         estimator.updateKinematicsFromFloatingBase(jointPos,jointVel,jointAcc,imuFrameIndex,
                                                    filteredIMUMeasurements.linProperAcc,filteredIMUMeasurements.angularVel,filteredIMUMeasurements.angularAcc);
 
@@ -1289,8 +1443,6 @@ void WholeBodyDynamicsDevice::updateKinematics()
         iDynTree::Vector3 gravity;
 
         // this should be valid because it was validated when set
-        iDynTree::FrameIndex fixedFrameIndex = estimator.model().getFrameIndex(settings.fixedFrameName);
-
         gravity(0) = settings.fixedFrameGravity.x;
         gravity(1) = settings.fixedFrameGravity.y;
         gravity(2) = settings.fixedFrameGravity.z;
@@ -1307,16 +1459,12 @@ void WholeBodyDynamicsDevice::updateKinematics()
 }
 
 
-void WholeBodyDynamicsDevice::readContactPoints()
+void WholeBodyDynamicsDevice::setDefaultContactLocations()
 {
-    // In this function the location of the external forces acting on the robot
-    // are computed. The basic strategy is to assume a contact for each subtree in which the
-    // robot is divided by the F/T sensors.
-
     measuredContactLocations.clear();
 
-    // For now just put the default contact points
     size_t nrOfSubModels = estimator.submodels().getNrOfSubModels();
+    bool allAdded = true;
 
     for(size_t subModel = 0; subModel < nrOfSubModels; subModel++)
     {
@@ -1326,30 +1474,34 @@ void WholeBodyDynamicsDevice::readContactPoints()
         if( !ok )
         {
             yWarning() << "wholeBodyDynamics: Failing in adding default contact for submodel " << subModel;
+            allAdded = false;
         }
     }
 
-    // Todo: read contact positions from skin
-
-    return;
+    // If a contact could not be added the set is rebuilt at the next cycle
+    measuredContactLocationsUpToDate = allAdded;
 }
 
-void addToSummer(iDynTree::Vector6 & buffer, const iDynTree::Wrench & addedWrench)
+void WholeBodyDynamicsDevice::readContactPoints()
 {
-    for(size_t i=0; i < wholeBodyDynamics_nrOfChannelsOfYARPFTSensor; i++)
-    {
-        buffer(i) = buffer(i) + addedWrench(i);
-    }
-}
+    // In this function the location of the external forces acting on the robot
+    // are computed. The basic strategy is to assume a contact for each subtree in which the
+    // robot is divided by the F/T sensors.
 
-void computeMean(const iDynTree::Vector6 & buffer, const size_t nrOfSamples, iDynTree::Wrench & mean)
-{
-    for(size_t i=0; i < wholeBodyDynamics_nrOfChannelsOfYARPFTSensor; i++)
+    // For now just put the default contact points: they are the same at each cycle,
+    // so the contact set is rebuilt only if it was invalidated
+    if( !measuredContactLocationsUpToDate )
     {
-        mean(i) = buffer(i)/nrOfSamples;
+        this->setDefaultContactLocations();
     }
-}
 
+    // Todo: read contact positions from skin
+    // When skin contacts appear, change or disappear, only the contacts of the
+    // affected submodels should be modified, setting measuredContactLocationsUpToDate
+    // to false when the default contacts need to be restored
+
+    return;
+}
 
 void WholeBodyDynamicsDevice::computeCalibration()
 {
@@ -1357,48 +1509,50 @@ void WholeBodyDynamicsDevice::computeCalibration()
     {
         // Todo: Check that the model is actually still during calibration
 
-        // Run the calibration
-        estimator.computeExpectedFTSensorsMeasurements(calibrationBuffers.assumedContactLocationsForCalibration,
-                                                       calibrationBuffers.predictedSensorMeasurementsForCalibration,
-                                                       calibrationBuffers.predictedExternalContactWrenchesForCalibration,
-                                                       calibrationBuffers.predictedJointTorquesForCalibration);
-
-        // The kinematics information was already set by the readSensorsAndUpdateKinematics method, just compute the offset and add to the buffer
-        for(size_t ft = 0; ft < ftSensors.size(); ft++)
+        // Pass a snapshot of the current state to the calibration thread, that computes the
+        // expected F/T measurements. If the thread is late, the sample of this cycle is not used.
+        wholeBodyDynamics::FTCalibrationSample * sample = calibrationWorker.beginPush();
+        if( sample )
         {
-            if( calibrationBuffers.calibratingFTsensor[ft] )
+            sample->useFixedFrame = (settings.kinematicSource != IMU);
+            if( sample->useFixedFrame )
+            {
+                sample->kinematicFrame = fixedFrameIndex;
+                sample->fixedFrameGravity(0) = settings.fixedFrameGravity.x;
+                sample->fixedFrameGravity(1) = settings.fixedFrameGravity.y;
+                sample->fixedFrameGravity(2) = settings.fixedFrameGravity.z;
+            }
+            else
+            {
+                sample->kinematicFrame = imuFrameIndex;
+                sample->imuLinProperAcc = filteredIMUMeasurements.linProperAcc;
+                sample->imuAngularVel = filteredIMUMeasurements.angularVel;
+                sample->imuAngularAcc = filteredIMUMeasurements.angularAcc;
+            }
+            sample->jointPos = jointPos;
+            sample->jointVel = jointVel;
+            sample->jointAcc = jointAcc;
+
+            for(size_t ft = 0; ft < this->getNrOfFTSensors(); ft++)
             {
-                iDynTree::Wrench estimatedFT;
                 iDynTree::Wrench measuredRawFT;
-                calibrationBuffers.predictedSensorMeasurementsForCalibration.getMeasurement(iDynTree::SIX_AXIS_FORCE_TORQUE,ft,estimatedFT);
                 rawSensorsMeasurements.getMeasurement(iDynTree::SIX_AXIS_FORCE_TORQUE,ft,measuredRawFT);
 
                 // We apply only the secondary calibration matrix because we are actually computing the offset right now
-                measuredRawFT = ftProcessors[ft].applySecondaryCalibrationMatrix(measuredRawFT);
-
-                addToSummer(calibrationBuffers.offsetSumBuffer[ft],measuredRawFT-estimatedFT);
-                addToSummer(calibrationBuffers.measurementSumBuffer[ft],measuredRawFT);
-                addToSummer(calibrationBuffers.estimationSumBuffer[ft],estimatedFT);
+                sample->measuredFT[ft] = ftProcessors[ft].applySecondaryCalibrationMatrix(measuredRawFT);
             }
-        }
 
-        // Increase the number of collected samples
-        calibrationBuffers.nrOfSamplesUsedUntilNowForCalibration++;
+            calibrationWorker.endPush();
+        }
 
-        if( calibrationBuffers.nrOfSamplesUsedUntilNowForCalibration >= calibrationBuffers.nrOfSamplesToUseForCalibration )
+        // Apply the offsets once the calibration thread has collected all the samples
+        if( calibrationWorker.getCalibrationResults(calibrationBuffers.offsets) )
         {
-            // Compute the offset by averaging the results
-            for(size_t ft = 0; ft < ftSensors.size(); ft++)
+            for(size_t ft = 0; ft < this->getNrOfFTSensors(); ft++)
             {
                 if( calibrationBuffers.calibratingFTsensor[ft] )
                 {
-                    iDynTree::Wrench measurementMean, estimationMean;
-                    computeMean(calibrationBuffers.offsetSumBuffer[ft],calibrationBuffers.nrOfSamplesUsedUntilNowForCalibration,ftProcessors[ft].offset());
-                    computeMean(calibrationBuffers.measurementSumBuffer[ft],calibrationBuffers.nrOfSamplesUsedUntilNowForCalibration,measurementMean);
-                    computeMean(calibrationBuffers.estimationSumBuffer[ft],calibrationBuffers.nrOfSamplesUsedUntilNowForCalibration,estimationMean);
-
-                    yInfo() << "wholeBodyDynamics: Offset for sensor " << estimator.sensors().getSensor(iDynTree::SIX_AXIS_FORCE_TORQUE,ft)->getName() << " " << ftProcessors[ft].offset().toString();
-                    yInfo() << "wholeBodyDynamics: obtained assuming a measurement of " << measurementMean.asVector().toString() << " and an estimated ft of " << estimationMean.asVector().toString();
+                    ftProcessors[ft].offset() = calibrationBuffers.offsets[ft];
                 }
             }
 
@@ -1453,8 +1607,8 @@ void WholeBodyDynamicsDevice::publishGravityCompensation()
 {
     if( m_gravityCompensationEnabled )
     {
-        this->m_gravCompHelper.getGravityCompensationTorques(this->m_gravityCompensationTorques);
         // Publish torques only in joints that are in compliant mode that they need it
+        m_gravityCompensationJointsToPublish.clear();
 
         for(size_t ii=0; ii < m_gravityCompesationJoints.size(); ii++)
         {
@@ -1486,7 +1640,7 @@ void WholeBodyDynamicsDevice::publishGravityCompensation()
                 case VOCAB_CM_VELOCITY:
                      if (int_mode == VOCAB_IM_COMPLIANT)
                      {
-                         remappedControlBoardInterfaces.impctrl->setImpedanceOffset((int)dof,this->m_gravityCompensationTorques(dof));
+                         m_gravityCompensationJointsToPublish.push_back(dof);
                      }
                      else
                      {
@@ -1495,6 +1649,19 @@ void WholeBodyDynamicsDevice::publishGravityCompensation()
                      break;
             }
         }
+
+        // The gravity torques (and the related pass on the model) are computed
+        // only if at least a joint needs them
+        if( m_gravityCompensationJointsToPublish.size() > 0 )
+        {
+            this->m_gravCompHelper.getGravityCompensationTorques(this->m_gravityCompensationTorques);
+
+            for(size_t ii=0; ii < m_gravityCompensationJointsToPublish.size(); ii++)
+            {
+                size_t dof = m_gravityCompensationJointsToPublish[ii];
+                remappedControlBoardInterfaces.impctrl->setImpedanceOffset((int)dof,this->m_gravityCompensationTorques(dof));
+            }
+        }
     }
 }
 
@@ -1548,29 +1715,79 @@ void WholeBodyDynamicsDevice::publishContacts()
 
 void WholeBodyDynamicsDevice::publishExternalWrenches()
 {
-    if( this->outputWrenchPorts.size() > 0 )
+    // Select the ports that need to be published in this cycle:
+    // the ones whose decimation period is elapsed and that have at least a reader
+    bool atLeastOnePortToPublish = false;
+    for(size_t i=0; i < this->outputWrenchPorts.size(); i++ )
     {
-        // Update kinDynComp model
-        iDynTree::Vector3 dummyGravity;
-        dummyGravity.zero();
-        this->kinDynComp.setRobotState(this->jointPos,this->jointVel,dummyGravity);
+        outputWrenchPortInformation & port = this->outputWrenchPorts[i];
+
+        port.cycles_since_last_publish++;
+        port.publish_in_this_cycle = false;
+        if( port.cycles_since_last_publish >= port.publish_decimation )
+        {
+            port.cycles_since_last_publish = 0;
+            port.publish_in_this_cycle = (port.output_port->getOutputCount() > 0);
+        }
+
+        if( port.publish_in_this_cycle )
+        {
+            atLeastOnePortToPublish = true;
+            outputWrenchFramesToUpdate[port.link_index] = true;
+            outputWrenchFramesToUpdate[port.origin_frame_index] = true;
+            outputWrenchFramesToUpdate[port.orientation_frame_index] = true;
+        }
+    }
 
-        // Compute net wrenches for each link
-        estimateExternalContactWrenches.computeNetWrenches(netExternalWrenchesExertedByTheEnviroment);
+    if( !atLeastOnePortToPublish )
+    {
+        return;
     }
 
+    // Update kinDynComp model
+    iDynTree::Vector3 dummyGravity;
+    dummyGravity.zero();
+    this->kinDynComp.setRobotState(this->jointPos,this->jointVel,dummyGravity);
+
+    // Compute net wrenches for each link
+    estimateExternalContactWrenches.computeNetWrenches(netExternalWrenchesExertedByTheEnviroment);
+
+    // Compute the world transform of all the frames used in this cycle:
+    // the forward kinematics is computed only once by kinDynComp, and each frame is
+    // queried once even if it is used by several ports (a link frame has the same index of its link)
+    for(size_t frame=0; frame < outputWrenchFramesToUpdate.size(); frame++ )
+    {
+        if( outputWrenchFramesToUpdate[frame] )
+        {
+            outputWrenchFramesWorldTransforms[frame] = this->kinDynComp.getWorldTransform(frame);
+            outputWrenchFramesToUpdate[frame] = false;
+        }
+    }
 
     // Get wrenches from the estimator and publish it on the port
     for(size_t i=0; i < this->outputWrenchPorts.size(); i++ )
     {
+        if( !(this->outputWrenchPorts[i].publish_in_this_cycle) )
+        {
+            continue;
+        }
+
         // Get the wrench in the link frame
         iDynTree::LinkIndex link = this->outputWrenchPorts[i].link_index;
         iDynTree::Wrench & link_f = netExternalWrenchesExertedByTheEnviroment(link);
 
-        // Transform the wrench in the desired frame
-        iDynTree::FrameIndex orientation = this->outputWrenchPorts[i].orientation_frame_index;
-        iDynTree::FrameIndex origin      = this->outputWrenchPorts[i].origin_frame_index;
-        iDynTree::Wrench pub_f = this->kinDynComp.getRelativeTransformExplicit(origin,orientation,link,link)*link_f;
+        // Transform the wrench in the desired frame, equivalent to
+        // kinDynComp.getRelativeTransformExplicit(origin,orientation,link,link)
+        const iDynTree::Transform & world_H_link        = outputWrenchFramesWorldTransforms[link];
+        const iDynTree::Transform & world_H_origin      = outputWrenchFramesWorldTransforms[this->outputWrenchPorts[i].origin_frame_index];
+        const iDynTree::Transform & world_H_orientation = outputWrenchFramesWorldTransforms[this->outputWrenchPorts[i].orientation_frame_index];
+
+        iDynTree::Rotation orientation_R_world = world_H_orientation.getRotation().inverse();
+        iDynTree::Position world_p_link_wrt_origin = world_H_link.getPosition() - world_H_origin.getPosition();
+        iDynTree::Transform orientation_H_link(orientation_R_world*world_H_link.getRotation(),
+                                               orientation_R_world*world_p_link_wrt_origin);
+
+        iDynTree::Wrench pub_f = orientation_H_link*link_f;
 
         iDynTree::toYarp(pub_f,outputWrenchPorts[i].output_vector);
 
@@ -1579,38 +1796,160 @@ void WholeBodyDynamicsDevice::publishExternalWrenches()
     }
 }
 
+void WholeBodyDynamicsDevice::profileStage(const int stage, double & tic)
+{
+    double toc = yarp::os::Time::now();
+    lastStageDurations[stage] = toc - tic;
+    tic = toc;
+}
+
 void WholeBodyDynamicsDevice::run()
+{
+    // The period can be changed with setRate, also by the thread stepping the device in host mode
+    double nominalPeriod = getRate()/1000.0;
+    if( nominalPeriod != loopTiming.getNominalPeriod() )
+    {
+        loopTiming.setNominalPeriod(nominalPeriod);
+    }
+
+    loopTiming.tickStarted(yarp::os::Time::now());
+
+    estimate();
+
+    loopTiming.tickFinished(yarp::os::Time::now());
+}
+
+void WholeBodyDynamicsDevice::estimate()
 {
     yarp::os::LockGuard guard(this->deviceMutex);
 
     if( correctlyConfigured )
     {
+        double tic = yarp::os::Time::now();
+
         // Load settings if modified
         //this->reconfigureClassFromSettings();
 
         // Read sensor readings
         this->readSensors();
+        this->profileStage(READ_SENSORS,tic);
 
         // Filter sensor and remove offset
         this->filterSensorsAndRemoveSensorOffsets();
+        this->profileStage(FILTER_SENSORS,tic);
 
         // Update kinematics
         this->updateKinematics();
+        this->profileStage(UPDATE_KINEMATICS,tic);
+
+        // Share the acquired state with the other devices
+        this->notifyEstimationStateListeners();
+        this->profileStage(NOTIFY_STATE_LISTENERS,tic);
 
         // Read contacts info from the skin or from assume contact location
         this->readContactPoints();
+        this->profileStage(READ_CONTACT_POINTS,tic);
 
         // Compute calibration if we are in calibration mode
         this->computeCalibration();
+        this->profileStage(COMPUTE_CALIBRATION,tic);
 
         // Compute estimated external forces and internal joint torques
         this->computeExternalForcesAndJointTorques();
+        this->profileStage(COMPUTE_ESTIMATION,tic);
 
         // Publish estimated quantities
         this->publishEstimatedQuantities();
+        this->profileStage(PUBLISH_ESTIMATES,tic);
     }
 }
 
+std::string WholeBodyDynamicsDevice::getEstimationStageName(const int stage)
+{
+    switch(stage)
+    {
+        case READ_SENSORS:
+            return "readSensors";
+        case FILTER_SENSORS:
+            return "filterSensors";
+        case UPDATE_KINEMATICS:
+            return "updateKinematics";
+        case NOTIFY_STATE_LISTENERS:
+            return "notifyStateListeners";
+        case READ_CONTACT_POINTS:
+            return "readContactPoints";
+        case COMPUTE_CALIBRATION:
+            return "computeCalibration";
+        case COMPUTE_ESTIMATION:
+            return "computeEstimation";
+        case PUBLISH_ESTIMATES:
+            return "publishEstimates";
+        default:
+            return "unknown";
+    }
+}
+
+const std::vector<double> & WholeBodyDynamicsDevice::getLastStageDurations() const
+{
+    return lastStageDurations;
+}
+
+void WholeBodyDynamicsDevice::notifyEstimationStateListeners()
+{
+    if( estimationStateListeners.size() == 0 )
+    {
+        return;
+    }
+
+    estimationState.sequenceNumber++;
+    estimationState.timestamp = yarp::os::Time::now();
+    estimationState.sensorReadCorrectly = sensorReadCorrectly;
+    estimationState.jointPos = jointPos;
+
+    for(size_t i=0; i < estimationStateListeners.size(); i++)
+    {
+        estimationStateListeners[i]->onNewEstimationState(estimationState);
+    }
+}
+
+bool WholeBodyDynamicsDevice::getEstimationStateJointNames(std::vector<std::string>& jointNames)
+{
+    yarp::os::LockGuard guard(this->deviceMutex);
+
+    jointNames = estimationJointNames;
+    return true;
+}
+
+bool WholeBodyDynamicsDevice::addEstimationStateListener(wholeBodyDynamics::IEstimationStateListener* listener)
+{
+    yarp::os::LockGuard guard(this->deviceMutex);
+
+    if( listener == 0 ||
+        std::find(estimationStateListeners.begin(),estimationStateListeners.end(),listener) != estimationStateListeners.end() )
+    {
+        return false;
+    }
+
+    estimationStateListeners.push_back(listener);
+    return true;
+}
+
+bool WholeBodyDynamicsDevice::removeEstimationStateListener(wholeBodyDynamics::IEstimationStateListener* listener)
+{
+    yarp::os::LockGuard guard(this->deviceMutex);
+
+    std::vector<wholeBodyDynamics::IEstimationStateListener *>::iterator it =
+        std::find(estimationStateListeners.begin(),estimationStateListeners.end(),listener);
+
+    if( it == estimationStateListeners.end() )
+    {
+        return false;
+    }
+
+    estimationStateListeners.erase(it);
+    return true;
+}
+
 bool WholeBodyDynamicsDevice::detachAll()
 {
     yarp::os::LockGuard guard(this->deviceMutex);
@@ -1632,6 +1971,7 @@ bool WholeBodyDynamicsDevice::detachAll()
     closeExternalWrenchesPorts();
     closeRPCPort();
     closeSettingsPort();
+    closeLoopTimingPort();
     closeSkinContactListsPorts();
 
 
@@ -1640,6 +1980,11 @@ bool WholeBodyDynamicsDevice::detachAll()
 
 bool WholeBodyDynamicsDevice::close()
 {
+    if( calibrationWorker.isRunning() )
+    {
+        calibrationWorker.stop();
+    }
+
     this->remappedControlBoard.close();
     this->remappedVirtualAnalogSensors.close();
 
@@ -1681,21 +2026,15 @@ bool WholeBodyDynamicsDevice::setupCalibrationWithExternalWrenchOnOneFrame(const
 
 void WholeBodyDynamicsDevice::setupCalibrationCommonPart(const int32_t nrOfSamples)
 {
-    calibrationBuffers.nrOfSamplesToUseForCalibration = (size_t)nrOfSamples;
-    calibrationBuffers.nrOfSamplesUsedUntilNowForCalibration = 0;
-
     for(size_t ft = 0; ft < this->getNrOfFTSensors(); ft++)
     {
         calibrationBuffers.calibratingFTsensor[ft] = true;
     }
     calibrationBuffers.ongoingCalibration = true;
 
-    for(size_t ft = 0; ft < this->getNrOfFTSensors(); ft++)
-    {
-        calibrationBuffers.offsetSumBuffer[ft].zero();
-        calibrationBuffers.measurementSumBuffer[ft].zero();
-        calibrationBuffers.estimationSumBuffer[ft].zero();
-    }
+    calibrationWorker.startCalibration(calibrationBuffers.assumedContactLocationsForCalibration,
+                                       calibrationBuffers.calibratingFTsensor,
+                                       (size_t)nrOfSamples);
 }
 
 bool WholeBodyDynamicsDevice::setupCalibrationWithExternalWrenchesOnTwoFrames(const std::string & frame1Name, const std::string & frame2Name, const int32_t nrOfSamples)
@@ -1894,9 +2233,9 @@ bool WholeBodyDynamicsDevice::useFixedFrameAsKinematicSource(const std::string&
 {
     yarp::os::LockGuard guard(this->deviceMutex);
 
-    iDynTree::FrameIndex fixedFrameIndex = estimator.model().getFrameIndex(fixedFrame);
+    iDynTree::FrameIndex newFixedFrameIndex = estimator.model().getFrameIndex(fixedFrame);
 
-    if( fixedFrameIndex == iDynTree::FRAME_INVALID_INDEX )
+    if( newFixedFrameIndex == iDynTree::FRAME_INVALID_INDEX )
     {
         yError() << "wholeBodyDynamics : useFixedFrameAsKinematicSource : requested not exiting frame " << fixedFrame << ", method failed";
         return false;
@@ -1905,6 +2244,7 @@ bool WholeBodyDynamicsDevice::useFixedFrameAsKinematicSource(const std::string&
     // Set the kinematic source to a fixed frame
     settings.kinematicSource = FIXED_FRAME;
     settings.fixedFrameName = fixedFrame;
+    fixedFrameIndex = newFixedFrameIndex;
 
     yInfo() << "wholeBodyDynamics : successfully set the kinematic source to be the fixed frame " << fixedFrame;
     yInfo() << "wholeBodyDynamics : with gravity " << settings.fixedFrameGravity.toString();
@@ -1948,6 +2288,14 @@ std::string WholeBodyDynamicsDevice::getCurrentSettingsString()
    return settings.toString();
 }
 
+std::string WholeBodyDynamicsDevice::getLoopTimingString()
+{
+   iCub::ctrl::realTime::LoopTimingStatistics stats;
+   loopTimingReporter.getLastStatistics(stats);
+
+   return stats.toString();
+}
+
 bool WholeBodyDynamicsDevice::resetSimpleLeggedOdometry(const std::string& /*initial_world_frame*/, const std::string& /*initial_fixed_link*/)
 {
     yError() << " wholeBodyDynamics : resetSimpleLeggedOdometry method not implemented";
@@ -23,11 +23,16 @@
 
 // Filters
 #include "ctrlLibRT/filters.h"
+#include "ctrlLibRT/loopTiming.h"
+#include "ctrlLibRT/atomics.h"
 
 #include <wholeBodyDynamicsSettings.h>
 #include <wholeBodyDynamics_IDLServer.h>
 #include "SixAxisForceTorqueMeasureHelpers.h"
 #include "GravityCompensationHelpers.h"
+#include "FTCalibrationWorker.h"
+#include "LoopTimingReporter.h"
+#include "WholeBodyEstimationState.h"
 
 #include <vector>
 
@@ -49,6 +54,12 @@ struct outputWrenchPortInformation
     iDynTree::LinkIndex link_index;
     iDynTree::FrameIndex origin_frame_index;
     iDynTree::FrameIndex orientation_frame_index;
+    /**
+     * The wrench is published once every publish_decimation estimation cycles.
+     */
+    int publish_decimation;
+    int cycles_since_last_publish;
+    bool publish_in_this_cycle;
     yarp::sig::Vector output_vector;
     yarp::os::BufferedPort<yarp::sig::Vector> * output_port;
 };
@@ -132,9 +143,14 @@ class wholeBodyDynamicsDeviceFilters
  * |                |   ...   | string (name of a link in the model) | - | -     | Yes      | Bottle of three elements describing how the link with linkName is described in skinDynLib: the first element is the name of the frame in which the contact info is expressed in skinDynLib (tipically DH frames), the second a integer describing the skinDynLib BodyPart , and the third a integer describing the skinDynLib LinkIndex  | |
  * |                |   linkName_n   | string (name of a link in the model) | - | - | Yes   | Bottle of three elements describing how the link with linkName is described in skinDynLib: the first element is the name of the frame in which the contact info is expressed in skinDynLib (tipically DH frames), the second a integer describing the skinDynLib BodyPart , and the third a integer describing the skinDynLib LinkIndex  | |
  * | WBD_OUTPUT_EXTERNAL_WRENCH_PORTS |  -  | group             | -     | -     | Yes       |  Group describing the external forces published on a YARP port by wholeBodyDynamics. | |
- * |                |   portName_1   | string (name of the port opened to stream the external wrench | - | - | Yes    | Bottle of three elements describing the wrench published on the port: the first element is the link of which the published external wrench is applied. This wrench is expressed around the origin of the frame named as second paramter, and with the orientation of the third parameter.  |  |
+ * |                |   portName_1   | string (name of the port opened to stream the external wrench | - | - | Yes    | Bottle of three elements describing the wrench published on the port: the first element is the link of which the published external wrench is applied. This wrench is expressed around the origin of the frame named as second paramter, and with the orientation of the third parameter.  | The bottle can be followed by an optional positive integer N: the wrench is then published only once every N estimation cycles. |
  * |                |   ...   | | - | ..                                        | Yes       | ..  |  |
  * |                |   portName_n   | .. | - | -                               | Yes       | ..  | |
+ * | enableEstimationThread |  -     | bool              |   -   | true          | No       | If false, attachAll does not start the periodic estimation thread and the estimation is performed only by explicit calls to run(). | Used to drive the device offline, for example by the wholeBodyDynamicsBenchmark executable. |
+ * | portPrefix     |      -         | string            |   -   | /wholeBodyDynamics | No  | Prefix of all the ports opened by the device. | Used to run several instances of the device in the same process, see the host mode of \ref wholeBodyDynamics3. |
+ * | calibrationQueueSize |    -     | int               |   -   | 100           | No       | Maximum number of samples waiting to be processed by the F/T offset calibration thread. | If the queue is full, the samples of the current cycle are not used for calibration. |
+ * | calibrationTrimFraction |  -    | double            |   -   | 0.0           | No       | Fraction of the lowest and of the highest offset samples discarded (for each channel) when computing the F/T offset. | 0.0 corresponds to the mean of the samples, a positive value (less than 0.5) to a trimmed mean, robust to the robot being bumped during calibration. |
+ * | loopTimingReportPeriod |  -     | double            |   s   | 1.0           | No       | Period of publication of the timing statistics of the estimation loop on the portPrefix/timing:o port. | The statistics (percentiles of the period and of the duration of run(), late cycles and overruns) of the last period are also returned by the getLoopTimingString RPC command. |
  * | GRAVITY_COMPENSATION |  -       | group             | -     | -            | No        |  Group for providing estimates of the torque necessary to compensate gravity. | Gravity calls setImpedanceOffset when the considered joints is in COMPLIANT_INTERACTION_MODE   |
  * |                      | enableGravityCompensation | bool | -  | -           | No        |  |  |
  * |                      | gravityCompensationBaseLink| string | - | -         | No        | ..  | |
@@ -143,6 +159,9 @@ class wholeBodyDynamicsDeviceFilters
  * The axes contained in the axesNames parameter are then mapped to the wrapped controlboard in the attachAll method, using controlBoardRemapper class.
  * Furthermore are also used to match the yarp axes to the joint names found in the passed URDF file.
  *
+ * The joint positions read at each cycle are shared through the wholeBodyDynamics::IEstimationStateSource interface
+ * with the devices attached to it (for example the floatingBaseEstimator, see its documentation for the composite mode).
+ *
  * \subsection GravityCompensation
  * This device also provides gravity compensation torques (using the IImpedanceControl::setImpedanceOffset method)
  * for axis that are in compliant interaction mode and in position/position direct/velocity control mode.
@@ -264,7 +283,8 @@ class wholeBodyDynamicsDeviceFilters
 class WholeBodyDynamicsDevice :  public yarp::dev::DeviceDriver,
                                  public yarp::dev::IMultipleWrapper,
                                  public yarp::os::RateThread,
-                                 public wholeBodyDynamics_IDLServer
+                                 public wholeBodyDynamics_IDLServer,
+                                 public wholeBodyDynamics::IEstimationStateSource
 {
     struct imuMeasurements
     {
@@ -302,6 +322,55 @@ private:
      */
     bool validOffsetAvailable;
 
+    /**
+     * If false the periodic thread is not started in attachAll,
+     * and the estimation is driven by explicit calls to run().
+     */
+    bool enableEstimationThread;
+
+    /**
+     * Duration (in seconds) of each stage of the last call to run().
+     */
+    std::vector<double> lastStageDurations;
+
+    /**
+     * State shared at each cycle with the devices registered as listeners
+     * (for example a floatingBaseEstimator running in the same process),
+     * so that they do not need to read again the same sensors.
+     */
+    wholeBodyDynamics::EstimationState estimationState;
+    std::vector<wholeBodyDynamics::IEstimationStateListener *> estimationStateListeners;
+
+    /**
+     * Fill the estimationState and call all the registered listeners.
+     */
+    void notifyEstimationStateListeners();
+
+    /**
+     * Save the time elapsed since tic as the duration of the specified stage,
+     * and restart tic.
+     */
+    void profileStage(const int stage, double & tic);
+
+    /**
+     * Body of run(): a complete estimation cycle, executed with the deviceMutex locked.
+     */
+    void estimate();
+
+    /**
+     * Period and duration of each call to run(), recorded without locks.
+     * The nominal period follows the period of the thread (see run()).
+     */
+    iCub::ctrl::realTime::LoopTimingRecorder loopTiming;
+
+    /**
+     * The timing statistics are published on the timing port
+     * once every loopTimingReportPeriod seconds by loopTimingReporter,
+     * that also keeps the statistics returned by getLoopTimingString.
+     */
+    double loopTimingReportPeriod;
+    wholeBodyDynamics::LoopTimingReporter loopTimingReporter;
+
 
     /**
      * Names of the axis (joint with at least a degree of freedom) used in estimation.
@@ -339,7 +408,51 @@ private:
      * a YARP RPC port.
      */
     wholeBodyDynamicsSettings settings;
-    wholeBodyDynamicsSettings::Editor settingsEditor;
+
+    /**
+     * Editor of the settings that signals when the frames of the kinematic source
+     * are changed through the settings port, so that the estimation loop looks up
+     * their indices only after a change.
+     */
+    class SettingsEditor : public wholeBodyDynamicsSettings::Editor
+    {
+    public:
+        SettingsEditor(wholeBodyDynamicsSettings & settings): wholeBodyDynamicsSettings::Editor(settings),
+                                                              kinematicSourceFramesChanged(0) {}
+
+        /**
+         * Return true if the frame names changed since the last call.
+         */
+        bool checkKinematicSourceFramesChanged()
+        {
+            return iCub::ctrl::realTime::atomicExchange(&kinematicSourceFramesChanged, 0) != 0;
+        }
+
+    protected:
+        virtual bool did_set_fixedFrameName()
+        {
+            iCub::ctrl::realTime::atomicStore(&kinematicSourceFramesChanged, 1);
+            return true;
+        }
+
+        virtual bool did_set_imuFrameName()
+        {
+            iCub::ctrl::realTime::atomicStore(&kinematicSourceFramesChanged, 1);
+            return true;
+        }
+
+    private:
+        volatile long kinematicSourceFramesChanged;
+    };
+
+    SettingsEditor settingsEditor;
+
+    /**
+     * Indices of settings.imuFrameName and settings.fixedFrameName in the estimator model,
+     * looked up in resolveKinematicSourceFrames() when the names are set.
+     */
+    iDynTree::FrameIndex imuFrameIndex;
+    iDynTree::FrameIndex fixedFrameIndex;
 
     /**
      * Mutex to protect the settings data structure, and all the data in
@@ -360,6 +473,7 @@ private:
 
     bool openSettingsPort();
     bool openRPCPort();
+    bool openLoopTimingPort();
     bool openRemapperControlBoard(os::Searchable& config);
     bool openRemapperVirtualSensors(os::Searchable& config);
     bool openEstimator(os::Searchable& config);
@@ -372,6 +486,7 @@ private:
      */
     bool closeSettingsPort();
     bool closeRPCPort();
+    bool closeLoopTimingPort();
     bool closeSkinContactListsPorts();
     bool closeExternalWrenchesPorts();
 
@@ -434,6 +549,12 @@ private:
     void readSensors();
     void filterSensorsAndRemoveSensorOffsets();
     void updateKinematics();
+
+    /**
+     * Look up the indices of the frames of the kinematic source,
+     * to be called whenever settings.imuFrameName or settings.fixedFrameName change.
+     */
+    void resolveKinematicSourceFrames();
     void readContactPoints();
     void computeCalibration();
     void computeExternalForcesAndJointTorques();
@@ -493,6 +614,20 @@ private:
     imuMeasurements                filteredIMUMeasurements;
 
     iDynTree::LinkUnknownWrenchContacts measuredContactLocations;
+
+    /**
+     * True if measuredContactLocations contains the current contact set.
+     * The default contacts do not change from one cycle to the other, so the
+     * set is built once and then only updated when the contact information changes.
+     */
+    bool measuredContactLocationsUpToDate;
+
+    /**
+     * Fill measuredContactLocations with a contact for each submodel,
+     * located in the default contact frame of the submodel.
+     * The set is marked as up to date only if all the contacts were added.
+     */
+    void setDefaultContactLocations();
     iDynTree::JointDOFsDoubleArray estimatedJointTorques;
     iDynTree::LinkContactWrenches  estimateExternalContactWrenches;
 
@@ -503,17 +638,23 @@ private:
     {
         bool ongoingCalibration;
         std::vector<bool> calibratingFTsensor;
-        std::vector<iDynTree::Vector6> offsetSumBuffer;
-        std::vector<iDynTree::Vector6> measurementSumBuffer;
-        std::vector<iDynTree::Vector6> estimationSumBuffer;
         iDynTree::LinkUnknownWrenchContacts assumedContactLocationsForCalibration;
-        iDynTree::SensorsMeasurements  predictedSensorMeasurementsForCalibration;
-        iDynTree::JointDOFsDoubleArray predictedJointTorquesForCalibration;
-        iDynTree::LinkContactWrenches  predictedExternalContactWrenchesForCalibration;
-        size_t nrOfSamplesUsedUntilNowForCalibration;
-        size_t nrOfSamplesToUseForCalibration;
+        std::vector<iDynTree::Wrench> offsets;
+        size_t queueSize;
+        double trimFraction;
     } calibrationBuffers;
 
+    /**
+     * Thread computing the F/T offsets from the samples collected
+     * in computeCalibration, out of the estimation loop.
+     */
+    wholeBodyDynamics::FTCalibrationWorker calibrationWorker;
+
+    /**
+     * Load the calibration settings and start the calibration thread.
+     */
+    bool openCalibrationWorker(yarp::os::Searchable& config);
+
     /**
      * Vector of classes used to process the raw FT measurements,
      * removing offset and using a secondary calibration matrix.
@@ -659,6 +800,11 @@ private:
        * @return the current settings as a human readable string.
        */
       virtual std::string getCurrentSettingsString();
+      /**
+       * Get the timing statistics of the estimation loop in the last reporting period.
+       * @return the statistics as a human readable string.
+       */
+      virtual std::string getLoopTimingString();
 
     void setupCalibrationCommonPart(const int32_t nrOfSamples);
     bool setupCalibrationWithExternalWrenchOnOneFrame(const std::string & frameName, const int32_t nrOfSamples);
@@ -722,6 +868,14 @@ private:
     //  informations on individual ports)
     std::vector< outputWrenchPortInformation > outputWrenchPorts;
 
+    /**
+     * Buffer of the world transforms of the frames used by the outputWrenchPorts,
+     * indexed by frame index. Only the frames needed in a given cycle are updated,
+     * with a single forward kinematics for all the ports.
+     */
+    std::vector<iDynTree::Transform> outputWrenchFramesWorldTransforms;
+    std::vector<bool> outputWrenchFramesToUpdate;
+
     // Buffer for external forces
     /**
      * The element netExternalWrenchesExertedByTheEnviroment[i] is the
@@ -737,10 +891,38 @@ private:
     bool m_gravityCompensationEnabled;
     wholeBodyDynamics::GravityCompensationHelper m_gravCompHelper;
     std::vector<size_t> m_gravityCompesationJoints;
+    std::vector<size_t> m_gravityCompensationJointsToPublish;
     iDynTree::JointDOFsDoubleArray m_gravityCompensationTorques;
     void resetGravityCompensation();
 
 public:
+    /**
+     * Stages in which the estimation loop (the run method) is divided.
+     */
+    enum EstimationStage
+    {
+        READ_SENSORS = 0,
+        FILTER_SENSORS,
+        UPDATE_KINEMATICS,
+        NOTIFY_STATE_LISTENERS,
+        READ_CONTACT_POINTS,
+        COMPUTE_CALIBRATION,
+        COMPUTE_ESTIMATION,
+        PUBLISH_ESTIMATES,
+        NR_OF_ESTIMATION_STAGES
+    };
+
+    /**
+     * Get a human readable name for a stage of the estimation loop.
+     */
+    static std::string getEstimationStageName(const int stage);
+
+    /**
+     * Get the duration (in seconds) of each stage of the last call to run().
+     * The vector is indexed by EstimationStage.
+     */
+    const std::vector<double> & getLastStageDurations() const;
+
     // CONSTRUCTOR
     WholeBodyDynamicsDevice();
     ~WholeBodyDynamicsDevice();
@@ -755,6 +937,11 @@ public:
 
     // RATE THREAD
     virtual void run();
+
+    // IESTIMATIONSTATESOURCE
+    virtual bool getEstimationStateJointNames(std::vector<std::string> & jointNames);
+    virtual bool addEstimationStateListener(wholeBodyDynamics::IEstimationStateListener * listener);
+    virtual bool removeEstimationStateListener(wholeBodyDynamics::IEstimationStateListener * listener);
 };
 
 }
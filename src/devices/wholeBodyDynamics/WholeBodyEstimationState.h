@@ -0,0 +1,95 @@
+#ifndef CODYCO_WHOLE_BODY_ESTIMATION_STATE_H
+#define CODYCO_WHOLE_BODY_ESTIMATION_STATE_H
+
+// iDynTree includes
+#include <iDynTree/Model/JointState.h>
+
+#include <string>
+#include <vector>
+
+namespace wholeBodyDynamics
+{
+
+/**
+ * State acquired by the wholeBodyDynamics device in a single estimation cycle.
+ *
+ * The state is immutable for the listeners: it is valid only during the
+ * IEstimationStateListener::onNewEstimationState call, and it must be copied
+ * if needed after that.
+ */
+struct EstimationState
+{
+    /**
+     * Counter incremented at each estimation cycle.
+     */
+    unsigned long sequenceNumber;
+
+    /**
+     * Time (as returned by yarp::os::Time::now) at which the sensors were read.
+     */
+    double timestamp;
+
+    /**
+     * True if all the sensors have been read correctly in this cycle.
+     */
+    bool sensorReadCorrectly;
+
+    /**
+     * Joint positions (in radians), ordered as the joint names returned by
+     * IEstimationStateSource::getEstimationStateJointNames.
+     */
+    iDynTree::JointPosDoubleArray jointPos;
+};
+
+/**
+ * Interface of a class that consumes the EstimationState produced by a IEstimationStateSource.
+ */
+class IEstimationStateListener
+{
+public:
+    virtual ~IEstimationStateListener() {}
+
+    /**
+     * Called by the source in its estimation thread, once for each cycle.
+     *
+     * The source may be holding its own locks and running with realtime constraints:
+     * the listener must only copy the data it needs (for example in a
+     * iCub::ctrl::realTime::TripleBuffer) and process them in its own thread,
+     * without blocking, allocating memory or writing on ports.
+     */
+    virtual void onNewEstimationState(const EstimationState & state) = 0;
+};
+
+/**
+ * Interface of a device that owns the sensor acquisition and shares
+ * the acquired state with other devices running in the same process,
+ * so that they do not need to read the same sensors again.
+ *
+ * The other devices get this interface explicitly, with PolyDriver::view
+ * on the source device.
+ */
+class IEstimationStateSource
+{
+public:
+    virtual ~IEstimationStateSource() {}
+
+    /**
+     * Get the names of the joints contained in the EstimationState::jointPos vector.
+     */
+    virtual bool getEstimationStateJointNames(std::vector<std::string> & jointNames) = 0;
+
+    /**
+     * Add a listener, that will be called at each estimation cycle.
+     * The source does not take ownership of the listener.
+     */
+    virtual bool addEstimationStateListener(IEstimationStateListener * listener) = 0;
+
+    /**
+     * Remove a listener previously added with addEstimationStateListener.
+     */
+    virtual bool removeEstimationStateListener(IEstimationStateListener * listener) = 0;
+};
+
+}
+
+#endif
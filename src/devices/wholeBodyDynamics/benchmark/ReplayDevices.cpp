@@ -0,0 +1,668 @@
+/*
+ * Copyright (C) 2016 Fondazione Istituto Italiano di Tecnologia
+ * CopyPolicy: Released under the terms of the LGPLv2.1 or later, see LGPL.TXT
+ */
+
+#include "ReplayDevices.h"
+
+#include <yarp/os/Bottle.h>
+#include <yarp/os/LogStream.h>
+#include <yarp/os/Property.h>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+namespace yarp {
+namespace dev {
+
+namespace
+{
+    const size_t replayDevices_nrOfChannelsOfFTSensor = 6;
+    const size_t replayDevices_nrOfChannelsOfIMUSensor = 12;
+    const double replayDevices_gravity = 9.81;
+
+    bool getAxesNames(yarp::os::Searchable& config, std::vector<std::string> & axesNames)
+    {
+        yarp::os::Bottle * propAxesNames = config.find("axesNames").asList();
+        if( propAxesNames == 0 )
+        {
+            yError() << "ReplayDevices: Error parsing parameters: \"axesNames\" should be followed by a list";
+            return false;
+        }
+
+        axesNames.resize(propAxesNames->size());
+        for(int ax=0; ax < propAxesNames->size(); ax++)
+        {
+            axesNames[ax] = propAxesNames->get(ax).asString().c_str();
+        }
+
+        return true;
+    }
+
+    /**
+     * Fill the buffer from the "file" parameter, if present.
+     * Return false only if the file is specified but it is not possible to load it.
+     */
+    bool loadBufferFromConfig(yarp::os::Searchable& config,
+                              ReplayBuffer & buf,
+                              const size_t expectedNrOfChannels,
+                              bool & loaded)
+    {
+        loaded = false;
+
+        if( !config.check("file") )
+        {
+            return true;
+        }
+
+        std::string fileName = config.find("file").asString().c_str();
+        if( !buf.loadFromDataDumperLog(fileName) )
+        {
+            return false;
+        }
+
+        if( buf.getNrOfChannels() != expectedNrOfChannels )
+        {
+            yError() << "ReplayDevices: log " << fileName << " has " << buf.getNrOfChannels()
+                     << " channels, while " << expectedNrOfChannels << " were expected";
+            return false;
+        }
+
+        loaded = true;
+        return true;
+    }
+
+    int getNrOfSyntheticSamples(yarp::os::Searchable& config)
+    {
+        int nrOfSamples = config.check("nrOfSamples",yarp::os::Value(1000)).asInt();
+        return nrOfSamples > 0 ? nrOfSamples : 1;
+    }
+}
+
+// ReplayClock
+
+ReplayClock::ReplayClock(const double period): m_sample(0), m_period(period)
+{
+}
+
+void ReplayClock::step()
+{
+    m_sample++;
+}
+
+void ReplayClock::reset()
+{
+    m_sample = 0;
+}
+
+size_t ReplayClock::sample() const
+{
+    return m_sample;
+}
+
+double ReplayClock::period() const
+{
+    return m_period;
+}
+
+double ReplayClock::time() const
+{
+    return m_period*m_sample;
+}
+
+// ReplayBuffer
+
+ReplayBuffer::ReplayBuffer(): m_nrOfChannels(0)
+{
+}
+
+void ReplayBuffer::resize(const size_t nrOfSamples, const size_t nrOfChannels)
+{
+    m_nrOfChannels = nrOfChannels;
+    m_data.assign(nrOfSamples*nrOfChannels,0.0);
+}
+
+bool ReplayBuffer::loadFromDataDumperLog(const std::string & fileName)
+{
+    std::ifstream log(fileName.c_str());
+
+    if( !log.is_open() )
+    {
+        yError() << "ReplayBuffer: impossible to open log " << fileName;
+        return false;
+    }
+
+    m_nrOfChannels = 0;
+    m_data.clear();
+
+    std::string line;
+    size_t lineNr = 0;
+    std::vector<double> values;
+    while( std::getline(log,line) )
+    {
+        lineNr++;
+
+        std::istringstream lineStream(line);
+        values.clear();
+        double value;
+        while( lineStream >> value )
+        {
+            values.push_back(value);
+        }
+
+        // Skip the counter and the timestamp
+        if( values.size() <= 2 )
+        {
+            continue;
+        }
+
+        size_t nrOfChannels = values.size()-2;
+        if( m_nrOfChannels == 0 )
+        {
+            m_nrOfChannels = nrOfChannels;
+        }
+
+        if( nrOfChannels != m_nrOfChannels )
+        {
+            yWarning() << "ReplayBuffer: skipping line " << lineNr << " of " << fileName
+                       << " : found " << nrOfChannels << " values instead of " << m_nrOfChannels;
+            continue;
+        }
+
+        m_data.insert(m_data.end(),values.begin()+2,values.end());
+    }
+
+    if( m_data.size() == 0 )
+    {
+        yError() << "ReplayBuffer: no valid sample found in log " << fileName;
+        return false;
+    }
+
+    return true;
+}
+
+size_t ReplayBuffer::getNrOfSamples() const
+{
+    return m_nrOfChannels == 0 ? 0 : m_data.size()/m_nrOfChannels;
+}
+
+size_t ReplayBuffer::getNrOfChannels() const
+{
+    return m_nrOfChannels;
+}
+
+double * ReplayBuffer::sample(const size_t sampleIdx)
+{
+    return &(m_data[(sampleIdx%getNrOfSamples())*m_nrOfChannels]);
+}
+
+const double * ReplayBuffer::sample(const size_t sampleIdx) const
+{
+    return &(m_data[(sampleIdx%getNrOfSamples())*m_nrOfChannels]);
+}
+
+// ReplayControlBoard
+
+ReplayControlBoard::ReplayControlBoard(): m_clock(0)
+{
+}
+
+ReplayControlBoard::~ReplayControlBoard()
+{
+}
+
+void ReplayControlBoard::setClock(ReplayClock* clock)
+{
+    m_clock = clock;
+}
+
+bool ReplayControlBoard::open(yarp::os::Searchable& config)
+{
+    if( !getAxesNames(config,m_axesNames) )
+    {
+        return false;
+    }
+
+    size_t nrOfAxes = m_axesNames.size();
+
+    bool loaded = false;
+    if( !loadBufferFromConfig(config,m_positions,nrOfAxes,loaded) )
+    {
+        return false;
+    }
+
+    if( !loaded )
+    {
+        // Synthetic trajectory: a sinusoid for each axis, with a different phase
+        double amplitude = config.check("amplitude",yarp::os::Value(10.0)).asDouble();
+        double frequency = config.check("frequency",yarp::os::Value(0.5)).asDouble();
+        size_t nrOfSamples = getNrOfSyntheticSamples(config);
+        double period = m_clock ? m_clock->period() : 0.01;
+
+        m_positions.resize(nrOfSamples,nrOfAxes);
+        for(size_t s=0; s < nrOfSamples; s++)
+        {
+            double * pos = m_positions.sample(s);
+            for(size_t ax=0; ax < nrOfAxes; ax++)
+            {
+                double phase = (2*M_PI*ax)/nrOfAxes;
+                pos[ax] = amplitude*sin(2*M_PI*frequency*period*s + phase);
+            }
+        }
+    }
+
+    computeDerivatives();
+
+    return true;
+}
+
+void ReplayControlBoard::computeDerivatives()
+{
+    size_t nrOfSamples = m_positions.getNrOfSamples();
+    size_t nrOfAxes    = m_positions.getNrOfChannels();
+    double period = m_clock ? m_clock->period() : 0.01;
+
+    m_velocities.resize(nrOfSamples,nrOfAxes);
+    m_accelerations.resize(nrOfSamples,nrOfAxes);
+
+    // Central differences, consistent with the wrap-around of the buffer
+    for(size_t s=0; s < nrOfSamples; s++)
+    {
+        const double * prev = m_positions.sample(s+nrOfSamples-1);
+        const double * curr = m_positions.sample(s);
+        const double * next = m_positions.sample(s+1);
+        double * vel = m_velocities.sample(s);
+        double * acc = m_accelerations.sample(s);
+        for(size_t ax=0; ax < nrOfAxes; ax++)
+        {
+            vel[ax] = (next[ax]-prev[ax])/(2*period);
+            acc[ax] = (next[ax]-2*curr[ax]+prev[ax])/(period*period);
+        }
+    }
+}
+
+bool ReplayControlBoard::getSampleChannel(const ReplayBuffer& buf, int j, double* v)
+{
+    if( j < 0 || j >= (int)m_axesNames.size() || !m_clock )
+    {
+        return false;
+    }
+
+    *v = buf.sample(m_clock->sample())[j];
+    return true;
+}
+
+bool ReplayControlBoard::getSample(const ReplayBuffer& buf, double* v)
+{
+    if( !m_clock )
+    {
+        return false;
+    }
+
+    const double * sample = buf.sample(m_clock->sample());
+    std::copy(sample,sample+buf.getNrOfChannels(),v);
+    return true;
+}
+
+bool ReplayControlBoard::close()
+{
+    return true;
+}
+
+bool ReplayControlBoard::getAxes(int* ax)
+{
+    *ax = (int)m_axesNames.size();
+    return true;
+}
+
+bool ReplayControlBoard::resetEncoder(int /*j*/)
+{
+    return false;
+}
+
+bool ReplayControlBoard::resetEncoders()
+{
+    return false;
+}
+
+bool ReplayControlBoard::setEncoder(int /*j*/, double /*val*/)
+{
+    return false;
+}
+
+bool ReplayControlBoard::setEncoders(const double* /*vals*/)
+{
+    return false;
+}
+
+bool ReplayControlBoard::getEncoder(int j, double* v)
+{
+    return getSampleChannel(m_positions,j,v);
+}
+
+bool ReplayControlBoard::getEncoders(double* encs)
+{
+    return getSample(m_positions,encs);
+}
+
+bool ReplayControlBoard::getEncoderSpeed(int j, double* sp)
+{
+    return getSampleChannel(m_velocities,j,sp);
+}
+
+bool ReplayControlBoard::getEncoderSpeeds(double* spds)
+{
+    return getSample(m_velocities,spds);
+}
+
+bool ReplayControlBoard::getEncoderAcceleration(int j, double* spds)
+{
+    return getSampleChannel(m_accelerations,j,spds);
+}
+
+bool ReplayControlBoard::getEncoderAccelerations(double* accs)
+{
+    return getSample(m_accelerations,accs);
+}
+
+bool ReplayControlBoard::getEncodersTimed(double* encs, double* time)
+{
+    bool ok = getSample(m_positions,encs);
+    for(size_t ax=0; ok && ax < m_axesNames.size(); ax++)
+    {
+        time[ax] = m_clock->time();
+    }
+    return ok;
+}
+
+bool ReplayControlBoard::getEncoderTimed(int j, double* encs, double* time)
+{
+    bool ok = getSampleChannel(m_positions,j,encs);
+    if( ok )
+    {
+        *time = m_clock->time();
+    }
+    return ok;
+}
+
+bool ReplayControlBoard::getAxisName(int axis, ConstString& name)
+{
+    if( axis < 0 || axis >= (int)m_axesNames.size() )
+    {
+        return false;
+    }
+
+    name = m_axesNames[axis];
+    return true;
+}
+
+bool ReplayControlBoard::getJointType(int axis, JointTypeEnum& type)
+{
+    if( axis < 0 || axis >= (int)m_axesNames.size() )
+    {
+        return false;
+    }
+
+    type = VOCAB_JOINTTYPE_REVOLUTE;
+    return true;
+}
+
+// ReplayFTSensor
+
+ReplayFTSensor::ReplayFTSensor(): m_clock(0)
+{
+}
+
+ReplayFTSensor::~ReplayFTSensor()
+{
+}
+
+void ReplayFTSensor::setClock(ReplayClock* clock)
+{
+    m_clock = clock;
+}
+
+bool ReplayFTSensor::open(yarp::os::Searchable& config)
+{
+    bool loaded = false;
+    if( !loadBufferFromConfig(config,m_measurements,replayDevices_nrOfChannelsOfFTSensor,loaded) )
+    {
+        return false;
+    }
+
+    if( !loaded )
+    {
+        double amplitude = config.check("amplitude",yarp::os::Value(5.0)).asDouble();
+        double frequency = config.check("frequency",yarp::os::Value(0.5)).asDouble();
+        size_t nrOfSamples = getNrOfSyntheticSamples(config);
+        double period = m_clock ? m_clock->period() : 0.01;
+
+        m_measurements.resize(nrOfSamples,replayDevices_nrOfChannelsOfFTSensor);
+        for(size_t s=0; s < nrOfSamples; s++)
+        {
+            double * meas = m_measurements.sample(s);
+            for(size_t ch=0; ch < replayDevices_nrOfChannelsOfFTSensor; ch++)
+            {
+                double chAmplitude = ch < 3 ? amplitude : 0.1*amplitude;
+                double phase = (2*M_PI*ch)/replayDevices_nrOfChannelsOfFTSensor;
+                meas[ch] = chAmplitude*sin(2*M_PI*frequency*period*s + phase);
+            }
+        }
+    }
+
+    return true;
+}
+
+bool ReplayFTSensor::close()
+{
+    return true;
+}
+
+int ReplayFTSensor::read(yarp::sig::Vector& out)
+{
+    if( !m_clock )
+    {
+        return AS_ERROR;
+    }
+
+    out.resize(replayDevices_nrOfChannelsOfFTSensor);
+    const double * sample = m_measurements.sample(m_clock->sample());
+    std::copy(sample,sample+replayDevices_nrOfChannelsOfFTSensor,out.data());
+
+    return AS_OK;
+}
+
+int ReplayFTSensor::getState(int /*ch*/)
+{
+    return m_clock ? AS_OK : AS_ERROR;
+}
+
+int ReplayFTSensor::getChannels()
+{
+    return (int)replayDevices_nrOfChannelsOfFTSensor;
+}
+
+int ReplayFTSensor::calibrateSensor()
+{
+    return AS_OK;
+}
+
+int ReplayFTSensor::calibrateSensor(const yarp::sig::Vector& /*value*/)
+{
+    return AS_OK;
+}
+
+int ReplayFTSensor::calibrateChannel(int /*ch*/)
+{
+    return AS_OK;
+}
+
+int ReplayFTSensor::calibrateChannel(int /*ch*/, double /*value*/)
+{
+    return AS_OK;
+}
+
+// ReplayIMU
+
+ReplayIMU::ReplayIMU(): m_clock(0)
+{
+}
+
+ReplayIMU::~ReplayIMU()
+{
+}
+
+void ReplayIMU::setClock(ReplayClock* clock)
+{
+    m_clock = clock;
+}
+
+bool ReplayIMU::open(yarp::os::Searchable& config)
+{
+    bool loaded = false;
+    if( !loadBufferFromConfig(config,m_measurements,replayDevices_nrOfChannelsOfIMUSensor,loaded) )
+    {
+        return false;
+    }
+
+    if( !loaded )
+    {
+        // Sensor at rest, with the z axis pointing up
+        size_t nrOfSamples = getNrOfSyntheticSamples(config);
+        m_measurements.resize(nrOfSamples,replayDevices_nrOfChannelsOfIMUSensor);
+        for(size_t s=0; s < nrOfSamples; s++)
+        {
+            m_measurements.sample(s)[5] = replayDevices_gravity;
+        }
+    }
+
+    return true;
+}
+
+bool ReplayIMU::close()
+{
+    return true;
+}
+
+bool ReplayIMU::read(yarp::sig::Vector& out)
+{
+    if( !m_clock )
+    {
+        return false;
+    }
+
+    out.resize(replayDevices_nrOfChannelsOfIMUSensor);
+    const double * sample = m_measurements.sample(m_clock->sample());
+    std::copy(sample,sample+replayDevices_nrOfChannelsOfIMUSensor,out.data());
+
+    return true;
+}
+
+bool ReplayIMU::getChannels(int* nc)
+{
+    *nc = (int)replayDevices_nrOfChannelsOfIMUSensor;
+    return true;
+}
+
+bool ReplayIMU::calibrate(int /*ch*/, double /*v*/)
+{
+    return false;
+}
+
+// ReplayVirtualAnalogSensor
+
+ReplayVirtualAnalogSensor::ReplayVirtualAnalogSensor(): m_nrOfUpdates(0)
+{
+}
+
+ReplayVirtualAnalogSensor::~ReplayVirtualAnalogSensor()
+{
+}
+
+const yarp::sig::Vector& ReplayVirtualAnalogSensor::getLastMeasure() const
+{
+    return m_lastMeasure;
+}
+
+size_t ReplayVirtualAnalogSensor::getNrOfUpdates() const
+{
+    return m_nrOfUpdates;
+}
+
+bool ReplayVirtualAnalogSensor::open(yarp::os::Searchable& config)
+{
+    if( !getAxesNames(config,m_axesNames) )
+    {
+        return false;
+    }
+
+    m_lastMeasure.resize(m_axesNames.size(),0.0);
+    m_nrOfUpdates = 0;
+
+    return true;
+}
+
+bool ReplayVirtualAnalogSensor::close()
+{
+    return true;
+}
+
+int ReplayVirtualAnalogSensor::getState(int /*ch*/)
+{
+    return IVirtualAnalogSensor::VAS_OK;
+}
+
+int ReplayVirtualAnalogSensor::getChannels()
+{
+    return (int)m_axesNames.size();
+}
+
+bool ReplayVirtualAnalogSensor::updateMeasure(yarp::sig::Vector& measure)
+{
+    if( measure.size() != m_lastMeasure.size() )
+    {
+        return false;
+    }
+
+    m_lastMeasure = measure;
+    m_nrOfUpdates++;
+    return true;
+}
+
+bool ReplayVirtualAnalogSensor::updateMeasure(int ch, double& measure)
+{
+    if( ch < 0 || ch >= (int)m_lastMeasure.size() )
+    {
+        return false;
+    }
+
+    m_lastMeasure[ch] = measure;
+    return true;
+}
+
+bool ReplayVirtualAnalogSensor::getAxisName(int axis, ConstString& name)
+{
+    if( axis < 0 || axis >= (int)m_axesNames.size() )
+    {
+        return false;
+    }
+
+    name = m_axesNames[axis];
+    return true;
+}
+
+bool ReplayVirtualAnalogSensor::getJointType(int axis, JointTypeEnum& type)
+{
+    if( axis < 0 || axis >= (int)m_axesNames.size() )
+    {
+        return false;
+    }
+
+    type = VOCAB_JOINTTYPE_REVOLUTE;
+    return true;
+}
+
+}
+}
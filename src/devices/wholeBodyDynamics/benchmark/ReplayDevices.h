@@ -0,0 +1,286 @@
+/*
+ * Copyright (C) 2016 Fondazione Istituto Italiano di Tecnologia
+ * CopyPolicy: Released under the terms of the LGPLv2.1 or later, see LGPL.TXT
+ */
+
+#ifndef CODYCO_WHOLE_BODY_DYNAMICS_REPLAY_DEVICES_H
+#define CODYCO_WHOLE_BODY_DYNAMICS_REPLAY_DEVICES_H
+
+#include <yarp/dev/DeviceDriver.h>
+#include <yarp/dev/ControlBoardInterfaces.h>
+#include <yarp/dev/IAnalogSensor.h>
+#include <yarp/dev/GenericSensorInterfaces.h>
+#include <yarp/dev/IVirtualAnalogSensor.h>
+
+#include <yarp/sig/Vector.h>
+
+#include <string>
+#include <vector>
+
+namespace yarp {
+namespace dev {
+
+/**
+ * Sample counter shared by all the replay devices.
+ *
+ * All the replay devices attached to the same clock return the
+ * sample with the same index, so the whole set of sensors is
+ * consistent during a call to WholeBodyDynamicsDevice::run(),
+ * regardless of how many times each interface is read.
+ */
+class ReplayClock
+{
+    size_t m_sample;
+    double m_period;
+
+public:
+    /**
+     * @param period time (in seconds) between two consecutive samples.
+     */
+    ReplayClock(const double period=0.01);
+
+    /**
+     * Advance the clock by one sample.
+     */
+    void step();
+
+    /**
+     * Reset the clock to the first sample.
+     */
+    void reset();
+
+    size_t sample() const;
+
+    double period() const;
+
+    /**
+     * Timestamp of the current sample, in seconds.
+     */
+    double time() const;
+};
+
+/**
+ * In-memory buffer of samples, each one of a fixed number of channels.
+ *
+ * The buffer can be filled from a log of the yarpdatadumper
+ * (each line in the format "counter timestamp value_1 ... value_n")
+ * or by the caller (for example with a synthetic trajectory).
+ * When the clock goes beyond the last sample the buffer wraps around,
+ * so a short log can drive an arbitrarily long benchmark.
+ */
+class ReplayBuffer
+{
+    size_t m_nrOfChannels;
+    std::vector<double> m_data;
+
+public:
+    ReplayBuffer();
+
+    /**
+     * Resize the buffer, setting all the samples to zero.
+     */
+    void resize(const size_t nrOfSamples, const size_t nrOfChannels);
+
+    /**
+     * Load the buffer from a yarpdatadumper log.
+     *
+     * The first two columns (counter and timestamp) are discarded.
+     * Lines with a number of values different from the one of the
+     * first valid line are skipped with a warning.
+     */
+    bool loadFromDataDumperLog(const std::string & fileName);
+
+    size_t getNrOfSamples() const;
+    size_t getNrOfChannels() const;
+
+    /**
+     * Pointer to the first channel of the specified sample (taken modulo the number of samples).
+     */
+    double * sample(const size_t sampleIdx);
+    const double * sample(const size_t sampleIdx) const;
+};
+
+/**
+ * \brief Control board that replays joint positions from memory.
+ *
+ * Implements IEncodersTimed and IAxisInfo, that are the interfaces
+ * required by the controlboardremapper used inside the WholeBodyDynamicsDevice.
+ * Positions, velocities and accelerations are expressed in degrees (as on the YARP wire).
+ *
+ * | Parameter name | Type               | Units | Default Value | Required | Description |
+ * |:--------------:|:------------------:|:-----:|:-------------:|:--------:|:-----------:|
+ * | axesNames      | vector of strings  | -     | -             | Yes      | Names of the axes exposed by the device. |
+ * | file           | string             | -     | -             | No       | yarpdatadumper log of the joint positions (one column for each axis). If not present, a synthetic sinusoidal trajectory is generated. |
+ * | amplitude      | double             | deg   | 10.0          | No       | Amplitude of the synthetic trajectory. |
+ * | frequency      | double             | Hz    | 0.5           | No       | Frequency of the synthetic trajectory. |
+ * | nrOfSamples    | int                | -     | 1000          | No       | Number of samples of the synthetic trajectory. |
+ *
+ * Velocities and accelerations are computed by finite differences of the replayed positions.
+ */
+class ReplayControlBoard : public DeviceDriver,
+                           public IEncodersTimed,
+                           public IAxisInfo
+{
+    ReplayClock * m_clock;
+    std::vector<std::string> m_axesNames;
+    ReplayBuffer m_positions;
+    ReplayBuffer m_velocities;
+    ReplayBuffer m_accelerations;
+
+    void computeDerivatives();
+    bool getSampleChannel(const ReplayBuffer & buf, int j, double * v);
+    bool getSample(const ReplayBuffer & buf, double * v);
+
+public:
+    ReplayControlBoard();
+    virtual ~ReplayControlBoard();
+
+    void setClock(ReplayClock * clock);
+
+    /* DeviceDriver methods */
+    virtual bool open(yarp::os::Searchable& config);
+    virtual bool close();
+
+    /* IEncoders methods */
+    virtual bool getAxes(int *ax);
+    virtual bool resetEncoder(int j);
+    virtual bool resetEncoders();
+    virtual bool setEncoder(int j, double val);
+    virtual bool setEncoders(const double *vals);
+    virtual bool getEncoder(int j, double *v);
+    virtual bool getEncoders(double *encs);
+    virtual bool getEncoderSpeed(int j, double *sp);
+    virtual bool getEncoderSpeeds(double *spds);
+    virtual bool getEncoderAcceleration(int j, double *spds);
+    virtual bool getEncoderAccelerations(double *accs);
+
+    /* IEncodersTimed methods */
+    virtual bool getEncodersTimed(double *encs, double *time);
+    virtual bool getEncoderTimed(int j, double *encs, double *time);
+
+    /* IAxisInfo methods */
+    virtual bool getAxisName(int axis, yarp::os::ConstString& name);
+    virtual bool getJointType(int axis, yarp::dev::JointTypeEnum& type);
+};
+
+/**
+ * \brief Six axis F/T sensor that replays measurements from memory.
+ *
+ * | Parameter name | Type    | Units   | Default Value | Required | Description |
+ * |:--------------:|:-------:|:-------:|:-------------:|:--------:|:-----------:|
+ * | file           | string  | -       | -             | No       | yarpdatadumper log of the sensor (6 columns, force then torque). If not present, a synthetic measurement is generated. |
+ * | amplitude      | double  | N       | 5.0           | No       | Amplitude of the synthetic force oscillation (torques use one tenth of it). |
+ * | frequency      | double  | Hz      | 0.5           | No       | Frequency of the synthetic measurement. |
+ * | nrOfSamples    | int     | -       | 1000          | No       | Number of samples of the synthetic measurement. |
+ */
+class ReplayFTSensor : public DeviceDriver,
+                       public IAnalogSensor
+{
+    ReplayClock * m_clock;
+    ReplayBuffer m_measurements;
+
+public:
+    ReplayFTSensor();
+    virtual ~ReplayFTSensor();
+
+    void setClock(ReplayClock * clock);
+
+    /* DeviceDriver methods */
+    virtual bool open(yarp::os::Searchable& config);
+    virtual bool close();
+
+    /* IAnalogSensor methods */
+    virtual int read(yarp::sig::Vector &out);
+    virtual int getState(int ch);
+    virtual int getChannels();
+    virtual int calibrateSensor();
+    virtual int calibrateSensor(const yarp::sig::Vector& value);
+    virtual int calibrateChannel(int ch);
+    virtual int calibrateChannel(int ch, double value);
+};
+
+/**
+ * \brief Inertial sensor that replays measurements from memory.
+ *
+ * The output follows the format of the iCub inertial sensor
+ * (http://wiki.icub.org/wiki/Inertial_Sensor): 12 channels, with the
+ * proper linear acceleration in channels 3-5 and the angular velocity (in deg/s)
+ * in channels 6-8.
+ *
+ * | Parameter name | Type    | Units   | Default Value | Required | Description |
+ * |:--------------:|:-------:|:-------:|:-------------:|:--------:|:-----------:|
+ * | file           | string  | -       | -             | No       | yarpdatadumper log of the inertial sensor (12 columns). If not present, a synthetic measurement of a sensor at rest is generated. |
+ * | nrOfSamples    | int     | -       | 1000          | No       | Number of samples of the synthetic measurement. |
+ */
+class ReplayIMU : public DeviceDriver,
+                  public IGenericSensor
+{
+    ReplayClock * m_clock;
+    ReplayBuffer m_measurements;
+
+public:
+    ReplayIMU();
+    virtual ~ReplayIMU();
+
+    void setClock(ReplayClock * clock);
+
+    /* DeviceDriver methods */
+    virtual bool open(yarp::os::Searchable& config);
+    virtual bool close();
+
+    /* IGenericSensor methods */
+    virtual bool read(yarp::sig::Vector &out);
+    virtual bool getChannels(int *nc);
+    virtual bool calibrate(int ch, double v);
+};
+
+/**
+ * \brief Virtual analog sensor that just stores the last measure received.
+ *
+ * Implements IVirtualAnalogSensor and IAxisInfo, as required by the virtualAnalogRemapper.
+ *
+ * | Parameter name | Type               | Units | Default Value | Required | Description |
+ * |:--------------:|:------------------:|:-----:|:-------------:|:--------:|:-----------:|
+ * | axesNames      | vector of strings  | -     | -             | Yes      | Names of the axes exposed by the device. |
+ */
+class ReplayVirtualAnalogSensor : public DeviceDriver,
+                                  public IVirtualAnalogSensor,
+                                  public IAxisInfo
+{
+    std::vector<std::string> m_axesNames;
+    yarp::sig::Vector m_lastMeasure;
+    size_t m_nrOfUpdates;
+
+public:
+    ReplayVirtualAnalogSensor();
+    virtual ~ReplayVirtualAnalogSensor();
+
+    /**
+     * Last measure received through updateMeasure.
+     */
+    const yarp::sig::Vector & getLastMeasure() const;
+
+    /**
+     * Number of calls to the vector version of updateMeasure.
+     */
+    size_t getNrOfUpdates() const;
+
+    /* DeviceDriver methods */
+    virtual bool open(yarp::os::Searchable& config);
+    virtual bool close();
+
+    /* IVirtualAnalogSensor methods */
+    virtual int getState(int ch);
+    virtual int getChannels();
+    virtual bool updateMeasure(yarp::sig::Vector &measure);
+    virtual bool updateMeasure(int ch, double &measure);
+
+    /* IAxisInfo methods */
+    virtual bool getAxisName(int axis, yarp::os::ConstString& name);
+    virtual bool getJointType(int axis, yarp::dev::JointTypeEnum& type);
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,315 @@
+/*
+ * Copyright (C) 2016 Fondazione Istituto Italiano di Tecnologia
+ * CopyPolicy: Released under the terms of the LGPLv2.1 or later, see LGPL.TXT
+ */
+
+/**
+\defgroup wholeBodyDynamicsBenchmark wholeBodyDynamicsBenchmark
+
+@ingroup codyco_module
+
+Offline benchmark of the \ref wholeBodyDynamicsDevice estimation loop.
+
+\section intro_sec Description
+
+This executable runs the estimation loop of the wholeBodyDynamicsDevice as fast
+as possible, without any robot, simulator or yarpserver. The devices attached
+to the wholeBodyDynamicsDevice are replaced by in-memory stand-ins (see ReplayDevices.h)
+that replay logs acquired with the yarpdatadumper or synthetic trajectories.
+At the end of the run the throughput of the loop and the latency statistics of each stage
+of the estimation are printed.
+
+The configuration is the one of the wholeBodyDynamicsDevice (by default the wholeBodyDynamicsDevice.ini
+file of the wholeBodyDynamics3 context, so the robot-specific version is used if YARP_ROBOT_NAME is set),
+and the model is loaded from the modelFile specified there. As for \ref wholeBodyDynamics3, the
+virtualAnalogRemapper and controlboardremapper plugins need to be available at runtime.
+
+\section parameters_sec Parameters
+In addition to the parameters of the wholeBodyDynamicsDevice:
+
+| Parameter name    | Type   | Units | Default Value | Required | Description |
+|:-----------------:|:------:|:-----:|:-------------:|:--------:|:-----------:|
+| iterations        | int    | -     | 10000         | No       | Number of iterations of the estimation loop. |
+| samplingPeriod    | double | s     | 0.01          | No       | Time between two samples of the replayed data. |
+| nrOfSamples       | int    | -     | 1000          | No       | Number of samples of the synthetic trajectories. |
+| maxMeanLoopTime   | double | s     | -             | No       | If present, the benchmark fails (non-zero exit code) if the mean duration of the loop exceeds this value. |
+| REPLAY_LOGS       | group  | -     | -             | No       | yarpdatadumper logs to replay: `encoders` (one column for each axis in axesNames), `imu`, and one entry for each F/T sensor, named as the sensor in the model. Missing entries are replaced by synthetic data. |
+
+\section usage_sec Usage
+~~~
+wholeBodyDynamicsBenchmark --from wholeBodyDynamicsDevice.ini --iterations 5000
+~~~
+*/
+
+#include "WholeBodyDynamicsDevice.h"
+#include "ReplayDevices.h"
+
+#include <yarp/os/Network.h>
+#include <yarp/os/LogStream.h>
+#include <yarp/os/Property.h>
+#include <yarp/os/ResourceFinder.h>
+#include <yarp/os/Time.h>
+#include <yarp/dev/PolyDriver.h>
+#include <yarp/dev/PolyDriverList.h>
+
+#include <iDynTree/Estimation/ExtWrenchesAndJointTorquesEstimator.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+/**
+ * Add a list of strings to a property, in the format expected by the axesNames option.
+ */
+void addAxesNames(yarp::os::Property & prop, const std::vector<std::string> & axesNames)
+{
+    prop.addGroup("axesNames");
+    yarp::os::Bottle & bot = prop.findGroup("axesNames").addList();
+    for(size_t i=0; i < axesNames.size(); i++)
+    {
+        bot.addString(axesNames[i].c_str());
+    }
+}
+
+/**
+ * Add the log file for the replay device with the specified key, if present in the REPLAY_LOGS group.
+ */
+void addReplayLog(yarp::os::Property & prop, yarp::os::Searchable & config, const std::string & key)
+{
+    yarp::os::Bottle & logs = config.findGroup("REPLAY_LOGS");
+    if( !logs.isNull() && logs.check(key.c_str()) )
+    {
+        yarp::os::ResourceFinder & rf = yarp::os::ResourceFinder::getResourceFinderSingleton();
+        std::string fileName = logs.find(key.c_str()).asString().c_str();
+        std::string fullPath = rf.findFileByName(fileName);
+        prop.put("file",fullPath.empty() ? fileName.c_str() : fullPath.c_str());
+    }
+}
+
+/**
+ * Wrap a replay device in a PolyDriver, and add it to the list of devices to attach.
+ */
+void pushDevice(yarp::dev::PolyDriverList & list,
+                std::vector<yarp::dev::PolyDriver *> & drivers,
+                yarp::dev::DeviceDriver * dev,
+                const std::string & key)
+{
+    yarp::dev::PolyDriver * poly = new yarp::dev::PolyDriver();
+    poly->give(dev,true);
+    drivers.push_back(poly);
+    list.push(poly,key.c_str());
+}
+
+struct StageStatistics
+{
+    double mean;
+    double p50;
+    double p99;
+    double max;
+};
+
+StageStatistics computeStatistics(std::vector<double> & durations)
+{
+    StageStatistics stats;
+    stats.mean = stats.p50 = stats.p99 = stats.max = 0.0;
+
+    if( durations.size() == 0 )
+    {
+        return stats;
+    }
+
+    std::sort(durations.begin(),durations.end());
+
+    double sum = 0.0;
+    for(size_t i=0; i < durations.size(); i++)
+    {
+        sum += durations[i];
+    }
+
+    stats.mean = sum/durations.size();
+    stats.p50  = durations[(durations.size()-1)/2];
+    stats.p99  = durations[((durations.size()-1)*99)/100];
+    stats.max  = durations.back();
+
+    return stats;
+}
+
+void printStatistics(const std::string & name, const StageStatistics & stats)
+{
+    printf("%-20s %12.2f %12.2f %12.2f %12.2f\n", name.c_str(),
+           1e6*stats.mean, 1e6*stats.p50, 1e6*stats.p99, 1e6*stats.max);
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    // The benchmark does not need a yarpserver: all the ports are local
+    yarp::os::Network::setLocalMode(true);
+    yarp::os::Network yarpNetwork;
+
+    yarp::os::ResourceFinder & rf = yarp::os::ResourceFinder::getResourceFinderSingleton();
+    rf.setVerbose(true);
+    rf.setDefaultContext("wholeBodyDynamics3");
+    rf.setDefaultConfigFile("wholeBodyDynamicsDevice.ini");
+    rf.configure(argc, argv);
+
+    int    nrOfIterations = rf.check("iterations",yarp::os::Value(10000)).asInt();
+    double samplingPeriod = rf.check("samplingPeriod",yarp::os::Value(0.01)).asDouble();
+    int    nrOfSamples    = rf.check("nrOfSamples",yarp::os::Value(1000)).asInt();
+
+    // Load the model, to get the axes and the F/T sensors for which a replay device is needed
+    std::vector<std::string> axesNames;
+    yarp::os::Bottle * propAxesNames = rf.find("axesNames").asList();
+    if( propAxesNames == 0 )
+    {
+        yError() << "wholeBodyDynamicsBenchmark: \"axesNames\" should be followed by a list";
+        return EXIT_FAILURE;
+    }
+
+    for(int ax=0; ax < propAxesNames->size(); ax++)
+    {
+        axesNames.push_back(propAxesNames->get(ax).asString().c_str());
+    }
+
+    std::string modelFileName = rf.check("modelFile",yarp::os::Value("model.urdf")).asString().c_str();
+    std::string modelFileFullPath = rf.findFileByName(modelFileName);
+
+    iDynTree::ExtWrenchesAndJointTorquesEstimator modelLoader;
+    if( !modelLoader.loadModelAndSensorsFromFileWithSpecifiedDOFs(modelFileFullPath,axesNames) )
+    {
+        yError() << "wholeBodyDynamicsBenchmark: impossible to load model from " << modelFileName
+                 << " ( full path: " << modelFileFullPath << " )";
+        return EXIT_FAILURE;
+    }
+
+    // Create the replay devices
+    yarp::dev::ReplayClock clock(samplingPeriod);
+    yarp::dev::PolyDriverList devicesList;
+    std::vector<yarp::dev::PolyDriver *> drivers;
+    bool ok = true;
+
+    yarp::os::Property commonConf;
+    commonConf.put("nrOfSamples",nrOfSamples);
+
+    {
+        yarp::dev::ReplayControlBoard * cb = new yarp::dev::ReplayControlBoard();
+        cb->setClock(&clock);
+        yarp::os::Property conf(commonConf);
+        addAxesNames(conf,axesNames);
+        addReplayLog(conf,rf,"encoders");
+        ok = ok && cb->open(conf);
+        pushDevice(devicesList,drivers,cb,"replay_controlboard");
+    }
+
+    yarp::dev::ReplayVirtualAnalogSensor * vas = new yarp::dev::ReplayVirtualAnalogSensor();
+    {
+        yarp::os::Property conf(commonConf);
+        addAxesNames(conf,axesNames);
+        ok = ok && vas->open(conf);
+        pushDevice(devicesList,drivers,vas,"replay_virtual_analog_sensor");
+    }
+
+    {
+        yarp::dev::ReplayIMU * imu = new yarp::dev::ReplayIMU();
+        imu->setClock(&clock);
+        yarp::os::Property conf(commonConf);
+        addReplayLog(conf,rf,"imu");
+        ok = ok && imu->open(conf);
+        pushDevice(devicesList,drivers,imu,"replay_imu");
+    }
+
+    // The F/T devices are matched with the sensors in the model using the device key
+    size_t nrOfFTs = modelLoader.sensors().getNrOfSensors(iDynTree::SIX_AXIS_FORCE_TORQUE);
+    for(size_t ft=0; ft < nrOfFTs; ft++)
+    {
+        std::string sensorName = modelLoader.sensors().getSensor(iDynTree::SIX_AXIS_FORCE_TORQUE,ft)->getName();
+        yarp::dev::ReplayFTSensor * ftDev = new yarp::dev::ReplayFTSensor();
+        ftDev->setClock(&clock);
+        yarp::os::Property conf(commonConf);
+        addReplayLog(conf,rf,sensorName);
+        ok = ok && ftDev->open(conf);
+        pushDevice(devicesList,drivers,ftDev,sensorName);
+    }
+
+    // Open the estimator, without starting its periodic thread
+    yarp::os::Property wbdConf;
+    wbdConf.fromString(rf.toString());
+    wbdConf.fromString("(enableEstimationThread false)",false);
+
+    yarp::dev::WholeBodyDynamicsDevice wbd;
+    ok = ok && wbd.open(wbdConf);
+    ok = ok && wbd.attachAll(devicesList);
+
+    if( !ok )
+    {
+        yError() << "wholeBodyDynamicsBenchmark: impossible to open the replay devices or the wholeBodyDynamicsDevice";
+        wbd.close();
+        for(size_t i=0; i < drivers.size(); i++)
+        {
+            delete drivers[i];
+        }
+        return EXIT_FAILURE;
+    }
+
+    // Run the estimation loop
+    const int nrOfStages = yarp::dev::WholeBodyDynamicsDevice::NR_OF_ESTIMATION_STAGES;
+    std::vector< std::vector<double> > stageDurations(nrOfStages,std::vector<double>(nrOfIterations,0.0));
+    std::vector<double> loopDurations(nrOfIterations,0.0);
+
+    double benchmarkTic = yarp::os::Time::now();
+    for(int it=0; it < nrOfIterations; it++)
+    {
+        double tic = yarp::os::Time::now();
+        wbd.run();
+        loopDurations[it] = yarp::os::Time::now()-tic;
+
+        const std::vector<double> & lastStageDurations = wbd.getLastStageDurations();
+        for(int stage=0; stage < nrOfStages; stage++)
+        {
+            stageDurations[stage][it] = lastStageDurations[stage];
+        }
+
+        clock.step();
+    }
+    double benchmarkDuration = yarp::os::Time::now()-benchmarkTic;
+
+    // Report
+    printf("wholeBodyDynamicsBenchmark: %d iterations in %.3f s (%.1f iterations/s), %u joint torques updates\n",
+           nrOfIterations, benchmarkDuration, nrOfIterations/benchmarkDuration,
+           (unsigned int)vas->getNrOfUpdates());
+    printf("%-20s %12s %12s %12s %12s\n","stage","mean [us]","p50 [us]","p99 [us]","max [us]");
+    for(int stage=0; stage < nrOfStages; stage++)
+    {
+        printStatistics(yarp::dev::WholeBodyDynamicsDevice::getEstimationStageName(stage),
+                        computeStatistics(stageDurations[stage]));
+    }
+    StageStatistics loopStats = computeStatistics(loopDurations);
+    printStatistics("total",loopStats);
+
+    int ret = EXIT_SUCCESS;
+    if( rf.check("maxMeanLoopTime") )
+    {
+        double maxMeanLoopTime = rf.find("maxMeanLoopTime").asDouble();
+        if( loopStats.mean > maxMeanLoopTime )
+        {
+            yError() << "wholeBodyDynamicsBenchmark: mean loop time " << loopStats.mean
+                     << " s exceeds the maximum allowed " << maxMeanLoopTime << " s";
+            ret = EXIT_FAILURE;
+        }
+    }
+
+    wbd.detachAll();
+    wbd.close();
+    for(size_t i=0; i < drivers.size(); i++)
+    {
+        delete drivers[i];
+    }
+
+    return ret;
+}
@@ -143,6 +143,11 @@ public:
    * @return the current settings as a human readable string.
    */
   virtual std::string getCurrentSettingsString();
+  /**
+   * Get the timing statistics of the estimation loop in the last reporting period.
+   * @return the statistics (percentiles of the period and of the duration of a cycle, late cycles and overruns) as a human readable string.
+   */
+  virtual std::string getLoopTimingString();
   virtual bool read(yarp::os::ConnectionReader& connection);
   virtual std::vector<std::string> help(const std::string& functionName="--all");
 };
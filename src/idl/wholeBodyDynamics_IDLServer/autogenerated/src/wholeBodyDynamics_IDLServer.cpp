@@ -193,6 +193,14 @@ public:
   virtual bool read(yarp::os::ConnectionReader& connection);
 };
 
+class wholeBodyDynamics_IDLServer_getLoopTimingString : public yarp::os::Portable {
+public:
+  std::string _return;
+  void init();
+  virtual bool write(yarp::os::ConnectionWriter& connection);
+  virtual bool read(yarp::os::ConnectionReader& connection);
+};
+
 bool wholeBodyDynamics_IDLServer_calib::write(yarp::os::ConnectionWriter& connection) {
   yarp::os::idl::WireWriter writer(connection);
   if (!writer.writeListHeader(3)) return false;
@@ -672,6 +680,27 @@ void wholeBodyDynamics_IDLServer_getCurrentSettingsString::init() {
   _return = "";
 }
 
+bool wholeBodyDynamics_IDLServer_getLoopTimingString::write(yarp::os::ConnectionWriter& connection) {
+  yarp::os::idl::WireWriter writer(connection);
+  if (!writer.writeListHeader(1)) return false;
+  if (!writer.writeTag("getLoopTimingString",1,1)) return false;
+  return true;
+}
+
+bool wholeBodyDynamics_IDLServer_getLoopTimingString::read(yarp::os::ConnectionReader& connection) {
+  yarp::os::idl::WireReader reader(connection);
+  if (!reader.readListReturn()) return false;
+  if (!reader.readString(_return)) {
+    reader.fail();
+    return false;
+  }
+  return true;
+}
+
+void wholeBodyDynamics_IDLServer_getLoopTimingString::init() {
+  _return = "";
+}
+
 wholeBodyDynamics_IDLServer::wholeBodyDynamics_IDLServer() {
   yarp().setOwner(*this);
 }
@@ -885,6 +914,16 @@ std::string wholeBodyDynamics_IDLServer::getCurrentSettingsString() {
   bool ok = yarp().write(helper,helper);
   return ok?helper._return:_return;
 }
+std::string wholeBodyDynamics_IDLServer::getLoopTimingString() {
+  std::string _return = "";
+  wholeBodyDynamics_IDLServer_getLoopTimingString helper;
+  helper.init();
+  if (!yarp().canWrite()) {
+    yError("Missing server method '%s'?","std::string wholeBodyDynamics_IDLServer::getLoopTimingString()");
+  }
+  bool ok = yarp().write(helper,helper);
+  return ok?helper._return:_return;
+}
 
 bool wholeBodyDynamics_IDLServer::read(yarp::os::ConnectionReader& connection) {
   yarp::os::idl::WireReader reader(connection);
@@ -1217,6 +1256,17 @@ bool wholeBodyDynamics_IDLServer::read(yarp::os::ConnectionReader& connection) {
       reader.accept();
       return true;
     }
+    if (tag == "getLoopTimingString") {
+      std::string _return;
+      _return = getLoopTimingString();
+      yarp::os::idl::WireWriter writer(reader);
+      if (!writer.isNull()) {
+        if (!writer.writeListHeader(1)) return false;
+        if (!writer.writeString(_return)) return false;
+      }
+      reader.accept();
+      return true;
+    }
     if (tag == "help") {
       std::string functionName;
       if (!reader.readString(functionName)) {
@@ -1272,6 +1322,7 @@ std::vector<std::string> wholeBodyDynamics_IDLServer::help(const std::string& fu
     helpString.push_back("setUseOfJointVelocities");
     helpString.push_back("setUseOfJointAccelerations");
     helpString.push_back("getCurrentSettingsString");
+    helpString.push_back("getLoopTimingString");
     helpString.push_back("help");
   }
   else {
@@ -1401,6 +1452,11 @@ std::vector<std::string> wholeBodyDynamics_IDLServer::help(const std::string& fu
       helpString.push_back("Get the current settings in the form of a string. ");
       helpString.push_back("@return the current settings as a human readable string. ");
     }
+    if (functionName=="getLoopTimingString") {
+      helpString.push_back("std::string getLoopTimingString() ");
+      helpString.push_back("Get the timing statistics of the estimation loop in the last reporting period. ");
+      helpString.push_back("@return the statistics (percentiles of the period and of the duration of a cycle, late cycles and overruns) as a human readable string. ");
+    }
     if (functionName=="help") {
       helpString.push_back("std::vector<std::string> help(const std::string& functionName=\"--all\")");
       helpString.push_back("Return list of available commands, or help message for a specific function");
@@ -159,6 +159,12 @@ service wholeBodyDynamics_IDLServer
    * @return the current settings as a human readable string.
    */
   string getCurrentSettingsString();
+
+  /**
+   * Get the timing statistics of the estimation loop in the last reporting period.
+   * @return the statistics (percentiles of the period and of the duration of a cycle, late cycles and overruns) as a human readable string.
+   */
+  string getLoopTimingString();
 }
 
 
@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2016 Fondazione Istituto Italiano di Tecnologia
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found at
+ * http://www.robotcub.org/icub/license/gpl.txt
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+*/
+
+/**
+ * \defgroup Atomics Atomics
+ *
+ * @ingroup ctrlLibRT
+ *
+ * Atomic operations on a long, for exchanging data between a realtime
+ * loop and other threads without locks.
+ *
+ */
+
+#ifndef RT_ATOMICS_H
+#define RT_ATOMICS_H
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+
+namespace iCub
+{
+
+namespace ctrl
+{
+
+namespace realTime
+{
+
+/**
+* \ingroup Atomics
+*
+* Atomically replace the value pointed by ptr.
+* All the atomic operations of this group are full memory barriers:
+* no memory access is reordered across them.
+* @return the previous value.
+*/
+inline long atomicExchange(volatile long * ptr, const long value)
+{
+#ifdef _MSC_VER
+    return _InterlockedExchange(ptr, value);
+#else
+    // __sync_lock_test_and_set is only an acquire barrier, so add the release part
+    __sync_synchronize();
+    return __sync_lock_test_and_set(ptr, value);
+#endif
+}
+
+/**
+* \ingroup Atomics
+*
+* Atomically add value to the value pointed by ptr.
+* @return the new value.
+*/
+inline long atomicAdd(volatile long * ptr, const long value)
+{
+#ifdef _MSC_VER
+    return _InterlockedExchangeAdd(ptr, value) + value;
+#else
+    return __sync_add_and_fetch(ptr, value);
+#endif
+}
+
+/**
+* \ingroup Atomics
+*
+* Atomically read the value pointed by ptr.
+*/
+inline long atomicLoad(volatile long * ptr)
+{
+    return atomicAdd(ptr, 0);
+}
+
+/**
+* \ingroup Atomics
+*
+* Atomically write the value pointed by ptr.
+*/
+inline void atomicStore(volatile long * ptr, const long value)
+{
+    atomicExchange(ptr, value);
+}
+
+/**
+* \ingroup Atomics
+*
+* Atomically increment the value pointed by ptr.
+* @return the new value.
+*/
+inline long atomicIncrement(volatile long * ptr)
+{
+    return atomicAdd(ptr, 1);
+}
+
+/**
+* \ingroup Atomics
+*
+* Atomically replace the value pointed by ptr with value, if it is equal to expected.
+* @return the value pointed by ptr before the operation
+*         (equal to expected if the value was replaced).
+*/
+inline long atomicCompareAndSwap(volatile long * ptr, const long expected, const long value)
+{
+#ifdef _MSC_VER
+    return _InterlockedCompareExchange(ptr, value, expected);
+#else
+    return __sync_val_compare_and_swap(ptr, expected, value);
+#endif
+}
+
+/**
+* \ingroup Atomics
+*
+* Atomically replace the value pointed by ptr with value, if value is greater.
+*/
+inline void atomicMax(volatile long * ptr, const long value)
+{
+    long current = atomicLoad(ptr);
+    while (value > current) {
+        long previous = atomicCompareAndSwap(ptr, current, value);
+        if (previous == current) break;
+        current = previous;
+    }
+}
+
+}
+
+}
+
+}
+
+#endif
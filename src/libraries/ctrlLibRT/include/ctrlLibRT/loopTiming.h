@@ -0,0 +1,180 @@
+/*
+ * Copyright (C) 2016 Fondazione Istituto Italiano di Tecnologia
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found at
+ * http://www.robotcub.org/icub/license/gpl.txt
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+*/
+
+/**
+ * \defgroup LoopTiming LoopTiming
+ *
+ * @ingroup ctrlLibRT
+ *
+ * Classes for monitoring the timing of periodic (control or estimation) loops.
+ *
+ */
+
+#ifndef RT_LOOPTIMING_H
+#define RT_LOOPTIMING_H
+
+#include <yarp/os/Bottle.h>
+
+#include <string>
+#include <vector>
+
+
+namespace iCub
+{
+
+namespace ctrl
+{
+
+namespace realTime
+{
+
+/**
+* \ingroup LoopTiming
+*
+* Timing statistics of a loop in a time window.
+* All the times are in seconds. The percentiles are upper bounds,
+* with a relative error of less than 3.2%.
+*/
+struct LoopTimingStatistics
+{
+    unsigned long ticks;        ///< number of ticks in the window
+    double periodP50;           ///< median of the period (time between the beginning of two consecutive ticks)
+    double periodP99;
+    double periodP999;
+    double periodMax;
+    double usedP50;             ///< median of the execution time of a tick
+    double usedP99;
+    double usedP999;
+    double usedMax;
+    unsigned long lateTicks;    ///< ticks started later than (1 + lateTolerance) nominal periods after the previous one
+    unsigned long overruns;     ///< ticks whose execution time exceeded the nominal period
+    unsigned long totalTicks;   ///< number of ticks since the creation of the recorder
+    unsigned long totalLateTicks;
+    unsigned long totalOverruns;
+
+    LoopTimingStatistics();
+
+    /**
+    * Write the statistics as a list of (key value) pairs:
+    * (ticks n) (period (p50 p99 p99.9 max)) (used (p50 p99 p99.9 max))
+    * (lateTicks n) (overruns n) (totalTicks n) (totalLateTicks n) (totalOverruns n).
+    * @param bottle the bottle to which the statistics are appended.
+    */
+    void toBottle(yarp::os::Bottle &bottle) const;
+
+    /**
+    * Return the statistics as a human readable string (times in ms).
+    */
+    std::string toString() const;
+};
+
+/**
+* \ingroup LoopTiming
+*
+* Recorder of the period and of the execution time of each tick of a loop.
+*
+* The loop thread calls tickStarted at the beginning and tickFinished at the end of
+* each tick: they only update two log-linear histograms (32 bins per power of two,
+* from 1 us to 67 s) and a few counters with atomic operations, without locks
+* or allocations, so the recorder can be left enabled in production.
+* Another thread periodically calls getStatistics, that computes the percentiles
+* of the ticks recorded since its previous call.
+*
+* There must be only one thread calling tickStarted/tickFinished and only one
+* thread calling getStatistics.
+*/
+class LoopTimingRecorder
+{
+public:
+    /**
+    * Creates a recorder.
+    * @param nominalPeriod nominal period of the loop (s).
+    * @param lateTolerance a tick is late if it starts more than
+    *                      (1 + lateTolerance) * nominalPeriod after the previous one.
+    */
+    LoopTimingRecorder(const double nominalPeriod, const double lateTolerance=0.5);
+
+    /**
+    * Record the beginning of a tick.
+    * @param now current time (s), e.g. yarp::os::Time::now().
+    */
+    void tickStarted(const double now);
+
+    /**
+    * Record the end of the tick started by the last tickStarted.
+    * @param now current time (s), e.g. yarp::os::Time::now().
+    */
+    void tickFinished(const double now);
+
+    /**
+    * Compute the statistics of the ticks recorded since the previous call.
+    * @param stats the computed statistics.
+    */
+    void getStatistics(LoopTimingStatistics &stats);
+
+    /**
+    * Change the nominal period of the loop, keeping the late tolerance.
+    * @param nominalPeriod nominal period of the loop (s).
+    * @note To be called by the thread calling tickStarted/tickFinished, e.g. at the
+    *       beginning of a tick when the period of the loop was changed.
+    */
+    void setNominalPeriod(const double nominalPeriod);
+
+    /**
+    * Return the nominal period of the loop (s).
+    */
+    double getNominalPeriod() const { return nominalPeriod; }
+
+private:
+    static int binIndex(const long microseconds);
+    static long binUpperBound(const int index);
+    static const int nrOfBins;
+
+    struct Histogram
+    {
+        std::vector<long> counts;           // written by the loop thread
+        std::vector<long> previousCounts;   // counts at the previous getStatistics
+        std::vector<unsigned long> windowCounts;
+        volatile long windowMax;            // us, reset by getStatistics
+
+        Histogram();
+        void record(const long microseconds);
+        void getPercentiles(unsigned long &samples, double &p50, double &p99, double &p999, double &max);
+    };
+
+    double nominalPeriod;
+    double lateTolerance;
+    double lateThreshold;
+
+    Histogram period;
+    Histogram used;
+
+    volatile long ticks;
+    volatile long lateTicks;
+    volatile long overruns;
+    long previousTicks;
+    long previousLateTicks;
+    long previousOverruns;
+
+    double lastTickStart;   // accessed only by the loop thread
+};
+
+}
+
+}
+
+}
+
+#endif
@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2016 Fondazione Istituto Italiano di Tecnologia
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found at
+ * http://www.robotcub.org/icub/license/gpl.txt
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+*/
+
+#ifndef RT_TRIPLEBUFFER_H
+#define RT_TRIPLEBUFFER_H
+
+#include "ctrlLibRT/atomics.h"
+
+#include <cstddef>
+#include <vector>
+
+
+namespace iCub
+{
+
+namespace ctrl
+{
+
+namespace realTime
+{
+
+/**
+* \ingroup Atomics
+*
+* Lock-free exchange of a value between one writer and one reader.
+*
+* The writer fills writeBuffer() and then calls publish(), the reader calls update()
+* and then reads readBuffer(). Neither of them ever waits for the other one, and the
+* reader always gets a complete value, i.e. the last one published before update().
+*
+* The three buffers are swapped, not copied: after publish() the write buffer
+* contains an old value, so the writer must fill it completely.
+* If there is more than one writer (or reader) they must be serialized by the caller.
+*/
+template <typename T>
+class TripleBuffer
+{
+public:
+    /**
+    * Creates a triple buffer.
+    * @param initialValue value of the three buffers, returned by readBuffer() before the first publish().
+    */
+    explicit TripleBuffer(const T &initialValue = T())
+    : buffers(3, initialValue), middle(1), writer(0), reader(2) {}
+
+    /**
+    * Return the buffer owned by the writer, to be filled before publish().
+    */
+    T &writeBuffer() { return buffers[writer]; }
+
+    /**
+    * Make the write buffer available to the reader.
+    * @return true if the value published before was not acquired by the reader, and it has been discarded.
+    */
+    bool publish()
+    {
+        long previous = atomicExchange(&middle, writer | FreshFlag);
+        writer = previous & IndexMask;
+        return (previous & FreshFlag) != 0;
+    }
+
+    /**
+    * Acquire the last published value, if any.
+    * @return true if a new value was published since the last call, false otherwise.
+    */
+    bool update()
+    {
+        if (!(atomicLoad(&middle) & FreshFlag)) return false;
+        reader = atomicExchange(&middle, reader) & IndexMask;
+        return true;
+    }
+
+    /**
+    * Return the buffer owned by the reader, i.e. the value acquired by the last update().
+    */
+    const T &readBuffer() const { return buffers[reader]; }
+
+    /**
+    * Set the three buffers to value, discarding the published value if not yet read.
+    * @note To be called only when neither the writer nor the reader are running,
+    *       for example to allocate the buffers before starting them.
+    */
+    void reset(const T &value)
+    {
+        for (std::size_t i = 0; i < buffers.size(); i++) buffers[i] = value;
+        middle = 1;
+        writer = 0;
+        reader = 2;
+    }
+
+private:
+    TripleBuffer(const TripleBuffer &);
+    TripleBuffer &operator=(const TripleBuffer &);
+
+    enum {
+        IndexMask = 3,
+        FreshFlag = 4
+    };
+
+    std::vector<T> buffers;
+    volatile long middle;   ///< index of the buffer in the middle, | FreshFlag if it was not read yet
+    long writer;
+    long reader;
+};
+
+}
+
+}
+
+}
+
+#endif
@@ -0,0 +1,229 @@
+/*
+ * Copyright (C) 2016 Fondazione Istituto Italiano di Tecnologia
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found at
+ * http://www.robotcub.org/icub/license/gpl.txt
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+*/
+
+#include "ctrlLibRT/loopTiming.h"
+#include "ctrlLibRT/atomics.h"
+
+#include <iomanip>
+#include <sstream>
+
+using namespace iCub::ctrl::realTime;
+
+namespace
+{
+    // 32 sub-bins for each power of two: relative error of the bin bounds < 1/32
+    const int subBinBits = 5;
+    const int subBins = 1 << subBinBits;
+    // values up to 2^(maxExponent+1)-1 us (about 67 s)
+    const int maxExponent = 25;
+    const long maxValue = (1L << (maxExponent + 1)) - 1;
+
+    inline long toMicroseconds(const double seconds)
+    {
+        if (seconds <= 0) return 0;
+        if (seconds >= maxValue * 1e-6) return maxValue;
+        return static_cast<long>(seconds * 1e6);
+    }
+}
+
+const int LoopTimingRecorder::nrOfBins = (maxExponent - subBinBits + 2) * subBins;
+
+/***************************************************************************/
+int LoopTimingRecorder::binIndex(const long microseconds)
+{
+    long value = microseconds < 0 ? 0 : (microseconds > maxValue ? maxValue : microseconds);
+    if (value < 2 * subBins) return static_cast<int>(value);
+
+    int exponent = 0;
+    for (long v = value; v > 1; v >>= 1) exponent++;
+    int shift = exponent - subBinBits;
+    return shift * subBins + static_cast<int>(value >> shift);
+}
+
+/***************************************************************************/
+long LoopTimingRecorder::binUpperBound(const int index)
+{
+    if (index < 2 * subBins) return index;
+
+    int shift = index / subBins - 1;
+    long mantissa = index - shift * subBins;
+    return ((mantissa + 1) << shift) - 1;
+}
+
+/***************************************************************************/
+LoopTimingStatistics::LoopTimingStatistics():
+    ticks(0), periodP50(0), periodP99(0), periodP999(0), periodMax(0),
+    usedP50(0), usedP99(0), usedP999(0), usedMax(0),
+    lateTicks(0), overruns(0), totalTicks(0), totalLateTicks(0), totalOverruns(0)
+{
+}
+
+/***************************************************************************/
+void LoopTimingStatistics::toBottle(yarp::os::Bottle &bottle) const
+{
+    yarp::os::Bottle &ticksPair = bottle.addList();
+    ticksPair.addString("ticks");
+    ticksPair.addInt(static_cast<int>(ticks));
+
+    const char *names[2] = {"period", "used"};
+    const double values[2][4] = {{periodP50, periodP99, periodP999, periodMax},
+                                 {usedP50, usedP99, usedP999, usedMax}};
+    for (int i = 0; i < 2; i++) {
+        yarp::os::Bottle &pair = bottle.addList();
+        pair.addString(names[i]);
+        yarp::os::Bottle &percentiles = pair.addList();
+        for (int j = 0; j < 4; j++) percentiles.addDouble(values[i][j]);
+    }
+
+    const char *counterNames[5] = {"lateTicks", "overruns", "totalTicks", "totalLateTicks", "totalOverruns"};
+    const unsigned long counters[5] = {lateTicks, overruns, totalTicks, totalLateTicks, totalOverruns};
+    for (int i = 0; i < 5; i++) {
+        yarp::os::Bottle &pair = bottle.addList();
+        pair.addString(counterNames[i]);
+        pair.addInt(static_cast<int>(counters[i]));
+    }
+}
+
+/***************************************************************************/
+std::string LoopTimingStatistics::toString() const
+{
+    std::ostringstream stream;
+    stream << std::fixed << std::setprecision(3)
+           << ticks << " ticks. Period [ms]: p50 " << 1e3 * periodP50 << " p99 " << 1e3 * periodP99
+           << " p99.9 " << 1e3 * periodP999 << " max " << 1e3 * periodMax
+           << ". Used [ms]: p50 " << 1e3 * usedP50 << " p99 " << 1e3 * usedP99
+           << " p99.9 " << 1e3 * usedP999 << " max " << 1e3 * usedMax
+           << ". Late ticks " << lateTicks << " (total " << totalLateTicks << ")"
+           << ", overruns " << overruns << " (total " << totalOverruns << ")";
+    return stream.str();
+}
+
+/***************************************************************************/
+LoopTimingRecorder::Histogram::Histogram():
+    counts(nrOfBins, 0), previousCounts(nrOfBins, 0), windowCounts(nrOfBins, 0), windowMax(0)
+{
+}
+
+/***************************************************************************/
+void LoopTimingRecorder::Histogram::record(const long microseconds)
+{
+    atomicIncrement(&counts[binIndex(microseconds)]);
+    atomicMax(&windowMax, microseconds);
+}
+
+/***************************************************************************/
+void LoopTimingRecorder::Histogram::getPercentiles(unsigned long &samples, double &p50, double &p99, double &p999, double &max)
+{
+    long maxMicroseconds = atomicExchange(&windowMax, 0);
+
+    samples = 0;
+    for (int i = 0; i < nrOfBins; i++) {
+        long current = atomicLoad(&counts[i]);
+        // the counters may wrap around: the difference is computed modulo
+        windowCounts[i] = static_cast<unsigned long>(current) - static_cast<unsigned long>(previousCounts[i]);
+        previousCounts[i] = current;
+        samples += windowCounts[i];
+    }
+
+    p50 = p99 = p999 = 0;
+    max = maxMicroseconds * 1e-6;
+    if (samples == 0) return;
+
+    // 1-based ranks of the percentiles
+    const double fractions[3] = {0.5, 0.99, 0.999};
+    double *percentiles[3] = {&p50, &p99, &p999};
+    unsigned long ranks[3];
+    for (int j = 0; j < 3; j++) {
+        ranks[j] = static_cast<unsigned long>(fractions[j] * samples);
+        if (ranks[j] < fractions[j] * samples || ranks[j] == 0) ranks[j]++;
+    }
+
+    unsigned long cumulative = 0;
+    int j = 0;
+    for (int i = 0; i < nrOfBins && j < 3; i++) {
+        cumulative += windowCounts[i];
+        while (j < 3 && cumulative >= ranks[j]) {
+            *percentiles[j] = binUpperBound(i) * 1e-6;
+            j++;
+        }
+    }
+
+    // the bins are upper bounds: the exact maximum is tighter. If the maximum was reset
+    // before all the ticks of the window were recorded use the bins instead
+    for (j = 0; j < 3; j++) {
+        if (maxMicroseconds > 0 && *percentiles[j] > max) *percentiles[j] = max;
+    }
+    if (maxMicroseconds == 0) max = p999;
+}
+
+/***************************************************************************/
+LoopTimingRecorder::LoopTimingRecorder(const double nominalPeriod, const double lateTolerance):
+    nominalPeriod(nominalPeriod), lateTolerance(lateTolerance), lateThreshold((1.0 + lateTolerance) * nominalPeriod),
+    ticks(0), lateTicks(0), overruns(0),
+    previousTicks(0), previousLateTicks(0), previousOverruns(0),
+    lastTickStart(-1.0)
+{
+}
+
+/***************************************************************************/
+void LoopTimingRecorder::setNominalPeriod(const double nominalPeriod)
+{
+    this->nominalPeriod = nominalPeriod;
+    lateThreshold = (1.0 + lateTolerance) * nominalPeriod;
+}
+
+/***************************************************************************/
+void LoopTimingRecorder::tickStarted(const double now)
+{
+    if (lastTickStart >= 0) {
+        double elapsed = now - lastTickStart;
+        period.record(toMicroseconds(elapsed));
+        if (elapsed > lateThreshold) atomicIncrement(&lateTicks);
+    }
+    lastTickStart = now;
+}
+
+/***************************************************************************/
+void LoopTimingRecorder::tickFinished(const double now)
+{
+    if (lastTickStart < 0) return;
+    double elapsed = now - lastTickStart;
+    used.record(toMicroseconds(elapsed));
+    if (elapsed > nominalPeriod) atomicIncrement(&overruns);
+    atomicIncrement(&ticks);
+}
+
+/***************************************************************************/
+void LoopTimingRecorder::getStatistics(LoopTimingStatistics &stats)
+{
+    unsigned long periodSamples = 0, usedSamples = 0;
+    period.getPercentiles(periodSamples, stats.periodP50, stats.periodP99, stats.periodP999, stats.periodMax);
+    used.getPercentiles(usedSamples, stats.usedP50, stats.usedP99, stats.usedP999, stats.usedMax);
+
+    long currentTicks = atomicLoad(&ticks);
+    long currentLateTicks = atomicLoad(&lateTicks);
+    long currentOverruns = atomicLoad(&overruns);
+
+    stats.ticks = static_cast<unsigned long>(currentTicks) - static_cast<unsigned long>(previousTicks);
+    stats.lateTicks = static_cast<unsigned long>(currentLateTicks) - static_cast<unsigned long>(previousLateTicks);
+    stats.overruns = static_cast<unsigned long>(currentOverruns) - static_cast<unsigned long>(previousOverruns);
+    stats.totalTicks = static_cast<unsigned long>(currentTicks);
+    stats.totalLateTicks = static_cast<unsigned long>(currentLateTicks);
+    stats.totalOverruns = static_cast<unsigned long>(currentOverruns);
+
+    previousTicks = currentTicks;
+    previousLateTicks = currentLateTicks;
+    previousOverruns = currentOverruns;
+}
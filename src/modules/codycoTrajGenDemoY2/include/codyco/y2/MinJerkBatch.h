@@ -0,0 +1,111 @@
+#ifndef MINJERKBATCH_Y2_H
+#define MINJERKBATCH_Y2_H
+
+#include <vector>
+#include <cstddef>
+
+namespace codyco {
+    namespace y2 {
+        class MinJerkBatch;
+    }
+}
+
+/**
+ * Minimum jerk trajectory generator for several parts at once.
+ *
+ * Each part is a group of channels sharing the same duration and the same time origin.
+ * When the target of a part changes, a quintic polynomial is planned from the current
+ * position, velocity and acceleration of each channel to the new target (reached with
+ * zero velocity and acceleration after the part duration), so retargeting is smooth.
+ * The state and the polynomial coefficients of all the channels are stored in a single
+ * contiguous block, and computeNextValues evaluates all the parts in one pass.
+ *
+ * All the memory is allocated by addPart: init, setTarget, setDuration and computeNextValues
+ * do not allocate.
+ */
+class codyco::y2::MinJerkBatch {
+public:
+    /**
+     * @param sampleTime time (in seconds) between two calls of computeNextValues.
+     */
+    MinJerkBatch(double sampleTime = 0.01);
+
+    void setSampleTime(double sampleTime);
+    double getSampleTime() const;
+
+    /**
+     * Add a part of size channels.
+     * @return the index of the part, used in all the other methods.
+     */
+    int addPart(std::size_t size, double duration);
+
+    int getNrOfParts() const;
+    std::size_t getPartSize(int part) const;
+
+    /**
+     * Set the duration of the part.
+     * It is used starting from the next trajectory planned for the part.
+     */
+    void setDuration(int part, double duration);
+    double getDuration(int part) const;
+
+    /**
+     * Set the part at rest in the specified position (getPartSize(part) elements).
+     */
+    void init(int part, const double *position);
+
+    /**
+     * Set the target of the part (getPartSize(part) elements).
+     * If the target is different from the current one a new trajectory
+     * is planned starting from the current state of the part.
+     */
+    void setTarget(int part, const double *target);
+
+    /**
+     * Advance all the parts by one sample time.
+     */
+    void computeNextValues();
+
+    const double * getPos(int part) const;
+    const double * getVel(int part) const;
+    const double * getAcc(int part) const;
+
+private:
+    enum StateBlock {
+        POSITION = 0,
+        VELOCITY,
+        ACCELERATION,
+        TARGET,
+        // Coefficients of the quintic polynomial, in increasing order of the power of time
+        COEFFICIENT_0,
+        COEFFICIENT_1,
+        COEFFICIENT_2,
+        COEFFICIENT_3,
+        COEFFICIENT_4,
+        COEFFICIENT_5,
+        NR_OF_STATE_BLOCKS
+    };
+
+    struct Part {
+        std::size_t offset;
+        std::size_t size;
+        double duration;
+        // Duration of the trajectory in execution (the part duration when the trajectory was planned)
+        double trajectoryDuration;
+        // Time elapsed from the start of the trajectory
+        double elapsedTime;
+        bool moving;
+    };
+
+    double m_sampleTime;
+    std::size_t m_nrOfChannels;
+    std::vector<Part> m_parts;
+    // NR_OF_STATE_BLOCKS blocks of m_nrOfChannels elements each
+    std::vector<double> m_state;
+
+    double * block(StateBlock stateBlock, const Part &part);
+    const double * block(StateBlock stateBlock, const Part &part) const;
+    void plan(Part &part);
+};
+
+#endif /* end of include guard: MINJERKBATCH_Y2_H */
@@ -1,4 +1,5 @@
 #include "Coordinator.h"
+#include "MinJerkBatch.h"
 
 #include <yarp/os/ResourceFinder.h>
 #include <yarp/os/BufferedPort.h>
@@ -18,14 +19,13 @@
 #include <yarp/math/Math.h>
 #include <yarpWholeBodyInterface/yarpWholeBodyInterface.h>
 
-#include <iCub/ctrl/minJerkCtrl.h>
+#include <ctrlLibRT/tripleBuffer.h>
 
 #include <vector>
 #include <list>
 #include <algorithm>
 
 
-
 namespace codyco {
     namespace y2 {
 
@@ -35,17 +35,88 @@ namespace codyco {
         const double TGM_RAD2DEG = 180.0 / M_PI;
         const double TGM_DEG2RAD = M_PI / 180.0;
 
+        // Parts contained in a message of the typed references port
+        enum ReferencesPart {
+            REFERENCES_TORSO     = 1 << 0,
+            REFERENCES_LEFT_ARM  = 1 << 1,
+            REFERENCES_RIGHT_ARM = 1 << 2,
+            REFERENCES_LEFT_LEG  = 1 << 3,
+            REFERENCES_RIGHT_LEG = 1 << 4,
+            REFERENCES_COM       = 1 << 5
+        };
+
+        // Elements of the typed references message preceding the set points (part mask and timestamp)
+        const int REFERENCES_HEADER_SIZE = 2;
+
+        namespace {
+            double limitInput(double value, double min, double max)
+            {
+                if (std::isnan(value) || std::isinf(value)) {
+                    yWarning("NaN or Inf detected");
+                    return 0;
+                }
+                if (value > max) {
+                    yWarning("Read value(%lf) is outside joint limit(%lf)", value, max);
+                    return max;
+                } else if (value < min) {
+                    yWarning("Read value(%lf) is outside joint limit(%lf)", value, min);
+                    return min;
+                }
+                return value;
+            }
+
+            // The com has no limits to be checked against, but a NaN or Inf would be
+            // propagated by the trajectory generator to the balancing controller
+            bool isFiniteInput(const double *values, int size)
+            {
+                for (int i = 0; i < size; i++) {
+                    if (std::isnan(values[i]) || std::isinf(values[i])) {
+                        yWarning("NaN or Inf detected in the com reference, ignoring it");
+                        return false;
+                    }
+                }
+                return true;
+            }
+        }
+
         class CoordinatorData;
 
         class Reader : public yarp::os::TypedReaderCallback<yarp::os::Property> {
         private:
             CoordinatorData &data;
-            double limitInput(double value, double min, double max);
         public:
             Reader(CoordinatorData& _data);
             virtual void onRead(yarp::os::Property& read);
         };
 
+        /**
+         * Reader of the typed references port.
+         *
+         * The message is parsed and limited without taking the coordinator mutex,
+         * and the result is handed off to updateModule through a triple buffer.
+         */
+        class VectorReader : public yarp::os::TypedReaderCallback<yarp::sig::Vector> {
+        private:
+            CoordinatorData &data;
+        public:
+            VectorReader(CoordinatorData& _data);
+            virtual void onRead(yarp::sig::Vector& read);
+        };
+
+        // Set points received on the typed references port, already limited and in the internal joint order
+        struct ReferencesSample {
+            int partMask;
+            double timestamp;
+            yarp::sig::Vector torso;
+            yarp::sig::Vector leftArm;
+            yarp::sig::Vector rightArm;
+            yarp::sig::Vector leftLeg;
+            yarp::sig::Vector rightLeg;
+            yarp::sig::Vector com;
+
+            ReferencesSample() : partMask(0), timestamp(0) {}
+        };
+
         //use delegation here
         struct CoordinatorData {
             yarp::os::Mutex mutex;
@@ -70,18 +141,20 @@ namespace codyco {
             yarp::sig::Vector rightArmTorqueControlledJointReferences;
             yarp::sig::Vector rightArmPositionControlledJointReferences;
 
-            //Trajectory generators
-            iCub::ctrl::minJerkTrajGen* torsoGenerator;
-            iCub::ctrl::minJerkTrajGen* leftArmGenerator;
-            iCub::ctrl::minJerkTrajGen* rightArmGenerator;
-            iCub::ctrl::minJerkTrajGen* torqueBalancingGenerator;
-            //Trajectory generator for the com
-            iCub::ctrl::minJerkTrajGen* comGenerator;
+            //Trajectory generator for all the parts and for the com
+            MinJerkBatch trajectoryGenerator;
+            int torsoTrajectory;
+            int leftArmTrajectory;
+            int rightArmTrajectory;
+            int torqueBalancingTrajectory;
+            int comTrajectory;
             /** if true, stream the output of the trajectory generator */
             bool comTrajGenActive;
-            yarp::sig::Vector comDesPos;
-            yarp::sig::Vector comDesVel;
-            yarp::sig::Vector comDesAcc;
+
+            //Position commands (in degrees) sent to the position controlled joints
+            yarp::sig::Vector torsoPositionCommands;
+            yarp::sig::Vector leftArmPositionCommands;
+            yarp::sig::Vector rightArmPositionCommands;
 
             yarp::sig::Vector torsoCurrentPosition;
             yarp::sig::Vector leftArmCurrentPosition;
@@ -132,10 +205,87 @@ namespace codyco {
 
             Reader reader;
 
+            // Typed references input, written by the vectorReader and read by updateModule
+            VectorReader vectorReader;
+            size_t typedReferencesSize;
+            ReferencesSample pendingReferences;
+            int lastPublishedReferencesMask;
+            iCub::ctrl::realTime::TripleBuffer<ReferencesSample> typedReferences;
+
             CoordinatorData()
             : referencesChanged(false)
             , reader(*this)
-            , torsoGenerator(0), leftArmGenerator(0), rightArmGenerator(0) {}
+            , vectorReader(*this)
+            , typedReferencesSize(0)
+            , lastPublishedReferencesMask(0)
+            , torsoTrajectory(-1), leftArmTrajectory(-1), rightArmTrajectory(-1)
+            , torqueBalancingTrajectory(-1), comTrajectory(-1) {}
+
+            void positionCommandsInDegrees(int trajectory, yarp::sig::Vector &commands)
+            {
+                const double *position = trajectoryGenerator.getPos(trajectory);
+                for (int i = 0; i < commands.size(); i++) {
+                    commands(i) = position[i] * TGM_RAD2DEG;
+                }
+            }
+
+            void initTypedReferences()
+            {
+                pendingReferences.torso = torsoJointReferences;
+                pendingReferences.leftArm = leftArmJointReferences;
+                pendingReferences.rightArm = rightArmJointReferences;
+                pendingReferences.leftLeg = leftLegReferences;
+                pendingReferences.rightLeg = rightLegReferences;
+                pendingReferences.com = comReferences;
+                typedReferences.reset(pendingReferences);
+                typedReferencesSize = REFERENCES_HEADER_SIZE
+                                    + torsoJointReferences.size()
+                                    + leftArmJointReferences.size()
+                                    + rightArmJointReferences.size()
+                                    + leftLegReferences.size()
+                                    + rightLegReferences.size()
+                                    + comReferences.size();
+            }
+
+            /**
+             * Apply the last references received on the typed port, if any.
+             * Must be called with the mutex held.
+             */
+            void consumeTypedReferences()
+            {
+                if (!typedReferences.update()) return;
+                const ReferencesSample &sample = typedReferences.readBuffer();
+
+                if (sample.partMask & REFERENCES_TORSO) {
+                    torsoJointReferences = sample.torso;
+                    mapInput(torsoJointIDs, torsoMappingInformationComplement,
+                             torsoJointReferences, torsoPositionControlledJointReferences, torsoTorqueControlledJointReferences);
+                }
+                if (sample.partMask & REFERENCES_LEFT_ARM) {
+                    leftArmJointReferences = sample.leftArm;
+                    mapInput(armJointIDs, armMappingInformationComplement,
+                             leftArmJointReferences, leftArmPositionControlledJointReferences, leftArmTorqueControlledJointReferences);
+                }
+                if (sample.partMask & REFERENCES_RIGHT_ARM) {
+                    rightArmJointReferences = sample.rightArm;
+                    mapInput(armJointIDs, armMappingInformationComplement,
+                             rightArmJointReferences, rightArmPositionControlledJointReferences, rightArmTorqueControlledJointReferences);
+                }
+                if (sample.partMask & REFERENCES_LEFT_LEG) {
+                    leftLegReferences = sample.leftLeg;
+                }
+                if (sample.partMask & REFERENCES_RIGHT_LEG) {
+                    rightLegReferences = sample.rightLeg;
+                }
+                if (sample.partMask & REFERENCES_COM) {
+                    comReferences = sample.com;
+                    // If this is the first com that we receive, reset the trajectory generator
+                    if (!comTrajGenActive) {
+                        trajectoryGenerator.init(comTrajectory, comReferences.data());
+                        comTrajGenActive = true;
+                    }
+                }
+            }
 
             void init()
             {
@@ -249,22 +399,6 @@ namespace codyco {
         Reader::Reader(CoordinatorData& _data)
         : data(_data) { }
 
-        double Reader::limitInput(double value, double min, double max)
-        {
-            if (std::isnan(value) || std::isinf(value)) {
-                yWarning("NaN or Inf detected");
-                return 0;
-            }
-            if (value > max) {
-                yWarning("Read value(%lf) is outside joint limit(%lf)", value, max);
-                return max;
-            } else if (value < min) {
-                yWarning("Read value(%lf) is outside joint limit(%lf)", value, min);
-                return min;
-            }
-            return value;
-        }
-
         void Reader::onRead(yarp::os::Property& read) {
             using namespace yarp::os;
             using yarp::sig::Vector;
@@ -333,19 +467,103 @@ namespace codyco {
             if( !com.isNull() && com.isList() && com.asList()->size() == COM_SIZE ) {
                 Bottle *list = com.asList();
 
+                double comReferences[COM_SIZE];
                 for (int i = 0; i < COM_SIZE; i++) {
-                    data.comReferences(i) = list->get(i).asDouble();
+                    comReferences[i] = list->get(i).asDouble();
+                }
+                if (!isFiniteInput(comReferences, COM_SIZE)) return;
+
+                for (int i = 0; i < COM_SIZE; i++) {
+                    data.comReferences(i) = comReferences[i];
                 }
 
                 // If this is the first com that we receive, reset the trajectory generator
-                if( !data.comTrajGenActive ) {
-                    data.comGenerator->init(data.comReferences);
+                if( !data.comTrajGenActive && data.comTrajectory >= 0 ) {
+                    data.trajectoryGenerator.init(data.comTrajectory, data.comReferences.data());
                     data.comTrajGenActive = true;
                 }
 
             }
         }
 
+        VectorReader::VectorReader(CoordinatorData& _data)
+        : data(_data) { }
+
+        void VectorReader::onRead(yarp::sig::Vector& read) {
+            // Called only by the port thread: pendingReferences and the writer slot are not shared
+            if (read.size() != data.typedReferencesSize) {
+                yWarning("Typed references of size %d received, expected %d", (int)read.size(), (int)data.typedReferencesSize);
+                return;
+            }
+
+            ReferencesSample &pending = data.pendingReferences;
+            int partMask = static_cast<int>(read[0]);
+            const double timestamp = read[1];
+            if (timestamp < pending.timestamp) {
+                // Out of order message
+                return;
+            }
+            pending.timestamp = timestamp;
+
+            const double *references = read.data() + REFERENCES_HEADER_SIZE;
+            if (partMask & REFERENCES_TORSO) {
+                // Torso is received in the opposite order, as in the Property input
+                const int torsoSize = pending.torso.size();
+                for (int i = 0; i < torsoSize; i++) {
+                    const int j = torsoSize - 1 - i;
+                    pending.torso(j) = limitInput(references[i], data.torsoMinLimits(j), data.torsoMaxLimits(j));
+                }
+            }
+            references += pending.torso.size();
+
+            if (partMask & REFERENCES_LEFT_ARM) {
+                for (int i = 0; i < pending.leftArm.size(); i++) {
+                    pending.leftArm(i) = limitInput(references[i], data.leftArmMinLimits(i), data.leftArmMaxLimits(i));
+                }
+            }
+            references += pending.leftArm.size();
+
+            if (partMask & REFERENCES_RIGHT_ARM) {
+                for (int i = 0; i < pending.rightArm.size(); i++) {
+                    pending.rightArm(i) = limitInput(references[i], data.rightArmMinLimits(i), data.rightArmMaxLimits(i));
+                }
+            }
+            references += pending.rightArm.size();
+
+            if (partMask & REFERENCES_LEFT_LEG) {
+                for (int i = 0; i < pending.leftLeg.size(); i++) {
+                    pending.leftLeg(i) = limitInput(references[i], data.leftLegMinLimits(i), data.leftLegMaxLimits(i));
+                }
+            }
+            references += pending.leftLeg.size();
+
+            if (partMask & REFERENCES_RIGHT_LEG) {
+                for (int i = 0; i < pending.rightLeg.size(); i++) {
+                    pending.rightLeg(i) = limitInput(references[i], data.rightLegMinLimits(i), data.rightLegMaxLimits(i));
+                }
+            }
+            references += pending.rightLeg.size();
+
+            if ((partMask & REFERENCES_COM) && !isFiniteInput(references, pending.com.size())) {
+                partMask &= ~REFERENCES_COM;
+            }
+            if (partMask & REFERENCES_COM) {
+                for (int i = 0; i < pending.com.size(); i++) {
+                    pending.com(i) = references[i];
+                }
+            }
+
+            // If the previously published sample has not been consumed yet it is going to be
+            // overwritten, so the parts it contained must be applied together with this one
+            ReferencesSample &sample = data.typedReferences.writeBuffer();
+            const int publishedMask = partMask | data.lastPublishedReferencesMask;
+            sample = pending;
+            sample.partMask = publishedMask;
+
+            const bool overwritten = data.typedReferences.publish();
+            data.lastPublishedReferencesMask = overwritten ? publishedMask : partMask;
+        }
+
         void CoordinatorData::mapInput(std::vector<int> &map, std::list<int> &complementMap,
                                        yarp::sig::Vector& input, yarp::sig::Vector &mapped, yarp::sig::Vector &complementMapped)
         {
@@ -364,6 +582,7 @@ namespace codyco {
         Coordinator::Coordinator()
         : m_threadPeriod(0.01)
         , m_inputJointReferences(0)
+        , m_inputTypedJointReferences(0)
         , m_motionDoneThreshold(4.0)
         , m_outputTorqueControlledJointReferences(0)
         , m_outputComDesiredPosVelAcc(0)
@@ -551,11 +770,6 @@ namespace codyco {
             //Resize com reference vector
             data->comReferences.resize(COM_SIZE, 0.0);
 
-            //Resize com desired trajectory helper buffers
-            data->comDesPos.resize(COM_SIZE, 0.0);
-            data->comDesVel.resize(COM_SIZE, 0.0);
-            data->comDesAcc.resize(COM_SIZE, 0.0);
-
             //Load limits
             data->torsoMinLimits.resize(torsoAxes, 0.0);
             data->torsoMaxLimits.resize(torsoAxes, 0.0);
@@ -714,21 +928,16 @@ namespace codyco {
             data->init();
 
             //Setup generators
-            data->torsoGenerator = new iCub::ctrl::minJerkTrajGen(data->torsoPositionControlledJointReferences.size(), trajectoryTimeStep, trajectoryTimeDuration);
-            data->leftArmGenerator = new iCub::ctrl::minJerkTrajGen(data->leftArmPositionControlledJointReferences.size(), trajectoryTimeStep, trajectoryTimeDuration);
-            data->rightArmGenerator = new iCub::ctrl::minJerkTrajGen(data->rightArmPositionControlledJointReferences.size(), trajectoryTimeStep, trajectoryTimeDuration);
-            data->torqueBalancingGenerator = new iCub::ctrl::minJerkTrajGen(iCubMainJoints.size(), trajectoryTimeStep, trajectoryTimeDuration);
-            data->comGenerator = new iCub::ctrl::minJerkTrajGen(3, trajectoryTimeStep,  trajectoryTimeDuration);
-
-            if (!data->torsoGenerator ||
-                !data->leftArmGenerator ||
-                !data->rightArmGenerator ||
-                !data->torqueBalancingGenerator ||
-                !data->comGenerator) {
-                yError("Could not create trajectory generator");
-                cleanup();
-                return false;
-            }
+            data->trajectoryGenerator.setSampleTime(trajectoryTimeStep);
+            data->torsoTrajectory = data->trajectoryGenerator.addPart(data->torsoPositionControlledJointReferences.size(), trajectoryTimeDuration);
+            data->leftArmTrajectory = data->trajectoryGenerator.addPart(data->leftArmPositionControlledJointReferences.size(), trajectoryTimeDuration);
+            data->rightArmTrajectory = data->trajectoryGenerator.addPart(data->rightArmPositionControlledJointReferences.size(), trajectoryTimeDuration);
+            data->torqueBalancingTrajectory = data->trajectoryGenerator.addPart(iCubMainJoints.size(), trajectoryTimeDuration);
+            data->comTrajectory = data->trajectoryGenerator.addPart(COM_SIZE, trajectoryTimeDuration);
+
+            data->torsoPositionCommands.resize(data->torsoPositionControlledJointReferences.size(), 0.0);
+            data->leftArmPositionCommands.resize(data->leftArmPositionControlledJointReferences.size(), 0.0);
+            data->rightArmPositionCommands.resize(data->rightArmPositionControlledJointReferences.size(), 0.0);
 
             //Map initial values
             data->mapInput(data->torsoJointIDs, data->torsoMappingInformationComplement,
@@ -740,11 +949,22 @@ namespace codyco {
 
             data->copyReferencesForTorqueOutput();
 
-            data->torsoGenerator->init(data->torsoPositionControlledJointReferences);
-            data->leftArmGenerator->init(data->leftArmPositionControlledJointReferences);
-            data->rightArmGenerator->init(data->rightArmPositionControlledJointReferences);
-            data->torqueBalancingGenerator->init(data->torqueControlOutputReferences);
-            data->comGenerator->init(data->comReferences);
+            data->trajectoryGenerator.init(data->torsoTrajectory, data->torsoPositionControlledJointReferences.data());
+            data->trajectoryGenerator.init(data->leftArmTrajectory, data->leftArmPositionControlledJointReferences.data());
+            data->trajectoryGenerator.init(data->rightArmTrajectory, data->rightArmPositionControlledJointReferences.data());
+            data->trajectoryGenerator.init(data->torqueBalancingTrajectory, data->torqueControlOutputReferences.data());
+            data->trajectoryGenerator.init(data->comTrajectory, data->comReferences.data());
+
+            //The typed references are limited without the mutex,
+            //so the port is opened only once limits and buffers are ready
+            data->initTypedReferences();
+            m_inputTypedJointReferences = new BufferedPort<Vector>();
+            if (!m_inputTypedJointReferences
+                || !m_inputTypedJointReferences->open(getName("/refsVector:i"))) {
+                cleanup();
+                return false;
+            }
+            m_inputTypedJointReferences->useCallback(data->vectorReader);
 
             yInfo("Coordinator ready");
             return true;
@@ -756,35 +976,44 @@ namespace codyco {
 
             CoordinatorData *data = static_cast<CoordinatorData*>(implementation);
             if (!data) return false;
-            if (!data->torsoGenerator || !data->leftArmGenerator ||
-                !data->rightArmGenerator || !data->torqueBalancingGenerator ||
-                !data->comGenerator ) return false;
+            if (data->trajectoryGenerator.getNrOfParts() == 0) return false;
 
             yarp::os::LockGuard guard(data->mutex);
             //            if (!data->referencesChanged) return true;
             //            data->referencesChanged = false;
 
+            data->consumeTypedReferences();
+
             data->copyReferencesForTorqueOutput();
 
-            data->torsoGenerator->computeNextValues(data->torsoPositionControlledJointReferences);
-            data->leftArmGenerator->computeNextValues(data->leftArmPositionControlledJointReferences);
-            data->rightArmGenerator->computeNextValues(data->rightArmPositionControlledJointReferences);
-            data->torqueBalancingGenerator->computeNextValues(data->torqueControlOutputReferences);
-            data->comGenerator->computeNextValues(data->comReferences);
+            //Trajectories are replanned only when the references change
+            data->trajectoryGenerator.setTarget(data->torsoTrajectory, data->torsoPositionControlledJointReferences.data());
+            data->trajectoryGenerator.setTarget(data->leftArmTrajectory, data->leftArmPositionControlledJointReferences.data());
+            data->trajectoryGenerator.setTarget(data->rightArmTrajectory, data->rightArmPositionControlledJointReferences.data());
+            data->trajectoryGenerator.setTarget(data->torqueBalancingTrajectory, data->torqueControlOutputReferences.data());
+            data->trajectoryGenerator.setTarget(data->comTrajectory, data->comReferences.data());
+
+            data->trajectoryGenerator.computeNextValues();
 
             //send to robot
-            data->torsoPositionControl->setPositions(data->torsoJointIDs.size(), data->torsoJointIDs.data(), (data->torsoGenerator->getPos() * TGM_RAD2DEG).data());
+            data->positionCommandsInDegrees(data->torsoTrajectory, data->torsoPositionCommands);
+            data->torsoPositionControl->setPositions(data->torsoJointIDs.size(), data->torsoJointIDs.data(), data->torsoPositionCommands.data());
 
-            data->leftArmPositionControl->setPositions(data->armJointIDs.size(), data->armJointIDs.data(), (data->leftArmGenerator->getPos() * TGM_RAD2DEG).data());
+            data->positionCommandsInDegrees(data->leftArmTrajectory, data->leftArmPositionCommands);
+            data->leftArmPositionControl->setPositions(data->armJointIDs.size(), data->armJointIDs.data(), data->leftArmPositionCommands.data());
 
-            data->rightArmPositionControl->setPositions(data->armJointIDs.size(), data->armJointIDs.data(), (data->rightArmGenerator->getPos() * TGM_RAD2DEG).data());
+            data->positionCommandsInDegrees(data->rightArmTrajectory, data->rightArmPositionCommands);
+            data->rightArmPositionControl->setPositions(data->armJointIDs.size(), data->armJointIDs.data(), data->rightArmPositionCommands.data());
 
             //send to torqueBalancing
 
             //send position impedance
             yarp::sig::Vector& torqueOutput = m_outputTorqueControlledJointReferences->prepare();
 //            torqueOutput.resize(data->torsoTorqueControlledJointReferences.size(), 0.0);
-            torqueOutput = data->torqueBalancingGenerator->getPos();
+            const size_t torqueOutputSize = data->trajectoryGenerator.getPartSize(data->torqueBalancingTrajectory);
+            const double *torqueOutputTrajectory = data->trajectoryGenerator.getPos(data->torqueBalancingTrajectory);
+            torqueOutput.resize(torqueOutputSize);
+            std::copy(torqueOutputTrajectory, torqueOutputTrajectory + torqueOutputSize, torqueOutput.data());
 
             m_outputTorqueControlledJointReferences->write();
 
@@ -794,12 +1023,12 @@ namespace codyco {
 
                 comDesPosVelAcc.resize(3*COM_SIZE, 0.0);
 
-                data->comDesPos = data->comGenerator->getPos();
-                data->comDesVel = data->comGenerator->getVel();
-                data->comDesAcc = data->comGenerator->getAcc();
-                comDesPosVelAcc.setSubvector(0,data->comDesPos);
-                comDesPosVelAcc.setSubvector(1*COM_SIZE,data->comDesVel);
-                comDesPosVelAcc.setSubvector(2*COM_SIZE,data->comDesAcc);
+                const double *comDesPos = data->trajectoryGenerator.getPos(data->comTrajectory);
+                const double *comDesVel = data->trajectoryGenerator.getVel(data->comTrajectory);
+                const double *comDesAcc = data->trajectoryGenerator.getAcc(data->comTrajectory);
+                std::copy(comDesPos, comDesPos + COM_SIZE, comDesPosVelAcc.data());
+                std::copy(comDesVel, comDesVel + COM_SIZE, comDesPosVelAcc.data() + 1*COM_SIZE);
+                std::copy(comDesAcc, comDesAcc + COM_SIZE, comDesPosVelAcc.data() + 2*COM_SIZE);
 
                 m_outputComDesiredPosVelAcc->write();
             }
@@ -822,6 +1051,12 @@ namespace codyco {
                 delete m_inputJointReferences;
                 m_inputJointReferences = 0;
             }
+            if (m_inputTypedJointReferences) {
+                m_inputTypedJointReferences->interrupt();
+                m_inputTypedJointReferences->close();
+                delete m_inputTypedJointReferences;
+                m_inputTypedJointReferences = 0;
+            }
             if (m_outputTorqueControlledJointReferences) {
                 m_outputTorqueControlledJointReferences->interrupt();
                 m_outputTorqueControlledJointReferences->close();
@@ -844,27 +1079,6 @@ namespace codyco {
             CoordinatorData *data = static_cast<CoordinatorData*>(implementation);
 
             if (data) {
-                if (data->torsoGenerator) {
-                    delete data->torsoGenerator;
-                    data->torsoGenerator = 0;
-                }
-                if (data->leftArmGenerator) {
-                    delete data->leftArmGenerator;
-                    data->leftArmGenerator = 0;
-                }
-                if (data->rightArmGenerator) {
-                    delete data->rightArmGenerator;
-                    data->rightArmGenerator = 0;
-                }
-                if (data->torqueBalancingGenerator) {
-                    delete data->torqueBalancingGenerator;
-                    data->torqueBalancingGenerator = 0;
-                }
-                if (data->comGenerator) {
-                    delete data->comGenerator;
-                    data->comGenerator = 0;
-                }
-
                 data->leftArmDriver.close();
                 data->rightArmDriver.close();
                 data->torsoDriver.close();
@@ -0,0 +1,173 @@
+#include "MinJerkBatch.h"
+
+#include <algorithm>
+
+namespace codyco {
+    namespace y2 {
+
+        MinJerkBatch::MinJerkBatch(double sampleTime)
+        : m_sampleTime(sampleTime)
+        , m_nrOfChannels(0) {}
+
+        void MinJerkBatch::setSampleTime(double sampleTime) { m_sampleTime = sampleTime; }
+
+        double MinJerkBatch::getSampleTime() const { return m_sampleTime; }
+
+        int MinJerkBatch::addPart(std::size_t size, double duration)
+        {
+            //Blocks are stored one after the other, so their stride changes
+            std::size_t newNrOfChannels = m_nrOfChannels + size;
+            std::vector<double> newState(NR_OF_STATE_BLOCKS * newNrOfChannels, 0.0);
+            for (int b = 0; b < NR_OF_STATE_BLOCKS; b++) {
+                std::copy(m_state.begin() + b * m_nrOfChannels,
+                          m_state.begin() + (b + 1) * m_nrOfChannels,
+                          newState.begin() + b * newNrOfChannels);
+            }
+            m_state.swap(newState);
+
+            Part part;
+            part.offset = m_nrOfChannels;
+            part.size = size;
+            part.duration = duration;
+            part.trajectoryDuration = duration;
+            part.elapsedTime = 0;
+            part.moving = false;
+            m_parts.push_back(part);
+
+            m_nrOfChannels = newNrOfChannels;
+            return static_cast<int>(m_parts.size()) - 1;
+        }
+
+        int MinJerkBatch::getNrOfParts() const { return static_cast<int>(m_parts.size()); }
+
+        std::size_t MinJerkBatch::getPartSize(int part) const { return m_parts[part].size; }
+
+        void MinJerkBatch::setDuration(int part, double duration) { m_parts[part].duration = duration; }
+
+        double MinJerkBatch::getDuration(int part) const { return m_parts[part].duration; }
+
+        double * MinJerkBatch::block(StateBlock stateBlock, const Part &part)
+        {
+            if (m_state.empty()) return 0;
+            return &m_state[0] + stateBlock * m_nrOfChannels + part.offset;
+        }
+
+        const double * MinJerkBatch::block(StateBlock stateBlock, const Part &part) const
+        {
+            if (m_state.empty()) return 0;
+            return &m_state[0] + stateBlock * m_nrOfChannels + part.offset;
+        }
+
+        void MinJerkBatch::init(int partIndex, const double *position)
+        {
+            Part &part = m_parts[partIndex];
+            if (part.size == 0) return;
+            std::copy(position, position + part.size, block(POSITION, part));
+            std::copy(position, position + part.size, block(TARGET, part));
+            std::fill(block(VELOCITY, part), block(VELOCITY, part) + part.size, 0.0);
+            std::fill(block(ACCELERATION, part), block(ACCELERATION, part) + part.size, 0.0);
+            part.elapsedTime = 0;
+            part.moving = false;
+        }
+
+        void MinJerkBatch::setTarget(int partIndex, const double *target)
+        {
+            Part &part = m_parts[partIndex];
+            if (part.size == 0) return;
+            double *currentTarget = block(TARGET, part);
+            if (std::equal(target, target + part.size, currentTarget)) return;
+
+            std::copy(target, target + part.size, currentTarget);
+            plan(part);
+        }
+
+        void MinJerkBatch::plan(Part &part)
+        {
+            const double T = part.duration;
+            const double *p0 = block(POSITION, part);
+            const double *v0 = block(VELOCITY, part);
+            const double *a0 = block(ACCELERATION, part);
+            const double *pf = block(TARGET, part);
+            double *c0 = block(COEFFICIENT_0, part);
+            double *c1 = block(COEFFICIENT_1, part);
+            double *c2 = block(COEFFICIENT_2, part);
+            double *c3 = block(COEFFICIENT_3, part);
+            double *c4 = block(COEFFICIENT_4, part);
+            double *c5 = block(COEFFICIENT_5, part);
+
+            part.trajectoryDuration = T;
+            part.elapsedTime = 0;
+            part.moving = T > 0;
+            if (!part.moving) {
+                //Degenerate duration: jump to the target
+                std::copy(pf, pf + part.size, block(POSITION, part));
+                std::fill(block(VELOCITY, part), block(VELOCITY, part) + part.size, 0.0);
+                std::fill(block(ACCELERATION, part), block(ACCELERATION, part) + part.size, 0.0);
+                return;
+            }
+
+            //Quintic from (p0, v0, a0) to (pf, 0, 0) in time T
+            const double T2 = T * T;
+            const double T3 = T2 * T;
+            const double T4 = T3 * T;
+            const double T5 = T4 * T;
+            for (std::size_t i = 0; i < part.size; i++) {
+                const double d = pf[i] - p0[i];
+                c0[i] = p0[i];
+                c1[i] = v0[i];
+                c2[i] = 0.5 * a0[i];
+                c3[i] = (20.0 * d - 12.0 * v0[i] * T - 3.0 * a0[i] * T2) / (2.0 * T3);
+                c4[i] = (-30.0 * d + 16.0 * v0[i] * T + 3.0 * a0[i] * T2) / (2.0 * T4);
+                c5[i] = (12.0 * d - 6.0 * v0[i] * T - a0[i] * T2) / (2.0 * T5);
+            }
+        }
+
+        void MinJerkBatch::computeNextValues()
+        {
+            for (std::vector<Part>::iterator part = m_parts.begin(); part != m_parts.end(); ++part) {
+                if (!part->moving) continue;
+
+                double *p = block(POSITION, *part);
+                double *v = block(VELOCITY, *part);
+                double *a = block(ACCELERATION, *part);
+                const std::size_t size = part->size;
+
+                part->elapsedTime += m_sampleTime;
+                if (part->elapsedTime >= part->trajectoryDuration) {
+                    const double *pf = block(TARGET, *part);
+                    std::copy(pf, pf + size, p);
+                    std::fill(v, v + size, 0.0);
+                    std::fill(a, a + size, 0.0);
+                    part->moving = false;
+                    continue;
+                }
+
+                const double t = part->elapsedTime;
+                const double t2 = t * t;
+                const double t3 = t2 * t;
+                const double t4 = t3 * t;
+                const double t5 = t4 * t;
+                const double *c0 = block(COEFFICIENT_0, *part);
+                const double *c1 = block(COEFFICIENT_1, *part);
+                const double *c2 = block(COEFFICIENT_2, *part);
+                const double *c3 = block(COEFFICIENT_3, *part);
+                const double *c4 = block(COEFFICIENT_4, *part);
+                const double *c5 = block(COEFFICIENT_5, *part);
+
+                //Branch free loop on contiguous arrays: vectorized by the compiler
+                for (std::size_t i = 0; i < size; i++) {
+                    p[i] = c0[i] + c1[i] * t + c2[i] * t2 + c3[i] * t3 + c4[i] * t4 + c5[i] * t5;
+                    v[i] = c1[i] + 2.0 * c2[i] * t + 3.0 * c3[i] * t2 + 4.0 * c4[i] * t3 + 5.0 * c5[i] * t4;
+                    a[i] = 2.0 * c2[i] + 6.0 * c3[i] * t + 12.0 * c4[i] * t2 + 20.0 * c5[i] * t3;
+                }
+            }
+        }
+
+        const double * MinJerkBatch::getPos(int part) const { return block(POSITION, m_parts[part]); }
+
+        const double * MinJerkBatch::getVel(int part) const { return block(VELOCITY, m_parts[part]); }
+
+        const double * MinJerkBatch::getAcc(int part) const { return block(ACCELERATION, m_parts[part]); }
+
+    }
+}
@@ -0,0 +1,212 @@
+/*
+ * Copyright (C) 2016 Fondazione Istituto Italiano di Tecnologia
+ * CopyPolicy: Released under the terms of the GNU GPL v2.0 or any later version.
+ */
+
+/*
+ * Test of the MinJerkBatch trajectory generator.
+ *
+ * Checks that:
+ *  - a trajectory started at rest follows the closed form minimum jerk profile
+ *    (position, velocity and acceleration) and stops on the target;
+ *  - the parts are independent: a part added later, with a different duration, gives
+ *    the same values of a generator containing only that part, and adding it does not
+ *    change the state of the existing parts;
+ *  - after a retarget in the middle of a trajectory the state is continuous, the
+ *    velocity and the acceleration are the derivatives of the position and of the
+ *    velocity, and the new target is reached with zero velocity;
+ *  - a zero duration moves the part to the target in one step.
+ *
+ * Usage: minJerkBatchTest [sample time in seconds, default 0.001]
+ */
+
+#include "MinJerkBatch.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace {
+
+    bool check(bool condition, const char *message, double value)
+    {
+        if (!condition) {
+            std::fprintf(stderr, "%s (%g)\n", message, value);
+        }
+        return condition;
+    }
+
+    double maxDifference(const double *a, const double *b, std::size_t size)
+    {
+        double difference = 0;
+        for (std::size_t i = 0; i < size; i++) {
+            difference = std::max(difference, std::fabs(a[i] - b[i]));
+        }
+        return difference;
+    }
+
+    /* Minimum jerk from rest to rest, evaluated at time t */
+    void closedForm(const std::vector<double> &initial, const std::vector<double> &target,
+                    double duration, double t,
+                    std::vector<double> &pos, std::vector<double> &vel, std::vector<double> &acc)
+    {
+        const double s = std::min(t / duration, 1.0);
+        for (std::size_t i = 0; i < initial.size(); i++) {
+            const double d = target[i] - initial[i];
+            pos[i] = initial[i] + d * (10 * s * s * s - 15 * s * s * s * s + 6 * s * s * s * s * s);
+            vel[i] = d * (30 * s * s - 60 * s * s * s + 30 * s * s * s * s) / duration;
+            acc[i] = d * (60 * s - 180 * s * s + 120 * s * s * s) / (duration * duration);
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    using codyco::y2::MinJerkBatch;
+
+    const double sampleTime = argc > 1 ? std::atof(argv[1]) : 0.001;
+    if (sampleTime <= 0 || sampleTime > 0.01) {
+        std::fprintf(stderr, "The sample time must be in (0, 0.01] s\n");
+        return EXIT_FAILURE;
+    }
+
+    const double armDuration = 1.0;
+    const double legDuration = 0.5;
+    const double initialArm[] = {0.1, -0.2, 0.3};
+    const double targetArm[] = {-0.5, 0.4, 1.2};
+    const double initialLeg[] = {0.0, 0.05};
+    const double targetLeg[] = {0.3, -0.25};
+    std::vector<double> armInitial(initialArm, initialArm + 3);
+    std::vector<double> armTarget(targetArm, targetArm + 3);
+    std::vector<double> pos(3), vel(3), acc(3);
+    bool ok = true;
+
+    MinJerkBatch generator(sampleTime);
+    const int arm = generator.addPart(3, armDuration);
+    generator.init(arm, initialArm);
+
+    //Adding a part changes the layout of the state, but not its content
+    const int leg = generator.addPart(2, legDuration);
+    generator.init(leg, initialLeg);
+    ok = check(maxDifference(generator.getPos(arm), initialArm, 3) == 0,
+               "The state of a part changed when adding another part", maxDifference(generator.getPos(arm), initialArm, 3)) && ok;
+
+    MinJerkBatch legOnly(sampleTime);
+    const int legOnlyPart = legOnly.addPart(2, legDuration);
+    legOnly.init(legOnlyPart, initialLeg);
+
+    //Trajectory from rest: closed form
+    generator.setTarget(arm, targetArm);
+    const int legStart = static_cast<int>(0.2 / sampleTime);
+    const int samples = static_cast<int>(1.5 * armDuration / sampleTime);
+    double closedFormError = 0;
+    double partsError = 0;
+    for (int k = 1; k <= samples; k++) {
+        if (k == legStart) {
+            generator.setTarget(leg, targetLeg);
+            legOnly.setTarget(legOnlyPart, targetLeg);
+        }
+        generator.computeNextValues();
+        legOnly.computeNextValues();
+
+        closedForm(armInitial, armTarget, armDuration, k * sampleTime, pos, vel, acc);
+        closedFormError = std::max(closedFormError, maxDifference(generator.getPos(arm), &pos[0], 3));
+        closedFormError = std::max(closedFormError, maxDifference(generator.getVel(arm), &vel[0], 3));
+        closedFormError = std::max(closedFormError, maxDifference(generator.getAcc(arm), &acc[0], 3));
+
+        partsError = std::max(partsError, maxDifference(generator.getPos(leg), legOnly.getPos(legOnlyPart), 2));
+        partsError = std::max(partsError, maxDifference(generator.getVel(leg), legOnly.getVel(legOnlyPart), 2));
+        partsError = std::max(partsError, maxDifference(generator.getAcc(leg), legOnly.getAcc(legOnlyPart), 2));
+    }
+    ok = check(closedFormError < 1e-9, "The trajectory from rest differs from the closed form", closedFormError) && ok;
+    ok = check(partsError == 0, "The parts are not independent", partsError) && ok;
+    ok = check(maxDifference(generator.getPos(leg), targetLeg, 2) == 0, "The target of the second part is not reached",
+               maxDifference(generator.getPos(leg), targetLeg, 2)) && ok;
+
+    //Retarget in the middle of a trajectory
+    const double retargetArm[] = {0.7, 0.0, -0.6};
+    generator.init(arm, initialArm);
+    generator.setTarget(arm, targetArm);
+    const int retargetSample = static_cast<int>(0.4 * armDuration / sampleTime);
+    //The retarget sample is the first of the new trajectory, the loop stops before its end
+    const int endSample = retargetSample + static_cast<int>(armDuration / sampleTime) - 1;
+    std::vector<double> previousPos(initialArm, initialArm + 3);
+    std::vector<double> previousVel(3, 0.0);
+    std::vector<double> previousAcc(3, 0.0);
+    std::vector<double> beforePreviousPos(previousPos);
+    std::vector<double> beforePreviousVel(previousVel);
+    double continuityError = 0;
+    double velocityError = 0;
+    double accelerationError = 0;
+    for (int k = 1; k < endSample; k++) {
+        if (k == retargetSample) {
+            generator.setTarget(arm, retargetArm);
+        }
+        generator.computeNextValues();
+        const double *p = generator.getPos(arm);
+        const double *v = generator.getVel(arm);
+        const double *a = generator.getAcc(arm);
+
+        if (k == retargetSample) {
+            //The new trajectory starts from the current state (Taylor expansion, the jerk is bounded)
+            for (int i = 0; i < 3; i++) {
+                const double expected = previousPos[i] + previousVel[i] * sampleTime + 0.5 * previousAcc[i] * sampleTime * sampleTime;
+                continuityError = std::max(continuityError, std::fabs(p[i] - expected));
+            }
+        }
+        if (k >= 2) {
+            //Central differences of the previous sample. The jerk is discontinuous at the
+            //retarget, so there the difference of the velocity is only first order accurate
+            for (int i = 0; i < 3; i++) {
+                velocityError = std::max(velocityError,
+                                         std::fabs((p[i] - beforePreviousPos[i]) / (2 * sampleTime) - previousVel[i]));
+                if (k != retargetSample) {
+                    accelerationError = std::max(accelerationError,
+                                                 std::fabs((v[i] - beforePreviousVel[i]) / (2 * sampleTime) - previousAcc[i]));
+                }
+            }
+        }
+
+        beforePreviousPos = previousPos;
+        beforePreviousVel = previousVel;
+        previousPos.assign(p, p + 3);
+        previousVel.assign(v, v + 3);
+        previousAcc.assign(a, a + 3);
+    }
+    // Error bounds for a 1 s trajectory of about 1 rad: jerk < 200 rad/s^3, snap < 2000 rad/s^4
+    ok = check(continuityError < 40 * sampleTime * sampleTime * sampleTime,
+               "The state is not continuous at the retarget", continuityError) && ok;
+    ok = check(velocityError < 40 * sampleTime * sampleTime,
+               "The velocity is not the derivative of the position", velocityError) && ok;
+    ok = check(accelerationError < 400 * sampleTime * sampleTime,
+               "The acceleration is not the derivative of the velocity", accelerationError) && ok;
+
+    //Close to the end the new target is almost reached, with almost zero velocity
+    const double remainingTime = armDuration - (endSample - retargetSample) * sampleTime;
+    const double finalPositionError = maxDifference(&previousPos[0], retargetArm, 3);
+    const std::vector<double> zero(3, 0.0);
+    const double finalVelocity = maxDifference(&previousVel[0], &zero[0], 3);
+    ok = check(finalPositionError < 40 * remainingTime * remainingTime * remainingTime,
+               "The new target is not reached at the end of the trajectory", finalPositionError) && ok;
+    ok = check(finalVelocity < 200 * remainingTime * remainingTime,
+               "The velocity is not zero at the end of the trajectory", finalVelocity) && ok;
+    //The elapsed time is accumulated, so the last sample can be a rounding error before the end
+    generator.computeNextValues();
+    generator.computeNextValues();
+    ok = check(maxDifference(generator.getPos(arm), retargetArm, 3) == 0 && maxDifference(generator.getVel(arm), &zero[0], 3) == 0,
+               "The part does not stop on the target", maxDifference(generator.getPos(arm), retargetArm, 3)) && ok;
+
+    //Zero duration: jump to the target
+    generator.setDuration(leg, 0);
+    generator.setTarget(leg, initialLeg);
+    ok = check(maxDifference(generator.getPos(leg), initialLeg, 2) == 0 && generator.getVel(leg)[0] == 0,
+               "A zero duration does not move the part to the target", maxDifference(generator.getPos(leg), initialLeg, 2)) && ok;
+
+    std::printf("MinJerkBatch test: sample time %g s, closed form error %g, continuity error %g,"
+                " velocity error %g, acceleration error %g, final position error %g, final velocity %g\n",
+                sampleTime, closedFormError, continuityError, velocityError, accelerationError,
+                finalPositionError, finalVelocity);
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
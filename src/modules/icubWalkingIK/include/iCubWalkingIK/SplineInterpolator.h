@@ -10,13 +10,17 @@
 #include <sstream>
 #include <string>
 #include <limits>
+#include <algorithm>
+
+#include <Eigen/Core>
 
 #include "string_utils.h"
 
 template <typename VectorType>
 struct SplineInterpolator {
 	SplineInterpolator() :
-		initialized(false) {}
+		initialized(false),
+		cursor(0) {}
     
     /** Time values found in the input file
      */
@@ -24,27 +28,34 @@ struct SplineInterpolator {
     /** 3D Coordinates found in the input file
      */
 	std::vector<VectorType> p_values;
-    /** Has the same size as p_values. Computes
-     *  derivatives of every three points.
-     */
-	std::vector<VectorType> m_values;
 
     /** Puts time values from FILENAME into t_values and
      *  the corresponding 3D coordinates into p_values.
      */
 	bool generateFromCSV (const char* filename);
 	void addPoints (double t, const VectorType &values);
-    /** Computes derivatives of the input data storing 
-     *  them in m_values
+    /** Copies the knots in contiguous storage and computes
+     *  the derivatives of every three points.
      */
 	void initialize ();
 
-    /** Calls initialize() and getInterpolants() 
+    /** Calls initialize() and evaluates the spline at time t.
+     *  Consecutive calls with increasing times reuse the segment found
+     *  in the previous call, otherwise the segment is found by binary search.
      */
 	VectorType getValues (double t);
 	VectorType getDerivatives (double t);
 	VectorType getSecondDerivatives (double t);
 
+    /** Evaluates the spline at all the times in the vector.
+     *  Column i of values is the value at times[i]. The output matrix is
+     *  resized only if it does not have the right size.
+     *  Sorted times are evaluated in linear time.
+     */
+	void getValues (const Eigen::VectorXd &times, Eigen::MatrixXd &values);
+	void getDerivatives (const Eigen::VectorXd &times, Eigen::MatrixXd &derivatives);
+	void getSecondDerivatives (const Eigen::VectorXd &times, Eigen::MatrixXd &secondDerivatives);
+
 	double getStartTime();
 	double getEndTime();
 
@@ -65,10 +76,24 @@ struct SplineInterpolator {
 	double h10_ddot (double t) { return 6. * t - 4.; };
 	double h01_ddot (double t) { return - 12. * t + 6.; };
 	double h11_ddot (double t) { return 6. * t - 2.; };
-    /** For a desired time t, it returns the two consecutive times and coordinates
-     *  as read from the input file that will contain it.
+    /** Knot positions (one column for each knot) and their derivatives,
+     *  filled by initialize()
+     */
+	Eigen::MatrixXd p_matrix;
+	Eigen::MatrixXd m_matrix;
+    /** Index of the last segment used
      */
-	void getInterpolants (double t, double &t0, double &t1, VectorType &p0, VectorType &m0, VectorType &p1, VectorType &m1);
+	size_t cursor;
+
+    /** For a desired time t, it returns the index k of the segment [t_values[k], t_values[k + 1]]
+     *  that contains it.
+     */
+	size_t getSegment (double t);
+    /** Evaluates the derivative of the specified order (0, 1 or 2) of the spline at time t,
+     *  using the segment k.
+     */
+	void evaluate (size_t k, double t, int order, Eigen::Ref<Eigen::VectorXd> out);
+	void evaluate (const Eigen::VectorXd &times, int order, Eigen::MatrixXd &out);
 };
 
 template <typename VectorType>
@@ -149,16 +174,20 @@ inline void SplineInterpolator<VectorType>::initialize() {
 		abort();
 	}
 
-	m_values = std::vector<VectorType>(p_values.size(), VectorType::Zero(p_values[0].size()));
+	const size_t nrOfKnots = t_values.size();
+	p_matrix.resize(p_values[0].size(), nrOfKnots);
+	for (size_t i = 0; i < nrOfKnots; i++) {
+		p_matrix.col(i) = p_values[i];
+	}
 
-	m_values[0] = (p_values[1] - p_values[0]) / (t_values[1] - t_values[0]);
+	m_matrix.setZero(p_values[0].size(), nrOfKnots);
 
-	size_t last_index = t_values.size() - 1;
-	m_values[last_index] = (p_values[last_index] - p_values[last_index - 1]) / (t_values[last_index] - t_values[last_index - 1]);
+	m_matrix.col(0) = (p_matrix.col(1) - p_matrix.col(0)) / (t_values[1] - t_values[0]);
 
-	for (size_t i = 1; i < t_values.size() - 1; i ++) {
-		VectorType m_value = VectorType::Zero(p_values[0].size());
+	size_t last_index = nrOfKnots - 1;
+	m_matrix.col(last_index) = (p_matrix.col(last_index) - p_matrix.col(last_index - 1)) / (t_values[last_index] - t_values[last_index - 1]);
 
+	for (size_t i = 1; i < nrOfKnots - 1; i ++) {
 		// finite difference
 		// m_value = (p_values[i + 1] - p_values[i]) / (2. * (t_values[i + 1] - t_values[i])) + (p_values[i] - p_values[i - 1]) / (2. * (t_values[i] - t_values[i - 1]));
 
@@ -166,107 +195,125 @@ inline void SplineInterpolator<VectorType>::initialize() {
 		//m_value = (p_values[i + 1] - p_values[i - 1]) / (2. * (t_values[i + 1] - t_values[i - 1]));
 
 		// Catmull-Rom Spline
-		m_value = (p_values[i + 1] - p_values[i - 1]) / (t_values[i + 1] - t_values[i - 1]);
-
-		m_values[i] = m_value;
-//		std::cerr << "Added derivatives: " << m_value.transpose() << std::endl;
+		m_matrix.col(i) = (p_matrix.col(i + 1) - p_matrix.col(i - 1)) / (t_values[i + 1] - t_values[i - 1]);
 	}
 
+	cursor = 0;
 	initialized = true;
 }
 
 template <typename VectorType>
-inline void SplineInterpolator<VectorType>::getInterpolants (double t, double &t0, double &t1, VectorType &p0, VectorType &m0, VectorType &p1, VectorType &m1) {
-	for (size_t i = 1; i < t_values.size(); i ++) {
-		if (t >= t_values[i - 1] && (t <= t_values[i] || t - t_values[i] < std::numeric_limits<double>::epsilon())) {
-			t0 = t_values[i - 1];
-			t1 = t_values[i];
-			p0 = p_values[i - 1];
-			m0 = m_values[i - 1];
-			p1 = p_values[i];
-			m1 = m_values[i];
-			
-			return;
+inline size_t SplineInterpolator<VectorType>::getSegment (double t) {
+	const size_t last_index = t_values.size() - 1;
+	// Same tolerance on the end of the range of the previous linear search
+	if (t < t_values[0] || t - t_values[last_index] >= std::numeric_limits<double>::epsilon()) {
+		std::cerr.precision(16);
+		std::cerr << "Could not find interpolants at time " << std::scientific << t << ". Range is [" << getStartTime() << ", " << getEndTime() << "]!" << std::endl;
+		abort();
+	}
+
+	// Sequential queries: try the last segment and the following one.
+	// A time equal to a knot belongs to the segment ending in the knot.
+	for (size_t k = cursor; k < std::min(cursor + 2, last_index); k++) {
+		if ((t > t_values[k] || (k == 0 && t == t_values[k])) && t <= t_values[k + 1]) {
+			cursor = k;
+			return k;
 		}
 	}
 
-	std::cerr.precision(16);
-	std::cerr << "Could not find interpolants at time " << std::scientific << t << ". Range is [" << getStartTime() << ", " << getEndTime() << "]!" << std::endl;
-	abort();
+	// Index of the first knot not before t
+	size_t upper = std::lower_bound(t_values.begin(), t_values.end(), t) - t_values.begin();
+	if (upper == 0) {
+		cursor = 0;
+	} else if (upper > last_index) {
+		// t is within the tolerance after the last knot
+		cursor = last_index - 1;
+	} else {
+		cursor = upper - 1;
+	}
+	return cursor;
 }
 
 template <typename VectorType>
-inline VectorType SplineInterpolator<VectorType>::getValues(double t) {
-	initialize();
-
-	double t0;
-	double t1;
-	VectorType p0 (VectorType::Zero(p_values[0].size()));
-	VectorType m0 (VectorType::Zero(p_values[0].size()));
-	VectorType p1 (VectorType::Zero(p_values[0].size()));
-	VectorType m1 (VectorType::Zero(p_values[0].size()));
+inline void SplineInterpolator<VectorType>::evaluate (size_t k, double t, int order, Eigen::Ref<Eigen::VectorXd> out) {
+	const double t0 = t_values[k];
+	const double t1 = t_values[k + 1];
+	const double dt = t1 - t0;
+	const double tau = (t - t0) / dt;
+
+	switch (order) {
+	case 0:
+		out.noalias() = h00(tau) * p_matrix.col(k) + h10(tau) * dt * m_matrix.col(k)
+			+ h01(tau) * p_matrix.col(k + 1) + h11(tau) * dt * m_matrix.col(k + 1);
+		break;
+	case 1: {
+		const double taudot = 1. / dt;
+		out.noalias() = h00_dot(tau) * taudot * p_matrix.col(k) + h10_dot(tau) * m_matrix.col(k)
+			+ h01_dot(tau) * taudot * p_matrix.col(k + 1) + h11_dot(tau) * m_matrix.col(k + 1);
+		break;
+	}
+	default: {
+		const double taudot = 1. / dt;
+		const double taudot_2 = taudot * taudot;
+		out.noalias() = h00_ddot(tau) * taudot_2 * p_matrix.col(k) + h10_ddot(tau) * taudot * m_matrix.col(k)
+			+ h01_ddot(tau) * taudot_2 * p_matrix.col(k + 1) + h11_ddot(tau) * taudot * m_matrix.col(k + 1);
+		break;
+	}
+	}
+}
 
-	getInterpolants (t, t0, t1, p0, m0, p1, m1);	
+template <typename VectorType>
+inline void SplineInterpolator<VectorType>::evaluate (const Eigen::VectorXd &times, int order, Eigen::MatrixXd &out) {
+	initialize();
 
-//	std::cout << "Using interpolants: t0 = " << t0 << " t1 = " << t1 << std::endl 
-//		<< " p0 = " << p0.transpose() << std::endl
-//		<< " m0 = " << m0.transpose() << std::endl
-//		<< " p1 = " << p1.transpose() << std::endl
-//		<< " m1 = " << m1.transpose() << std::endl;
+	if (out.rows() != p_matrix.rows() || out.cols() != times.size()) {
+		out.resize(p_matrix.rows(), times.size());
+	}
+	for (int i = 0; i < times.size(); i++) {
+		evaluate(getSegment(times[i]), times[i], order, out.col(i));
+	}
+}
 
-	double tau = (t - t0) / (t1 - t0);
+template <typename VectorType>
+inline VectorType SplineInterpolator<VectorType>::getValues(double t) {
+	initialize();
 
-	return h00(tau) * p0 + h10(tau) * (t1 - t0) * m0 + h01(tau) * p1 + h11(tau) * (t1 - t0) * m1;
+	VectorType result (p_matrix.rows());
+	evaluate(getSegment(t), t, 0, result);
+	return result;
 }
 
 template <typename VectorType>
 inline VectorType SplineInterpolator<VectorType>::getDerivatives(double t) {
 	initialize();
 
-	double t0;
-	double t1;
-	VectorType p0 (VectorType::Zero(p_values[0].size()));
-	VectorType m0 (VectorType::Zero(p_values[0].size()));
-	VectorType p1 (VectorType::Zero(p_values[0].size()));
-	VectorType m1 (VectorType::Zero(p_values[0].size()));
-
-	getInterpolants (t, t0, t1, p0, m0, p1, m1);	
-
-//	std::cout << "Using interpolants: t0 = " << t0 << " t1 = " << t1 << std::endl 
-//		<< " p0 = " << p0.transpose() << std::endl
-//		<< " m0 = " << m0.transpose() << std::endl
-//		<< " p1 = " << p1.transpose() << std::endl
-//		<< " m1 = " << m1.transpose() << std::endl;
-
-	double tau = (t - t0) / (t1 - t0);
-	double taudot = (1.) / ((t1 - t0));
-
-	return h00_dot(tau) * taudot * p0 + h10_dot(tau) * taudot * (t1 - t0) * m0 + h01_dot(tau) * taudot * p1 + h11_dot(tau) * taudot * (t1 - t0) * m1;
+	VectorType result (p_matrix.rows());
+	evaluate(getSegment(t), t, 1, result);
+	return result;
 }
 
 template <typename VectorType>
 inline VectorType SplineInterpolator<VectorType>::getSecondDerivatives(double t) {
 	initialize();
 
-	double t0;
-	double t1;
-	VectorType p0 (VectorType::Zero(p_values[0].size()));
-	VectorType m0 (VectorType::Zero(p_values[0].size()));
-	VectorType p1 (VectorType::Zero(p_values[0].size()));
-	VectorType m1 (VectorType::Zero(p_values[0].size()));
-
-	getInterpolants (t, t0, t1, p0, m0, p1, m1);	
+	VectorType result (p_matrix.rows());
+	evaluate(getSegment(t), t, 2, result);
+	return result;
+}
 
-//	std::cout << "Using interpolants: t0 = " << t0 << " t1 = " << t1 << std::endl 
-//		<< " p0 = " << p0.transpose() << std::endl
-//		<< " m0 = " << m0.transpose() << std::endl
-//		<< " p1 = " << p1.transpose() << std::endl
-//		<< " m1 = " << m1.transpose() << std::endl;
+template <typename VectorType>
+inline void SplineInterpolator<VectorType>::getValues (const Eigen::VectorXd &times, Eigen::MatrixXd &values) {
+	evaluate(times, 0, values);
+}
 
-	double tau = (t - t0) / (t1 - t0);
-	double taudot_2 = (1.) / ((t1 - t0) * (t1 - t0));
+template <typename VectorType>
+inline void SplineInterpolator<VectorType>::getDerivatives (const Eigen::VectorXd &times, Eigen::MatrixXd &derivatives) {
+	evaluate(times, 1, derivatives);
+}
 
-	return h00_ddot(tau) * taudot_2 * p0 + h10_ddot(tau) * taudot_2 * (t1 - t0) * m0 + h01_ddot(tau) * taudot_2 * p1 + h11_ddot(tau) * taudot_2 * (t1 - t0) * m1;
+template <typename VectorType>
+inline void SplineInterpolator<VectorType>::getSecondDerivatives (const Eigen::VectorXd &times, Eigen::MatrixXd &secondDerivatives) {
+	evaluate(times, 2, secondDerivatives);
 }
 
 template <typename VectorType>
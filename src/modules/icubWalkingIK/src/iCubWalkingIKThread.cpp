@@ -221,6 +221,17 @@ void iCubWalkingIKThread::generateFeetTrajectories(std::string walkingPatternFil
     r_foot_interp.generateFromCSV(r_foot_pattern_aug_file.c_str());
     l_foot_interp.generateFromCSV(l_foot_pattern_aug_file.c_str());
     com_interp.generateFromCSV(std::string(m_outputDir + "/com_pattern.csv").c_str());
+
+    // sample all the trajectories at once
+    Eigen::VectorXd traj_times(N_traj);
+    for(unsigned int i = 0; i < N_traj; i++)
+        traj_times[i] = i*ts;
+    Eigen::MatrixXd r_foot_values;
+    Eigen::MatrixXd l_foot_values;
+    Eigen::MatrixXd com_values;
+    r_foot_interp.getValues(traj_times, r_foot_values);
+    l_foot_interp.getValues(traj_times, l_foot_values);
+    com_interp.getValues(traj_times, com_values);
     
     double t = 0.0;
     int h = 1; //index used to separate left and right feet
@@ -228,9 +239,9 @@ void iCubWalkingIKThread::generateFeetTrajectories(std::string walkingPatternFil
     double t_ss = paramsList.T_stride/2 - 2*paramsList.T_switch;
     for(unsigned int i = 0; i < N_traj; i++)
     {
-        r_foot_traj[i] = r_foot_interp.getValues(t);
-        l_foot_traj[i] = l_foot_interp.getValues(t);
-        com_traj[i]    = com_interp.getValues(t);
+        r_foot_traj[i] = r_foot_values.col(i);
+        l_foot_traj[i] = l_foot_values.col(i);
+        com_traj[i]    = com_values.col(i);
         // For the first
         if (h==1 && i>0)
         {
@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) 2016 Fondazione Istituto Italiano di Tecnologia
+ * CopyPolicy: Released under the terms of the GNU GPL v2.0 or any later version.
+ */
+
+/*
+ * Benchmark of the SplineInterpolator on a trajectory with many knots.
+ *
+ * The spline is sampled ten times per knot with:
+ *  - a linear search of the segment, as done before the segment lookup was introduced (reference);
+ *  - sequential calls of getValues;
+ *  - calls of getValues in random order;
+ *  - the batch version of getValues.
+ * The benchmark fails if the results differ from the reference or if the spline
+ * does not interpolate the knots.
+ *
+ * Usage: splineInterpolatorBenchmark [number of knots, default 10000]
+ */
+
+#include "SplineInterpolator.h"
+
+#include <Eigen/Core>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <vector>
+
+namespace {
+
+    double now()
+    {
+        return static_cast<double>(std::clock()) / CLOCKS_PER_SEC;
+    }
+
+    /* Evaluation with the linear search of the segment */
+    Eigen::VectorXd linearSearchValues(const std::vector<double> &t_values,
+                                       const std::vector<Eigen::VectorXd> &p_values,
+                                       const std::vector<Eigen::VectorXd> &m_values,
+                                       double t)
+    {
+        for (size_t i = 1; i < t_values.size(); i++) {
+            if (t >= t_values[i - 1] && (t <= t_values[i] || t - t_values[i] < std::numeric_limits<double>::epsilon())) {
+                double dt = t_values[i] - t_values[i - 1];
+                double tau = (t - t_values[i - 1]) / dt;
+                return (2. * tau * tau * tau - 3. * tau * tau + 1.) * p_values[i - 1]
+                    + (tau * tau * tau - 2. * tau * tau + tau) * dt * m_values[i - 1]
+                    + (- 2. * tau * tau * tau + 3. * tau * tau) * p_values[i]
+                    + (tau * tau * tau - tau * tau) * dt * m_values[i];
+            }
+        }
+        return Eigen::VectorXd();
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int nrOfKnots = argc > 1 ? std::atoi(argv[1]) : 10000;
+    const int samplesPerKnot = 10;
+    const int dimension = 3;
+    if (nrOfKnots < 3) {
+        std::fprintf(stderr, "At least 3 knots are needed\n");
+        return EXIT_FAILURE;
+    }
+
+    SplineInterpolator<Eigen::VectorXd> interpolator;
+    for (int i = 0; i < nrOfKnots; i++) {
+        double t = 0.01 * i;
+        Eigen::VectorXd p(dimension);
+        p << std::sin(t), std::cos(2 * t), 0.1 * t;
+        interpolator.addPoints(t, p);
+    }
+
+    //Derivatives of the knots, for the reference implementation
+    std::vector<Eigen::VectorXd> m_values(nrOfKnots);
+    const std::vector<double> &t_values = interpolator.t_values;
+    const std::vector<Eigen::VectorXd> &p_values = interpolator.p_values;
+    m_values[0] = (p_values[1] - p_values[0]) / (t_values[1] - t_values[0]);
+    m_values[nrOfKnots - 1] = (p_values[nrOfKnots - 1] - p_values[nrOfKnots - 2]) / (t_values[nrOfKnots - 1] - t_values[nrOfKnots - 2]);
+    for (int i = 1; i < nrOfKnots - 1; i++) {
+        m_values[i] = (p_values[i + 1] - p_values[i - 1]) / (t_values[i + 1] - t_values[i - 1]);
+    }
+
+    const int nrOfSamples = samplesPerKnot * (nrOfKnots - 1) + 1;
+    Eigen::VectorXd times(nrOfSamples);
+    for (int i = 0; i < nrOfSamples; i++) {
+        times(i) = interpolator.getStartTime() + (interpolator.getEndTime() - interpolator.getStartTime()) * i / (nrOfSamples - 1);
+    }
+    std::vector<int> shuffled(nrOfSamples);
+    for (int i = 0; i < nrOfSamples; i++) {
+        shuffled[i] = i;
+    }
+    std::srand(0);
+    for (int i = nrOfSamples - 1; i > 0; i--) {
+        std::swap(shuffled[i], shuffled[std::rand() % (i + 1)]);
+    }
+
+    Eigen::MatrixXd reference(dimension, nrOfSamples);
+    Eigen::MatrixXd sequential(dimension, nrOfSamples);
+    Eigen::MatrixXd random(dimension, nrOfSamples);
+    Eigen::MatrixXd batch(dimension, nrOfSamples);
+
+    double start = now();
+    for (int i = 0; i < nrOfSamples; i++) {
+        reference.col(i) = linearSearchValues(t_values, p_values, m_values, times(i));
+    }
+    double referenceTime = now() - start;
+
+    start = now();
+    for (int i = 0; i < nrOfSamples; i++) {
+        sequential.col(i) = interpolator.getValues(times(i));
+    }
+    double sequentialTime = now() - start;
+
+    start = now();
+    for (int i = 0; i < nrOfSamples; i++) {
+        random.col(shuffled[i]) = interpolator.getValues(times(shuffled[i]));
+    }
+    double randomTime = now() - start;
+
+    start = now();
+    interpolator.getValues(times, batch);
+    double batchTime = now() - start;
+
+    std::printf("SplineInterpolator benchmark: %d knots, %d samples\n", nrOfKnots, nrOfSamples);
+    std::printf("linear search:      %g s\n", referenceTime);
+    std::printf("sequential:         %g s\n", sequentialTime);
+    std::printf("random order:       %g s\n", randomTime);
+    std::printf("batch:              %g s\n", batchTime);
+
+    const double tolerance = 1e-12;
+    double sequentialError = (sequential - reference).cwiseAbs().maxCoeff();
+    double randomError = (random - reference).cwiseAbs().maxCoeff();
+    double batchError = (batch - reference).cwiseAbs().maxCoeff();
+    if (sequentialError > tolerance || randomError > tolerance || batchError > tolerance) {
+        std::fprintf(stderr, "Results differ from the linear search (errors %g %g %g)\n",
+                     sequentialError, randomError, batchError);
+        return EXIT_FAILURE;
+    }
+
+    for (int i = 0; i < nrOfKnots; i++) {
+        if ((interpolator.getValues(t_values[i]) - p_values[i]).cwiseAbs().maxCoeff() > tolerance) {
+            std::fprintf(stderr, "The spline does not interpolate knot %d\n", i);
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
+}
@@ -33,8 +33,10 @@
 #include <string.h>
 
 #include <cmath>
+#include <algorithm>
 
 #include "module.h"
+#include "poseOrdering.h"
 
 
 
@@ -109,10 +111,14 @@ bool reachRandomJointPositionsModule::configure(ResourceFinder &rf)
     {
         mode = GRID_MAPPING_WITH_RETURN;
     }
+    else if( mode_cfg == "gridMappingOptimized" )
+    {
+        mode = GRID_MAPPING_OPTIMIZED;
+    }
     else
     {
         std::cerr << "[ERR] reachRandomJointPositionsModule: mode " << mode_cfg << "is not available, exiting." << std::endl;
-        std::cerr << "[ERR] existing modes: random, gridVisit, gridMapping, gridMappingWithReturn" << std::endl;
+        std::cerr << "[ERR] existing modes: random, gridVisit, gridMapping, gridMappingWithReturn, gridMappingOptimized" << std::endl;
     }
 
     
@@ -125,6 +131,7 @@ bool reachRandomJointPositionsModule::configure(ResourceFinder &rf)
     return_point_waiting_period = rf.check("return_point_waiting_period",5.0).asDouble();
     elapsed_time = 0.0;
     ref_speed = rf.check("ref_speed",3.0).asDouble();
+    return_point_interval = rf.check("return_point_interval",0).asInt();
     period = rf.check("period",1.0).asDouble();
 
     //Check ports collecting position flagging data
@@ -319,12 +326,29 @@ bool reachRandomJointPositionsModule::configure(ResourceFinder &rf)
                 std::cout << listOfDesiredPositions[i].toString() << std::endl;
             }
 
+            std::cout << "Expected session duration: "
+                      << expectedSessionDuration(originalPositions,listOfDesiredPositions) << " s" << std::endl;
+
             isTheRobotInReturnPoint.open("/"+moduleName+"/"+controlledJoints[0].part_name+"/isTheRobotInReturnPoint:o");
             useFurtherPosForFitting.open("/"+moduleName+"/"+controlledJoints[0].part_name+"/useFurtherPosForFitting:o");
             
             break;
         }
 
+        case GRID_MAPPING_OPTIMIZED:
+        {
+            if( !this->generateOptimizedGrid() )
+            {
+                close_drivers();
+                return false;
+            }
+
+            isTheRobotInReturnPoint.open("/"+moduleName+"/"+controlledJoints[0].part_name+"/isTheRobotInReturnPoint:o");
+            useFurtherPosForFitting.open("/"+moduleName+"/"+controlledJoints[0].part_name+"/useFurtherPosForFitting:o");
+
+            break;
+        }
+
         case RANDOM:
         case GRID_VISIT:
             break;
@@ -377,6 +401,7 @@ bool reachRandomJointPositionsModule::getNewDesiredPosition(yarp::sig::Vector &
     {
         case GRID_MAPPING:
         case GRID_MAPPING_WITH_RETURN:
+        case GRID_MAPPING_OPTIMIZED:
             if( next_desired_position >= 0 && next_desired_position < int(listOfDesiredPositions.size()) )
             {
                 desired_pos = listOfDesiredPositions[next_desired_position].pos;
@@ -531,6 +556,142 @@ bool reachRandomJointPositionsModule::drawRow(yarp::sig::Vector center, int movi
     return true;
 }
 
+bool reachRandomJointPositionsModule::generateOptimizedGrid()
+{
+    int nrOfControlledJoints = int(controlledJoints.size());
+
+    is_desired_point_return_point = false;
+    listOfDesiredPositions.resize(0,desiredPositions(yarp::sig::Vector(),0.0));
+    next_desired_position = 0;
+
+    //Values of each joint in the grid: steps of delta from the center, within the limits
+    yarp::sig::Vector center(nrOfControlledJoints);
+    std::vector< std::vector<double> > jointValues(nrOfControlledJoints);
+    for(int jnt=0; jnt < nrOfControlledJoints; jnt++ )
+    {
+        const controlledJoint & joint = controlledJoints[jnt];
+        if( joint.delta <= 0.0 )
+        {
+            std::cerr << "[ERR] reachRandomJointPositionsModule: delta of joint " << jnt << " should be positive" << std::endl;
+            return false;
+        }
+        center[jnt] = (joint.lower_limit+joint.upper_limit)/2;
+        int semi_nr_of_lines = ceil((joint.upper_limit-center[jnt])/joint.delta);
+        for(int i = -semi_nr_of_lines; i <= semi_nr_of_lines; i++ )
+        {
+            double value = std::min(joint.upper_limit,std::max(joint.lower_limit,center[jnt]+i*joint.delta));
+            if( jointValues[jnt].empty() || jointValues[jnt].back() != value )
+            {
+                jointValues[jnt].push_back(value);
+            }
+        }
+    }
+
+    //All the combinations of the joint values, except the center (that is the return point)
+    std::vector<yarp::sig::Vector> poses;
+    std::vector<size_t> valueIdx(nrOfControlledJoints,0);
+    bool done = false;
+    while( !done )
+    {
+        yarp::sig::Vector pose(nrOfControlledJoints);
+        bool isCenter = true;
+        for(int jnt=0; jnt < nrOfControlledJoints; jnt++ )
+        {
+            pose[jnt] = jointValues[jnt][valueIdx[jnt]];
+            isCenter = isCenter && (pose[jnt] == center[jnt]);
+        }
+        if( !isCenter )
+        {
+            poses.push_back(pose);
+        }
+
+        //Next combination
+        done = true;
+        for(int jnt=0; jnt < nrOfControlledJoints && done; jnt++ )
+        {
+            valueIdx[jnt]++;
+            if( valueIdx[jnt] < jointValues[jnt].size() )
+            {
+                done = false;
+            }
+            else
+            {
+                valueIdx[jnt] = 0;
+            }
+        }
+    }
+
+    double original_travel_time = pathTravelTime(center,poses,ref_speed,true);
+
+    //Order the poses as a tour starting and ending at the center
+    nearestNeighbourOrder(center,poses,ref_speed);
+    twoOptOrder(center,poses,ref_speed,true);
+
+    //If the center is visited every return_point_interval poses, optimize each loop on its own
+    if( return_point_interval > 0 )
+    {
+        for(size_t first=0; first < poses.size(); first += return_point_interval )
+        {
+            size_t last = std::min(poses.size(),first+return_point_interval);
+            std::vector<yarp::sig::Vector> loop(poses.begin()+first,poses.begin()+last);
+            twoOptOrder(center,loop,ref_speed,true);
+            std::copy(loop.begin(),loop.end(),poses.begin()+first);
+        }
+    }
+
+    std::cout << "Travel time between the " << poses.size() << " poses: " << original_travel_time
+              << " s in grid order, " << pathTravelTime(center,poses,ref_speed,true) << " s after ordering" << std::endl;
+
+    //Start at the center of the workspace
+    listOfDesiredPositions.push_back(desiredPositions(center,return_point_waiting_period,
+                                                      true,desiredPositions::ROW_OUT));
+    for(size_t i=0; i < poses.size(); i++ )
+    {
+        bool first_of_loop = (return_point_interval > 0) ? (i % return_point_interval == 0) : (i == 0);
+        bool last_of_loop = (i == poses.size()-1)
+                            || (return_point_interval > 0 && (i+1) % return_point_interval == 0);
+
+        //Data can be used for fitting while moving between poses, but not on the way to the return point
+        desiredPositions::RowBoundary_t boundary = desiredPositions::ROW_IN;
+        if( last_of_loop )
+        {
+            boundary = desiredPositions::ROW_STOP;
+        }
+        else if( first_of_loop )
+        {
+            boundary = desiredPositions::ROW_START;
+        }
+        listOfDesiredPositions.push_back(desiredPositions(poses[i],static_pose_period,false,boundary));
+
+        if( last_of_loop )
+        {
+            listOfDesiredPositions.push_back(desiredPositions(center,return_point_waiting_period,
+                                                              true,desiredPositions::ROW_OUT));
+        }
+    }
+
+    std::cout << "Expected session duration: "
+              << expectedSessionDuration(originalPositions,listOfDesiredPositions) << " s" << std::endl;
+
+    return true;
+}
+
+double reachRandomJointPositionsModule::expectedSessionDuration(const yarp::sig::Vector & initial,
+                                                                const std::vector<desiredPositions> & positions)
+{
+    //The module checks the motion every period, and moves to the next position
+    //only when more than the waiting time has elapsed from the end of the motion
+    double duration = 0.0;
+    yarp::sig::Vector current = initial;
+    for(size_t i=0; i < positions.size(); i++ )
+    {
+        duration += ceil(travelTime(current,positions[i].pos,ref_speed)/period)*period;
+        duration += (floor(positions[i].waiting_time/period)+1)*period;
+        current = positions[i].pos;
+    }
+    return duration;
+}
+
 bool reachRandomJointPositionsModule::latchTimestampSync()
 {
     //Open State_ext:o port and connect to anonymous port
@@ -88,12 +88,13 @@ class reachRandomJointPositionsModule: public RFModule
     double period;
     double avgTime, stdDev, avgTimeUsed, stdDevUsed;
     
-    enum { RANDOM, GRID_VISIT, GRID_MAPPING, GRID_MAPPING_WITH_RETURN } mode;
+    enum { RANDOM, GRID_VISIT, GRID_MAPPING, GRID_MAPPING_WITH_RETURN, GRID_MAPPING_OPTIMIZED } mode;
 
     double static_pose_period;
     double return_point_waiting_period;
     double elapsed_time; // time passed from when the desired pose was reached
     double ref_speed;
+    int return_point_interval; // number of poses between two visits of the return point (GRID_MAPPING_OPTIMIZED mode)
     bool waitingForConnToReturnFlagPort;
     bool waitingForConnToFittingFlagPort;
 
@@ -145,6 +146,21 @@ private:
     bool drawRow(yarp::sig::Vector center, int movingJointIdx, int fixedJointStep,
                  bool withReturn, bool flagReturn);
 
+    /*
+     * Generate the vector of desired positions visiting all the points
+     * of the grid of the controlled joints, ordered to minimize the
+     * travel time, with a visit of the center every return_point_interval poses
+     */
+    bool generateOptimizedGrid();
+
+    /*
+     * Expected duration of the visit of the desired positions, starting from
+     * the initial one, considering the travel time at ref_speed, the waiting
+     * times and the period of the module
+     */
+    double expectedSessionDuration(const yarp::sig::Vector & initial,
+                                   const std::vector<desiredPositions> & positions);
+
     /*
      * Synchronise th timestamp with the one from iCub "State_ext:o" port envelope
      */
@@ -0,0 +1,107 @@
+/*
+* Copyright (C) 2016 Fondazione Istituto Italiano di Tecnologia
+* Permission is granted to copy, distribute, and/or modify this program
+* under the terms of the GNU General Public License, version 2 or any
+* later version published by the Free Software Foundation.
+*
+* A copy of the license can be found at
+* http://www.robotcub.org/icub/license/gpl.txt
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details
+*/
+
+#include "poseOrdering.h"
+
+#include <algorithm>
+#include <cmath>
+
+double travelTime(const yarp::sig::Vector & from, const yarp::sig::Vector & to, double ref_speed)
+{
+    double max_displacement = 0.0;
+    for(size_t jnt=0; jnt < from.size(); jnt++ )
+    {
+        max_displacement = std::max(max_displacement, std::fabs(to[jnt]-from[jnt]));
+    }
+    return max_displacement/ref_speed;
+}
+
+double pathTravelTime(const yarp::sig::Vector & start, const std::vector<yarp::sig::Vector> & poses,
+                      double ref_speed, bool returnToStart)
+{
+    if( poses.empty() )
+    {
+        return 0.0;
+    }
+
+    double total_time = travelTime(start,poses[0],ref_speed);
+    for(size_t i=1; i < poses.size(); i++ )
+    {
+        total_time += travelTime(poses[i-1],poses[i],ref_speed);
+    }
+    if( returnToStart )
+    {
+        total_time += travelTime(poses[poses.size()-1],start,ref_speed);
+    }
+    return total_time;
+}
+
+void nearestNeighbourOrder(const yarp::sig::Vector & start, std::vector<yarp::sig::Vector> & poses,
+                           double ref_speed)
+{
+    const yarp::sig::Vector * current = &start;
+    for(size_t i=0; i < poses.size(); i++ )
+    {
+        //Find the nearest pose among the ones not visited yet
+        size_t nearest = i;
+        double nearest_time = travelTime(*current,poses[i],ref_speed);
+        for(size_t j=i+1; j < poses.size(); j++ )
+        {
+            double time = travelTime(*current,poses[j],ref_speed);
+            if( time < nearest_time )
+            {
+                nearest = j;
+                nearest_time = time;
+            }
+        }
+        std::swap(poses[i],poses[nearest]);
+        current = &poses[i];
+    }
+}
+
+void twoOptOrder(const yarp::sig::Vector & start, std::vector<yarp::sig::Vector> & poses,
+                 double ref_speed, bool returnToStart, int maxPasses)
+{
+    const int n = int(poses.size());
+    // Numerical tolerance, to avoid loops on moves that do not change the travel time
+    const double tolerance = 1e-9;
+
+    bool improved = true;
+    for(int pass=0; improved && pass < maxPasses; pass++ )
+    {
+        improved = false;
+        //Reverse poses[i..k], with poses[-1] = start and poses[n] = start (if returnToStart)
+        for(int i=0; i < n-1; i++ )
+        {
+            const yarp::sig::Vector & before = (i == 0) ? start : poses[i-1];
+            for(int k=i+1; k < n; k++ )
+            {
+                double old_time = travelTime(before,poses[i],ref_speed);
+                double new_time = travelTime(before,poses[k],ref_speed);
+                if( k < n-1 || returnToStart )
+                {
+                    const yarp::sig::Vector & after = (k == n-1) ? start : poses[k+1];
+                    old_time += travelTime(poses[k],after,ref_speed);
+                    new_time += travelTime(poses[i],after,ref_speed);
+                }
+                if( new_time < old_time - tolerance )
+                {
+                    std::reverse(poses.begin()+i,poses.begin()+k+1);
+                    improved = true;
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,51 @@
+/*
+* Copyright (C) 2016 Fondazione Istituto Italiano di Tecnologia
+* Permission is granted to copy, distribute, and/or modify this program
+* under the terms of the GNU General Public License, version 2 or any
+* later version published by the Free Software Foundation.
+*
+* A copy of the license can be found at
+* http://www.robotcub.org/icub/license/gpl.txt
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+* Public License for more details
+*/
+
+#ifndef REACHRANDOM_JOINT_POSITIONS_POSE_ORDERING_H
+#define REACHRANDOM_JOINT_POSITIONS_POSE_ORDERING_H
+
+#include <vector>
+
+#include <yarp/sig/Vector.h>
+
+/*
+ * Time needed to move from a joint configuration to another one,
+ * if all the joints move at the same time with speed ref_speed
+ * (i.e. the time needed by the joint with the biggest displacement).
+ */
+double travelTime(const yarp::sig::Vector & from, const yarp::sig::Vector & to, double ref_speed);
+
+/*
+ * Total travel time of the path start -> poses[0] -> ... -> poses[n-1],
+ * plus the way back to start if returnToStart is true.
+ */
+double pathTravelTime(const yarp::sig::Vector & start, const std::vector<yarp::sig::Vector> & poses,
+                      double ref_speed, bool returnToStart);
+
+/*
+ * Reorder poses with the nearest neighbour heuristic, starting from start.
+ */
+void nearestNeighbourOrder(const yarp::sig::Vector & start, std::vector<yarp::sig::Vector> & poses,
+                           double ref_speed);
+
+/*
+ * Improve the order of poses with 2-opt moves (reversal of a subsequence),
+ * until no move reduces the travel time of the path starting at start
+ * (and going back to start, if returnToStart is true) or maxPasses is reached.
+ */
+void twoOptOrder(const yarp::sig::Vector & start, std::vector<yarp::sig::Vector> & poses,
+                 double ref_speed, bool returnToStart, int maxPasses=100);
+
+#endif
@@ -0,0 +1,105 @@
+#ifndef BATCH_OPTIM_PROBLEM_H
+#define BATCH_OPTIM_PROBLEM_H
+
+#include <yarp/sig/Vector.h>
+#include <vector>
+#include <string>
+#include <ostream>
+
+class OptimProblem;
+
+/**
+ * Solves a list of OptimProblem instances in parallel.
+ *
+ * Each worker thread owns an OptimProblem (i.e. its own model and IpOpt solver).
+ * The list of targets is split in contiguous blocks, one for each worker, so that consecutive
+ * targets (e.g. a sweep of CoM positions) are warm started from the previous solution.
+ * The assignment of the targets to the workers is deterministic, and so are the results.
+ *
+ * The solvers of the workers run concurrently in the same process, thus the IpOpt linear solver
+ * must be re-entrant. This is known only for the HSL solvers ma77, ma86 and ma97: with any other
+ * linear solver, including the default one of the IpOpt installation, only one worker is created.
+ * MUMPS, ma27 and ma57 in particular keep their state in global (COMMON block) variables.
+ */
+class BatchOptimProblem
+{
+public:
+    /**
+     * Single optimization problem
+     */
+    struct Target {
+        yarp::sig::Vector desiredCoM;
+        yarp::sig::Vector desiredJoints;
+        std::string feetInContact;
+    };
+
+    /**
+     * Solution and statistics of a single optimization problem
+     */
+    struct Result {
+        bool success;
+        yarp::sig::Vector solution;
+        double optimum;
+        int iterations;
+        double solutionTime; //wall time (seconds)
+        unsigned worker;
+    };
+
+    /**
+     * Constructor
+     *
+     * @param numberOfWorkers number of parallel threads. If 0 the number of available processors is used
+     * @param linearSolver IpOpt linear solver. If empty the default of the IpOpt installation is used.
+     *                     If it is not known to be re-entrant a single worker is used
+     */
+    explicit BatchOptimProblem(unsigned numberOfWorkers = 0, const std::string& linearSolver = "");
+    virtual ~BatchOptimProblem();
+
+    /**
+     * Initializes the model and the linear solver of all the workers.
+     * @see OptimProblem::initializeModel
+     *
+     * @return true if inizialization succeded. False otherwise.
+     */
+    bool initializeModel(const std::string modelFile, const std::vector<std::string>& jointsMapping = std::vector<std::string>());
+
+    /**
+     * Solves all the targets.
+     *
+     * @param targets list of problems to be solved
+     * @param results solutions and timing of each problem (same order as targets)
+     *
+     * @return true if all the problems have been solved. False otherwise
+     */
+    bool solve(const std::vector<Target>& targets, std::vector<Result>& results);
+
+    /**
+     * Returns the wall time (seconds) of the last call to solve
+     */
+    double totalSolutionTime() const;
+
+    /**
+     * Returns the number of worker threads
+     */
+    unsigned numberOfWorkers() const;
+
+    /**
+     * Prints a per-problem timing report of the last call to solve
+     *
+     * @param results results as returned by solve
+     * @param stream output stream
+     */
+    void printReport(const std::vector<Result>& results, std::ostream& stream) const;
+
+private:
+    class Worker;
+
+    std::vector<Worker*> m_workers;
+    std::string m_linearSolver;
+    double m_totalSolutionTime;
+
+    static unsigned availableProcessors();
+    static bool isThreadSafeLinearSolver(const std::string& linearSolver);
+};
+
+#endif // BATCH_OPTIM_PROBLEM_H
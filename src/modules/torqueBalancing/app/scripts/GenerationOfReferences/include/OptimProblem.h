@@ -2,7 +2,9 @@
 #define OPTIM_PROBLEM_H
 
 #include <IpTNLP.hpp>
+#include <IpSmartPtr.hpp>
 #include <vector>
+#include <string>
 
 namespace yarp {
     namespace sig {
@@ -10,6 +12,10 @@ namespace yarp {
     }
 }
 
+namespace Ipopt {
+    class IpoptApplication;
+}
+
 class SolverData;
 /**
  * This class solves the following optimization problem:
@@ -22,6 +28,9 @@ class SolverData;
  * (if 2 feet in contact additional constraint)
  *               left_X_right = constant
  *
+ * The relative feet pose constraint is expressed as the position of the right foot w.r.t. the left foot (3)
+ * and the vector part of the quaternion of the orientation error (3). Its Jacobian is sparse as it depends only
+ * on the legs joints.
  *
  * Once you created an instance of this class, you should call (in order) the following two methods:
  * - initializeModel: it initialize the structure of the mechanical system. It needs the URDF description of the robot
@@ -29,10 +38,17 @@ class SolverData;
  *                    i.e. the index in the variable qDes, and the name of the joint in the URDF
  * - solveOptimization: this actually perform the optimization procedure. It needs the desired com configuration,
  *                      together with the desired joints configuration and which foot is in contact
+ *
+ * The IpOpt solver is created once and reused by consecutive calls to solveOptimization.
+ * If two consecutive problems share the same structure (same feet in contact), the second one is
+ * warm started from the solution of the first one.
  */
 class OptimProblem
 {
     SolverData *pimpl;
+    Ipopt::SmartPtr<Ipopt::IpoptApplication> m_application;
+    Ipopt::SmartPtr<Ipopt::TNLP> m_solver;
+    int m_lastIterationCount;
 
 
 public:
@@ -61,6 +77,48 @@ public:
      */
     bool solveOptimization(const yarp::sig::Vector& desiredCoM, const yarp::sig::Vector& desiredJoints, const std::string feetInContact);
 
+    /**
+     * Enables or disables warm starting consecutive problems (default: enabled)
+     *
+     * @param enabled true to warm start from the previous solution
+     */
+    void setWarmStartEnabled(bool enabled);
+
+    /**
+     * Sets the IpOpt linear solver (option linear_solver, e.g. mumps, ma27, ma57).
+     * If not called the default of the IpOpt installation is used.
+     * Must be called after initializeModel.
+     *
+     * @param linearSolver name of the linear solver
+     * @return true if the option was accepted. False otherwise
+     */
+    bool setLinearSolver(const std::string& linearSolver);
+
+    /**
+     * Enables or disables the solver output (default: enabled)
+     *
+     * @param verbose true to print the IpOpt output and the solution
+     */
+    void setVerbose(bool verbose);
+
+    /**
+     * Returns the solution of the last optimization problem
+     *
+     * @param solution the optimal joints configuration
+     * @return true if the last optimization succeded. False otherwise
+     */
+    bool getSolution(yarp::sig::Vector& solution) const;
+
+    /**
+     * Returns the cost at the solution of the last optimization problem
+     */
+    double getOptimum() const;
+
+    /**
+     * Returns the number of IpOpt iterations of the last optimization problem
+     */
+    int getIterationCount() const;
+
 
 };
 
@@ -42,6 +42,27 @@ public:
     bool resetModelInformation(const std::string modelFile, const std::vector<std::string> &variableToDoFMapping);
     bool resetOptimizationData(const yarp::sig::Vector& desiredCoM, const yarp::sig::Vector& desiredJoints, std::string feetInContact);
 
+    /**
+     * Computes the relative pose of the right sole w.r.t. the left sole
+     * and (optionally) its Jacobian w.r.t. the optimization variables.
+     * The robot state must be already updated.
+     *
+     * @param computeJacobian true if also the Jacobian should be computed
+     */
+    bool computeRelativeFeetPose(bool computeJacobian = true);
+
+    /**
+     * Returns true if the last call to resetOptimizationData changed the
+     * structure (variables, constraints or Jacobian sparsity) of the problem
+     */
+    bool problemStructureChanged() const;
+
+    /**
+     * Returns true if warm start is enabled and the solution of the
+     * previous problem can be used to warm start the current one
+     */
+    bool warmStartAvailable() const;
+
 private:
     //model information
     iDynTree::HighLevel::DynamicsComputations dynamics;
@@ -56,17 +77,37 @@ private:
     unsigned int dofs;
     unsigned int optimVariableSize;
     unsigned int constraintsSize;
+    unsigned int jacobianNonZeros;
+
+    //optimization variables (index) which influence the relative feet pose
+    std::vector<int> relativeFeetPoseVariables;
 
     //optimization-related variables
     Eigen::VectorXd qDes;
     Eigen::VectorXd comDes;
     FeetInContact feetInContact;
-    iDynTree::Transform right_X_left;
+    iDynTree::Transform left_X_right;
 
     //Buffers
     Eigen::VectorXd qError;
     Eigen::MatrixXd hessian;
     iDynTree::MatrixDynSize comJacobian;
+    iDynTree::MatrixDynSize leftFootJacobian;
+    iDynTree::MatrixDynSize rightFootJacobian;
+    //relative feet pose: position (3) + quaternion vector part of the orientation error (3)
+    Eigen::Matrix<double, 6, 1> relativeFeetPose;
+    //Jacobian of relativeFeetPose: 6 x relativeFeetPoseVariables.size()
+    Eigen::MatrixXd relativeFeetPoseJacobian;
+
+    //Warm start (from the previous solution)
+    bool structureChanged;
+    bool hasWarmStart;
+    bool warmStartEnabled;
+    Eigen::VectorXd warmStartPrimal;
+    Eigen::VectorXd warmStartConstraintsMultipliers;
+    Eigen::VectorXd warmStartLowerBoundMultipliers;
+    Eigen::VectorXd warmStartUpperBoundMultipliers;
+    bool verbose;
 
 
     //Solution
@@ -80,6 +121,7 @@ private:
 
 
     friend class Solver;
+    friend class OptimProblem;
 
 };
 
@@ -0,0 +1,204 @@
+#include "BatchOptimProblem.h"
+#include "OptimProblem.h"
+
+#include <yarp/os/Thread.h>
+#include <yarp/os/Time.h>
+#include <yarp/os/LogStream.h>
+#include <algorithm>
+#include <iomanip>
+#include <cassert>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+class BatchOptimProblem::Worker : public yarp::os::Thread
+{
+    OptimProblem m_problem;
+    const std::vector<Target>* m_targets;
+    std::vector<Result>* m_results;
+    unsigned m_id;
+    size_t m_begin;
+    size_t m_end;
+
+public:
+    Worker(unsigned id)
+    : m_targets(0)
+    , m_results(0)
+    , m_id(id)
+    , m_begin(0)
+    , m_end(0)
+    {
+        m_problem.setVerbose(false);
+    }
+
+    bool initializeModel(const std::string modelFile, const std::vector<std::string>& jointsMapping, const std::string& linearSolver)
+    {
+        if (!m_problem.initializeModel(modelFile, jointsMapping)) return false;
+        //the solver is created by initializeModel
+        m_problem.setVerbose(false);
+        return linearSolver.empty() || m_problem.setLinearSolver(linearSolver);
+    }
+
+    void assignTargets(const std::vector<Target>& targets, std::vector<Result>& results, size_t begin, size_t end)
+    {
+        m_targets = &targets;
+        m_results = &results;
+        m_begin = begin;
+        m_end = end;
+    }
+
+    virtual void run()
+    {
+        assert(m_targets && m_results);
+        for (size_t index = m_begin; index < m_end && !isStopping(); ++index) {
+            const Target& target = (*m_targets)[index];
+            Result& result = (*m_results)[index];
+
+            double start = yarp::os::Time::now();
+            m_problem.solveOptimization(target.desiredCoM, target.desiredJoints, target.feetInContact);
+            result.solutionTime = yarp::os::Time::now() - start;
+
+            result.success = m_problem.getSolution(result.solution);
+            result.optimum = m_problem.getOptimum();
+            result.iterations = m_problem.getIterationCount();
+            result.worker = m_id;
+        }
+    }
+};
+
+BatchOptimProblem::BatchOptimProblem(unsigned numberOfWorkers, const std::string& linearSolver)
+: m_linearSolver(linearSolver)
+, m_totalSolutionTime(0)
+{
+    if (!isThreadSafeLinearSolver(linearSolver)) {
+        if (numberOfWorkers > 1) {
+            yWarning() << "The linear solver" << (linearSolver.empty() ? "of the IpOpt installation" : linearSolver)
+                       << "is not known to be thread safe: the problems are solved by a single worker";
+        }
+        numberOfWorkers = 1;
+    } else if (numberOfWorkers == 0) {
+        numberOfWorkers = availableProcessors();
+    }
+    m_workers.reserve(numberOfWorkers);
+    for (unsigned i = 0; i < numberOfWorkers; ++i) {
+        m_workers.push_back(new Worker(i));
+    }
+}
+
+BatchOptimProblem::~BatchOptimProblem()
+{
+    for (std::vector<Worker*>::iterator it = m_workers.begin(); it != m_workers.end(); ++it) {
+        (*it)->stop();
+        delete *it;
+    }
+    m_workers.clear();
+}
+
+bool BatchOptimProblem::initializeModel(const std::string modelFile, const std::vector<std::string>& jointsMapping)
+{
+    for (std::vector<Worker*>::iterator it = m_workers.begin(); it != m_workers.end(); ++it) {
+        if (!(*it)->initializeModel(modelFile, jointsMapping, m_linearSolver)) {
+            yError() << "Could not initialize the solver with the linear solver" << (m_linearSolver.empty() ? "of the IpOpt installation" : m_linearSolver);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool BatchOptimProblem::solve(const std::vector<Target>& targets, std::vector<Result>& results)
+{
+    results.clear();
+    Result emptyResult;
+    emptyResult.success = false;
+    emptyResult.optimum = 0;
+    emptyResult.iterations = 0;
+    emptyResult.solutionTime = 0;
+    emptyResult.worker = 0;
+    results.resize(targets.size(), emptyResult);
+
+    //contiguous blocks: the first (targets % workers) workers get one more target
+    size_t workersCount = std::min(m_workers.size(), targets.size());
+    size_t blockSize = workersCount > 0 ? targets.size() / workersCount : 0;
+    size_t remainder = workersCount > 0 ? targets.size() % workersCount : 0;
+
+    double start = yarp::os::Time::now();
+    size_t begin = 0;
+    for (size_t i = 0; i < workersCount; ++i) {
+        size_t end = begin + blockSize + (i < remainder ? 1 : 0);
+        m_workers[i]->assignTargets(targets, results, begin, end);
+        m_workers[i]->start();
+        begin = end;
+    }
+    for (size_t i = 0; i < workersCount; ++i) {
+        //wait for the worker to process its block
+        m_workers[i]->join();
+    }
+    m_totalSolutionTime = yarp::os::Time::now() - start;
+
+    bool allSolved = true;
+    for (std::vector<Result>::const_iterator it = results.begin(); it != results.end(); ++it) {
+        allSolved = allSolved && it->success;
+    }
+    return allSolved;
+}
+
+double BatchOptimProblem::totalSolutionTime() const
+{
+    return m_totalSolutionTime;
+}
+
+unsigned BatchOptimProblem::numberOfWorkers() const
+{
+    return m_workers.size();
+}
+
+void BatchOptimProblem::printReport(const std::vector<Result>& results, std::ostream& stream) const
+{
+    double cumulativeTime = 0;
+    double maxTime = 0;
+    unsigned solved = 0;
+
+    stream << std::setw(8) << "#" << std::setw(8) << "worker" << std::setw(10) << "status"
+    << std::setw(8) << "iter" << std::setw(14) << "time [ms]" << std::setw(14) << "cost" << "\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& result = results[i];
+        stream << std::setw(8) << i << std::setw(8) << result.worker
+        << std::setw(10) << (result.success ? "solved" : "FAILED")
+        << std::setw(8) << result.iterations
+        << std::setw(14) << std::fixed << std::setprecision(3) << result.solutionTime * 1e3
+        << std::setw(14) << std::scientific << std::setprecision(4) << result.optimum << "\n";
+        cumulativeTime += result.solutionTime;
+        maxTime = std::max(maxTime, result.solutionTime);
+        if (result.success) solved++;
+    }
+    stream << std::fixed << std::setprecision(3);
+    stream << "Solved " << solved << "/" << results.size() << " problems with " << numberOfWorkers() << " workers\n";
+    stream << "Wall time: " << m_totalSolutionTime * 1e3 << " ms, cumulative solver time: " << cumulativeTime * 1e3 << " ms\n";
+    if (!results.empty()) {
+        stream << "Average time per problem: " << cumulativeTime * 1e3 / results.size() << " ms, max: " << maxTime * 1e3 << " ms\n";
+    }
+    if (m_totalSolutionTime > 0) {
+        stream << "Parallel speedup: " << cumulativeTime / m_totalSolutionTime << "\n";
+    }
+}
+
+bool BatchOptimProblem::isThreadSafeLinearSolver(const std::string& linearSolver)
+{
+    //HSL solvers whose state is all in the caller-provided data (ma27 and ma57 use COMMON blocks)
+    return linearSolver == "ma77" || linearSolver == "ma86" || linearSolver == "ma97";
+}
+
+unsigned BatchOptimProblem::availableProcessors()
+{
+#ifdef _WIN32
+    SYSTEM_INFO systemInfo;
+    GetSystemInfo(&systemInfo);
+    long processors = systemInfo.dwNumberOfProcessors;
+#else
+    long processors = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    return processors > 0 ? static_cast<unsigned>(processors) : 1;
+}
@@ -3,6 +3,7 @@
 #include <yarp/sig/Vector.h>
 #include <yarp/os/LogStream.h>
 #include <IpIpoptApplication.hpp>
+#include <IpSolveStatistics.hpp>
 
 #include "Solver.h"
 #include "SolverData.h"
@@ -11,12 +12,16 @@ using namespace Ipopt;
 
 OptimProblem::OptimProblem()
 : pimpl(0)
+, m_lastIterationCount(0)
 {
     pimpl = new SolverData();
 }
 
 OptimProblem::~OptimProblem()
 {
+    //the solver references pimpl: release it first
+    m_solver = 0;
+    m_application = 0;
     if (pimpl) {
         delete pimpl;
         pimpl = 0;
@@ -26,51 +31,118 @@ OptimProblem::~OptimProblem()
 bool OptimProblem::initializeModel(const std::string modelFile, const std::vector<std::string> &jointsMapping)
 {
     assert(pimpl);
-    return pimpl->resetModelInformation(modelFile, jointsMapping);
-}
-
+    if (!pimpl->resetModelInformation(modelFile, jointsMapping)) return false;
 
-bool OptimProblem::solveOptimization(const yarp::sig::Vector& desiredCoM, const yarp::sig::Vector& desiredJoints, std::string feetInContact)
-{
-    assert(pimpl);
-    pimpl->resetOptimizationData(desiredCoM, desiredJoints, feetInContact);
+    // Create a new instance of your nlp
+    //  (use a SmartPtr, not raw)
+    m_solver = new Solver(*pimpl);
 
-//    // Create a new instance of your nlp
-//    //  (use a SmartPtr, not raw)
-    SmartPtr<TNLP> mynlp = new Solver(*pimpl);
-//
     // Create a new instance of IpoptApplication
     //  (use a SmartPtr, not raw)
     // We are using the factory, since this allows us to compile this
     // example with an Ipopt Windows DLL
-    SmartPtr<IpoptApplication> app = IpoptApplicationFactory();
-//
-//    // Change some options
-//    // Note: The following choices are only examples, they might not be
-//    //       suitable for your optimization problem.
-//    app->Options()->SetNumericValue("tol", 1e-9);
-//    app->Options()->SetStringValue("mu_strategy", "adaptive");
-//    app->Options()->SetStringValue("output_file", "ipopt.out");
-    app->Options()->SetStringValue("hessian_approximation", "limited-memory");
-//
-//    // Intialize the IpoptApplication and process the options
-    ApplicationReturnStatus status;
-    status = app->Initialize();
+    // The application is reused for all the subsequent optimizations
+    m_application = IpoptApplicationFactory();
+    m_application->Options()->SetStringValue("hessian_approximation", "limited-memory");
+    m_application->Options()->SetIntegerValue("print_level", pimpl->verbose ? 5 : 0);
+    // Warm start options (used only if warm_start_init_point is yes)
+    m_application->Options()->SetNumericValue("warm_start_bound_push", 1e-9);
+    m_application->Options()->SetNumericValue("warm_start_mult_bound_push", 1e-9);
+
+    // Intialize the IpoptApplication and process the options
+    ApplicationReturnStatus status = m_application->Initialize();
     if (status != Solve_Succeeded) {
         yError("*** Error during initialization of IpOpt!");
-        return (int) status;
+        m_application = 0;
+        return false;
+    }
+    return true;
+}
+
+
+bool OptimProblem::solveOptimization(const yarp::sig::Vector& desiredCoM, const yarp::sig::Vector& desiredJoints, std::string feetInContact)
+{
+    assert(pimpl);
+    if (IsNull(m_application)) {
+        yError("Model not initialized. Call initializeModel first");
+        return false;
+    }
+    if (!pimpl->resetOptimizationData(desiredCoM, desiredJoints, feetInContact)) {
+        return false;
     }
 
+    //the same flag selects the starting point in Solver::get_starting_point
+    m_application->Options()->SetStringValue("warm_start_init_point", pimpl->warmStartAvailable() ? "yes" : "no");
+
     // Ask Ipopt to solve the problem
-    status = app->OptimizeTNLP(mynlp);
+    // If the structure did not change we can reuse the data structures of the previous run
+    ApplicationReturnStatus status;
+    if (pimpl->problemStructureChanged()) {
+        status = m_application->OptimizeTNLP(m_solver);
+    } else {
+        status = m_application->ReOptimizeTNLP(m_solver);
+    }
+    pimpl->structureChanged = false;
 
-    if (status == Solve_Succeeded) {
-        yInfo("*** The problem solved!");
+    m_lastIterationCount = 0;
+    SmartPtr<SolveStatistics> statistics = m_application->Statistics();
+    if (IsValid(statistics)) {
+        m_lastIterationCount = statistics->IterationCount();
     }
-    else {
-        yError("*** The problem FAILED!");
+
+    bool solved = status == Solve_Succeeded || status == Solved_To_Acceptable_Level;
+    if (pimpl->verbose) {
+        if (solved) {
+            yInfo("*** The problem solved!");
+        }
+        else {
+            yError("*** The problem FAILED!");
+        }
     }
+    return solved;
+}
 
-    return (int) status;
+void OptimProblem::setWarmStartEnabled(bool enabled)
+{
+    assert(pimpl);
+    pimpl->warmStartEnabled = enabled;
+}
+
+bool OptimProblem::setLinearSolver(const std::string& linearSolver)
+{
+    if (IsNull(m_application)) {
+        yError("Model not initialized. Call initializeModel first");
+        return false;
+    }
+    return m_application->Options()->SetStringValue("linear_solver", linearSolver);
+}
+
+void OptimProblem::setVerbose(bool verbose)
+{
+    assert(pimpl);
+    pimpl->verbose = verbose;
+    if (IsValid(m_application)) {
+        m_application->Options()->SetIntegerValue("print_level", verbose ? 5 : 0);
+    }
+}
 
+bool OptimProblem::getSolution(yarp::sig::Vector& solution) const
+{
+    assert(pimpl);
+    solution.resize(pimpl->primalSolution.size());
+    for (int i = 0; i < pimpl->primalSolution.size(); i++) {
+        solution[i] = pimpl->primalSolution[i];
+    }
+    return pimpl->finalStatus == ::SUCCESS;
+}
+
+double OptimProblem::getOptimum() const
+{
+    assert(pimpl);
+    return pimpl->optimum;
+}
+
+int OptimProblem::getIterationCount() const
+{
+    return m_lastIterationCount;
 }
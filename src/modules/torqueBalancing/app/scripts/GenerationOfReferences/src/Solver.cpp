@@ -31,8 +31,10 @@ bool Solver::get_nlp_info(Ipopt::Index& n, Ipopt::Index& m, Ipopt::Index& nnz_ja
     n = m_data.optimVariableSize;
     m = m_data.constraintsSize;
 
-    nnz_jac_g = m * n; //for now just treat everything as dense
-    nnz_h_lag = n * n; //for now just treat everything as dense
+    //CoM rows are dense, relative feet pose rows only depend on the legs joints
+    nnz_jac_g = m_data.jacobianNonZeros;
+    //The Hessian is approximated (limited-memory) by IpOpt: it is never requested
+    nnz_h_lag = 0;
 
     index_style = C_STYLE;
     return true;
@@ -52,17 +54,16 @@ bool Solver::get_bounds_info(Ipopt::Index n, Ipopt::Number* x_l, Ipopt::Number*
 
     if (m_data.feetInContact == BOTH_FEET_IN_CONTACT) {
         // relative transform position constraint
-        iDynTree::Position position = m_data.right_X_left.getPosition();
-        iDynTree::Rotation rotation = m_data.right_X_left.getRotation();
+        iDynTree::Position position = m_data.left_X_right.getPosition();
         g_l[3] = g_u[3] = position(0);
         g_l[4] = g_u[4] = position(1);
         g_l[5] = g_u[5] = position(2);
 
-        //TODO:        g_l[3] = g_u[3] = rotation.getQuaterion(0);
-        g_l[6] = g_u[6] = rotation(0,0);
-        g_l[7] = g_u[7] = rotation(0,0);
-        g_l[8] = g_u[8] = rotation(0,0);
-        g_l[9] = g_u[9] = rotation(0,0);
+        // relative transform orientation constraint:
+        // the vector part of the orientation error quaternion must be zero
+        g_l[6] = g_u[6] = 0;
+        g_l[7] = g_u[7] = 0;
+        g_l[8] = g_u[8] = 0;
     }
 
     return true;
@@ -72,10 +73,28 @@ bool Solver::get_starting_point(Ipopt::Index n, bool init_x, Ipopt::Number* x,
                                                          bool init_z, Ipopt::Number* z_L, Ipopt::Number* z_U,
                                                          Ipopt::Index m, bool init_lambda, Ipopt::Number* lambda)
 {
-    //Let's assert what we expect: only initial x_0
+    //z and lambda are requested only when warm starting (warm_start_init_point = yes)
     assert(init_x);
-    assert(!init_z);
-    assert(!init_lambda);
+    assert(!(init_z || init_lambda) || m_data.warmStartAvailable());
+
+    if (m_data.warmStartAvailable()) {
+        //Start from the solution of the previous problem
+        for (Index i = 0; i < n; ++i) {
+            x[i] = m_data.warmStartPrimal[i];
+        }
+        if (init_z) {
+            for (Index i = 0; i < n; ++i) {
+                z_L[i] = m_data.warmStartLowerBoundMultipliers[i];
+                z_U[i] = m_data.warmStartUpperBoundMultipliers[i];
+            }
+        }
+        if (init_lambda) {
+            for (Index i = 0; i < m; ++i) {
+                lambda[i] = m_data.warmStartConstraintsMultipliers[i];
+            }
+        }
+        return true;
+    }
 
     for (Index i = 0; i < n; ++i) {
         x[i] = m_data.qDes[i];
@@ -127,19 +146,10 @@ bool Solver::eval_g(Ipopt::Index n, const Ipopt::Number* x,
     g[2] = com(2);
 
     if (m_data.feetInContact == BOTH_FEET_IN_CONTACT) {
-        //TODO:
-        iDynTree::Transform kinematic = m_data.dynamics.getRelativeTransform("l_sole", "r_sole");
-        iDynTree::Position position = kinematic.getPosition();
-        iDynTree::Rotation rotation = kinematic.getRotation();
-        g[3] = position(0);
-        g[4] = position(1);
-        g[5] = position(2);
-
-        //TODO:        g_l[3] = g_u[3] = rotation.getQuaterion(0);
-        g[6] = rotation(0,0);
-        g[7] = rotation(0,0);
-        g[8] = rotation(0,0);
-        g[9] = rotation(0,0);
+        result = result && m_data.computeRelativeFeetPose(false);
+        for (Index i = 0; i < 6; i++) {
+            g[3 + i] = m_data.relativeFeetPose(i);
+        }
     }
     return result;
 }
@@ -152,6 +162,9 @@ bool Solver::eval_jac_g(Ipopt::Index n, const Ipopt::Number* x, bool new_x,
     if (new_x) {
         result = result && updateState(x);
     }
+    //Layout (row-wise): 3 dense CoM rows, then (if both feet are in contact)
+    //6 relative feet pose rows restricted to the legs variables
+    Index relativePoseVariables = m_data.relativeFeetPoseVariables.size();
     if (!values) {
         //Sparsity structure of the Jacobian
         for (Index row = 0; row < 3; row++) {
@@ -160,6 +173,14 @@ bool Solver::eval_jac_g(Ipopt::Index n, const Ipopt::Number* x, bool new_x,
                 jCol[row * n + col] = col;
             }
         }
+        if (m_data.feetInContact == BOTH_FEET_IN_CONTACT) {
+            for (Index row = 0; row < 6; row++) {
+                for (Index col = 0; col < relativePoseVariables; col++) {
+                    iRow[3 * n + row * relativePoseVariables + col] = 3 + row;
+                    jCol[3 * n + row * relativePoseVariables + col] = m_data.relativeFeetPoseVariables[col];
+                }
+            }
+        }
     } else {
         //Actual Jacobian
         // CoM Jacobian
@@ -171,7 +192,13 @@ bool Solver::eval_jac_g(Ipopt::Index n, const Ipopt::Number* x, bool new_x,
         }
 
         if (m_data.feetInContact == BOTH_FEET_IN_CONTACT) {
-
+            // Relative feet pose Jacobian
+            result = result && m_data.computeRelativeFeetPose();
+            for (Index row = 0; row < 6; row++) {
+                for (Index col = 0; col < relativePoseVariables; col++) {
+                    values[3 * n + row * relativePoseVariables + col] = m_data.relativeFeetPoseJacobian(row, col);
+                }
+            }
         }
     }
     return result;
@@ -229,16 +256,16 @@ void Solver::finalize_solution(Ipopt::SolverReturn status, Ipopt::Index n,
     }
     m_data.optimum = obj_value;
 
-    std::cerr << "Solution (primal) - rad:" << m_data.primalSolution.transpose() << "\nn";
-    std::cerr << "Solution (primal) - deg:" << (m_data.primalSolution.transpose() * 180.0/M_PI) << "\n";
-
     for (Index i = 0; i < m; i++) {
         m_data.constraintsValue[i] = g[i];
         m_data.constraintsMultipliers[i] = lambda[i];
-        m_data.lowerBoundMultipliers[n + i] = z_L[n + i];
-        m_data.upperBoundMultipliers[n + i] = z_U[n + i];
     }
 
+    if (!m_data.verbose) return;
+
+    std::cerr << "Solution (primal) - rad:" << m_data.primalSolution.transpose() << "\n";
+    std::cerr << "Solution (primal) - deg:" << (m_data.primalSolution.transpose() * 180.0/M_PI) << "\n";
+
     std::cerr << "Constraints value (CoM)\n"
     << m_data.constraintsValue << "\n";
 
@@ -2,8 +2,38 @@
 
 #include <yarp/os/LogStream.h>
 #include <yarp/sig/Matrix.h>
+#include <Eigen/Geometry>
+#include <limits>
+#include <cassert>
 
-SolverData::SolverData() {}
+namespace {
+    typedef Eigen::Map<const Eigen::Matrix<double, 3, 3, Eigen::RowMajor> > RotationMap;
+    typedef Eigen::Map<const Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> > JacobianMap;
+
+    inline Eigen::Matrix3d skew(const Eigen::Vector3d& v)
+    {
+        Eigen::Matrix3d skewMatrix;
+        skewMatrix <<     0, -v(2),  v(1),
+                       v(2),     0, -v(0),
+                      -v(1),  v(0),     0;
+        return skewMatrix;
+    }
+}
+
+SolverData::SolverData()
+: rightFootFrameID(-1)
+, leftFootFrameID(-1)
+, dofs(0)
+, optimVariableSize(0)
+, constraintsSize(0)
+, jacobianNonZeros(0)
+, feetInContact(LEFT_FOOT_IN_CONTACT)
+, structureChanged(true)
+, hasWarmStart(false)
+, warmStartEnabled(true)
+, verbose(true)
+, finalStatus(ERROR)
+, optimum(std::numeric_limits<double>::max()) {}
 
 bool SolverData::resetModelInformation(const std::string modelFile, const std::vector<std::string> &_jointsMapping)
 {
@@ -24,6 +54,8 @@ bool SolverData::resetModelInformation(const std::string modelFile, const std::v
     dofsSizeZero.zero();
 
     comJacobian.resize(3, 6 + dofs);
+    leftFootJacobian.resize(6, 6 + dofs);
+    rightFootJacobian.resize(6, 6 + dofs);
 
     if (_jointsMapping.empty()) {
         //one to one mapping:
@@ -32,10 +64,13 @@ bool SolverData::resetModelInformation(const std::string modelFile, const std::v
         for (unsigned i = 0; i < dofs; i++) {
             variableToDoFMapping.push_back(i);
         }
+        qDes.setZero(dofs);
+        optimVariableSize = qDes.size();
 
     } else {
         //We have less optimization variables of joints (or order is not the same)
         //Mapping each optimization variable to the correspinding joint index in the model
+        variableToDoFMapping.clear();
         variableToDoFMapping.reserve(_jointsMapping.size());
         qDes.setZero(_jointsMapping.size());
         optimVariableSize = qDes.size();
@@ -48,6 +83,10 @@ bool SolverData::resetModelInformation(const std::string modelFile, const std::v
         for (std::vector<std::string>::const_iterator it = _jointsMapping.begin();
              it != _jointsMapping.end(); ++it) {
             int index = dynamics.getJointIndex(*it);
+            if (index < 0) {
+                yError() << "Joint " << *it << " not found in the model";
+                return false;
+            }
             variableToDoFMapping.push_back(index);
         }
         yInfo() << "Mapping translated to (# => model index): " << variableToDoFMapping;
@@ -56,13 +95,24 @@ bool SolverData::resetModelInformation(const std::string modelFile, const std::v
     //looking for feet frames
     leftFootFrameID = dynamics.getFrameIndex("l_sole");
     rightFootFrameID = dynamics.getFrameIndex("r_sole");
+    if (leftFootFrameID < 0 || rightFootFrameID < 0) {
+        yError("Feet frames (l_sole, r_sole) not found in the model");
+        return false;
+    }
+
+    //The model changed: any previous solution is meaningless
+    structureChanged = true;
+    hasWarmStart = false;
+    finalStatus = ERROR;
     return result;
 }
 
 bool SolverData::resetOptimizationData(const yarp::sig::Vector& desiredCoM, const yarp::sig::Vector& desiredJoints, std::string feetInContact)
 {
-    if (variableToDoFMapping.size() > 0)
-        assert(desiredJoints.size() == qDes.size());
+    if (static_cast<int>(desiredJoints.size()) != qDes.size()) {
+        yError() << "Desired joints size (" << desiredJoints.size() << ") does not match the number of optimization variables (" << qDes.size() << ")";
+        return false;
+    }
 
     comDes.resize(3);
     for (int i = 0; i < 3; i++) {
@@ -72,9 +122,17 @@ bool SolverData::resetOptimizationData(const yarp::sig::Vector& desiredCoM, cons
     for (int i = 0; i < desiredJoints.size(); i++) {
         qDes[i] = desiredJoints[i];
     }
+
+    //save the previous problem structure to check if it changed
+    FeetInContact previousFeetInContact = this->feetInContact;
+    unsigned int previousVariableSize = optimVariableSize;
+    unsigned int previousConstraintsSize = constraintsSize;
+    unsigned int previousJacobianNonZeros = jacobianNonZeros;
+
     //specify dimensions
     optimVariableSize = qDes.size();
     constraintsSize = 3;
+    relativeFeetPoseVariables.clear();
 
     if (feetInContact == "left") {
         this->feetInContact = LEFT_FOOT_IN_CONTACT;
@@ -88,15 +146,59 @@ bool SolverData::resetOptimizationData(const yarp::sig::Vector& desiredCoM, cons
         this->feetInContact = BOTH_FEET_IN_CONTACT;
         dynamics.setFloatingBase("l_sole");
         //TODO: read state - or take it from input
-        //we must read the relative transform. I don't have the current state. I cannot compute it
-        right_X_left = dynamics.getRelativeTransform("l_sole", "r_sole");
+        //For now the relative feet transform is the one at the zero configuration.
+        //We compute it explicitly at zero as the state could be dirty from a previous solution
+        allJoints.zero();
+        if (!dynamics.setRobotState(allJoints, dofsSizeZero, dofsSizeZero, world_gravity)) {
+            yError("Failed to set the robot state");
+            return false;
+        }
+        left_X_right = dynamics.getRelativeTransform(leftFootFrameID, rightFootFrameID);
+
+        //Structural sparsity of the relative feet pose constraint:
+        //only the joints in the chain between the two feet have non zero columns
+        //in the feet Jacobians (the angular part of a revolute joint column is its axis, thus never zero)
+        if (!dynamics.getFrameJacobian(leftFootFrameID, leftFootJacobian)
+            || !dynamics.getFrameJacobian(rightFootFrameID, rightFootJacobian)) {
+            yError("Failed to compute the feet Jacobians");
+            return false;
+        }
+        for (unsigned index = 0; index < variableToDoFMapping.size(); ++index) {
+            unsigned column = 6 + variableToDoFMapping[index];
+            for (unsigned row = 0; row < 6; ++row) {
+                if (leftFootJacobian(row, column) != 0 || rightFootJacobian(row, column) != 0) {
+                    relativeFeetPoseVariables.push_back(index);
+                    break;
+                }
+            }
+        }
+        relativeFeetPoseJacobian.setZero(6, relativeFeetPoseVariables.size());
+
         constraintsSize += 3 //relative transform position constraint
-                        + 4; //relative transform orientation (expressed in quaternion) constraint
+                        + 3; //relative transform orientation (vector part of the error quaternion) constraint
     } else {
         yError() << "Unsupported feet configuration";
         return false;
     }
 
+    //CoM Jacobian is dense, the relative feet pose Jacobian is not
+    jacobianNonZeros = 3 * optimVariableSize + 6 * relativeFeetPoseVariables.size();
+
+    structureChanged = structureChanged
+    || previousFeetInContact != this->feetInContact
+    || previousVariableSize != optimVariableSize
+    || previousConstraintsSize != constraintsSize
+    || previousJacobianNonZeros != jacobianNonZeros;
+
+    //Warm start from the previous solution if the problem structure is the same
+    hasWarmStart = !structureChanged && finalStatus == SUCCESS;
+    if (hasWarmStart) {
+        warmStartPrimal = primalSolution;
+        warmStartConstraintsMultipliers = constraintsMultipliers;
+        warmStartLowerBoundMultipliers = lowerBoundMultipliers;
+        warmStartUpperBoundMultipliers = upperBoundMultipliers;
+    }
+
     //resizing buffers
     qError.resize(optimVariableSize);
     hessian.setIdentity(optimVariableSize, optimVariableSize);
@@ -108,9 +210,68 @@ bool SolverData::resetOptimizationData(const yarp::sig::Vector& desiredCoM, cons
     optimum = std::numeric_limits<double>::max();
     constraintsMultipliers.resize(constraintsSize); constraintsMultipliers.setZero();
     constraintsValue.resize(constraintsSize); constraintsValue.setZero();
-    //TODO: check dimensions here
-    lowerBoundMultipliers.resize(optimVariableSize + constraintsSize); lowerBoundMultipliers.setZero();
-    upperBoundMultipliers.resize(optimVariableSize + constraintsSize); upperBoundMultipliers.setZero();
+    lowerBoundMultipliers.resize(optimVariableSize); lowerBoundMultipliers.setZero();
+    upperBoundMultipliers.resize(optimVariableSize); upperBoundMultipliers.setZero();
+
+    return true;
+}
+
+bool SolverData::computeRelativeFeetPose(bool computeJacobian)
+{
+    iDynTree::Transform world_X_left = dynamics.getWorldTransform(leftFootFrameID);
+    iDynTree::Transform world_X_right = dynamics.getWorldTransform(rightFootFrameID);
+
+    iDynTree::Position leftPosition = world_X_left.getPosition();
+    iDynTree::Position rightPosition = world_X_right.getPosition();
+    iDynTree::Rotation leftRotation = world_X_left.getRotation();
+    iDynTree::Rotation rightRotation = world_X_right.getRotation();
+    iDynTree::Rotation desiredRotation = left_X_right.getRotation();
+
+    RotationMap world_R_left(leftRotation.data());
+    RotationMap world_R_right(rightRotation.data());
+    RotationMap left_R_right_desired(desiredRotation.data());
+    Eigen::Vector3d distance(rightPosition(0) - leftPosition(0),
+                             rightPosition(1) - leftPosition(1),
+                             rightPosition(2) - leftPosition(2));
 
+    //position of the right foot w.r.t. the left foot
+    relativeFeetPose.head<3>() = world_R_left.transpose() * distance;
+
+    //orientation error: R_err = left_R_right_desired^T * left_R_right
+    //the constraint is the vector part of the corresponding quaternion (zero at the desired orientation)
+    Eigen::Matrix3d orientationError = left_R_right_desired.transpose() * world_R_left.transpose() * world_R_right;
+    Eigen::Quaterniond errorQuaternion(orientationError);
+    if (errorQuaternion.w() < 0) errorQuaternion.coeffs() *= -1;
+    Eigen::Vector3d epsilon = errorQuaternion.vec();
+    relativeFeetPose.tail<3>() = epsilon;
+
+    if (!computeJacobian) return true;
+
+    //Jacobians.
+    //Frame Jacobians map the joint velocities to the frame twist, with linear part (first 3 rows)
+    //the velocity of the frame origin and angular part (last 3 rows) expressed in the world frame.
+    //position:    d/dt left_p_right = world_R_left^T (v_r - v_l + S(p_r - p_l) w_l)
+    //orientation: d/dt epsilon = 1/2 (eta I + S(epsilon)) world_R_right^T (w_r - w_l)
+    if (!dynamics.getFrameJacobian(leftFootFrameID, leftFootJacobian)
+        || !dynamics.getFrameJacobian(rightFootFrameID, rightFootJacobian)) {
+        return false;
+    }
+    JacobianMap leftJacobian(leftFootJacobian.data(), 6, 6 + dofs);
+    JacobianMap rightJacobian(rightFootJacobian.data(), 6, 6 + dofs);
+
+    Eigen::Matrix3d positionProjection = world_R_left.transpose();
+    Eigen::Matrix3d positionAngularTerm = positionProjection * skew(distance);
+    Eigen::Matrix3d orientationProjection = 0.5 * (errorQuaternion.w() * Eigen::Matrix3d::Identity() + skew(epsilon)) * world_R_right.transpose();
+
+    for (unsigned index = 0; index < relativeFeetPoseVariables.size(); ++index) {
+        unsigned column = 6 + variableToDoFMapping[relativeFeetPoseVariables[index]];
+        relativeFeetPoseJacobian.block<3, 1>(0, index) = positionProjection * (rightJacobian.block<3, 1>(0, column) - leftJacobian.block<3, 1>(0, column))
+        + positionAngularTerm * leftJacobian.block<3, 1>(3, column);
+        relativeFeetPoseJacobian.block<3, 1>(3, index) = orientationProjection * (rightJacobian.block<3, 1>(3, column) - leftJacobian.block<3, 1>(3, column));
+    }
     return true;
 }
+
+bool SolverData::problemStructureChanged() const { return structureChanged; }
+
+bool SolverData::warmStartAvailable() const { return warmStartEnabled && hasWarmStart; }
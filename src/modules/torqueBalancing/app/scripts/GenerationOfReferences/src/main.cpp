@@ -4,8 +4,110 @@
 #include <yarp/sig/Vector.h>
 #include <yarp/math/Math.h>
 #include <cmath>
+#include <fstream>
+#include <iostream>
 #include "OptimProblem.h"
+#include "BatchOptimProblem.h"
+
+static bool readVector(const yarp::os::Value& value, yarp::sig::Vector& vector)
+{
+    if (!value.isList()) return false;
+    yarp::os::Bottle *list = value.asList();
+    vector.resize(list->size());
+    for (int i = 0; i < list->size(); i++) {
+        vector[i] = list->get(i).asDouble();
+    }
+    return true;
+}
 
+/**
+ * Batch mode: each (non empty, non comment) line of the batch file is a list of key-value pairs, e.g.
+ * (comDes (0.0 0.01 0.511)) (qDes (...)) (feetInSupport both)
+ * qDes and feetInSupport are optional: if missing the global qDes and feetInSupport parameters are used
+ */
+static int solveBatch(yarp::os::ResourceFinder& resourceFinder, const std::string& modelFile, const std::vector<std::string>& mapping)
+{
+    using namespace yarp::os;
+
+    std::string batchFileName = resourceFinder.findFileByName(resourceFinder.find("batchFile").asString());
+    std::ifstream batchFile(batchFileName.c_str());
+    if (!batchFile.is_open()) {
+        yError() << "Could not open batch file" << batchFileName;
+        return -1;
+    }
+
+    //default values
+    yarp::sig::Vector defaultJoints(0);
+    if (resourceFinder.check("qDes") && !readVector(resourceFinder.find("qDes"), defaultJoints)) {
+        yError("qDes parameter should be a list");
+        return -2;
+    }
+    std::string defaultFeetInSupport = resourceFinder.check("feetInSupport", Value("both")).asString();
+
+    std::vector<BatchOptimProblem::Target> targets;
+    std::string line;
+    unsigned lineNumber = 0;
+    while (std::getline(batchFile, line)) {
+        lineNumber++;
+        size_t firstCharacter = line.find_first_not_of(" \t\r");
+        if (firstCharacter == std::string::npos || line[firstCharacter] == '#') continue;
+
+        Property problem;
+        problem.fromString(line);
+
+        BatchOptimProblem::Target target;
+        if (!readVector(problem.find("comDes"), target.desiredCoM) || target.desiredCoM.size() != 3) {
+            yError() << "Line" << lineNumber << ": comDes is required and should be a list of 3 values";
+            return -2;
+        }
+        if (problem.check("qDes")) {
+            if (!readVector(problem.find("qDes"), target.desiredJoints)) {
+                yError() << "Line" << lineNumber << ": qDes should be a list";
+                return -2;
+            }
+        } else {
+            target.desiredJoints = defaultJoints;
+        }
+        if (!mapping.empty() && target.desiredJoints.size() != mapping.size()) {
+            yError() << "Line" << lineNumber << ": qDes size does not match jointMapping size";
+            return -2;
+        }
+        target.feetInContact = problem.check("feetInSupport", Value(defaultFeetInSupport)).asString();
+        targets.push_back(target);
+    }
+    yInfo() << "Read" << targets.size() << "problems from" << batchFileName;
+
+    BatchOptimProblem batch(resourceFinder.check("threads", Value(0), "Checking number of threads").asInt(),
+                            resourceFinder.check("linearSolver", Value(""), "Checking IpOpt linear solver").asString());
+    if (!batch.initializeModel(modelFile, mapping)) {
+        yError("Error initializing the robot model");
+        return -2;
+    }
+
+    std::vector<BatchOptimProblem::Result> results;
+    bool allSolved = batch.solve(targets, results);
+    batch.printReport(results, std::cout);
+
+    if (resourceFinder.check("batchOutput")) {
+        //one line for each problem: index success solution (rad)
+        std::string outputFileName = resourceFinder.find("batchOutput").asString();
+        std::ofstream output(outputFileName.c_str());
+        if (!output.is_open()) {
+            yError() << "Could not open output file" << outputFileName;
+            return -1;
+        }
+        for (size_t i = 0; i < results.size(); ++i) {
+            output << i << " " << (results[i].success ? 1 : 0) << " " << results[i].solution.toString(-1, 1).c_str() << "\n";
+        }
+        yInfo() << "Solutions written to" << outputFileName;
+    }
+
+    if (!allSolved) {
+        yError("Some problems could not be solved");
+        return -3;
+    }
+    return 0;
+}
 
 /**
  *
@@ -24,6 +126,10 @@ int main(int argc, char **argv) {
         std::cout<< "\t--qDes             :Desired joint positions of the robot." << std::endl;
         std::cout<< "\t--feetInSupport    :left, right or both" << std::endl;
         std::cout<< "\t--jointMapping     :[optional]ordered list of joints name which should be used in the optimization. Size must match size of qDes. If missing all joints are assumed" << std::endl;
+        std::cout<< "\t--batchFile        :[optional]file with one problem per line, e.g. (comDes (x y z)) (qDes (...)) (feetInSupport both). qDes and feetInSupport default to the values above. Problems are solved in parallel" << std::endl;
+        std::cout<< "\t--threads          :[optional]number of parallel solvers in batch mode, used only with a thread safe linear solver. Default: number of processors" << std::endl;
+        std::cout<< "\t--batchOutput      :[optional]file where the batch solutions are written" << std::endl;
+        std::cout<< "\t--linearSolver     :[optional]IpOpt linear solver in batch mode. Default: the one of the IpOpt installation. Only ma77, ma86 and ma97 are thread safe, with the others a single thread is used" << std::endl;
         return 0;
     }
 
@@ -32,6 +138,22 @@ int main(int argc, char **argv) {
     std::string filepath = resourceFinder.findFileByName(filename);
 
     yInfo() << "Robot model found in " << filepath;
+
+    if (resourceFinder.check("batchFile")) {
+        std::vector<std::string> mapping;
+        if (resourceFinder.check("jointMapping", "Checking joint mapping parameter")) {
+            Bottle *mappingBottle = resourceFinder.find("jointMapping").asList();
+            if (!mappingBottle) {
+                yError("jointMapping parameter should be a list.");
+                return -2;
+            }
+            mapping.reserve(mappingBottle->size());
+            for (int i = 0; i < mappingBottle->size(); i++) {
+                mapping.push_back(mappingBottle->get(i).asString());
+            }
+        }
+        return solveBatch(resourceFinder, filepath, mapping);
+    }
     
     //read desired CoM
     if (!resourceFinder.check("comDes", "Checking desired CoM parameter")) {
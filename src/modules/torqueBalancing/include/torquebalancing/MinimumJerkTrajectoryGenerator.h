@@ -21,21 +21,19 @@
 #include <Eigen/Core>
 
 
-namespace iCub {
-    namespace ctrl {
-        class minJerkTrajGen;
-    }
-}
-
-namespace yarp {
-    namespace sig {
-        class Vector;
-    }
-}
-
 namespace codyco {
     namespace torquebalancing {
         
+        /** Minimum jerk trajectory from the current state to the set point.
+         *
+         * Each call to computeReference plans a quintic polynomial from the current
+         * position, velocity and acceleration of the trajectory (or from currentValue at rest,
+         * if initFilter is true) to the set point, reached with zero velocity and acceleration
+         * after the duration specified in initializeTimeParameters.
+         * The polynomial is evaluated at the time passed to updateTrajectoryForCurrentTime,
+         * so the output does not depend on the jitter of the calling thread.
+         * No memory is allocated after construction.
+         */
         class MinimumJerkTrajectoryGenerator : public ReferenceFilter {
         public:
             MinimumJerkTrajectoryGenerator(int dimension);
@@ -47,6 +45,9 @@ namespace codyco {
             virtual bool initializeTimeParameters(double sampleTime,
                                                   double duration);
             
+            /** @param initialTime time at which the trajectory starts. If negative the trajectory
+             * starts at the first call of updateTrajectoryForCurrentTime.
+             */
             virtual bool computeReference(const Eigen::VectorXd& setPoint,
                                           const Eigen::VectorXd& currentValue,
                                           double initialTime = 0.0,
@@ -61,16 +62,20 @@ namespace codyco {
         private:
             
             int m_size;
-            iCub::ctrl::minJerkTrajGen* m_minimumJerkGenerator;
             Eigen::VectorXd m_computedPosition;
             Eigen::VectorXd m_computedVelocity;
             Eigen::VectorXd m_computedAcceleration;
             
             double m_sampleTime;
             double m_duration;
-            
-            yarp::sig::Vector* m_yarpReference;
-            yarp::sig::Vector* m_yarpInitialValue;
+
+            Eigen::VectorXd m_setPoint;
+            //Coefficients of the polynomial (one row for each element, columns in increasing order of the power of time)
+            Eigen::MatrixXd m_coefficients;
+            double m_trajectoryStartTime;
+            double m_trajectoryDuration;
+            bool m_trajectoryStartPending;
+            bool m_trajectoryValid;
         };
     }
 }
@@ -83,11 +83,12 @@ namespace codyco {
             TorqueBalancingModuleCommandStart,
             TorqueBalancingModuleCommandStop,
             TorqueBalancingModuleCommandQuit,
-            TorqueBalancingModuleCommandHelp
+            TorqueBalancingModuleCommandHelp,
+            TorqueBalancingModuleCommandTiming
 
         } TorqueBalancingModuleCommand;
 
-        static const int TorqueBalancingModuleCommandSize = 4;
+        static const int TorqueBalancingModuleCommandSize = 5;
 
         const paramHelp::CommandDescription TorqueBalancingModuleCommandDescriptions[]  =
         {
@@ -95,6 +96,7 @@ namespace codyco {
             paramHelp::CommandDescription("stop", TorqueBalancingModuleCommandStop, "Stop the control actions"),
             paramHelp::CommandDescription("help", TorqueBalancingModuleCommandHelp, "Get instructions about how to communicate with this module"),
             paramHelp::CommandDescription("quit", TorqueBalancingModuleCommandQuit, "Stop the control actions and quit the module"),
+            paramHelp::CommandDescription("timing", TorqueBalancingModuleCommandTiming, "Get the timing statistics of the control loop in the last 5 seconds"),
         };
     }
 }
@@ -0,0 +1,123 @@
+/**
+ * Copyright (C) 2016 CoDyCo
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found at
+ * http://www.robotcub.org/icub/license/gpl.txt
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+#ifndef QPSOLVER_H
+#define QPSOLVER_H
+
+#include <Eigen/Core>
+
+namespace codyco {
+    namespace torquebalancing {
+
+        /** @brief Limits on the work done by a single QPSolver::solve call
+         */
+        struct QPSolverSettings {
+            QPSolverSettings();
+
+            int maxIterations; /*!< maximum number of iterations of a solve. Default 100 */
+            double maxTime; /*!< maximum duration of a solve in seconds, 0 for no limit. Default 0 */
+            double absoluteTolerance; /*!< absolute tolerance on the residuals. Default 1e-3 */
+            double relativeTolerance; /*!< relative tolerance on the residuals. Default 1e-3 */
+            double rho; /*!< ADMM penalty parameter. Default 0.1 */
+            double sigma; /*!< regularization of the linear system. Default 1e-6 */
+            double relaxation; /*!< ADMM over-relaxation parameter in (0, 2). Default 1.6 */
+        };
+
+        enum QPSolverStatus {
+            QPSolverStatusSolved, /*!< the residuals are below the tolerances */
+            QPSolverStatusMaxIterations, /*!< the iterations budget ran out before convergence */
+            QPSolverStatusMaxTime, /*!< the time budget ran out before convergence */
+            QPSolverStatusInvalidProblem /*!< wrong sizes, or the hessian is not positive definite */
+        };
+
+        /** @brief Dense convex quadratic program solver for small problems in a control loop.
+         *
+         * Solves
+         * \f[ \min_x \frac{1}{2} x^\top H x + g^\top x \quad s.t. \quad l \leq C x \leq u \f]
+         * with the alternating direction method of multipliers (as in OSQP), with H positive definite.
+         * Bounds can be set to +/- infinity (e.g. std::numeric_limits<double>::max()).
+         *
+         * All the memory is allocated by resize(): solve() never allocates, and its duration is bounded
+         * by the iterations and time budgets of the settings.
+         * Consecutive solves of problems of the same size are warm started from the previous solution
+         * (also if it did not converge), so slowly varying problems usually need a few iterations.
+         */
+        class QPSolver {
+        public:
+            /** Constructor.
+             * @param maxVariables maximum number of variables
+             * @param maxConstraints maximum number of constraints
+             */
+            QPSolver(int maxVariables = 0, int maxConstraints = 0);
+
+            /** Allocates the memory for problems up to the specified sizes. It resets the warm start.
+             * @param maxVariables maximum number of variables
+             * @param maxConstraints maximum number of constraints
+             */
+            void resize(int maxVariables, int maxConstraints);
+
+            const QPSolverSettings& settings() const;
+            void setSettings(const QPSolverSettings& settings);
+
+            /** Solves the problem. The sizes must not exceed the ones passed to resize().
+             *
+             * @param hessian n x n positive definite matrix H
+             * @param gradient n vector g
+             * @param constraints m x n matrix C
+             * @param lowerBounds m vector l
+             * @param upperBounds m vector u
+             * @param[out] solution n vector. Last iterate if the solver did not converge. Not modified if the problem is invalid
+             * @return the outcome of the solve
+             */
+            QPSolverStatus solve(const Eigen::Ref<const Eigen::MatrixXd>& hessian,
+                                 const Eigen::Ref<const Eigen::VectorXd>& gradient,
+                                 const Eigen::Ref<const Eigen::MatrixXd>& constraints,
+                                 const Eigen::Ref<const Eigen::VectorXd>& lowerBounds,
+                                 const Eigen::Ref<const Eigen::VectorXd>& upperBounds,
+                                 Eigen::Ref<Eigen::VectorXd> solution);
+
+            /** Discards the previous solution: the next solve starts from zero
+             */
+            void resetWarmStart();
+
+            /** Returns the number of iterations performed by the last solve
+             * @return the number of iterations of the last solve
+             */
+            int iterations() const;
+
+        private:
+            bool factorize(int variables);
+            void solveFactorized(int variables, Eigen::Ref<Eigen::VectorXd> rhs);
+
+            QPSolverSettings m_settings;
+            int m_maxVariables;
+            int m_maxConstraints;
+            int m_warmStartVariables; /*!< sizes of the problem of the warm start, -1 if not available */
+            int m_warmStartConstraints;
+            int m_iterations;
+
+            Eigen::MatrixXd m_kktMatrix; /*!< maxVariables x maxVariables. Cholesky factor of H + sigma I + rho C'C */
+            Eigen::VectorXd m_x; /*!< maxVariables */
+            Eigen::VectorXd m_xTilde; /*!< maxVariables */
+            Eigen::VectorXd m_z; /*!< maxConstraints */
+            Eigen::VectorXd m_zTilde; /*!< maxConstraints */
+            Eigen::VectorXd m_y; /*!< maxConstraints */
+            Eigen::VectorXd m_variablesBuffer; /*!< maxVariables */
+            Eigen::VectorXd m_constraintsBuffer; /*!< maxConstraints */
+        };
+    }
+}
+
+#endif /* end of include guard: QPSOLVER_H */
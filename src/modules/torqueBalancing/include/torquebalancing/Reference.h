@@ -27,7 +27,7 @@ namespace codyco {
         class ReferenceDelegate {
         public:
             virtual ~ReferenceDelegate();
-            virtual void referenceWillChangeValue(const Reference&, const Eigen::VectorXd& newValue);
+            virtual void referenceWillChangeValue(const Reference&, const Eigen::Ref<const Eigen::VectorXd>& newValue);
             virtual void referenceDidChangeValue(const Reference&);
             virtual bool operator==(const ReferenceDelegate&) const;
             virtual bool operator<(const ReferenceDelegate&) const;
@@ -38,6 +38,10 @@ namespace codyco {
          * The size is passed at construction and cannot be changed. It can be obtained by calling valueSize() function.
          * The content of this object which is not valid is not guaranteed to contain meaningful values (i.e. it can be garbage, so do not use it).
          * This class is thread-safe for setting and reading values.
+         *
+         * Values are published through a double buffer with a sequence number:
+         * writers are serialized among themselves, while readers never lock and
+         * never allocate, and always get a value written by a single call to setValue.
          */
         class Reference
         {
@@ -50,14 +54,19 @@ namespace codyco {
             bool setUpReaderPort(std::string portName);
             bool tearDownReaderPort();
             
-            /** Return the current value.
+            /** Copy the current value in the storage provided by the caller.
              * Before using the value is some computation check if it is valid or not.
-             * @return the current value
+             * The copy is never interleaved with a concurrent setValue.
+             *
+             * @param[out] value storage of valueSize() elements where to copy the current value
+             * @param[out] sequenceNumber if not NULL, filled with the number of values set until the copied one
+             * @param[out] timestamp if not NULL, filled with the time (yarp::os::Time::now()) at which the copied value was set
              */
-            const Eigen::VectorXd& value() const;
-            
+            void readValue(Eigen::Ref<Eigen::VectorXd> value, unsigned long *sequenceNumber = 0, double *timestamp = 0) const;
+
             /** Sets the value for the current reference.
              * The state of the reference automatically switch to active.
+             * Values of size different from valueSize() are discarded.
              *
              * @param _value value of the new reference to be saved.
              */
@@ -82,8 +91,13 @@ namespace codyco {
             int valueSize() const;
             
         private:
-            Eigen::VectorXd m_value;
-            bool m_valid;
+            /** m_values[(m_sequence / 2) % 2] is the current value.
+             * m_sequence is odd while setValue is writing the other element.
+             */
+            Eigen::VectorXd m_values[2];
+            double m_timestamps[2];
+            volatile long m_sequence;
+            volatile long m_valid;
             const int m_valueSize;
 
             void * m_implementation;
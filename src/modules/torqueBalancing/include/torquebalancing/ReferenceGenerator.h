@@ -17,6 +17,7 @@
 #ifndef REFERENCEGENERATOR_H
 #define REFERENCEGENERATOR_H
 
+#include <ctrlLibRT/tripleBuffer.h>
 #include <yarp/os/RateThread.h>
 
 #include <Eigen/Core>
@@ -43,6 +44,29 @@ namespace codyco {
         class ReferenceFilter;
         class Reference;
 
+        /** Gains of the PID of a ReferenceGenerator.
+         */
+        struct ReferenceGeneratorGains {
+            ReferenceGeneratorGains(int signalSize);
+
+            Eigen::VectorXd proportionalGains;
+            Eigen::VectorXd derivativeGains;
+            Eigen::VectorXd integralGains;
+            double integralLimit; /*!< absolute value of the bound on the integral term */
+        };
+
+        /** Variables computed by a ReferenceGenerator in a single step.
+         */
+        struct ReferenceGeneratorMonitoredVariables {
+            ReferenceGeneratorMonitoredVariables(int signalSize, int referenceSize);
+
+            Eigen::VectorXd computedReference; /*!< output of the generator */
+            Eigen::VectorXd error; /*!< instantaneous error */
+            Eigen::VectorXd errorIntegral; /*!< integral of the error */
+            Eigen::VectorXd actualReference; /*!< (filtered) reference of the signal */
+            Eigen::VectorXd signal; /*!< value of the signal read from the input reader */
+        };
+
         //TODO: change name to PIDController or something else
         /** This class is responsible of generating a proper reference signal.
          *
@@ -51,6 +75,9 @@ namespace codyco {
          * It then writes the computed reference to the reference object.
          *
          * This class is thread-safe, i.e., every access to variables are guarded by a mutex.
+         * The gains and the monitored variables do not use the mutex of the generator: the new gains
+         * are adopted at the beginning of the next step and the monitored variables are published
+         * at the end of each step, so tuning and monitoring never wait for a step to finish.
          */
         class ReferenceGenerator: public ::yarp::os::RateThread
         {
@@ -76,6 +103,14 @@ namespace codyco {
             virtual void threadRelease();
             virtual void run();
 
+            /** Computes and writes the output reference at the specified time.
+             *
+             * This is the body of run(). It can be called directly to step the generator
+             * synchronously from another loop: in this case the thread must not be started.
+             * @param now current time (yarp::os::Time::now())
+             */
+            void step(double now);
+
 #pragma mark - Getter and setter
 
             ReferenceGeneratorInputReader& inputReader();
@@ -90,6 +125,16 @@ namespace codyco {
 
             const ReferenceFilter* referenceFilter();
 
+            /** Use the derivatives of the filtered reference in the controller.
+             *
+             * If enabled, the first derivative computed by the reference filter is used as the
+             * reference of the signal derivative, and the second derivative as the feedforward term,
+             * in place of the values set with setSignalDerivativeReference and setSignalFeedForward.
+             * This is meaningful only if the output of the controller is the second derivative of the signal.
+             * @param enabled true to use the filter derivatives. Default to false.
+             */
+            void setReferenceFilterDerivativesEnabled(bool enabled);
+
 
             /** Returns the current signal reference used by this controller
              * @return the current signal reference
@@ -168,7 +213,7 @@ namespace codyco {
              *
              * @return the used proportional gains
              */
-            const Eigen::VectorXd& proportionalGains();
+            Eigen::VectorXd proportionalGains();
 
             /** Sets the new proportional gains to be used in the trajectory generation
              *
@@ -180,7 +225,7 @@ namespace codyco {
              *
              * @return the used derivative gains
              */
-            const Eigen::VectorXd& derivativeGains();
+            Eigen::VectorXd derivativeGains();
 
             /** Sets the new derivative gains to be used in the trajectory generation
              *
@@ -192,7 +237,7 @@ namespace codyco {
              *
              * @return the used integral gains
              */
-            const Eigen::VectorXd& integralGains();
+            Eigen::VectorXd integralGains();
 
             /** Sets the new integral gains to be used in the trajectory generation
              *
@@ -229,24 +274,39 @@ namespace codyco {
                              const Eigen::VectorXd& integralGains,
                              double integralLimit = NAN);
 
+            /** Returns the last gains set for this controller.
+             *
+             * @return the gains of the controller
+             */
+            ReferenceGeneratorGains gains();
+
             /** Returns the computed reference signal by this controller
              *
              * @return the output of this controller
              */
-            const Eigen::VectorXd& computedReference();
+            Eigen::VectorXd computedReference();
 
             /** Returns the instantaneous error between the signal reference and its measured value.
              * @return the instantaneous error
              */
-            const Eigen::VectorXd& instantaneousError();
+            Eigen::VectorXd instantaneousError();
 
             /** Returns the integral of the error from the activation time to now
              * @return the integral of the error
              */
-            const Eigen::VectorXd& errorIntegral();
+            Eigen::VectorXd errorIntegral();
+
+            /** Reads the variables computed in the last step.
+             *
+             * All the variables belong to the same step.
+             * @param[out] variables the monitored variables
+             */
+            void readMonitoredVariables(ReferenceGeneratorMonitoredVariables& variables);
 
         private:
 
+            void publishGains();
+
             void limitIntegral(const Eigen::Ref<Eigen::VectorXd>& integral, Eigen::Ref<Eigen::VectorXd> limitedIntegral);
 
             const std::string m_name;
@@ -254,6 +314,7 @@ namespace codyco {
             Reference& m_outputReference;
             ReferenceGeneratorInputReader& m_reader;
             ReferenceFilter* m_referenceFilter;
+            bool m_referenceFilterDerivativesEnabled;
 
             Eigen::VectorXd m_computedReference;
             Eigen::VectorXd m_integralTerm;
@@ -275,8 +336,19 @@ namespace codyco {
             //Utility variables
             Eigen::VectorXd m_currentSignalValue;
             Eigen::VectorXd m_actualReference;
+            Eigen::VectorXd m_actualDerivativeReference;
+            Eigen::VectorXd m_actualFeedForward;
 
             yarp::os::Mutex m_mutex;
+
+            //Gains set by the clients (guarded by m_gainsMutex) and adopted by step()
+            yarp::os::Mutex m_gainsMutex;
+            ReferenceGeneratorGains m_clientGains;
+            iCub::ctrl::realTime::TripleBuffer<ReferenceGeneratorGains> m_gains;
+
+            //Variables published by step(). The mutex serializes the readers
+            yarp::os::Mutex m_monitoredVariablesMutex;
+            iCub::ctrl::realTime::TripleBuffer<ReferenceGeneratorMonitoredVariables> m_monitoredVariables;
         };
 
         /**
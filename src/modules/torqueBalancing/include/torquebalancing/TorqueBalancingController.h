@@ -18,6 +18,10 @@
 #define TORQUEBALANCINGCONTROLLER_H
 
 #include "config.h"
+#include "DynamicConstraint.h"
+#include "QPSolver.h"
+#include <ctrlLibRT/loopTiming.h>
+#include <ctrlLibRT/tripleBuffer.h>
 #include <yarp/os/RateThread.h>
 #include <yarp/os/Mutex.h>
 #include <wbi/wbiUtil.h>
@@ -27,7 +31,8 @@
 #include <Eigen/SVD>
 #include <Eigen/LU>
 
-#include <map>
+#include <string>
+#include <vector>
 
 #include <yarp/os/BufferedPort.h>
 #include <yarp/sig/Vector.h>
@@ -39,8 +44,6 @@ namespace wbi {
 
 namespace codyco {
     namespace torquebalancing {
-        class DynamicContraint;
-
         //Move this somewhere else (and make this more generic)
         class TorqueBalancingController;
         class ControllerDelegate {
@@ -51,6 +54,45 @@ namespace codyco {
         };
 
         class ControllerReferences;
+        class ReferenceGenerator;
+
+        /** @brief Gains and limits used by the controller.
+         *
+         * The parameters are set by the clients as a whole and adopted by the controller
+         * at the beginning of a cycle, so a cycle never uses a partially updated set.
+         */
+        struct TorqueBalancingControllerParameters {
+            TorqueBalancingControllerParameters(int actuatedDOFs);
+
+            double centroidalMomentumGain;
+            Eigen::VectorXd impedanceGains; /*!< actuatedDOFs */
+            Eigen::VectorXd torqueSaturationLimit; /*!< actuatedDOFs */
+        };
+
+        /** @brief Limits of the contact wrenches enforced by the force distribution QP.
+         *
+         * The limits are expressed in the frame of each contact, whose z axis is the contact normal,
+         * and are the same for all the contacts.
+         */
+        struct ContactForceLimits {
+            ContactForceLimits();
+
+            double frictionCoefficient; /*!< static friction coefficient (the cone is approximated by a pyramid). Default 1/3 */
+            double torsionalFrictionCoefficient; /*!< maximum ratio between the torque about the normal and the normal force (m). Default 2/150 */
+            double minimumNormalForce; /*!< N. Default 10 */
+            double centerOfPressureLimits[4]; /*!< xMin, xMax, yMin, yMax of the center of pressure in the contact frame (m). Default -0.07, 0.12, -0.045, 0.05 */
+            double regularization; /*!< weight of the distance from the unconstrained forces w.r.t. the error on the desired momentum derivative. Default 1e-2 */
+        };
+
+        /** @brief Variables computed by the controller in a single cycle
+         */
+        struct TorqueBalancingControllerMonitoredVariables {
+            TorqueBalancingControllerMonitoredVariables(int actuatedDOFs);
+
+            Eigen::VectorXd desiredFeetForces; /*!< 12 (l_sole and r_sole wrenches, zero if not registered) */
+            Eigen::VectorXd desiredContactForces; /*!< 6 x registered contacts, in registration order. Zero for the inactive contacts */
+            Eigen::VectorXd outputTorques; /*!< actuatedDOFs */
+        };
         
         /** @brief Represents the actual controller
          *
@@ -91,12 +133,26 @@ namespace codyco {
             /** Returns the gains used in the impedance control
              * @return the gains for the impedance control
              */
-            const Eigen::VectorXd& impedanceGains();
+            Eigen::VectorXd impedanceGains();
             
             /** Sets the new gains to be used in the impedance control
              * @param impedanceGains the new gains for the impedance control
              */
-            void setImpedanceGains(Eigen::VectorXd& impedanceGains);
+            void setImpedanceGains(const Eigen::VectorXd& impedanceGains);
+
+            /** Returns the last parameters set by the clients
+             * @return the parameters of the controller
+             */
+            TorqueBalancingControllerParameters parameters();
+
+            /** Sets all the parameters of the controller at once.
+             *
+             * The new parameters are used starting from the next cycle.
+             * This function never waits for the control cycle to finish.
+             * @param parameters the new parameters. Only the absolute value of the saturation limit is considered.
+             * @return true if the parameters have the right size. False otherwise (and the parameters are ignored)
+             */
+            bool setParameters(const TorqueBalancingControllerParameters& parameters);
             
             /** Sets the state of the controller.
              *
@@ -118,12 +174,12 @@ namespace codyco {
             /** Sets the torque saturation limits for the actuators
              * @param newSaturation new value for the saturation limit
              */
-            void setTorqueSaturationLimit(Eigen::VectorXd& newSaturation);
+            void setTorqueSaturationLimit(const Eigen::VectorXd& newSaturation);
             
             /** Returns the current torque saturation limits
              * @return the saturation limits
              */
-            const Eigen::VectorXd& torqueSaturationLimit();
+            Eigen::VectorXd torqueSaturationLimit();
 
             /** Sets the current delegate. NULL to unset it
              * 
@@ -131,14 +187,84 @@ namespace codyco {
              */
             void setDelegate(ControllerDelegate *delegate);
 
-            /** Initialize the rigid constraints 
+            /** Initialize the rigid constraints
              *
+             * Registers one contact for each frame, initially active. Only the registered contacts
+             * can be activated or deactivated afterwards. The frames are resolved to their indices
+             * and all the buffers are sized for the registered contacts here, so the control loop
+             * never looks up a frame by name nor allocates memory when the contacts change.
              * @note this function must be called before the initialization of the thread
              * to take effect
-             * @param constraintsLinkName the list of 
+             * @param constraintsLinkName the list of frames in contact with the environment
+             * @return true if all the frames exist and are not repeated. False otherwise
              */
             bool setInitialConstraintSet(const std::vector<std::string> &constraintsLinkName);
 
+            /** Initialize the rigid constraints, specifying the initial state of each of them
+             *
+             * Same as setInitialConstraintSet(constraintsLinkName), but the contacts whose
+             * initiallyActive element is false are registered as inactive: they are not used
+             * until they are activated.
+             * @param constraintsLinkName the list of frames that can be in contact with the environment
+             * @param initiallyActive for each frame, true if it is in contact at startup
+             * @return true if all the frames exist and are not repeated and the two lists have the same size. False otherwise
+             */
+            bool setInitialConstraintSet(const std::vector<std::string> &constraintsLinkName, const std::vector<bool> &initiallyActive);
+
+            /** Steps the specified reference generators at the beginning of each controller cycle.
+             *
+             * The generators are stepped in the given order, all with the same time, before
+             * reading the references, so their output is used in the same cycle.
+             * The threads of the generators must not be started.
+             * @note this function must be called before the initialization of the thread
+             * @param generators the reference generators to be stepped by the controller
+             */
+            void setSynchronousReferenceGenerators(const std::vector<ReferenceGenerator*> &generators);
+
+            /** Enables the distribution of the contact forces with a quadratic program.
+             *
+             * The contact forces are normally the ones giving the desired rate of change of the momentum
+             * with the minimum torques, computed with pseudoinverses, which do not respect the friction
+             * cones, the center of pressure limits and the unilaterality of the contacts.
+             * If enabled, at each cycle these forces are projected on the ones respecting the limits,
+             * by minimizing the error on the momentum derivative plus a regularization term.
+             * The QP is warm started from the previous cycle and its work is bounded by the solver settings:
+             * if it does not converge in the budget the controller uses the unconstrained forces for that cycle.
+             * @note this function must be called before the initialization of the thread
+             * @param enabled true to enable the QP
+             * @param limits the limits of the contact wrenches
+             * @param settings the settings (and budgets) of the QP solver
+             */
+            void setForceDistributionQP(bool enabled, const ContactForceLimits& limits, const QPSolverSettings& settings);
+
+            /** Returns the statistics of the force distribution QP since the last call of this method.
+             * The solve time includes the construction of the problem.
+             * @param[out] meanSolveTime mean solve time in seconds
+             * @param[out] maximumSolveTime maximum solve time in seconds
+             * @param[out] meanIterations mean number of iterations
+             * @param[out] fallbacks number of solves that did not converge (unconstrained forces used)
+             * @return the number of samples
+             */
+            int forceDistributionStatistics(double &meanSolveTime, double &maximumSolveTime, double &meanIterations, int &fallbacks);
+
+            /** Returns the statistics of the age of the desired CoM acceleration used by the controller
+             * (time elapsed from its computation to its use) since the last call of this method.
+             * @param[out] mean mean age in seconds
+             * @param[out] stdDeviation standard deviation of the age in seconds
+             * @param[out] maximum maximum age in seconds
+             * @return the number of samples
+             */
+            int referenceLatencyStatistics(double &mean, double &stdDeviation, double &maximum);
+
+            /** Computes the timing statistics of the control loop (period and duration of each cycle,
+             * late cycles and overruns) since the last call of this method.
+             *
+             * The control loop records its timing without locks: this method never waits for the control cycle to finish.
+             * @note only one thread at a time can call this method
+             * @param[out] statistics the timing statistics
+             */
+            void loopTimingStatistics(iCub::ctrl::realTime::LoopTimingStatistics &statistics);
+
             /** Adds an additional constraint to the dynamics equation
              *
              * Constraint is described at acceleration level, i.e.
@@ -147,7 +273,7 @@ namespace codyco {
              * written in a frame defined as:
              * - origin at the base frame
              * - orientation to coincide with the world frame orientation
-             * @param frameName the name of the frame
+             * @param frameName the name of the frame. It must be one of the frames passed to setInitialConstraintSet
              * @param smooth true if the transition should be smooth (non smooth not supported yet).
              * @return true if the constraint is successfully added
              */
@@ -163,51 +289,112 @@ namespace codyco {
 
 #pragma mark - Monitorable variables
             
-            const Eigen::VectorXd& desiredFeetForces();
+            Eigen::VectorXd desiredFeetForces();
             
-            const Eigen::VectorXd& outputTorques();
+            Eigen::VectorXd outputTorques();
+
+            /** Reads the variables computed in the last cycle.
+             *
+             * All the variables belong to the same cycle.
+             * This function never waits for the control cycle to finish.
+             * @param[out] variables the monitored variables
+             */
+            void readMonitoredVariables(TorqueBalancingControllerMonitoredVariables& variables);
 
             
         private:
+            void controlCycle();
             void readReferences();
             bool jointsInLimitRange();
             bool updateRobotState();
+            void updateActiveContacts();
+            int contactIndex(const std::string& frameName) const;
             void computeContactForces(const Eigen::Ref<Eigen::VectorXd>& desiredCOMAcceleration, Eigen::Ref<Eigen::VectorXd> desiredContactForces);
-            void computeTorques(const Eigen::Ref<Eigen::VectorXd>& desiredContactForces, Eigen::Ref<Eigen::VectorXd> torques);
+            void computeTorques(Eigen::Ref<Eigen::VectorXd> desiredContactForces, Eigen::Ref<Eigen::VectorXd> torques);
+            bool distributeContactForces(Eigen::Ref<Eigen::VectorXd> contactForces);
             void writeTorques();
+            void adoptParameters(const TorqueBalancingControllerParameters& parameters);
+            void publishParameters();
             
             wbi::wholeBodyInterface& m_robot;
             int m_actuatedDOFs;
             double m_dynamicsTransitionTime;
 
             ControllerDelegate *m_delegate;
+            std::vector<ReferenceGenerator*> m_synchronousReferenceGenerators;
             
             yarp::os::Mutex m_mutex;
+            iCub::ctrl::realTime::LoopTimingRecorder m_loopTiming;
             
             bool m_active;
             bool m_checkJointLimits;
             
             //configuration-time constants
-            int m_leftFootLinkID;
-            int m_rightFootLinkID;
             int m_centerOfMassLinkID;
 
-            typedef std::map<std::string, class DynamicConstraint> ConstraintsMap;
-            ConstraintsMap m_activeConstraints;
+            /** @brief A contact registered by setInitialConstraintSet */
+            struct ContactConstraint {
+                ContactConstraint(const std::string& frameName, int linkID);
+
+                std::string frameName;
+                int linkID; /*!< index of the frame in the robot interface */
+                DynamicConstraint constraint;
+                Eigen::Matrix<double, 7, 1> position; /*!< 7 (position and axis-angle orientation of the frame) */
+            };
+
+            //Registered contacts and indices (in m_contacts) of the contacts used in the current cycle.
+            //The active contacts are packed in the first 6 x m_activeContacts.size() rows of the contact buffers
+            std::vector<ContactConstraint> m_contacts;
+            std::vector<int> m_activeContacts;
+            int m_leftFootContact; /*!< index of l_sole in m_contacts or -1 (monitored feet forces) */
+            int m_rightFootContact; /*!< index of r_sole in m_contacts or -1 (monitored feet forces) */
+
+            //Force distribution QP. The buffers are sized for all the registered contacts
+            bool m_forceDistributionQP;
+            ContactForceLimits m_contactForceLimits;
+            QPSolver m_forceDistributionSolver;
+            std::vector<int> m_forceDistributionContacts; /*!< active contacts of the last solve (warm start) */
+            Eigen::MatrixXd m_forceDistributionHessian; /*!< (6 x contacts) x (6 x contacts) */
+            Eigen::VectorXd m_forceDistributionGradient; /*!< (6 x contacts) */
+            Eigen::MatrixXd m_forceDistributionConstraints; /*!< (11 x contacts) x (6 x contacts) */
+            Eigen::VectorXd m_forceDistributionLowerBounds; /*!< (11 x contacts) */
+            Eigen::VectorXd m_forceDistributionUpperBounds; /*!< (11 x contacts) */
+            Eigen::VectorXd m_forceDistributionSolution; /*!< (6 x contacts) */
+            Eigen::VectorXd m_forceDistributionContactForces; /*!< (6 x contacts) */
+            Eigen::VectorXd m_forceDistributionNullSpaceForces; /*!< (6 x contacts) */
+            Eigen::VectorXd m_forceDistributionTorques; /*!< actuatedDOFs */
+            int m_forceDistributionSamples;
+            double m_forceDistributionTimeSum;
+            double m_forceDistributionTimeMaximum;
+            double m_forceDistributionIterationsSum;
+            int m_forceDistributionFallbacks;
 
             //References
             ControllerReferences& m_references;
+            int m_referenceLatencySamples;
+            double m_referenceLatencySum;
+            double m_referenceLatencySquaredSum;
+            double m_referenceLatencyMaximum;
             Eigen::VectorXd m_desiredJointsConfiguration; /*!< actuatedDOFs */
             
             //Gains
             double m_centroidalMomentumGain;
             Eigen::VectorXd m_impedanceGains; /*!< actuatedDOFs */
 
+            //Parameters set by the clients (guarded by m_parametersMutex) and adopted by run()
+            yarp::os::Mutex m_parametersMutex;
+            TorqueBalancingControllerParameters m_clientParameters;
+            iCub::ctrl::realTime::TripleBuffer<TorqueBalancingControllerParameters> m_parameters;
+
+            //Variables published by run() at the end of each cycle. The mutex serializes the readers
+            yarp::os::Mutex m_monitoredVariablesMutex;
+            iCub::ctrl::realTime::TripleBuffer<TorqueBalancingControllerMonitoredVariables> m_monitoredVariables;
+
             //references
             Eigen::Vector3d m_desiredCOMAcceleration;
             Eigen::VectorXd m_desiredFeetForces; /*!< 12 */
             Eigen::VectorXd m_desiredCentroidalMomentum;  /*!< 6 */
-            Eigen::VectorXd m_desiredContactForces; /*!< 12 (Vectorisation of contact wrenches at feet: left_wrench and right_wrench) */
+            Eigen::VectorXd m_desiredContactForces; /*!< 6 x contacts (Vectorisation of the wrenches of the active contacts) */
 
             //state of the robot
             Eigen::VectorXd m_jointPositions;  /*!< totalDOFs */
@@ -217,8 +404,6 @@ namespace codyco {
             wbi::Frame m_world2BaseFrame;
             Eigen::VectorXd m_world2BaseFrameSerialization;
             Eigen::Vector3d m_centerOfMassPosition;
-            Eigen::VectorXd m_rightFootPosition; /*!< 7 */
-            Eigen::VectorXd m_leftFootPosition; /*!< 7 */
 
             //Limits
             Eigen::VectorXd m_minJointLimits; /* actuatedDOFs */
@@ -226,8 +411,9 @@ namespace codyco {
             Eigen::VectorXd m_torqueSaturationLimit; /* actuatedDOFs */
             
             //Jacobians
-            Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> m_contactsJacobian; /*!< (6x2) x totalDOFs (forces and torques for feet)*/
-            Eigen::VectorXd m_contactsDJacobianDq; /*!< (6x2) */
+            typedef Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> ContactsJacobian;
+            ContactsJacobian m_contactsJacobian; /*!< (6 x contacts) x totalDOFs (forces and torques for each contact)*/
+            Eigen::VectorXd m_contactsDJacobianDq; /*!< (6 x contacts) */
             
             //Kinematic and dynamic variables
             Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic> m_massMatrix; /*!< totalDOFs x totalDOFs */
@@ -236,20 +422,20 @@ namespace codyco {
             Eigen::VectorXd m_centroidalMomentum; /*!< 6 */
             
             //variables used in computation.
-            Eigen::MatrixXd m_centroidalForceMatrix; /*!< 6 x 12 */
+            Eigen::MatrixXd m_centroidalForceMatrix; /*!< 6 x (6 x contacts) */
             Eigen::VectorXd m_gravityForce; /*!< 6 */
             Eigen::MatrixXd m_torquesSelector; /*!< totalDOFs x actuatedDOFs */
             //pseuo inverses
-            Eigen::MatrixXd m_pseudoInverseOfJcMInvSt; /*!< actuatedDOFs x (6x2) */
+            Eigen::MatrixXd m_pseudoInverseOfJcMInvSt; /*!< actuatedDOFs x (6 x contacts) */
             Eigen::MatrixXd m_nullSpaceProjectorOfJcMInvSt; /*!< actuatedDOFs x actuatedDOFs */
 //            Eigen::MatrixXd m_pseudoInverseOfJcBase; /*!< 6 x 12 */
-            Eigen::MatrixXd m_pseudoInverseOfCentroidalForceMatrix; /*!< 12 x 6 */
-            Eigen::MatrixXd m_nullSpaceOfCentroidalForceMatrix; /*!< 12 x 12 */
-            Eigen::MatrixXd m_pseudoInverseOfTauN0_f; /*!< 12 x actuatedDoFs */
-            Eigen::JacobiSVD<Eigen::MatrixXd::PlainObject> m_svdDecompositionOfJcMInvSt; /*!< (6x2) x actuatedDOFs */
+            Eigen::MatrixXd m_pseudoInverseOfCentroidalForceMatrix; /*!< (6 x contacts) x 6 */
+            Eigen::MatrixXd m_nullSpaceOfCentroidalForceMatrix; /*!< (6 x contacts) x (6 x contacts) */
+            Eigen::MatrixXd m_pseudoInverseOfTauN0_f; /*!< (6 x contacts) x actuatedDoFs */
+            Eigen::JacobiSVD<Eigen::MatrixXd::PlainObject> m_svdDecompositionOfJcMInvSt; /*!< (6 x contacts) x actuatedDOFs */
             Eigen::JacobiSVD<Eigen::MatrixXd::PlainObject> m_svdDecompositionOfJcBase; /*!< 12 x 6 */
-            Eigen::JacobiSVD<Eigen::MatrixXd::PlainObject> m_svdDecompositionOfCentroidalForceMatrix; /*!< 6 x 12 */
-            Eigen::JacobiSVD<Eigen::MatrixXd::PlainObject> m_svdDecompositionOfTauN0_f; /*!< actuatedDoFs x 12 */
+            Eigen::JacobiSVD<Eigen::MatrixXd::PlainObject> m_svdDecompositionOfCentroidalForceMatrix; /*!< 6 x (6 x contacts) */
+            Eigen::JacobiSVD<Eigen::MatrixXd::PlainObject> m_svdDecompositionOfTauN0_f; /*!< actuatedDoFs x (6 x contacts) */
             Eigen::PartialPivLU<Eigen::MatrixXd::PlainObject> m_luDecompositionOfCentroidalMatrix; /*!< 6 x 6. Used for plain inversion */
             
             //constant auxiliary variables
@@ -257,8 +443,6 @@ namespace codyco {
             Eigen::Matrix<double, 7, 1> m_rotoTranslationVector; /*!< 7 */
             Eigen::VectorXd m_jointsZeroVector; /*!< actuatedDOFs */
             Eigen::Matrix<double, 6, 1> m_esaZeroVector; /*!< 6 */
-            Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> m_jacobianTemporary; /* 6 x totalDOFs */
-            Eigen::VectorXd m_dJacobiaDqTemporary; /* 6 */
             
             //TODO: move all buffers inside this struct to simplify reading
             struct Buffers {
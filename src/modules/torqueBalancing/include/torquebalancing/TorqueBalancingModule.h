@@ -19,9 +19,11 @@
 
 #include "Reference.h"
 #include "TorqueBalancingController.h"
+#include "ReferenceGenerator.h"
 
 #include <yarp/os/RFModule.h>
 #include <yarp/os/PortReaderBuffer.h>
+#include <yarp/os/Mutex.h>
 #include <paramHelp/paramProxyInterface.h>
 
 #include <map>
@@ -105,6 +107,11 @@ namespace codyco {
              */
             void monitorVariables();
 
+            /** Reads the timing statistics of the control loop, publishes them
+             * and warns if the loop missed its deadlines
+             */
+            void reportLoopTiming();
+
             /**
              * Switch the low level torque control PIDs to the PIDs specified by the input key
              *
@@ -150,12 +157,19 @@ namespace codyco {
             yarp::os::Port* m_rpcPort;
             yarp::os::BufferedPort<yarp::os::Bottle>* m_constraintsPort;
             yarp::os::BufferedPort<yarp::os::Property>* m_eventsPort;
+            yarp::os::BufferedPort<yarp::os::Bottle>* m_timingPort;
+
+            //timing statistics of the control loop computed by updateModule, returned by the "timing" command
+            yarp::os::Mutex m_loopTimingMutex;
+            iCub::ctrl::realTime::LoopTimingStatistics m_loopTimingStatistics;
 
             ParamHelperManager* m_paramHelperManager;
 
             Eigen::VectorXd m_jointsConfiguration; /*!< Resting position of the impedance control */
             Eigen::VectorXd m_tempHeptaVector; /*!< Temporary vector of 7 elements */
             Eigen::VectorXd m_comReference; /*!< Reference for the center of mass */
+            Eigen::VectorXd m_streamedCOMReference; /*!< Last value read from the CoM streaming port */
+            Eigen::VectorXd m_streamedJointsReference; /*!< Last value read from the joints streaming port */
 
             typedef std::map<std::string, codyco::PIDList> PidMap;
             PidMap m_torquePIDs;
@@ -189,6 +203,7 @@ namespace codyco {
 
             bool m_initialized;
             paramHelp::ParamHelperServer* m_parameterServer;
+            ReferenceGenerator* m_comGenerator;
 
             Eigen::VectorXd m_comProportionalGain;
             Eigen::VectorXd m_comDerivativeGain;
@@ -209,6 +224,11 @@ namespace codyco {
             Eigen::VectorXd m_monitoredDesiredCOM;
             Eigen::VectorXd m_monitoredMeasuredCOM;
 
+            //Snapshots read from the controller and the COM generator
+            ReferenceGeneratorMonitoredVariables m_comGeneratorMonitoredVariables;
+            TorqueBalancingControllerMonitoredVariables m_controllerMonitoredVariables;
+
+            void publishParameters();
 
         public:
             ParamHelperManager(TorqueBalancingModule& module, int actuatedDOFs);
@@ -221,7 +241,6 @@ namespace codyco {
 
             bool processRPCCommand(const yarp::os::Bottle& command, yarp::os::Bottle& reply);
             void sendMonitoredVariables();
-            void syncLinkedVariables();
 
             virtual ~ParamHelperManager();
             virtual void parameterUpdated(const paramHelp::ParamProxyInterface *proxyInterface);
@@ -0,0 +1,212 @@
+/**
+ * Copyright (C) 2016 CoDyCo
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found at
+ * http://www.robotcub.org/icub/license/gpl.txt
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+#include "QPSolver.h"
+
+#include <yarp/os/Time.h>
+
+#include <cmath>
+#include <algorithm>
+
+namespace codyco {
+    namespace torquebalancing {
+
+        QPSolverSettings::QPSolverSettings()
+        : maxIterations(100)
+        , maxTime(0)
+        , absoluteTolerance(1e-3)
+        , relativeTolerance(1e-3)
+        , rho(0.1)
+        , sigma(1e-6)
+        , relaxation(1.6) {}
+
+        QPSolver::QPSolver(int maxVariables, int maxConstraints)
+        : m_maxVariables(0)
+        , m_maxConstraints(0)
+        , m_warmStartVariables(-1)
+        , m_warmStartConstraints(-1)
+        , m_iterations(0)
+        {
+            resize(maxVariables, maxConstraints);
+        }
+
+        void QPSolver::resize(int maxVariables, int maxConstraints)
+        {
+            m_maxVariables = std::max(maxVariables, 0);
+            m_maxConstraints = std::max(maxConstraints, 0);
+            m_kktMatrix.setZero(m_maxVariables, m_maxVariables);
+            m_x.setZero(m_maxVariables);
+            m_xTilde.setZero(m_maxVariables);
+            m_z.setZero(m_maxConstraints);
+            m_zTilde.setZero(m_maxConstraints);
+            m_y.setZero(m_maxConstraints);
+            m_variablesBuffer.setZero(m_maxVariables);
+            m_constraintsBuffer.setZero(m_maxConstraints);
+            resetWarmStart();
+        }
+
+        const QPSolverSettings& QPSolver::settings() const { return m_settings; }
+
+        void QPSolver::setSettings(const QPSolverSettings& settings) { m_settings = settings; }
+
+        void QPSolver::resetWarmStart()
+        {
+            m_warmStartVariables = m_warmStartConstraints = -1;
+        }
+
+        int QPSolver::iterations() const { return m_iterations; }
+
+        QPSolverStatus QPSolver::solve(const Eigen::Ref<const Eigen::MatrixXd>& hessian,
+                                       const Eigen::Ref<const Eigen::VectorXd>& gradient,
+                                       const Eigen::Ref<const Eigen::MatrixXd>& constraints,
+                                       const Eigen::Ref<const Eigen::VectorXd>& lowerBounds,
+                                       const Eigen::Ref<const Eigen::VectorXd>& upperBounds,
+                                       Eigen::Ref<Eigen::VectorXd> solution)
+        {
+            const double startTime = m_settings.maxTime > 0 ? yarp::os::Time::now() : 0;
+            const int n = hessian.rows();
+            const int m = constraints.rows();
+            m_iterations = 0;
+
+            if (n > m_maxVariables || m > m_maxConstraints
+                || hessian.cols() != n || gradient.size() != n || solution.size() != n
+                || constraints.cols() != n || lowerBounds.size() != m || upperBounds.size() != m) {
+                return QPSolverStatusInvalidProblem;
+            }
+
+            const double rho = m_settings.rho;
+            const double sigma = m_settings.sigma;
+            const double alpha = m_settings.relaxation;
+
+            //K = H + sigma I + rho C'C (the constraints matrix changes at each solve: always factorize)
+            Eigen::Block<Eigen::MatrixXd> kkt = m_kktMatrix.topLeftCorner(n, n);
+            kkt = hessian;
+            kkt.diagonal().array() += sigma;
+            kkt.noalias() += rho * constraints.transpose() * constraints;
+            if (!factorize(n)) {
+                resetWarmStart();
+                return QPSolverStatusInvalidProblem;
+            }
+
+            Eigen::VectorBlock<Eigen::VectorXd> x = m_x.head(n);
+            Eigen::VectorBlock<Eigen::VectorXd> xTilde = m_xTilde.head(n);
+            Eigen::VectorBlock<Eigen::VectorXd> z = m_z.head(m);
+            Eigen::VectorBlock<Eigen::VectorXd> zTilde = m_zTilde.head(m);
+            Eigen::VectorBlock<Eigen::VectorXd> y = m_y.head(m);
+            Eigen::VectorBlock<Eigen::VectorXd> variablesBuffer = m_variablesBuffer.head(n);
+            Eigen::VectorBlock<Eigen::VectorXd> constraintsBuffer = m_constraintsBuffer.head(m);
+
+            if (m_warmStartVariables != n || m_warmStartConstraints != m) {
+                x.setZero();
+                y.setZero();
+                z = lowerBounds.cwiseMax(Eigen::VectorXd::Zero(m)).cwiseMin(upperBounds);
+            }
+            m_warmStartVariables = n;
+            m_warmStartConstraints = m;
+
+            QPSolverStatus status = QPSolverStatusMaxIterations;
+            while (m_iterations < m_settings.maxIterations) {
+                m_iterations++;
+
+                //x update: (H + sigma I + rho C'C) xTilde = sigma x - g + C'(rho z - y)
+                constraintsBuffer = rho * z - y;
+                xTilde.noalias() = constraints.transpose() * constraintsBuffer;
+                xTilde += sigma * x - gradient;
+                solveFactorized(n, xTilde);
+
+                //relaxed z and x updates
+                zTilde.noalias() = constraints * xTilde;
+                zTilde = alpha * zTilde + (1.0 - alpha) * z;
+                x = alpha * xTilde + (1.0 - alpha) * x;
+
+                //projection on the bounds and dual update
+                constraintsBuffer = (zTilde + y / rho).cwiseMax(lowerBounds).cwiseMin(upperBounds);
+                y += rho * (zTilde - constraintsBuffer);
+                z = constraintsBuffer;
+
+                //residuals
+                constraintsBuffer.noalias() = constraints * x;
+                double primalResidual = (constraintsBuffer - z).lpNorm<Eigen::Infinity>();
+                double primalScale = std::max(constraintsBuffer.lpNorm<Eigen::Infinity>(), z.lpNorm<Eigen::Infinity>());
+
+                variablesBuffer.noalias() = hessian * x;
+                double dualScale = variablesBuffer.lpNorm<Eigen::Infinity>();
+                xTilde.noalias() = constraints.transpose() * y;
+                dualScale = std::max(dualScale, xTilde.lpNorm<Eigen::Infinity>());
+                dualScale = std::max(dualScale, gradient.lpNorm<Eigen::Infinity>());
+                variablesBuffer += xTilde + gradient;
+                double dualResidual = variablesBuffer.lpNorm<Eigen::Infinity>();
+
+                if (primalResidual <= m_settings.absoluteTolerance + m_settings.relativeTolerance * primalScale
+                    && dualResidual <= m_settings.absoluteTolerance + m_settings.relativeTolerance * dualScale) {
+                    status = QPSolverStatusSolved;
+                    break;
+                }
+                if (m_settings.maxTime > 0 && yarp::os::Time::now() - startTime > m_settings.maxTime) {
+                    status = QPSolverStatusMaxTime;
+                    break;
+                }
+            }
+
+            if (!x.allFinite() || !y.allFinite()) {
+                resetWarmStart();
+                return QPSolverStatusInvalidProblem;
+            }
+            solution = x;
+            return status;
+        }
+
+        bool QPSolver::factorize(int variables)
+        {
+            //in place Cholesky decomposition (lower triangular factor) of the top left corner of m_kktMatrix
+            for (int j = 0; j < variables; j++) {
+                double diagonal = m_kktMatrix(j, j);
+                for (int k = 0; k < j; k++) {
+                    diagonal -= m_kktMatrix(j, k) * m_kktMatrix(j, k);
+                }
+                if (!(diagonal > 0)) return false;
+                diagonal = std::sqrt(diagonal);
+                m_kktMatrix(j, j) = diagonal;
+                for (int i = j + 1; i < variables; i++) {
+                    double value = m_kktMatrix(i, j);
+                    for (int k = 0; k < j; k++) {
+                        value -= m_kktMatrix(i, k) * m_kktMatrix(j, k);
+                    }
+                    m_kktMatrix(i, j) = value / diagonal;
+                }
+            }
+            return true;
+        }
+
+        void QPSolver::solveFactorized(int variables, Eigen::Ref<Eigen::VectorXd> rhs)
+        {
+            //L L' x = rhs
+            for (int i = 0; i < variables; i++) {
+                double value = rhs(i);
+                for (int k = 0; k < i; k++) {
+                    value -= m_kktMatrix(i, k) * rhs(k);
+                }
+                rhs(i) = value / m_kktMatrix(i, i);
+            }
+            for (int i = variables - 1; i >= 0; i--) {
+                double value = rhs(i);
+                for (int k = i + 1; k < variables; k++) {
+                    value -= m_kktMatrix(k, i) * rhs(k);
+                }
+                rhs(i) = value / m_kktMatrix(i, i);
+            }
+        }
+    }
+}
@@ -22,7 +22,10 @@
 #include <yarp/os/BufferedPort.h>
 #include <yarp/sig/Vector.h>
 #include <yarp/os/Thread.h>
-#include <set>
+#include <yarp/os/Time.h>
+#include <ctrlLibRT/atomics.h>
+#include <algorithm>
+#include <vector>
 
 
 //C++ 11
@@ -36,6 +39,10 @@
 //    };
 //}
 
+using iCub::ctrl::realTime::atomicIncrement;
+using iCub::ctrl::realTime::atomicLoad;
+using iCub::ctrl::realTime::atomicStore;
+
 namespace codyco {
     namespace torquebalancing {
 
@@ -43,7 +50,7 @@ namespace codyco {
         
 
         ReferenceDelegate::~ReferenceDelegate() {}
-        void ReferenceDelegate::referenceWillChangeValue(const codyco::torquebalancing::Reference &, const Eigen::VectorXd& newValue) {}
+        void ReferenceDelegate::referenceWillChangeValue(const codyco::torquebalancing::Reference &, const Eigen::Ref<const Eigen::VectorXd>& newValue) {}
         void ReferenceDelegate::referenceDidChangeValue(const codyco::torquebalancing::Reference &) {}
 
         bool ReferenceDelegate::operator==(const ReferenceDelegate &other) const {return &other == this;}
@@ -72,8 +79,8 @@ namespace codyco {
         };
 
         struct ReferencePrivateImplementation {
-            yarp::os::Mutex m_lock;
-            std::set<ReferenceDelegate*> delegates;
+            yarp::os::Mutex m_lock; //serializes the writers, readers never take it
+            std::vector<ReferenceDelegate*> delegates;
 
             ReferenceReader reader;
             yarp::os::BufferedPort<yarp::sig::Vector> *readerPort;
@@ -96,10 +103,15 @@ namespace codyco {
 
 
         Reference::Reference(int referenceSize)
-        : m_value(referenceSize)
-        , m_valid(false)
+        : m_sequence(0)
+        , m_valid(0)
         , m_valueSize(referenceSize)
-        , m_implementation(new ReferencePrivateImplementation(*this)) {}
+        , m_implementation(new ReferencePrivateImplementation(*this))
+        {
+            m_values[0].setZero(referenceSize);
+            m_values[1].setZero(referenceSize);
+            m_timestamps[0] = m_timestamps[1] = 0;
+        }
         
         Reference::~Reference()
         {
@@ -115,14 +127,16 @@ namespace codyco {
         {
             if (!delegate) return;
             ReferencePrivateImplementation *implementation = static_cast<ReferencePrivateImplementation*>(m_implementation);
-            implementation->delegates.insert(delegate);
+            if (std::find(implementation->delegates.begin(), implementation->delegates.end(), delegate) == implementation->delegates.end())
+                implementation->delegates.push_back(delegate);
         }
 
         void Reference::removeDelegate(ReferenceDelegate *delegate)
         {
             if (!delegate) return;
             ReferencePrivateImplementation *implementation = static_cast<ReferencePrivateImplementation*>(m_implementation);
-            implementation->delegates.erase(delegate);
+            implementation->delegates.erase(std::remove(implementation->delegates.begin(), implementation->delegates.end(), delegate),
+                                            implementation->delegates.end());
         }
 
         bool Reference::setUpReaderPort(std::string portName)
@@ -156,44 +170,55 @@ namespace codyco {
             return true;
         }
 
-        const Eigen::VectorXd& Reference::value() const
+        void Reference::readValue(Eigen::Ref<Eigen::VectorXd> value, unsigned long *sequenceNumber, double *timestamp) const
         {
-            ReferencePrivateImplementation *implementation = static_cast<ReferencePrivateImplementation*>(m_implementation);
-            yarp::os::LockGuard guard(implementation->m_lock);
-            return m_value;
+            //The buffer being copied is overwritten only by the second setValue
+            //starting after the first load: if it happened, copy again
+            unsigned long startSequence, endSequence;
+            double valueTimestamp;
+            do {
+                startSequence = static_cast<unsigned long>(atomicLoad(const_cast<volatile long*>(&m_sequence)));
+                value = m_values[(startSequence / 2) % 2];
+                valueTimestamp = m_timestamps[(startSequence / 2) % 2];
+                endSequence = static_cast<unsigned long>(atomicLoad(const_cast<volatile long*>(&m_sequence)));
+            } while (endSequence - (startSequence & ~1ul) > 2);
+
+            if (sequenceNumber) *sequenceNumber = startSequence / 2;
+            if (timestamp) *timestamp = valueTimestamp;
         }
         
         void Reference::setValue(const Eigen::Ref<const Eigen::VectorXd>& _value)
         {
+            if (_value.size() != m_valueSize) return;
             ReferencePrivateImplementation *implementation = static_cast<ReferencePrivateImplementation*>(m_implementation);
 
-            if (implementation->delegates.size() > 0)
-                for (std::set<ReferenceDelegate*>::iterator delegate = implementation->delegates.begin(); delegate != implementation->delegates.end(); delegate++) {
-                    (*delegate)->referenceWillChangeValue(*this, _value);
-                }
+            for (std::vector<ReferenceDelegate*>::const_iterator delegate = implementation->delegates.begin();
+                 delegate != implementation->delegates.end(); ++delegate) {
+                (*delegate)->referenceWillChangeValue(*this, _value);
+            }
             {
                 yarp::os::LockGuard guard(implementation->m_lock);
-                m_value = _value;
-                m_valid = true;
+                //write the buffer not read by the readers, then publish it
+                atomicIncrement(&m_sequence);
+                m_values[(m_sequence / 2 + 1) % 2] = _value;
+                m_timestamps[(m_sequence / 2 + 1) % 2] = yarp::os::Time::now();
+                atomicIncrement(&m_sequence);
+                atomicStore(&m_valid, 1);
+            }
+            for (std::vector<ReferenceDelegate*>::const_iterator delegate = implementation->delegates.begin();
+                 delegate != implementation->delegates.end(); ++delegate) {
+                (*delegate)->referenceDidChangeValue(*this);
             }
-            if (implementation->delegates.size() > 0)
-                for (std::set<ReferenceDelegate*>::iterator delegate = implementation->delegates.begin(); delegate != implementation->delegates.end(); delegate++) {
-                    (*delegate)->referenceDidChangeValue(*this);
-                }
         }
 
         void Reference::setValid(bool isValid)
         {
-            ReferencePrivateImplementation *implementation = static_cast<ReferencePrivateImplementation*>(m_implementation);
-            yarp::os::LockGuard guard(implementation->m_lock);
-            m_valid = isValid;
+            atomicStore(&m_valid, isValid ? 1 : 0);
         }
         
         bool Reference::isValid()
         {
-            ReferencePrivateImplementation *implementation = static_cast<ReferencePrivateImplementation*>(m_implementation);
-            yarp::os::LockGuard guard(implementation->m_lock);
-            return m_valid;
+            return atomicLoad(&m_valid) != 0;
         }
         
         int Reference::valueSize() const
@@ -25,6 +25,21 @@
 namespace codyco {
     namespace torquebalancing {
 
+#pragma mark - Gains and monitored variables
+
+        ReferenceGeneratorGains::ReferenceGeneratorGains(int signalSize)
+        : proportionalGains(Eigen::VectorXd::Zero(signalSize))
+        , derivativeGains(Eigen::VectorXd::Zero(signalSize))
+        , integralGains(Eigen::VectorXd::Zero(signalSize))
+        , integralLimit(std::numeric_limits<double>::max()) {}
+
+        ReferenceGeneratorMonitoredVariables::ReferenceGeneratorMonitoredVariables(int signalSize, int referenceSize)
+        : computedReference(Eigen::VectorXd::Zero(referenceSize))
+        , error(Eigen::VectorXd::Zero(signalSize))
+        , errorIntegral(Eigen::VectorXd::Zero(signalSize))
+        , actualReference(Eigen::VectorXd::Zero(referenceSize))
+        , signal(Eigen::VectorXd::Zero(signalSize)) {}
+
 #pragma mark - ReferenceGenerator methods
 
         ReferenceGenerator::ReferenceGenerator(int period, Reference& reference, ReferenceGeneratorInputReader& reader, const std::string& name)
@@ -33,6 +48,7 @@ namespace codyco {
         , m_outputReference(reference)
         , m_reader(reader)
         , m_referenceFilter(0)
+        , m_referenceFilterDerivativesEnabled(false)
         , m_computedReference(reference.valueSize())
         , m_integralTerm(reader.signalSize())
         , m_error(reader.signalSize())
@@ -47,6 +63,11 @@ namespace codyco {
         , m_active(false)
         , m_currentSignalValue(reference.valueSize())
         , m_actualReference(reference.valueSize())
+        , m_actualDerivativeReference(reference.valueSize())
+        , m_actualFeedForward(reference.valueSize())
+        , m_clientGains(reader.signalSize())
+        , m_gains(m_clientGains)
+        , m_monitoredVariables(ReferenceGeneratorMonitoredVariables(reader.signalSize(), reference.valueSize()))
         {
             m_proportionalGains.setZero();
             m_derivativeGains.setZero();
@@ -88,16 +109,35 @@ namespace codyco {
         }
 
         void ReferenceGenerator::run()
+        {
+            step(yarp::os::Time::now());
+        }
+
+        void ReferenceGenerator::step(double now)
         {
             yarp::os::LockGuard guard(m_mutex);
+            //the whole step uses the same gains. Sizes are checked by the setters: no allocation here
+            if (m_gains.update()) {
+                const ReferenceGeneratorGains& gains = m_gains.readBuffer();
+                m_proportionalGains = gains.proportionalGains;
+                m_derivativeGains = gains.derivativeGains;
+                m_integralGains = gains.integralGains;
+                m_integralLimit = gains.integralLimit;
+            }
             if (m_active) {
-                double now = yarp::os::Time::now();
                 if (m_previousTime < 0) m_previousTime = now;
                 double dt = now - m_previousTime;
 
                 m_actualReference = m_signalReference;
+                m_actualDerivativeReference = m_signalDerivativeReference;
+                m_actualFeedForward = m_signalFeedForward;
                 if (m_referenceFilter && m_referenceFilter->updateTrajectoryForCurrentTime(now)) {
                     m_actualReference = m_referenceFilter->getComputedValue();
+                    if (m_referenceFilterDerivativesEnabled) {
+                        //the filter replaces the streamed derivatives: they refer to the unfiltered reference
+                        m_actualDerivativeReference = m_referenceFilter->getComputedDerivativeValue();
+                        m_actualFeedForward = m_referenceFilter->getComputedSecondDerivativeValue();
+                    }
                 }
                 long context = now * 1000; //i use the time in ms as a context
 
@@ -107,12 +147,20 @@ namespace codyco {
                 m_integralTerm += dt * m_error;
                 limitIntegral(m_integralTerm, m_integralTerm);
 
-                m_computedReference = m_signalFeedForward
+                m_computedReference = m_actualFeedForward
                 - m_proportionalGains.asDiagonal() * m_error
-                - m_derivativeGains.asDiagonal() * (m_reader.getSignalDerivative(context) - m_signalDerivativeReference)
+                - m_derivativeGains.asDiagonal() * (m_reader.getSignalDerivative(context) - m_actualDerivativeReference)
                 - m_integralGains.asDiagonal() * m_integralTerm;
                 m_outputReference.setValue(m_computedReference);
 
+                ReferenceGeneratorMonitoredVariables& monitoredVariables = m_monitoredVariables.writeBuffer();
+                monitoredVariables.computedReference = m_computedReference;
+                monitoredVariables.error = m_error;
+                monitoredVariables.errorIntegral = m_integralTerm;
+                monitoredVariables.actualReference = m_actualReference;
+                monitoredVariables.signal = m_currentSignalValue;
+                m_monitoredVariables.publish();
+
 //                if (strcmp("com pid", m_name.c_str()) == 0) {
 //                    std::cout << m_actualReference.transpose() << "\n";
 //                }
@@ -149,6 +197,12 @@ namespace codyco {
             return m_referenceFilter;
         }
 
+        void ReferenceGenerator::setReferenceFilterDerivativesEnabled(bool enabled)
+        {
+            yarp::os::LockGuard guard(m_mutex);
+            m_referenceFilterDerivativesEnabled = enabled;
+        }
+
         const Eigen::VectorXd& ReferenceGenerator::signalReference()
         {
             yarp::os::LockGuard guard(m_mutex);
@@ -242,56 +296,76 @@ namespace codyco {
             return m_active;
         }
 
-        const Eigen::VectorXd& ReferenceGenerator::proportionalGains()
+        Eigen::VectorXd ReferenceGenerator::proportionalGains()
         {
-            yarp::os::LockGuard guard(m_mutex);
-            return m_proportionalGains;
+            yarp::os::LockGuard guard(m_gainsMutex);
+            return m_clientGains.proportionalGains;
         }
 
         void ReferenceGenerator::setProportionalGains(const Eigen::VectorXd& proportionalGains)
         {
-            yarp::os::LockGuard guard(m_mutex);
-            m_proportionalGains = proportionalGains;
+            if (proportionalGains.size() != m_clientGains.proportionalGains.size()) return;
+            yarp::os::LockGuard guard(m_gainsMutex);
+            m_clientGains.proportionalGains = proportionalGains;
+            publishGains();
         }
 
-        const Eigen::VectorXd& ReferenceGenerator::derivativeGains()
+        Eigen::VectorXd ReferenceGenerator::derivativeGains()
         {
-            yarp::os::LockGuard guard(m_mutex);
-            return m_derivativeGains;
+            yarp::os::LockGuard guard(m_gainsMutex);
+            return m_clientGains.derivativeGains;
         }
 
         void ReferenceGenerator::setDerivativeGains(const Eigen::VectorXd& derivativeGains)
         {
-            yarp::os::LockGuard guard(m_mutex);
-            m_derivativeGains = derivativeGains;
+            if (derivativeGains.size() != m_clientGains.derivativeGains.size()) return;
+            yarp::os::LockGuard guard(m_gainsMutex);
+            m_clientGains.derivativeGains = derivativeGains;
+            publishGains();
         }
 
-        const Eigen::VectorXd& ReferenceGenerator::integralGains()
+        Eigen::VectorXd ReferenceGenerator::integralGains()
         {
-            yarp::os::LockGuard guard(m_mutex);
-            return m_integralGains;
+            yarp::os::LockGuard guard(m_gainsMutex);
+            return m_clientGains.integralGains;
         }
 
         void ReferenceGenerator::setIntegralGains(const Eigen::VectorXd& integralGains)
         {
-            yarp::os::LockGuard guard(m_mutex);
-            m_integralGains = integralGains;
+            if (integralGains.size() != m_clientGains.integralGains.size()) return;
+            yarp::os::LockGuard guard(m_gainsMutex);
+            m_clientGains.integralGains = integralGains;
+            publishGains();
         }
 
         double ReferenceGenerator::integralLimit()
         {
-            yarp::os::LockGuard guard(m_mutex);
-            return m_integralLimit;
+            yarp::os::LockGuard guard(m_gainsMutex);
+            return m_clientGains.integralLimit;
         }
 
         void ReferenceGenerator::setIntegralLimit(double integralLimit)
         {
             if (!codyco::math::isnan(integralLimit)) {
-                yarp::os::LockGuard guard(m_mutex);
-                m_integralLimit = std::abs(integralLimit);
+                yarp::os::LockGuard guard(m_gainsMutex);
+                m_clientGains.integralLimit = std::abs(integralLimit);
+                publishGains();
             }
         }
 
+        ReferenceGeneratorGains ReferenceGenerator::gains()
+        {
+            yarp::os::LockGuard guard(m_gainsMutex);
+            return m_clientGains;
+        }
+
+        void ReferenceGenerator::publishGains()
+        {
+            //called with m_gainsMutex held: the buffer must be filled completely
+            m_gains.writeBuffer() = m_clientGains;
+            m_gains.publish();
+        }
+
         void ReferenceGenerator::limitIntegral(const Eigen::Ref<Eigen::VectorXd>& integral, Eigen::Ref<Eigen::VectorXd> limitedIntegral)
         {
 //            limitedIntegral = integral.array().cwiseMin(m_integralLimit).cwiseMax(-m_integralLimit).matrix();
@@ -306,31 +380,53 @@ namespace codyco {
                                              const Eigen::VectorXd& integralGains,
                                              double integralLimit)
         {
-            yarp::os::LockGuard guard(m_mutex);
-            m_proportionalGains = proportionalGains;
-            m_derivativeGains = derivativeGains;
-            m_integralGains = integralGains;
+            const int signalSize = m_clientGains.proportionalGains.size();
+            if (proportionalGains.size() != signalSize
+                || derivativeGains.size() != signalSize
+                || integralGains.size() != signalSize) {
+                return;
+            }
+            yarp::os::LockGuard guard(m_gainsMutex);
+            m_clientGains.proportionalGains = proportionalGains;
+            m_clientGains.derivativeGains = derivativeGains;
+            m_clientGains.integralGains = integralGains;
             if (!codyco::math::isnan(integralLimit)) {
-                m_integralLimit = std::abs(integralLimit);
+                m_clientGains.integralLimit = std::abs(integralLimit);
             }
+            publishGains();
         }
 
-        const Eigen::VectorXd& ReferenceGenerator::computedReference()
+        Eigen::VectorXd ReferenceGenerator::computedReference()
         {
-            yarp::os::LockGuard guard(m_mutex);
-            return m_computedReference;
+            yarp::os::LockGuard guard(m_monitoredVariablesMutex);
+            m_monitoredVariables.update();
+            return m_monitoredVariables.readBuffer().computedReference;
         }
 
-        const Eigen::VectorXd& ReferenceGenerator::instantaneousError()
+        Eigen::VectorXd ReferenceGenerator::instantaneousError()
         {
-            yarp::os::LockGuard guard(m_mutex);
-            return m_error;
+            yarp::os::LockGuard guard(m_monitoredVariablesMutex);
+            m_monitoredVariables.update();
+            return m_monitoredVariables.readBuffer().error;
         }
 
-        const Eigen::VectorXd& ReferenceGenerator::errorIntegral()
+        Eigen::VectorXd ReferenceGenerator::errorIntegral()
         {
-            yarp::os::LockGuard guard(m_mutex);
-            return m_integralTerm;
+            yarp::os::LockGuard guard(m_monitoredVariablesMutex);
+            m_monitoredVariables.update();
+            return m_monitoredVariables.readBuffer().errorIntegral;
+        }
+
+        void ReferenceGenerator::readMonitoredVariables(ReferenceGeneratorMonitoredVariables& variables)
+        {
+            yarp::os::LockGuard guard(m_monitoredVariablesMutex);
+            m_monitoredVariables.update();
+            const ReferenceGeneratorMonitoredVariables& published = m_monitoredVariables.readBuffer();
+            variables.computedReference = published.computedReference;
+            variables.error = published.error;
+            variables.errorIntegral = published.errorIntegral;
+            variables.actualReference = published.actualReference;
+            variables.signal = published.signal;
         }
 
 #pragma mark - ReferenceGeneratorInputReader methods
@@ -16,6 +16,7 @@
 
 #include "TorqueBalancingController.h"
 #include "Reference.h"
+#include "ReferenceGenerator.h"
 #include "DynamicConstraint.h"
 
 #include <wbi/wholeBodyInterface.h>
@@ -24,16 +25,20 @@
 #include <yarpWholeBodyInterface/yarpWholeBodyInterface.h>
 #include <yarp/os/LogStream.h>
 #include <yarp/os/LockGuard.h>
+#include <yarp/os/Time.h>
 #include <codyco/Utils.h>
 
 #include <iCub/ctrl/minJerkCtrl.h>
 
 #include <iostream>
 #include <limits>
+#include <cmath>
 
 #include <Eigen/LU>
+#include <Eigen/Geometry>
 
 #define TORQUEBALANCING_STATEACTIVE_THRESHOLD 0.05
+#define TORQUEBALANCING_CONTACTFORCE_CONSTRAINTS 11
 
 namespace codyco {
     namespace torquebalancing {
@@ -43,6 +48,30 @@ namespace codyco {
         void ControllerDelegate::controllerDidStart(TorqueBalancingController& controller) {}
         void ControllerDelegate::controllerDidStop(TorqueBalancingController& controller) {}
 
+#pragma mark - Parameters and monitored variables
+
+        TorqueBalancingControllerParameters::TorqueBalancingControllerParameters(int actuatedDOFs)
+        : centroidalMomentumGain(0)
+        , impedanceGains(Eigen::VectorXd::Zero(actuatedDOFs))
+        , torqueSaturationLimit(Eigen::VectorXd::Constant(actuatedDOFs, std::numeric_limits<double>::max())) {}
+
+        ContactForceLimits::ContactForceLimits()
+        : frictionCoefficient(1.0 / 3.0)
+        , torsionalFrictionCoefficient(2.0 / 150.0)
+        , minimumNormalForce(10)
+        , regularization(1e-2)
+        {
+            centerOfPressureLimits[0] = -0.07;
+            centerOfPressureLimits[1] = 0.12;
+            centerOfPressureLimits[2] = -0.045;
+            centerOfPressureLimits[3] = 0.05;
+        }
+
+        TorqueBalancingControllerMonitoredVariables::TorqueBalancingControllerMonitoredVariables(int actuatedDOFs)
+        : desiredFeetForces(Eigen::VectorXd::Zero(12))
+        , desiredContactForces(Eigen::VectorXd::Zero(12))
+        , outputTorques(Eigen::VectorXd::Zero(actuatedDOFs)) {}
+
 #pragma mark - Torque Balancing Controller Implementation
 
         TorqueBalancingController::TorqueBalancingController(int period, ControllerReferences& references, wbi::wholeBodyInterface& robot, int actuatedDOFs, double dynamicSmoothingTime)
@@ -51,13 +80,29 @@ namespace codyco {
         , m_actuatedDOFs(actuatedDOFs)
         , m_dynamicsTransitionTime(dynamicSmoothingTime)
         , m_delegate(0)
+        , m_loopTiming(period / 1000.0)
         , m_active(false)
         , m_checkJointLimits(true)
         , m_centerOfMassLinkID(wbi::wholeBodyInterface::COM_LINK_ID)
+        , m_leftFootContact(-1)
+        , m_rightFootContact(-1)
+        , m_forceDistributionQP(false)
+        , m_forceDistributionSamples(0)
+        , m_forceDistributionTimeSum(0)
+        , m_forceDistributionTimeMaximum(0)
+        , m_forceDistributionIterationsSum(0)
+        , m_forceDistributionFallbacks(0)
         , m_references(references)
+        , m_referenceLatencySamples(0)
+        , m_referenceLatencySum(0)
+        , m_referenceLatencySquaredSum(0)
+        , m_referenceLatencyMaximum(0)
         , m_desiredJointsConfiguration(actuatedDOFs)
         , m_centroidalMomentumGain(0)
         , m_impedanceGains(actuatedDOFs)
+        , m_clientParameters(actuatedDOFs)
+        , m_parameters(m_clientParameters)
+        , m_monitoredVariables(TorqueBalancingControllerMonitoredVariables(actuatedDOFs))
         , m_desiredCOMAcceleration(3)
         , m_desiredFeetForces(12)
         , m_desiredCentroidalMomentum(6)
@@ -68,8 +113,6 @@ namespace codyco {
         , m_baseVelocity(6)
         , m_world2BaseFrameSerialization(16)
         , m_centerOfMassPosition(3)
-        , m_rightFootPosition(7)
-        , m_leftFootPosition(7)
         , m_minJointLimits(actuatedDOFs)
         , m_maxJointLimits(actuatedDOFs)
         , m_torqueSaturationLimit(actuatedDOFs)
@@ -96,10 +139,13 @@ namespace codyco {
         , m_rotoTranslationVector(7)
         , m_jointsZeroVector(actuatedDOFs)
         , m_esaZeroVector(6)
-        , m_jacobianTemporary(6, actuatedDOFs + 6)
-        , m_dJacobiaDqTemporary(6)
         , m_buffers(actuatedDOFs) {}
 
+        TorqueBalancingController::ContactConstraint::ContactConstraint(const std::string& frameName, int linkID)
+        : frameName(frameName)
+        , linkID(linkID)
+        , position(Eigen::Matrix<double, 7, 1>::Zero()) {}
+
         TorqueBalancingController::Buffers::Buffers(int actuatedDOFs)
         : baseAndJointsVector(actuatedDOFs + 6)
         , jointsVector(actuatedDOFs)
@@ -122,16 +168,8 @@ namespace codyco {
         {
             using namespace Eigen;
             //Initialize constant variables
-            bool linkFound = true;
-            linkFound = m_robot.getFrameList().idToIndex("l_sole", m_leftFootLinkID);
-            linkFound = linkFound && m_robot.getFrameList().idToIndex("r_sole", m_rightFootLinkID);
-
-            //centroidal force matrix
+            //centroidal force matrix: rebuilt at each cycle from the active contacts
             m_centroidalForceMatrix.setZero();
-            m_centroidalForceMatrix.block<3, 3>(0, 0) = Matrix3d::Identity();
-            m_centroidalForceMatrix.block<3, 3>(0, 6) = Matrix3d::Identity();
-            m_centroidalForceMatrix.block<3, 3>(3, 3) = Matrix3d::Identity();
-            m_centroidalForceMatrix.block<3, 3>(3, 9) = Matrix3d::Identity();
             //gravity
             m_gravityForce.setZero();
             m_gravityUnitVector[0] = m_gravityUnitVector[1] = 0;
@@ -142,15 +180,17 @@ namespace codyco {
 
             m_jointsZeroVector.setZero();
             m_esaZeroVector.setZero();
-            m_torqueSaturationLimit.setConstant(std::numeric_limits<double>::max());
 
             //reset status to zero
             m_jointPositions.setZero();
             m_jointVelocities.setZero();
             m_baseVelocity.setZero();
             m_centerOfMassPosition.setZero();
-            m_rightFootPosition.setZero();
-            m_leftFootPosition.setZero();
+            for (std::vector<ContactConstraint>::iterator contact = m_contacts.begin();
+                 contact != m_contacts.end(); ++contact) {
+                contact->position.setZero();
+            }
+            m_activeContacts.clear();
             m_contactsJacobian.setZero();
             m_contactsDJacobianDq.setZero();
             m_generalizedBiasForces.setZero();
@@ -160,8 +200,9 @@ namespace codyco {
 
             m_desiredJointsConfiguration.setZero();
 
-            //zeroing gains
-            m_impedanceGains.setZero();
+            //gains and limits: last parameters set by the clients
+            m_parameters.update();
+            adoptParameters(m_parameters.readBuffer());
 
             //zeroing monitored variables
             m_desiredFeetForces.setZero();
@@ -191,17 +232,17 @@ namespace codyco {
             } while(!result && count >0);
 
             std::stringstream formattedConstraintsString;
-            formattedConstraintsString << m_activeConstraints.size() << " Dyn. Constraints = ";
-            for (ConstraintsMap::const_iterator it = m_activeConstraints.begin();
-                 it != m_activeConstraints.end(); it++) {
-                formattedConstraintsString << it->first << " ";
+            formattedConstraintsString << m_contacts.size() << " Dyn. Constraints = ";
+            for (std::vector<ContactConstraint>::const_iterator it = m_contacts.begin();
+                 it != m_contacts.end(); it++) {
+                formattedConstraintsString << it->frameName << " ";
             }
             yInfo("%s", formattedConstraintsString.str().c_str());
 
 
 //            debugPort.open("/tb/debug:o");
 
-            return linkFound && result && !m_activeConstraints.empty();
+            return result && !m_contacts.empty();
         }
 
         void TorqueBalancingController::threadRelease()
@@ -211,7 +252,27 @@ namespace codyco {
 
         void TorqueBalancingController::run()
         {
+            m_loopTiming.tickStarted(yarp::os::Time::now());
+            controlCycle();
+            m_loopTiming.tickFinished(yarp::os::Time::now());
+        }
+
+        void TorqueBalancingController::controlCycle()
+        {
+            //the generators have their own lock: they do not need the controller one
+            if (!m_synchronousReferenceGenerators.empty()) {
+                double now = yarp::os::Time::now();
+                for (std::vector<ReferenceGenerator*>::iterator generator = m_synchronousReferenceGenerators.begin();
+                     generator != m_synchronousReferenceGenerators.end(); ++generator) {
+                    (*generator)->step(now);
+                }
+            }
+
             yarp::os::LockGuard guard(m_mutex);
+            //the whole cycle uses the same parameters
+            if (m_parameters.update()) {
+                adoptParameters(m_parameters.readBuffer());
+            }
             if (!m_active) return;
 
             //read references
@@ -243,32 +304,87 @@ namespace codyco {
 
             //write torques
             writeTorques();
+
+            //monitored forces in registration order, zero for the inactive contacts
+            TorqueBalancingControllerMonitoredVariables& monitoredVariables = m_monitoredVariables.writeBuffer();
+            monitoredVariables.desiredContactForces.setZero(6 * m_contacts.size());
+            m_desiredFeetForces.setZero();
+            for (int active = 0; active < static_cast<int>(m_activeContacts.size()); active++) {
+                int contact = m_activeContacts[active];
+                monitoredVariables.desiredContactForces.segment<6>(6 * contact) = m_desiredContactForces.segment<6>(6 * active);
+                if (contact == m_leftFootContact) {
+                    m_desiredFeetForces.head<6>() = m_desiredContactForces.segment<6>(6 * active);
+                } else if (contact == m_rightFootContact) {
+                    m_desiredFeetForces.tail<6>() = m_desiredContactForces.segment<6>(6 * active);
+                }
+            }
+            monitoredVariables.desiredFeetForces = m_desiredFeetForces;
+            monitoredVariables.outputTorques = m_torques;
+            m_monitoredVariables.publish();
         }
 
 #pragma mark - Getter and setter
 
         double TorqueBalancingController::centroidalMomentumGain()
         {
-            yarp::os::LockGuard guard(m_mutex);
-            return m_centroidalMomentumGain;
+            yarp::os::LockGuard guard(m_parametersMutex);
+            return m_clientParameters.centroidalMomentumGain;
         }
 
         void TorqueBalancingController::setCentroidalMomentumGain(double centroidalMomentumGain)
         {
-            yarp::os::LockGuard guard(m_mutex);
-            m_centroidalMomentumGain = centroidalMomentumGain;
+            yarp::os::LockGuard guard(m_parametersMutex);
+            m_clientParameters.centroidalMomentumGain = centroidalMomentumGain;
+            publishParameters();
         }
 
-        const Eigen::VectorXd& TorqueBalancingController::impedanceGains()
+        Eigen::VectorXd TorqueBalancingController::impedanceGains()
         {
-            yarp::os::LockGuard guard(m_mutex);
-            return m_impedanceGains;
+            yarp::os::LockGuard guard(m_parametersMutex);
+            return m_clientParameters.impedanceGains;
         }
 
-        void TorqueBalancingController::setImpedanceGains(Eigen::VectorXd& impedanceGains)
+        void TorqueBalancingController::setImpedanceGains(const Eigen::VectorXd& impedanceGains)
         {
-            yarp::os::LockGuard guard(m_mutex);
-            m_impedanceGains = impedanceGains;
+            if (impedanceGains.size() != m_actuatedDOFs) return;
+            yarp::os::LockGuard guard(m_parametersMutex);
+            m_clientParameters.impedanceGains = impedanceGains;
+            publishParameters();
+        }
+
+        TorqueBalancingControllerParameters TorqueBalancingController::parameters()
+        {
+            yarp::os::LockGuard guard(m_parametersMutex);
+            return m_clientParameters;
+        }
+
+        bool TorqueBalancingController::setParameters(const TorqueBalancingControllerParameters& parameters)
+        {
+            if (parameters.impedanceGains.size() != m_actuatedDOFs
+                || parameters.torqueSaturationLimit.size() != m_actuatedDOFs) {
+                return false;
+            }
+            yarp::os::LockGuard guard(m_parametersMutex);
+            m_clientParameters.centroidalMomentumGain = parameters.centroidalMomentumGain;
+            m_clientParameters.impedanceGains = parameters.impedanceGains;
+            m_clientParameters.torqueSaturationLimit = parameters.torqueSaturationLimit.array().abs();
+            publishParameters();
+            return true;
+        }
+
+        void TorqueBalancingController::publishParameters()
+        {
+            //called with m_parametersMutex held: the buffer must be filled completely
+            m_parameters.writeBuffer() = m_clientParameters;
+            m_parameters.publish();
+        }
+
+        void TorqueBalancingController::adoptParameters(const TorqueBalancingControllerParameters& parameters)
+        {
+            //sizes are checked by the setters: no allocation here
+            m_centroidalMomentumGain = parameters.centroidalMomentumGain;
+            m_impedanceGains = parameters.impedanceGains;
+            m_torqueSaturationLimit = parameters.torqueSaturationLimit;
         }
 
         void TorqueBalancingController::setActiveState(bool isActive)
@@ -310,16 +426,18 @@ namespace codyco {
             return m_checkJointLimits;
         }
 
-        void TorqueBalancingController::setTorqueSaturationLimit(Eigen::VectorXd& newSaturation)
+        void TorqueBalancingController::setTorqueSaturationLimit(const Eigen::VectorXd& newSaturation)
         {
-            yarp::os::LockGuard guard(m_mutex);
-            m_torqueSaturationLimit = newSaturation.array().abs();
+            if (newSaturation.size() != m_actuatedDOFs) return;
+            yarp::os::LockGuard guard(m_parametersMutex);
+            m_clientParameters.torqueSaturationLimit = newSaturation.array().abs();
+            publishParameters();
         }
 
-        const Eigen::VectorXd& TorqueBalancingController::torqueSaturationLimit()
+        Eigen::VectorXd TorqueBalancingController::torqueSaturationLimit()
         {
-            yarp::os::LockGuard guard(m_mutex);
-            return m_torqueSaturationLimit;
+            yarp::os::LockGuard guard(m_parametersMutex);
+            return m_clientParameters.torqueSaturationLimit;
         }
 
         void TorqueBalancingController::setDelegate(ControllerDelegate *delegate)
@@ -330,80 +448,199 @@ namespace codyco {
 
 
         bool TorqueBalancingController::setInitialConstraintSet(const std::vector<std::string> &constraintsLinkName)
+        {
+            return setInitialConstraintSet(constraintsLinkName, std::vector<bool>(constraintsLinkName.size(), true));
+        }
+
+        bool TorqueBalancingController::setInitialConstraintSet(const std::vector<std::string> &constraintsLinkName, const std::vector<bool> &initiallyActive)
         {
             if (isRunning()) return false;
-            //TODO: two days before the demo is not the right moment to make the constraints generic.
-            // For now simply accept the l_sole or r_sole constraints.
-            // move everything to something more generic ASAP
+            if (initiallyActive.size() != constraintsLinkName.size()) {
+                yError("The initial state of the constraints has %d elements, %d expected",
+                       static_cast<int>(initiallyActive.size()), static_cast<int>(constraintsLinkName.size()));
+                return false;
+            }
             bool result = true;
-            m_activeConstraints.clear();
+            m_contacts.clear();
+            m_leftFootContact = m_rightFootContact = -1;
             for (std::vector<std::string>::const_iterator it = constraintsLinkName.begin();
                  it != constraintsLinkName.end(); it++) {
+                int linkID = -1;
+                if (!m_robot.getFrameList().idToIndex(*it, linkID)) {
+                    yError("Constraint frame %s not found", it->c_str());
+                    result = false;
+                    continue;
+                }
+                if (contactIndex(*it) >= 0) {
+                    yError("Constraint frame %s specified more than once", it->c_str());
+                    result = false;
+                    continue;
+                }
                 if ((*it).compare("l_sole") == 0) {
-                    DynamicConstraint leftFoot;
-                    result = result && leftFoot.init(true, getRate() / 1000.0, m_dynamicsTransitionTime);
-                    m_activeConstraints.insert(ConstraintsMap::value_type(*it, leftFoot));
-
+                    m_leftFootContact = m_contacts.size();
                 } else if ((*it).compare("r_sole") == 0) {
-                    DynamicConstraint rightFoot;
-                    result = result && rightFoot.init(true, getRate() / 1000.0, m_dynamicsTransitionTime);
-                    m_activeConstraints.insert(ConstraintsMap::value_type(*it, rightFoot));
+                    m_rightFootContact = m_contacts.size();
                 }
+                m_contacts.push_back(ContactConstraint(*it, linkID));
+                const bool active = initiallyActive[it - constraintsLinkName.begin()];
+                result = result && m_contacts.back().constraint.init(active, getRate() / 1000.0, m_dynamicsTransitionTime);
+            }
+
+            //size all the buffers for the worst case, i.e. all the contacts active
+            const int contactsRows = 6 * m_contacts.size();
+            m_activeContacts.reserve(m_contacts.size());
+            m_desiredContactForces.setZero(contactsRows);
+            m_contactsJacobian.setZero(contactsRows, m_actuatedDOFs + 6);
+            m_contactsDJacobianDq.setZero(contactsRows);
+            m_centroidalForceMatrix.setZero(6, contactsRows);
+            m_pseudoInverseOfJcMInvSt.setZero(m_actuatedDOFs, contactsRows);
+            m_pseudoInverseOfCentroidalForceMatrix.setZero(contactsRows, 6);
+            m_nullSpaceOfCentroidalForceMatrix.setZero(contactsRows, contactsRows);
+            m_pseudoInverseOfTauN0_f.setZero(contactsRows, m_actuatedDOFs);
+
+            const int forceConstraintsRows = TORQUEBALANCING_CONTACTFORCE_CONSTRAINTS * m_contacts.size();
+            m_forceDistributionSolver.resize(contactsRows, forceConstraintsRows);
+            m_forceDistributionContacts.clear();
+            m_forceDistributionContacts.reserve(m_contacts.size());
+            m_forceDistributionHessian.setZero(contactsRows, contactsRows);
+            m_forceDistributionGradient.setZero(contactsRows);
+            m_forceDistributionConstraints.setZero(forceConstraintsRows, contactsRows);
+            m_forceDistributionLowerBounds.setZero(forceConstraintsRows);
+            m_forceDistributionUpperBounds.setZero(forceConstraintsRows);
+            m_forceDistributionSolution.setZero(contactsRows);
+            m_forceDistributionContactForces.setZero(contactsRows);
+            m_forceDistributionNullSpaceForces.setZero(contactsRows);
+            m_forceDistributionTorques.setZero(m_actuatedDOFs);
+
+            return result && !m_contacts.empty();
+        }
+
+        int TorqueBalancingController::contactIndex(const std::string& frameName) const
+        {
+            for (int i = 0; i < static_cast<int>(m_contacts.size()); i++) {
+                if (m_contacts[i].frameName == frameName) return i;
+            }
+            return -1;
+        }
+
+        void TorqueBalancingController::setForceDistributionQP(bool enabled, const ContactForceLimits& limits, const QPSolverSettings& settings)
+        {
+            if (isRunning()) return;
+            m_forceDistributionQP = enabled;
+            m_contactForceLimits = limits;
+            m_forceDistributionSolver.setSettings(settings);
+            m_forceDistributionSolver.resetWarmStart();
+        }
+
+        int TorqueBalancingController::forceDistributionStatistics(double &meanSolveTime, double &maximumSolveTime, double &meanIterations, int &fallbacks)
+        {
+            yarp::os::LockGuard guard(m_mutex);
+            int samples = m_forceDistributionSamples;
+            meanSolveTime = maximumSolveTime = meanIterations = 0;
+            fallbacks = m_forceDistributionFallbacks;
+            if (samples > 0) {
+                meanSolveTime = m_forceDistributionTimeSum / samples;
+                maximumSolveTime = m_forceDistributionTimeMaximum;
+                meanIterations = m_forceDistributionIterationsSum / samples;
             }
+            m_forceDistributionSamples = 0;
+            m_forceDistributionTimeSum = 0;
+            m_forceDistributionTimeMaximum = 0;
+            m_forceDistributionIterationsSum = 0;
+            m_forceDistributionFallbacks = 0;
+            return samples;
+        }
 
-            return result && m_activeConstraints.size() >= 1 && m_activeConstraints.size() <= 2;
+        void TorqueBalancingController::setSynchronousReferenceGenerators(const std::vector<ReferenceGenerator*> &generators)
+        {
+            if (isRunning()) return;
+            m_synchronousReferenceGenerators = generators;
+        }
+
+        int TorqueBalancingController::referenceLatencyStatistics(double &mean, double &stdDeviation, double &maximum)
+        {
+            yarp::os::LockGuard guard(m_mutex);
+            int samples = m_referenceLatencySamples;
+            mean = stdDeviation = maximum = 0;
+            if (samples > 0) {
+                mean = m_referenceLatencySum / samples;
+                double variance = m_referenceLatencySquaredSum / samples - mean * mean;
+                stdDeviation = variance > 0 ? std::sqrt(variance) : 0;
+                maximum = m_referenceLatencyMaximum;
+            }
+            m_referenceLatencySamples = 0;
+            m_referenceLatencySum = 0;
+            m_referenceLatencySquaredSum = 0;
+            m_referenceLatencyMaximum = 0;
+            return samples;
+        }
+
+        void TorqueBalancingController::loopTimingStatistics(iCub::ctrl::realTime::LoopTimingStatistics &statistics)
+        {
+            m_loopTiming.getStatistics(statistics);
         }
 
         bool TorqueBalancingController::addDynamicConstraint(std::string frameName, bool /*smooth*/)
         {
-            //For now full jacobians are not written in an "iterative" way.
-            //just hardcode all the possible scenarios. (as in MATLAB version)
-            //This must be changed in the future
-            //            ConstraintsMap::iterator found = m_activeConstraints.find(frameName);
-            //            if (found != m_activeConstraints.end()) return false;
-            //            DynamicContraint constraint(frameName);
-            //            constraint.createMemory();
-            //            m_activeConstraints.insert(ConstraintsMap::value_type(frameName, constraint));
+            //the registered contacts do not change while the thread runs: no need of the lock for the lookup
+            int found = contactIndex(frameName);
+            if (found < 0) return false;
             yarp::os::LockGuard guard(m_mutex);
-            ConstraintsMap::iterator found = m_activeConstraints.find(frameName);
-            if (found == m_activeConstraints.end()) return false;
-            found->second.activate();
+            m_contacts[found].constraint.activate();
 
             return true;
         }
 
         bool TorqueBalancingController::removeDynamicConstraint(std::string frameName, bool /*smooth*/)
         {
+            int found = contactIndex(frameName);
+            if (found < 0) return false;
             yarp::os::LockGuard guard(m_mutex);
-            ConstraintsMap::iterator found = m_activeConstraints.find(frameName);
-            if (found == m_activeConstraints.end()) return false;
-            found->second.deactivate();
+            m_contacts[found].constraint.deactivate();
 
             return true;
         }
 
 #pragma mark - Monitorable variables
 
-        const Eigen::VectorXd& TorqueBalancingController::desiredFeetForces()
+        Eigen::VectorXd TorqueBalancingController::desiredFeetForces()
         {
-            yarp::os::LockGuard guard(m_mutex);
-            return m_desiredFeetForces;
+            yarp::os::LockGuard guard(m_monitoredVariablesMutex);
+            m_monitoredVariables.update();
+            return m_monitoredVariables.readBuffer().desiredFeetForces;
         }
 
-        const Eigen::VectorXd& TorqueBalancingController::outputTorques()
+        Eigen::VectorXd TorqueBalancingController::outputTorques()
         {
-            yarp::os::LockGuard guard(m_mutex);
-            return m_torques;
+            yarp::os::LockGuard guard(m_monitoredVariablesMutex);
+            m_monitoredVariables.update();
+            return m_monitoredVariables.readBuffer().outputTorques;
+        }
+
+        void TorqueBalancingController::readMonitoredVariables(TorqueBalancingControllerMonitoredVariables& variables)
+        {
+            yarp::os::LockGuard guard(m_monitoredVariablesMutex);
+            m_monitoredVariables.update();
+            variables.desiredFeetForces = m_monitoredVariables.readBuffer().desiredFeetForces;
+            variables.desiredContactForces = m_monitoredVariables.readBuffer().desiredContactForces;
+            variables.outputTorques = m_monitoredVariables.readBuffer().outputTorques;
         }
 
 #pragma mark - Controller methods
 
         void TorqueBalancingController::readReferences()
         {
-            if (m_references.desiredCOMAcceleration().isValid())
-                m_desiredCOMAcceleration = m_references.desiredCOMAcceleration().value();
+            if (m_references.desiredCOMAcceleration().isValid()) {
+                double timestamp = 0;
+                m_references.desiredCOMAcceleration().readValue(m_desiredCOMAcceleration, 0, &timestamp);
+                double latency = yarp::os::Time::now() - timestamp;
+                m_referenceLatencySamples++;
+                m_referenceLatencySum += latency;
+                m_referenceLatencySquaredSum += latency * latency;
+                if (latency > m_referenceLatencyMaximum) m_referenceLatencyMaximum = latency;
+            }
             if (m_references.desiredJointsConfiguration().isValid()) {
-                m_desiredJointsConfiguration = m_references.desiredJointsConfiguration().value();
+                m_references.desiredJointsConfiguration().readValue(m_desiredJointsConfiguration);
             }
         }
 
@@ -435,64 +672,35 @@ namespace codyco {
 
             result = result && m_robot.getEstimates(wbi::ESTIMATE_BASE_VEL, m_baseVelocity.data());
 
-            //update jacobians (both feet in one variable)
-            ConstraintsMap::iterator leftFootConstraint = m_activeConstraints.find("l_sole");
-            if (leftFootConstraint != m_activeConstraints.end()) {
-                leftFootConstraint->second.updateStateInterpolation();
-            }
-            ConstraintsMap::iterator rightFootConstraint = m_activeConstraints.find("r_sole");
-            if (rightFootConstraint != m_activeConstraints.end()) {
-                rightFootConstraint->second.updateStateInterpolation();
-            }
-
-            m_contactsJacobian.setZero();
-            if (leftFootConstraint != m_activeConstraints.end()
-                && leftFootConstraint->second.isActiveWithThreshold(TORQUEBALANCING_STATEACTIVE_THRESHOLD)) {
-                m_jacobianTemporary.setZero();
-                m_robot.computeJacobian(m_jointPositions.data(), m_world2BaseFrame, m_leftFootLinkID, m_jacobianTemporary.data());
-                m_jacobianTemporary *= leftFootConstraint->second.continuousValue();
-                m_contactsJacobian.topRows(6) = m_jacobianTemporary;
-            }
-            if (rightFootConstraint != m_activeConstraints.end()
-                && rightFootConstraint->second.isActiveWithThreshold(TORQUEBALANCING_STATEACTIVE_THRESHOLD)) {
-                m_jacobianTemporary.setZero();
-                m_robot.computeJacobian(m_jointPositions.data(), m_world2BaseFrame, m_rightFootLinkID, m_jacobianTemporary.data());
-                m_jacobianTemporary *= rightFootConstraint->second.continuousValue();
-                m_contactsJacobian.bottomRows(6) = m_jacobianTemporary;
+            //update the activation of the contacts and select the ones used in this cycle
+            updateActiveContacts();
+            const int activeContacts = m_activeContacts.size();
+
+            //update jacobians (active contacts packed in one variable)
+            for (int active = 0; active < activeContacts; active++) {
+                const ContactConstraint& contact = m_contacts[m_activeContacts[active]];
+                //row major: the 6 rows of a contact are a contiguous 6 x totalDOFs matrix
+                m_contactsJacobian.middleRows<6>(6 * active).setZero();
+                m_robot.computeJacobian(m_jointPositions.data(), m_world2BaseFrame, contact.linkID, m_contactsJacobian.row(6 * active).data());
+                m_contactsJacobian.middleRows<6>(6 * active) *= contact.constraint.continuousValue();
             }
 
             //update kinematic quantities
             m_robot.forwardKinematics(m_jointPositions.data(), m_world2BaseFrame, m_centerOfMassLinkID, m_rotoTranslationVector.data());
             m_centerOfMassPosition = m_rotoTranslationVector.head<3>();
-            m_robot.forwardKinematics(m_jointPositions.data(), m_world2BaseFrame, m_leftFootLinkID, m_leftFootPosition.data());
-            m_robot.forwardKinematics(m_jointPositions.data(), m_world2BaseFrame, m_rightFootLinkID, m_rightFootPosition.data());
-//            yarp::sig::Vector &v = debugPort.prepare();
-//            v.resize(6+16);
-//            v(0) = m_leftFootPosition(0) - m_centerOfMassPosition(0);
-//            v(1) = m_leftFootPosition(1) - m_centerOfMassPosition(1);
-//            v(2) = m_leftFootPosition(2) - m_centerOfMassPosition(2);
-//            v(3) = m_rightFootPosition(0) - m_centerOfMassPosition(0);
-//            v(4) = m_rightFootPosition(1) - m_centerOfMassPosition(1);
-//            v(5) = m_rightFootPosition(2) - m_centerOfMassPosition(2);
-//            for (int i = 0; i < 16; i++) {
-//                v(6+ i) = m_world2BaseFrameSerialization.data()[i];
-//            }
-//            debugPort.write();
+            for (int active = 0; active < activeContacts; active++) {
+                ContactConstraint& contact = m_contacts[m_activeContacts[active]];
+                m_robot.forwardKinematics(m_jointPositions.data(), m_world2BaseFrame, contact.linkID, contact.position.data());
+            }
 
             //update dynamic quantities
             m_robot.computeMassMatrix(m_jointPositions.data(), m_world2BaseFrame, m_massMatrix.data());
             m_robot.computeCentroidalMomentum(m_jointPositions.data(), m_world2BaseFrame, m_jointVelocities.data(), m_baseVelocity.data(), m_centroidalMomentum.data());
 
-            m_contactsDJacobianDq.setZero();
-            if (leftFootConstraint != m_activeConstraints.end()
-                && leftFootConstraint->second.isActiveWithThreshold(TORQUEBALANCING_STATEACTIVE_THRESHOLD)) {
-                m_robot.computeDJdq(m_jointPositions.data(), m_world2BaseFrame, m_jointVelocities.data(), m_baseVelocity.data(), m_leftFootLinkID, m_contactsDJacobianDq.head(6).data());
-                m_contactsDJacobianDq.head(6) *= leftFootConstraint->second.continuousValue();
-            }
-            if (rightFootConstraint != m_activeConstraints.end()
-                && rightFootConstraint->second.isActiveWithThreshold(TORQUEBALANCING_STATEACTIVE_THRESHOLD)) {
-                m_robot.computeDJdq(m_jointPositions.data(), m_world2BaseFrame, m_jointVelocities.data(), m_baseVelocity.data(), m_rightFootLinkID, m_contactsDJacobianDq.tail(6).data());
-                m_contactsDJacobianDq.tail(6) *= rightFootConstraint->second.continuousValue();
+            for (int active = 0; active < activeContacts; active++) {
+                const ContactConstraint& contact = m_contacts[m_activeContacts[active]];
+                m_robot.computeDJdq(m_jointPositions.data(), m_world2BaseFrame, m_jointVelocities.data(), m_baseVelocity.data(), contact.linkID, m_contactsDJacobianDq.segment<6>(6 * active).data());
+                m_contactsDJacobianDq.segment<6>(6 * active) *= contact.constraint.continuousValue();
             }
 
             //Compute bias forces
@@ -505,6 +713,18 @@ namespace codyco {
             return result;
         }
 
+        void TorqueBalancingController::updateActiveContacts()
+        {
+            //the capacity is reserved by setInitialConstraintSet: no allocation here
+            m_activeContacts.clear();
+            for (int i = 0; i < static_cast<int>(m_contacts.size()); i++) {
+                m_contacts[i].constraint.updateStateInterpolation();
+                if (m_contacts[i].constraint.isActiveWithThreshold(TORQUEBALANCING_STATEACTIVE_THRESHOLD)) {
+                    m_activeContacts.push_back(i);
+                }
+            }
+        }
+
         void TorqueBalancingController::computeContactForces(const Eigen::Ref<Eigen::VectorXd>& desiredCOMAcceleration, Eigen::Ref<Eigen::VectorXd> desiredContactForces)
         {
 #if defined(DEBUG) && defined(EIGEN_RUNTIME_NO_MALLOC)
@@ -514,30 +734,17 @@ namespace codyco {
             double mass = m_massMatrix(0, 0);
             m_gravityForce(2) = -mass * 9.81;
 
-            ConstraintsMap::const_iterator leftFootConstraint = m_activeConstraints.find("l_sole");
-            ConstraintsMap::const_iterator rightFootConstraint = m_activeConstraints.find("r_sole");
-
-            //building centroidalForceMatrix
-            bool leftConstraintIsActive = false;
-            bool rightConstraintIsActive = false;
-
-            m_centroidalForceMatrix.setZero();
-            if (leftFootConstraint != m_activeConstraints.end()
-                && leftFootConstraint->second.isActiveWithThreshold(TORQUEBALANCING_STATEACTIVE_THRESHOLD)) {
-                leftConstraintIsActive = true;
-                m_centroidalForceMatrix.block<3, 3>(0, 0).setIdentity();
-                m_centroidalForceMatrix.block<3, 3>(3, 3).setIdentity();
-                math::skewSymmentricMatrixFrom3DVector(m_leftFootPosition.head<3>() - m_centerOfMassPosition, m_centroidalForceMatrix.block<3, 3>(3, 0));
-                m_centroidalForceMatrix.leftCols(6) *= leftFootConstraint->second.continuousValue();
-            }
-
-            if (rightFootConstraint != m_activeConstraints.end()
-                && rightFootConstraint->second.isActiveWithThreshold(TORQUEBALANCING_STATEACTIVE_THRESHOLD)) {
-                rightConstraintIsActive = true;
-                m_centroidalForceMatrix.block<3, 3>(0, 6).setIdentity();
-                m_centroidalForceMatrix.block<3, 3>(3, 9).setIdentity();
-                math::skewSymmentricMatrixFrom3DVector(m_rightFootPosition.head<3>() - m_centerOfMassPosition, m_centroidalForceMatrix.block<3, 3>(3, 6));
-                m_centroidalForceMatrix.rightCols(6) *= rightFootConstraint->second.continuousValue();
+            const int activeContacts = m_activeContacts.size();
+            const int contactsRows = 6 * activeContacts;
+
+            //building centroidalForceMatrix (active contacts only)
+            for (int active = 0; active < activeContacts; active++) {
+                const ContactConstraint& contact = m_contacts[m_activeContacts[active]];
+                m_centroidalForceMatrix.middleCols<6>(6 * active).setZero();
+                m_centroidalForceMatrix.block<3, 3>(0, 6 * active).setIdentity();
+                m_centroidalForceMatrix.block<3, 3>(3, 6 * active + 3).setIdentity();
+                math::skewSymmentricMatrixFrom3DVector(contact.position.head<3>() - m_centerOfMassPosition, m_centroidalForceMatrix.block<3, 3>(3, 6 * active));
+                m_centroidalForceMatrix.middleCols<6>(6 * active) *= contact.constraint.continuousValue();
             }
 
             m_desiredCentroidalMomentum.head<3>() = mass * desiredCOMAcceleration;
@@ -548,29 +755,30 @@ namespace codyco {
             //Becaues it is not stable yet we use the explicit computation of the SVD
             //            m_svdDecompositionOfCentroidalForceMatrix.compute(m_centroidalForceMatrix).solve(m_desiredCentroidalMomentum - m_gravityForce);
             m_buffers.esaVector = m_desiredCentroidalMomentum - m_gravityForce;
-            if (leftConstraintIsActive ^ rightConstraintIsActive) {
-                m_desiredFeetForces.setZero();
+            desiredContactForces.setZero();
+            if (activeContacts == 1) {
                 //substitute the pseudoinverse with its inverse
-                m_luDecompositionOfCentroidalMatrix.compute(m_centroidalForceMatrix.block<6, 6>(0, leftConstraintIsActive ? 0 : 6));
-                m_desiredFeetForces.segment(leftConstraintIsActive ? 0 : 6, 6) = m_luDecompositionOfCentroidalMatrix.solve(m_buffers.esaVector);
-                m_nullSpaceOfCentroidalForceMatrix.setZero();
+                m_luDecompositionOfCentroidalMatrix.compute(m_centroidalForceMatrix.leftCols<6>());
+                desiredContactForces.head<6>() = m_luDecompositionOfCentroidalMatrix.solve(m_buffers.esaVector);
+                m_nullSpaceOfCentroidalForceMatrix.topLeftCorner<6, 6>().setZero();
 
-            } else {
-                math::pseudoInverse(m_centroidalForceMatrix, m_svdDecompositionOfCentroidalForceMatrix,
-                                    m_pseudoInverseOfCentroidalForceMatrix, PseudoInverseTolerance);
-                m_desiredFeetForces.noalias() = m_pseudoInverseOfCentroidalForceMatrix * m_buffers.esaVector;
+            } else if (activeContacts > 1) {
+                MatrixXd::ColsBlockXpr centroidalForceMatrix = m_centroidalForceMatrix.leftCols(contactsRows);
+                MatrixXd::RowsBlockXpr pseudoInverseOfCentroidalForceMatrix = m_pseudoInverseOfCentroidalForceMatrix.topRows(contactsRows);
+                math::pseudoInverse(centroidalForceMatrix, m_svdDecompositionOfCentroidalForceMatrix,
+                                    pseudoInverseOfCentroidalForceMatrix, PseudoInverseTolerance);
+                desiredContactForces.head(contactsRows).noalias() = pseudoInverseOfCentroidalForceMatrix * m_buffers.esaVector;
 
                 //TODO: change the following line by using the null space basis obtained by the pseudoinverse method
-                m_nullSpaceOfCentroidalForceMatrix.setIdentity();
-                m_nullSpaceOfCentroidalForceMatrix -= m_pseudoInverseOfCentroidalForceMatrix * m_centroidalForceMatrix;
+                m_nullSpaceOfCentroidalForceMatrix.topLeftCorner(contactsRows, contactsRows).setIdentity();
+                m_nullSpaceOfCentroidalForceMatrix.topLeftCorner(contactsRows, contactsRows).noalias() -= pseudoInverseOfCentroidalForceMatrix * centroidalForceMatrix;
             }
-            desiredContactForces = m_desiredFeetForces;
 #if defined(DEBUG) && defined(EIGEN_RUNTIME_NO_MALLOC)
             Eigen::internal::set_is_malloc_allowed(true);
 #endif
         }
 
-        void TorqueBalancingController::computeTorques(const Eigen::Ref<Eigen::VectorXd>& desiredContactForces, Eigen::Ref<Eigen::VectorXd> torques)
+        void TorqueBalancingController::computeTorques(Eigen::Ref<Eigen::VectorXd> desiredContactForces, Eigen::Ref<Eigen::VectorXd> torques)
         {
             using namespace Eigen;
 
@@ -578,36 +786,62 @@ namespace codyco {
             Eigen::internal::set_is_malloc_allowed(false);
 #endif
 
-            //Names are taken from "math" from brevity
-            MatrixXd JcMInv = m_contactsJacobian * m_massMatrix.inverse(); //to become instance (?)
-            MatrixXd JcMInvJct = JcMInv * m_contactsJacobian.transpose(); //to become instance (?)
-            MatrixXd JcMInvTorqueSelector = JcMInv * m_torquesSelector; //to become instance (?)
-            MatrixXd jointProjectedBaseAccelerations = m_massMatrix.block(6, 0, m_actuatedDOFs, 6) * m_massMatrix.topLeftCorner<6, 6>().inverse();
+            //Only the rows of the active contacts are used
+            const int contactsRows = 6 * m_activeContacts.size();
 
-            math::dampedPseudoInverse(JcMInvTorqueSelector, m_svdDecompositionOfJcMInvSt, m_pseudoInverseOfJcMInvSt,
-                                      PseudoInverseTolerance,
-                                      JcMInvSPseudoInverseDampingTerm);
-            math::pseudoInverse(JcMInvTorqueSelector, m_svdDecompositionOfJcMInvSt,
-                                m_pseudoInverseOfJcMInvSt, PseudoInverseTolerance);
-            //TODO: change the following line by using the null space basis obtained by the pseudoinverse method
-            MatrixXd JcNullSpaceProjector = MatrixXd::Identity(m_actuatedDOFs, m_actuatedDOFs) - m_pseudoInverseOfJcMInvSt * JcMInvTorqueSelector;
-
-            MatrixXd mult_f_tau0 =  jointProjectedBaseAccelerations * m_contactsJacobian.leftCols(6).transpose() - m_contactsJacobian.rightCols(m_actuatedDOFs).transpose();
+            MatrixXd jointProjectedBaseAccelerations = m_massMatrix.block(6, 0, m_actuatedDOFs, 6) * m_massMatrix.topLeftCorner<6, 6>().inverse();
 
             VectorXd  torques0 =  m_gravityBiasTorques.tail(m_actuatedDOFs) - m_impedanceGains.asDiagonal() * (m_jointPositions - m_desiredJointsConfiguration) - jointProjectedBaseAccelerations * m_generalizedBiasForces.head<6>();
 
-            MatrixXd mult_f_tau = -m_pseudoInverseOfJcMInvSt * JcMInvJct + JcNullSpaceProjector * mult_f_tau0;
-
-            VectorXd n_tau = m_pseudoInverseOfJcMInvSt * (JcMInv * m_generalizedBiasForces - m_contactsDJacobianDq) + JcNullSpaceProjector * torques0;
-
-            //TODO: change the following line by using the null space basis obtained by the pseudoinverse method
-//            MatrixXd forceMatrixNullSpaceProjector = MatrixXd::Identity(12, 12) - m_pseudoInverseOfCentroidalForceMatrix * m_centroidalForceMatrix;
-
-            MatrixXd mat = mult_f_tau * m_nullSpaceOfCentroidalForceMatrix;
-
-            math::pseudoInverse(mult_f_tau * m_nullSpaceOfCentroidalForceMatrix, m_svdDecompositionOfTauN0_f,m_pseudoInverseOfTauN0_f, PseudoInverseTolerance, Eigen::ComputeFullV|Eigen::ComputeFullU);
-
-            torques = (MatrixXd::Identity(n_tau.size(), n_tau.size()) -mult_f_tau * m_nullSpaceOfCentroidalForceMatrix * m_pseudoInverseOfTauN0_f) * (n_tau + mult_f_tau * desiredContactForces);
+            if (contactsRows == 0) {
+                //no contact forces: only the null space (postural) torques
+                torques = torques0;
+            } else {
+                ContactsJacobian::RowsBlockXpr contactsJacobian = m_contactsJacobian.topRows(contactsRows);
+                MatrixXd::ColsBlockXpr pseudoInverseOfJcMInvSt = m_pseudoInverseOfJcMInvSt.leftCols(contactsRows);
+                Block<MatrixXd> nullSpaceOfCentroidalForceMatrix = m_nullSpaceOfCentroidalForceMatrix.topLeftCorner(contactsRows, contactsRows);
+                MatrixXd::RowsBlockXpr pseudoInverseOfTauN0_f = m_pseudoInverseOfTauN0_f.topRows(contactsRows);
+
+                //Names are taken from "math" from brevity
+                MatrixXd JcMInv = contactsJacobian * m_massMatrix.inverse(); //to become instance (?)
+                MatrixXd JcMInvJct = JcMInv * contactsJacobian.transpose(); //to become instance (?)
+                MatrixXd JcMInvTorqueSelector = JcMInv * m_torquesSelector; //to become instance (?)
+
+                math::dampedPseudoInverse(JcMInvTorqueSelector, m_svdDecompositionOfJcMInvSt, pseudoInverseOfJcMInvSt,
+                                          PseudoInverseTolerance,
+                                          JcMInvSPseudoInverseDampingTerm);
+                math::pseudoInverse(JcMInvTorqueSelector, m_svdDecompositionOfJcMInvSt,
+                                    pseudoInverseOfJcMInvSt, PseudoInverseTolerance);
+                //TODO: change the following line by using the null space basis obtained by the pseudoinverse method
+                MatrixXd JcNullSpaceProjector = MatrixXd::Identity(m_actuatedDOFs, m_actuatedDOFs) - pseudoInverseOfJcMInvSt * JcMInvTorqueSelector;
+
+                MatrixXd mult_f_tau0 =  jointProjectedBaseAccelerations * contactsJacobian.leftCols(6).transpose() - contactsJacobian.rightCols(m_actuatedDOFs).transpose();
+
+                MatrixXd mult_f_tau = -pseudoInverseOfJcMInvSt * JcMInvJct + JcNullSpaceProjector * mult_f_tau0;
+
+                VectorXd n_tau = pseudoInverseOfJcMInvSt * (JcMInv * m_generalizedBiasForces - m_contactsDJacobianDq.head(contactsRows)) + JcNullSpaceProjector * torques0;
+
+                math::pseudoInverse(mult_f_tau * nullSpaceOfCentroidalForceMatrix, m_svdDecompositionOfTauN0_f, pseudoInverseOfTauN0_f, PseudoInverseTolerance, Eigen::ComputeFullV|Eigen::ComputeFullU);
+
+                if (!m_forceDistributionQP) {
+                    torques = (MatrixXd::Identity(n_tau.size(), n_tau.size()) -mult_f_tau * nullSpaceOfCentroidalForceMatrix * pseudoInverseOfTauN0_f) * (n_tau + mult_f_tau * desiredContactForces.head(contactsRows));
+                } else {
+                    //same torques as above, but through the contact forces: the ones giving the desired
+                    //momentum derivative with the minimum torques. Then project them on the contact limits
+                    //computed in the preallocated buffers: this branch does not allocate
+                    VectorBlock<VectorXd> contactForces = m_forceDistributionContactForces.head(contactsRows);
+                    VectorBlock<VectorXd> nullSpaceForces = m_forceDistributionNullSpaceForces.head(contactsRows);
+                    m_forceDistributionTorques = n_tau;
+                    m_forceDistributionTorques.noalias() += mult_f_tau * desiredContactForces.head(contactsRows);
+                    nullSpaceForces.noalias() = pseudoInverseOfTauN0_f * m_forceDistributionTorques;
+                    contactForces = desiredContactForces.head(contactsRows);
+                    contactForces.noalias() -= nullSpaceOfCentroidalForceMatrix * nullSpaceForces;
+                    distributeContactForces(contactForces);
+                    torques = n_tau;
+                    torques.noalias() += mult_f_tau * contactForces;
+                    desiredContactForces.head(contactsRows) = contactForces;
+                }
+            }
 
 //            m_buffers.totalDoFsLDLTDecomposition.compute(m_massMatrix);
 //            Eigen::internal::solve_retval<LDLT<MatrixXd::PlainObject>, MatrixXd> var =
@@ -656,6 +890,101 @@ namespace codyco {
 #endif
         }
 
+        bool TorqueBalancingController::distributeContactForces(Eigen::Ref<Eigen::VectorXd> contactForces)
+        {
+            using namespace Eigen;
+            double startTime = yarp::os::Time::now();
+
+            const int activeContacts = m_activeContacts.size();
+            const int contactsRows = 6 * activeContacts;
+            const int constraintsRows = TORQUEBALANCING_CONTACTFORCE_CONSTRAINTS * activeContacts;
+            const double infinity = std::numeric_limits<double>::max();
+
+            //the previous solution is meaningful only for the same contacts
+            if (m_forceDistributionContacts != m_activeContacts) {
+                m_forceDistributionSolver.resetWarmStart();
+                m_forceDistributionContacts = m_activeContacts;
+            }
+
+            //cost: error on the momentum derivative plus distance from the unconstrained forces f*
+            //1/2 (f - f*)' (A'A + regularization I) (f - f*), as A f* is the desired momentum derivative
+            MatrixXd::ColsBlockXpr centroidalForceMatrix = m_centroidalForceMatrix.leftCols(contactsRows);
+            Block<MatrixXd> hessian = m_forceDistributionHessian.topLeftCorner(contactsRows, contactsRows);
+            VectorBlock<VectorXd> gradient = m_forceDistributionGradient.head(contactsRows);
+            hessian.noalias() = centroidalForceMatrix.transpose() * centroidalForceMatrix;
+            hessian.diagonal().array() += m_contactForceLimits.regularization;
+            gradient.noalias() = -hessian * contactForces;
+
+            //constraints on the wrench of each contact, expressed in the contact frame (z axis normal to the contact):
+            //unilaterality, friction (inscribed pyramid), center of pressure and torsional friction
+            Block<MatrixXd> constraints = m_forceDistributionConstraints.topLeftCorner(constraintsRows, contactsRows);
+            VectorBlock<VectorXd> lowerBounds = m_forceDistributionLowerBounds.head(constraintsRows);
+            VectorBlock<VectorXd> upperBounds = m_forceDistributionUpperBounds.head(constraintsRows);
+            const double friction = m_contactForceLimits.frictionCoefficient / std::sqrt(2.0);
+            const double torsionalFriction = m_contactForceLimits.torsionalFrictionCoefficient;
+            const double *copLimits = m_contactForceLimits.centerOfPressureLimits;
+            constraints.setZero();
+            for (int active = 0; active < activeContacts; active++) {
+                const Matrix<double, 7, 1>& position = m_contacts[m_activeContacts[active]].position;
+                Matrix3d rotation = AngleAxisd(position(6), position.segment<3>(3)).toRotationMatrix();
+                Vector3d tangentX = rotation.col(0);
+                Vector3d tangentY = rotation.col(1);
+                Vector3d normal = rotation.col(2);
+
+                Block<MatrixXd, TORQUEBALANCING_CONTACTFORCE_CONSTRAINTS, 6> contactConstraints =
+                m_forceDistributionConstraints.block<TORQUEBALANCING_CONTACTFORCE_CONSTRAINTS, 6>(TORQUEBALANCING_CONTACTFORCE_CONSTRAINTS * active, 6 * active);
+                //normal force
+                contactConstraints.block<1, 3>(0, 0) = normal.transpose();
+                //friction: |f_t| <= mu f_n
+                contactConstraints.block<1, 3>(1, 0) = (tangentX - friction * normal).transpose();
+                contactConstraints.block<1, 3>(2, 0) = (tangentX + friction * normal).transpose();
+                contactConstraints.block<1, 3>(3, 0) = (tangentY - friction * normal).transpose();
+                contactConstraints.block<1, 3>(4, 0) = (tangentY + friction * normal).transpose();
+                //center of pressure: x = -m_y / f_n, y = m_x / f_n
+                contactConstraints.block<1, 3>(5, 0) = -copLimits[1] * normal.transpose();
+                contactConstraints.block<1, 3>(5, 3) = -tangentY.transpose();
+                contactConstraints.block<1, 3>(6, 0) = -copLimits[0] * normal.transpose();
+                contactConstraints.block<1, 3>(6, 3) = -tangentY.transpose();
+                contactConstraints.block<1, 3>(7, 0) = -copLimits[3] * normal.transpose();
+                contactConstraints.block<1, 3>(7, 3) = tangentX.transpose();
+                contactConstraints.block<1, 3>(8, 0) = -copLimits[2] * normal.transpose();
+                contactConstraints.block<1, 3>(8, 3) = tangentX.transpose();
+                //torsional friction: |m_n| <= mu_t f_n
+                contactConstraints.block<1, 3>(9, 0) = -torsionalFriction * normal.transpose();
+                contactConstraints.block<1, 3>(9, 3) = normal.transpose();
+                contactConstraints.block<1, 3>(10, 0) = torsionalFriction * normal.transpose();
+                contactConstraints.block<1, 3>(10, 3) = normal.transpose();
+
+                //rows 1, 3, 5, 7, 9 are upper bounded by zero, rows 2, 4, 6, 8, 10 are lower bounded by zero
+                VectorBlock<VectorXd, TORQUEBALANCING_CONTACTFORCE_CONSTRAINTS> lower =
+                m_forceDistributionLowerBounds.segment<TORQUEBALANCING_CONTACTFORCE_CONSTRAINTS>(TORQUEBALANCING_CONTACTFORCE_CONSTRAINTS * active);
+                VectorBlock<VectorXd, TORQUEBALANCING_CONTACTFORCE_CONSTRAINTS> upper =
+                m_forceDistributionUpperBounds.segment<TORQUEBALANCING_CONTACTFORCE_CONSTRAINTS>(TORQUEBALANCING_CONTACTFORCE_CONSTRAINTS * active);
+                lower(0) = m_contactForceLimits.minimumNormalForce;
+                upper(0) = infinity;
+                for (int row = 1; row < TORQUEBALANCING_CONTACTFORCE_CONSTRAINTS; row += 2) {
+                    lower(row) = -infinity;
+                    upper(row) = 0;
+                    lower(row + 1) = 0;
+                    upper(row + 1) = infinity;
+                }
+            }
+
+            VectorBlock<VectorXd> solution = m_forceDistributionSolution.head(contactsRows);
+            QPSolverStatus status = m_forceDistributionSolver.solve(hessian, gradient, constraints, lowerBounds, upperBounds, solution);
+            bool solved = status == QPSolverStatusSolved;
+            //otherwise keep the unconstrained forces
+            if (solved) contactForces = solution;
+
+            double solveTime = yarp::os::Time::now() - startTime;
+            m_forceDistributionSamples++;
+            m_forceDistributionTimeSum += solveTime;
+            if (solveTime > m_forceDistributionTimeMaximum) m_forceDistributionTimeMaximum = solveTime;
+            m_forceDistributionIterationsSum += m_forceDistributionSolver.iterations();
+            if (!solved) m_forceDistributionFallbacks++;
+            return solved;
+        }
+
         void TorqueBalancingController::writeTorques()
         {
             m_robot.setControlReference(m_torques.data());
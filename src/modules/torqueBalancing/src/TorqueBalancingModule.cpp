@@ -33,6 +33,7 @@
 #include <yarp/os/LockGuard.h>
 #include <yarp/dev/ControlBoardPid.h>
 #include <iostream>
+#include <algorithm>
 #include <sstream>
 #include <vector>
 
@@ -61,9 +62,11 @@ namespace codyco {
         , m_references(0)
         , m_rpcPort(0)
         , m_constraintsPort(0)
+        , m_timingPort(0)
         , m_paramHelperManager(0)
         , m_tempHeptaVector(7)
-        , m_comReference(3) {}
+        , m_comReference(3)
+        , m_streamedCOMReference(9) {}
 
         TorqueBalancingModule::~TorqueBalancingModule() { cleanup(); }
 
@@ -99,6 +102,7 @@ namespace codyco {
             double actuatedDOFs = iCubMainJoints.size();
 
             m_jointsConfiguration.resize(actuatedDOFs);
+            m_streamedJointsReference.resize(actuatedDOFs);
 
             //Load configuration-time parameters
             m_moduleName = rf.check("name", Value("torqueBalancing"), "Looking for module name").asString();
@@ -112,6 +116,8 @@ namespace codyco {
             Value falseValue;
             falseValue.fromString("false");
             bool autoStart = rf.check("autostart", falseValue, "Looking for autostart option").asBool();
+            bool synchronousReferences = rf.check("synchronousReferences", falseValue, "Looking for synchronous references option").asBool();
+            bool comSmoothDerivatives = rf.check("comSmoothDerivatives", falseValue, "Looking for CoM smoother derivatives option").asBool();
 
             //Check smooth parameter
             //Structure is: key: smooth
@@ -190,6 +196,13 @@ namespace codyco {
                 return false;
             }
 
+            m_timingPort = new yarp::os::BufferedPort<yarp::os::Bottle>();
+            if (!m_timingPort
+                || !m_timingPort->open(("/" + getName("/timing:o")).c_str())) {
+                yError("Could not open timing port: /%s/timing:o", m_moduleName.c_str());
+                return false;
+            }
+
             m_constraintsPort = new yarp::os::BufferedPort<yarp::os::Bottle>();
             if (!m_constraintsPort
                 || !m_constraintsPort->open(("/" + getName("/constraints:i")).c_str())) {
@@ -289,6 +302,11 @@ namespace codyco {
                     MinimumJerkTrajectoryGenerator comSmoother(3);
                     comSmoother.initializeTimeParameters(m_controllerThreadPeriod/1000, comSmoothDuration);
                     generator->setReferenceFilter(&comSmoother);
+                    if (comSmoothDerivatives) {
+                        //the output of the com generator is the desired acceleration
+                        yInfo("COM smoother derivatives are used as velocity reference and feedforward");
+                        generator->setReferenceFilterDerivativesEnabled(true);
+                    }
                 }
                 generator->setSignalReference(m_comReference);
                 m_referenceGenerators.insert(std::pair<TaskType, ReferenceGenerator*>(TaskTypeCOM, generator));
@@ -332,6 +350,14 @@ namespace codyco {
             }
             m_controller->setDelegate(this);
             m_controller->setCheckJointLimits(checkJointLimits);
+            if (synchronousReferences) {
+                //the generators are stepped by the controller, CoM first and then posture
+                yInfo("Reference generators are stepped synchronously by the controller");
+                std::vector<ReferenceGenerator*> generators;
+                generators.push_back(m_referenceGenerators[TaskTypeCOM]);
+                generators.push_back(m_referenceGenerators[TaskTypeImpedanceControl]);
+                m_controller->setSynchronousReferenceGenerators(generators);
+            }
 
             //link controller and references variables to param helper manager
             if (!m_paramHelperManager->linkVariables()
@@ -362,17 +388,56 @@ namespace codyco {
                 constraintsLinkName.push_back("l_sole");
                 constraintsLinkName.push_back("r_sole");
             }
-            if (!m_controller->setInitialConstraintSet(constraintsLinkName)) {
+
+            //Constraints not in contact at startup
+            std::vector<bool> constraintsInitiallyActive(constraintsLinkName.size(), true);
+            if (rf.check("inactive_constraint_links", "Checking rigid constraints inactive at startup")) {
+                Bottle *list = rf.find("inactive_constraint_links").asList();
+                for (int i = 0; list && i < list->size(); i++) {
+                    std::vector<std::string>::const_iterator found = std::find(constraintsLinkName.begin(), constraintsLinkName.end(), list->get(i).asString());
+                    if (found == constraintsLinkName.end()) {
+                        yError("Inactive constraint %s is not in constraint_links", list->get(i).asString().c_str());
+                        return false;
+                    }
+                    constraintsInitiallyActive[found - constraintsLinkName.begin()] = false;
+                }
+            }
+            if (!m_controller->setInitialConstraintSet(constraintsLinkName, constraintsInitiallyActive)) {
                 yError("Could not set initial dynamic constraints.");
                 return false;
             }
 
+            //Contact forces distribution through the QP (limits in the contact frames)
+            bool forceDistributionQP = rf.check("forceDistributionQP", falseValue, "Looking for contact forces QP option").asBool();
+            ContactForceLimits contactForceLimits;
+            contactForceLimits.frictionCoefficient = rf.check("frictionCoefficient", Value(contactForceLimits.frictionCoefficient), "Looking for friction coefficient").asDouble();
+            contactForceLimits.torsionalFrictionCoefficient = rf.check("torsionalFrictionCoefficient", Value(contactForceLimits.torsionalFrictionCoefficient), "Looking for torsional friction coefficient").asDouble();
+            contactForceLimits.minimumNormalForce = rf.check("minimumNormalForce", Value(contactForceLimits.minimumNormalForce), "Looking for minimum normal force").asDouble();
+            contactForceLimits.regularization = rf.check("forceDistributionRegularization", Value(contactForceLimits.regularization), "Looking for contact forces regularization").asDouble();
+            if (rf.check("centerOfPressureLimits", "Looking for center of pressure limits")) {
+                Bottle *limits = rf.find("centerOfPressureLimits").asList();
+                if (!limits || limits->size() != 4) {
+                    yError("centerOfPressureLimits must be a list of 4 values (xMin xMax yMin yMax)");
+                    return false;
+                }
+                for (int i = 0; i < 4; i++) {
+                    contactForceLimits.centerOfPressureLimits[i] = limits->get(i).asDouble();
+                }
+            }
+            QPSolverSettings qpSettings;
+            qpSettings.maxIterations = rf.check("qpMaxIterations", Value(qpSettings.maxIterations), "Looking for QP iterations budget").asInt();
+            //by default leave most of the control period to the rest of the cycle
+            qpSettings.maxTime = rf.check("qpMaxTime", Value(0.2 * m_controllerThreadPeriod), "Looking for QP time budget [ms]").asDouble() * 1e-3;
+            m_controller->setForceDistributionQP(forceDistributionQP, contactForceLimits, qpSettings);
+
             //start threads. Controllers start always in inactive state
             //This is needed because they have to be initialized before setting gains, etc..
             bool threadsStarted = true;
 
-            for (std::map<TaskType, ReferenceGenerator*>::iterator it = m_referenceGenerators.begin(); it != m_referenceGenerators.end(); it++) {
-                threadsStarted = threadsStarted && it->second->start();
+            if (!synchronousReferences) {
+                for (std::map<TaskType, ReferenceGenerator*>::iterator it = m_referenceGenerators.begin(); it != m_referenceGenerators.end(); it++) {
+                    threadsStarted = threadsStarted && it->second->start();
+                }
             }
             threadsStarted = threadsStarted && m_controller->start();
 
@@ -398,27 +463,52 @@ namespace codyco {
                 return false;
             }
 
-            m_paramHelperManager->syncLinkedVariables();
             monitorVariables();
 
             static int counter = 0;
             counter = (counter + 1) % (static_cast<int>(5 / m_modulePeriod)); //every 5 seconds
 
             if (counter == 0) {
-                double periodMean = 0, periodStdDeviation = 0;
-                double usedMean = 0, usedStdDeviation = 0;
+                reportLoopTiming();
 
-                m_controller->getEstPeriod(periodMean, periodStdDeviation);
-                m_controller->getEstUsed(usedMean, usedStdDeviation);
+                //age of the CoM reference when used by the controller: its standard deviation is the phase jitter between the threads
+                double latencyMean = 0, latencyStdDeviation = 0, latencyMaximum = 0;
+                if (m_controller->referenceLatencyStatistics(latencyMean, latencyStdDeviation, latencyMaximum) > 0) {
+                    yInfo("Reference latency: %lf +/- %lf [ms] (max %lf [ms])", 1e3 * latencyMean, 1e3 * latencyStdDeviation, 1e3 * latencyMaximum);
+                }
 
-                if (periodMean > 1.3 * m_controllerThreadPeriod) {
-                    yWarning("Control loop is too slow. Real period: %lf +/- %lf. Expected period: %d[ms]\nDuration of 'run' method: %lf +/- %lf", periodMean, periodStdDeviation, m_controllerThreadPeriod, usedMean, usedStdDeviation);
+                double qpMeanTime = 0, qpMaximumTime = 0, qpMeanIterations = 0;
+                int qpFallbacks = 0;
+                if (m_controller->forceDistributionStatistics(qpMeanTime, qpMaximumTime, qpMeanIterations, qpFallbacks) > 0) {
+                    yInfo("Contact forces QP: %lf [ms] (max %lf [ms]), %lf iterations, %d fallbacks", 1e3 * qpMeanTime, 1e3 * qpMaximumTime, qpMeanIterations, qpFallbacks);
                 }
             }
 
             return true;
         }
 
+        void TorqueBalancingModule::reportLoopTiming()
+        {
+            iCub::ctrl::realTime::LoopTimingStatistics statistics;
+            m_controller->loopTimingStatistics(statistics);
+            {
+                yarp::os::LockGuard guard(m_loopTimingMutex);
+                m_loopTimingStatistics = statistics;
+            }
+
+            if (m_timingPort) {
+                yarp::os::Bottle &bottle = m_timingPort->prepare();
+                bottle.clear();
+                statistics.toBottle(bottle);
+                m_timingPort->write();
+            }
+
+            //a single late cycle can destabilize the balancing: do not look only at the mean period
+            if (statistics.lateTicks > 0 || statistics.overruns > 0) {
+                yWarning("Control loop missed its deadline (expected period: %d[ms]). %s", m_controllerThreadPeriod, statistics.toString().c_str());
+            }
+        }
+
         bool TorqueBalancingModule::close()
         {
             setControllersActiveState(false);
@@ -456,6 +546,12 @@ namespace codyco {
                 m_eventsPort = 0;
             }
 
+            if (m_timingPort) {
+                m_timingPort->close();
+                delete m_timingPort;
+                m_timingPort = 0;
+            }
+
             //close controller thread
             if (m_controller) {
                 m_controller->setDelegate(NULL);
@@ -503,19 +599,20 @@ namespace codyco {
                 taskType = TaskTypeCOM;
                 std::map<TaskType, ReferenceGenerator*>::iterator found = m_referenceGenerators.find(taskType);
                 if (found != m_referenceGenerators.end()) {
-                    const Eigen::VectorXd &newReference = reference.value();
+                    reference.readValue(m_streamedCOMReference);
                     //check if smoother is active.
                     if (found->second->referenceFilter()) {
-                        found->second->setSignalReference(newReference.head(3));
+                        found->second->setSignalReference(m_streamedCOMReference.head(3));
                     } else {
-                        found->second->setAllReferences(newReference.head(3), newReference.segment(3, 3), newReference.tail(3));
+                        found->second->setAllReferences(m_streamedCOMReference.head(3), m_streamedCOMReference.segment(3, 3), m_streamedCOMReference.tail(3));
                     }
                 }
             } else if (&reference == &m_references->desiredJointsPosition()) {
                 taskType = TaskTypeImpedanceControl;
                 std::map<TaskType, ReferenceGenerator*>::iterator found = m_referenceGenerators.find(taskType);
                 if (found != m_referenceGenerators.end()) {
-                    found->second->setSignalReference(reference.value());
+                    reference.readValue(m_streamedJointsReference);
+                    found->second->setSignalReference(m_streamedJointsReference);
                 }
             } else return;
         }
@@ -761,6 +858,7 @@ namespace codyco {
         : m_module(module)
         , m_initialized(false)
         , m_parameterServer(0)
+        , m_comGenerator(0)
         , m_comProportionalGain(3)
         , m_comDerivativeGain(3)
         , m_comIntegralGain(3)
@@ -775,6 +873,8 @@ namespace codyco {
         , m_monitoredOutputTorques(actuatedDOFs)
         , m_monitoredDesiredCOM(3)
         , m_monitoredMeasuredCOM(3)
+        , m_comGeneratorMonitoredVariables(3, 3)
+        , m_controllerMonitoredVariables(actuatedDOFs)
         {
             //this is totally crazy..
             //indexes to modify are last 3:
@@ -819,6 +919,10 @@ namespace codyco {
             if (!m_initialized) return false;
             bool linked = true;
 
+            //generators are created before linking the variables
+            std::map<TaskType, ReferenceGenerator*>::iterator foundController = m_module.m_referenceGenerators.find(TaskTypeCOM);
+            m_comGenerator = foundController != m_module.m_referenceGenerators.end() ? foundController->second : 0;
+
             //COM
             linked = linked && m_parameterServer->linkParam(TorqueBalancingModuleParameterCOMProportionalGain, m_comProportionalGain.data())
             && m_parameterServer->registerParamValueChangedCallback(TorqueBalancingModuleParameterCOMProportionalGain, this);
@@ -865,27 +969,29 @@ namespace codyco {
             commandRegistered = commandRegistered && m_parameterServer->registerCommandCallback(TorqueBalancingModuleCommandStop, this);
             commandRegistered = commandRegistered && m_parameterServer->registerCommandCallback(TorqueBalancingModuleCommandQuit, this);
             commandRegistered = commandRegistered && m_parameterServer->registerCommandCallback(TorqueBalancingModuleCommandHelp, this);
+            commandRegistered = commandRegistered && m_parameterServer->registerCommandCallback(TorqueBalancingModuleCommandTiming, this);
 
             return commandRegistered;
         }
 
         void TorqueBalancingModule::ParamHelperManager::loadDefaultVariables()
         {
-            std::map<TaskType, ReferenceGenerator*>::iterator foundController;
-            ReferenceGenerator* comGenerator = 0;
-            if ((foundController = m_module.m_referenceGenerators.find(TaskTypeCOM)) != m_module.m_referenceGenerators.end()) {
-                comGenerator = foundController->second;
-            }
+            publishParameters();
+        }
 
-            if (comGenerator) {
-                comGenerator->setProportionalGains(m_comProportionalGain);
-                comGenerator->setDerivativeGains(m_comDerivativeGain);
-                comGenerator->setIntegralGains(m_comIntegralGain);
-                //                 comGenerator->setAllGains(m_comProportionalGain, m_comDerivativeGain, m_comIntegralGain);
+        void TorqueBalancingModule::ParamHelperManager::publishParameters()
+        {
+            //Each set of parameters is published as a whole and adopted by the threads at the beginning of their next cycle
+            if (m_comGenerator) {
+                m_comGenerator->setAllGains(m_comProportionalGain, m_comDerivativeGain, m_comIntegralGain, m_comIntegralLimit);
+            }
+            TorqueBalancingControllerParameters parameters(m_impedanceControlGains.size());
+            parameters.centroidalMomentumGain = m_centroidalGain;
+            parameters.impedanceGains = m_impedanceControlGains;
+            parameters.torqueSaturationLimit = m_torqueSaturation;
+            if (!m_module.m_controller->setParameters(parameters)) {
+                yError("Invalid size of the controller parameters");
             }
-            m_module.m_controller->setCentroidalMomentumGain(m_centroidalGain);
-            m_module.m_controller->setImpedanceGains(m_impedanceControlGains);
-            m_module.m_controller->setTorqueSaturationLimit(m_torqueSaturation);
         }
 
         bool TorqueBalancingModule::ParamHelperManager::processRPCCommand(const yarp::os::Bottle &command, yarp::os::Bottle &reply)
@@ -900,83 +1006,39 @@ namespace codyco {
                 yError("Error: controller or server are nil! Please restart the module");
                 return;
             }
-            //copy updated varables to internal monitor variables
-            std::map<TaskType, ReferenceGenerator*>::iterator foundController;
-            ReferenceGenerator* comGenerator = 0;
-            if ((foundController = m_module.m_referenceGenerators.find(TaskTypeCOM)) != m_module.m_referenceGenerators.end()) {
-                comGenerator = foundController->second;
+            //copy the last published snapshots to internal monitor variables
+            if (m_comGenerator) {
+                m_comGenerator->readMonitoredVariables(m_comGeneratorMonitoredVariables);
+                m_monitoredDesiredCOMAcceleration = m_comGeneratorMonitoredVariables.computedReference;
+                m_monitoredCOMError = m_comGeneratorMonitoredVariables.error;
+                m_monitoredCOMIntegralError = m_comGeneratorMonitoredVariables.errorIntegral;
+                m_monitoredDesiredCOM = m_comGeneratorMonitoredVariables.actualReference;
+                m_monitoredMeasuredCOM = m_comGeneratorMonitoredVariables.signal.head<3>();
             }
-
-            if (comGenerator) {
-                m_monitoredDesiredCOMAcceleration = comGenerator->computedReference();
-                m_monitoredCOMError = comGenerator->instantaneousError();
-                m_monitoredCOMIntegralError = comGenerator->errorIntegral();
-                m_monitoredDesiredCOM = comGenerator->actualReference();
-                m_monitoredMeasuredCOM = comGenerator->inputReader().getSignal().segment<3>(0);
-            }
-            m_monitoredFeetForces = m_module.m_controller->desiredFeetForces();
-            m_monitoredOutputTorques = m_module.m_controller->outputTorques();
+            m_module.m_controller->readMonitoredVariables(m_controllerMonitoredVariables);
+            m_monitoredFeetForces = m_controllerMonitoredVariables.desiredFeetForces;
+            m_monitoredOutputTorques = m_controllerMonitoredVariables.outputTorques;
 
             //send variables
             m_parameterServer->sendStreamParams();
 
         }
 
-        void TorqueBalancingModule::ParamHelperManager::syncLinkedVariables()
-        {
-            std::map<TaskType, ReferenceGenerator*>::iterator foundController;
-            ReferenceGenerator* comGenerator = 0;
-            if ((foundController = m_module.m_referenceGenerators.find(TaskTypeCOM)) != m_module.m_referenceGenerators.end()) {
-                comGenerator = foundController->second;
-            }
-            if (comGenerator) {
-                m_comProportionalGain = comGenerator->proportionalGains();
-                m_comDerivativeGain = comGenerator->derivativeGains();
-                m_comIntegralGain = comGenerator->integralGains();
-                m_comIntegralLimit = comGenerator->integralLimit();
-            }
-        }
-
         void TorqueBalancingModule::ParamHelperManager::parameterUpdated(const paramHelp::ParamProxyInterface *proxyInterface)
         {
             assert(m_parameterServer);
-            std::map<TaskType, ReferenceGenerator*>::iterator foundController;
             switch (proxyInterface->id) {
                     //COM
                 case TorqueBalancingModuleParameterCOMProportionalGain:
-                    foundController = m_module.m_referenceGenerators.find(TaskTypeCOM);
-                    if (foundController != m_module.m_referenceGenerators.end()) {
-                        foundController->second->setProportionalGains(m_comProportionalGain);
-                    }
-                    break;
                 case TorqueBalancingModuleParameterCOMDerivativeGain:
-                    foundController = m_module.m_referenceGenerators.find(TaskTypeCOM);
-                    if (foundController != m_module.m_referenceGenerators.end()) {
-                        foundController->second->setDerivativeGains(m_comDerivativeGain);
-                    }
-                    break;
                 case TorqueBalancingModuleParameterCOMIntegralGain:
-                    foundController = m_module.m_referenceGenerators.find(TaskTypeCOM);
-                    if (foundController != m_module.m_referenceGenerators.end()) {
-                        foundController->second->setIntegralGains(m_comIntegralGain);
-                    }
-                    break;
                 case TorqueBalancingModuleParameterCOMIntegralLimit:
-                    foundController = m_module.m_referenceGenerators.find(TaskTypeCOM);
-                    if (foundController != m_module.m_referenceGenerators.end()) {
-                        foundController->second->setIntegralLimit(m_comIntegralLimit);
-                    }
-                    break;
                     //Centroidal and gains
                 case TorqueBalancingModuleParameterCentroidalGain:
-                    m_module.m_controller->setCentroidalMomentumGain(m_centroidalGain);
-                    break;
                 case TorqueBalancingModuleParameterImpedanceGain:
-                    m_module.m_controller->setImpedanceGains(m_impedanceControlGains);
-                    break;
                     //Saturation
                 case TorqueBalancingModuleParameterTorqueSaturation:
-                    m_module.m_controller->setTorqueSaturationLimit(m_torqueSaturation);
+                    publishParameters();
                     break;
             }
         }
@@ -1000,6 +1062,12 @@ namespace codyco {
                 case TorqueBalancingModuleCommandHelp:
                     m_parameterServer->getHelpMessage(reply);
                     break;
+                case TorqueBalancingModuleCommandTiming:
+                {
+                    yarp::os::LockGuard guard(m_module.m_loopTimingMutex);
+                    m_module.m_loopTimingStatistics.toBottle(reply);
+                    break;
+                }
                 default:
                     break;
             }
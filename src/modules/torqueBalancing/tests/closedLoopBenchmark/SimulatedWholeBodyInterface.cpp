@@ -0,0 +1,395 @@
+/**
+ * Copyright (C) 2016 CoDyCo
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found at
+ * http://www.robotcub.org/icub/license/gpl.txt
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+#include "SimulatedWholeBodyInterface.h"
+
+#include <yarp/os/Property.h>
+#include <Eigen/Geometry>
+#include <cmath>
+
+namespace {
+    const double IntegrationStep = 0.001;
+    const double RotorInertia = 0.05;
+    //viscous friction of the joints: the postural task of the controller has no damping term
+    const double JointDamping = 2;
+    const double PositionControlStiffness = 100;
+    const double PositionControlDamping = 2;
+    const double JointLimit = 2;
+
+    //position and axis-angle orientation from a rotation vector
+    void rotoTranslation(const Eigen::Vector3d& position, const Eigen::Vector3d& rotation, double *x)
+    {
+        Eigen::Map<Eigen::Matrix<double, 7, 1> > rotoTranslation(x);
+        rotoTranslation.head<3>() = position;
+        double angle = rotation.norm();
+        if (angle > 0) {
+            rotoTranslation.segment<3>(3) = rotation / angle;
+        } else {
+            rotoTranslation.segment<3>(3) = Eigen::Vector3d::UnitZ();
+        }
+        rotoTranslation(6) = angle;
+    }
+}
+
+namespace codyco {
+    namespace torquebalancing {
+
+        SimulatedWholeBodyInterface::SimulatedWholeBodyInterface()
+        : yarpWbi::yarpWholeBodyInterface("simulatedWholeBodyInterface", yarp::os::Property())
+        , m_totalDOFs(0)
+        , m_mass(0)
+        , m_initialBasePosition(0, 0, 0.6)
+        , m_time(0)
+        , m_integrationStep(IntegrationStep)
+        , m_torqueControl(false)
+        {
+            buildModel();
+        }
+
+        SimulatedWholeBodyInterface::~SimulatedWholeBodyInterface() {}
+
+        int SimulatedWholeBodyInterface::addJoint(int parent, const Eigen::Vector3d& axis, const Eigen::Vector3d& position)
+        {
+            Joint joint;
+            joint.parent = parent;
+            joint.axis = axis;
+            joint.position = position;
+            m_joints.push_back(joint);
+            return m_joints.size() - 1;
+        }
+
+        void SimulatedWholeBodyInterface::addFrame(const std::string& name, int joint, const Eigen::Vector3d& position)
+        {
+            PointFrame frame;
+            frame.joint = joint;
+            frame.position = position;
+            m_frames.push_back(frame);
+            m_frameList.addID(name);
+        }
+
+        SimulatedWholeBodyInterface::FrameJacobian SimulatedWholeBodyInterface::pointJacobian(int joint, const Eigen::Vector3d& position) const
+        {
+            FrameJacobian jacobian = FrameJacobian::Zero(6, m_totalDOFs);
+            //base: v = v_b + w_b x r
+            jacobian.block<3, 3>(0, 0).setIdentity();
+            jacobian.block<3, 3>(0, 3) << 0, position(2), -position(1),
+                                          -position(2), 0, position(0),
+                                          position(1), -position(0), 0;
+            jacobian.block<3, 3>(3, 3).setIdentity();
+            for (int j = joint; j >= 0; j = m_joints[j].parent) {
+                jacobian.block<3, 1>(0, 6 + j) = m_joints[j].axis.cross(position - m_joints[j].position);
+                jacobian.block<3, 1>(3, 6 + j) = m_joints[j].axis;
+            }
+            return jacobian;
+        }
+
+        void SimulatedWholeBodyInterface::buildModel()
+        {
+            using Eigen::Vector3d;
+            const Vector3d x = Vector3d::UnitX(), y = Vector3d::UnitY(), z = Vector3d::UnitZ();
+
+            //torso
+            int torsoPitch = addJoint(-1, y, Vector3d(0, 0, 0.05));
+            int torsoRoll = addJoint(torsoPitch, x, Vector3d(0, 0, 0.05));
+            int torsoYaw = addJoint(torsoRoll, z, Vector3d(0, 0, 0.05));
+            Body body;
+            body.joint = -1; body.mass = 4; body.centerOfMass = Vector3d(0, 0, 0); body.inertia = 0.02;
+            m_bodies.push_back(body);
+            body.joint = torsoYaw; body.mass = 12; body.centerOfMass = Vector3d(0, 0, 0.25); body.inertia = 0.2;
+            m_bodies.push_back(body);
+
+            //arms: left (side = 1) and right (side = -1)
+            int hands[2];
+            for (int arm = 0; arm < 2; arm++) {
+                double side = arm == 0 ? 1 : -1;
+                int shoulderPitch = addJoint(torsoYaw, y, Vector3d(0, side * 0.15, 0.35));
+                int shoulderRoll = addJoint(shoulderPitch, x, Vector3d(0, side * 0.15, 0.35));
+                int shoulderYaw = addJoint(shoulderRoll, z, Vector3d(0, side * 0.15, 0.35));
+                int elbow = addJoint(shoulderYaw, y, Vector3d(0, side * 0.15, 0.2));
+                int wrist = addJoint(elbow, z, Vector3d(0, side * 0.15, 0.08));
+                body.joint = shoulderYaw; body.mass = 1.2; body.centerOfMass = Vector3d(0, side * 0.15, 0.28); body.inertia = 0.005;
+                m_bodies.push_back(body);
+                body.joint = wrist; body.mass = 0.8; body.centerOfMass = Vector3d(0, side * 0.15, 0.12); body.inertia = 0.003;
+                m_bodies.push_back(body);
+                hands[arm] = wrist;
+            }
+
+            //legs: bent knees (the jacobians of the feet are singular with straight legs)
+            int ankles[2];
+            for (int leg = 0; leg < 2; leg++) {
+                double side = leg == 0 ? 1 : -1;
+                int hipPitch = addJoint(-1, y, Vector3d(0, side * 0.07, -0.05));
+                int hipRoll = addJoint(hipPitch, x, Vector3d(0, side * 0.07, -0.05));
+                int hipYaw = addJoint(hipRoll, z, Vector3d(0, side * 0.07, -0.05));
+                int knee = addJoint(hipYaw, y, Vector3d(0.05, side * 0.07, -0.3));
+                int anklePitch = addJoint(knee, y, Vector3d(0, side * 0.07, -0.55));
+                int ankleRoll = addJoint(anklePitch, x, Vector3d(0, side * 0.07, -0.55));
+                body.joint = hipYaw; body.mass = 3; body.centerOfMass = Vector3d(0.025, side * 0.07, -0.18); body.inertia = 0.03;
+                m_bodies.push_back(body);
+                body.joint = knee; body.mass = 1.5; body.centerOfMass = Vector3d(0.025, side * 0.07, -0.43); body.inertia = 0.01;
+                m_bodies.push_back(body);
+                body.joint = ankleRoll; body.mass = 0.7; body.centerOfMass = Vector3d(0.03, side * 0.07, -0.58); body.inertia = 0.002;
+                m_bodies.push_back(body);
+                ankles[leg] = ankleRoll;
+            }
+            m_totalDOFs = m_joints.size() + 6;
+
+            //the soles first: they are the contacts of the simulation
+            addFrame("l_sole", ankles[0], Vector3d(0.03, 0.07, -0.6));
+            addFrame("r_sole", ankles[1], Vector3d(0.03, -0.07, -0.6));
+            addFrame("l_hand", hands[0], Vector3d(0, 0.15, 0.02));
+            addFrame("r_hand", hands[1], Vector3d(0, -0.15, 0.02));
+
+            //constant model
+            m_frameJacobians.clear();
+            for (std::vector<PointFrame>::const_iterator frame = m_frames.begin(); frame != m_frames.end(); ++frame) {
+                m_frameJacobians.push_back(pointJacobian(frame->joint, frame->position));
+            }
+
+            m_massMatrix = RotorInertia * Eigen::MatrixXd::Identity(m_totalDOFs, m_totalDOFs);
+            m_massMatrix.topLeftCorner<6, 6>().setZero();
+            m_centerOfMassJacobian.setZero(6, m_totalDOFs);
+            m_centerOfMassOffset.setZero();
+            m_mass = 0;
+            for (std::vector<Body>::const_iterator b = m_bodies.begin(); b != m_bodies.end(); ++b) {
+                FrameJacobian jacobian = pointJacobian(b->joint, b->centerOfMass);
+                m_massMatrix += b->mass * jacobian.topRows<3>().transpose() * jacobian.topRows<3>();
+                m_massMatrix += b->inertia * jacobian.bottomRows<3>().transpose() * jacobian.bottomRows<3>();
+                m_centerOfMassJacobian.topRows<3>() += b->mass * jacobian.topRows<3>();
+                m_centerOfMassOffset += b->mass * b->centerOfMass;
+                m_mass += b->mass;
+            }
+            m_centerOfMassJacobian.topRows<3>() /= m_mass;
+            m_centerOfMassOffset /= m_mass;
+
+            m_contactsJacobian.resize(12, m_totalDOFs);
+            m_contactsJacobian.topRows<6>() = m_frameJacobians[0];
+            m_contactsJacobian.bottomRows<6>() = m_frameJacobians[1];
+
+            Eigen::MatrixXd constrainedDynamics = Eigen::MatrixXd::Zero(m_totalDOFs + 12, m_totalDOFs + 12);
+            constrainedDynamics.topLeftCorner(m_totalDOFs, m_totalDOFs) = m_massMatrix;
+            constrainedDynamics.topRightCorner(m_totalDOFs, 12) = -m_contactsJacobian.transpose();
+            constrainedDynamics.bottomLeftCorner(12, m_totalDOFs) = m_contactsJacobian;
+            m_constrainedDynamics.compute(constrainedDynamics);
+
+            //state: zero configuration, at rest
+            const int actuatedDOFs = m_totalDOFs - 6;
+            m_displacement.setZero(m_totalDOFs);
+            m_velocity.setZero(m_totalDOFs);
+            m_torques.setZero(actuatedDOFs);
+            m_commandedTorques.setZero(actuatedDOFs);
+            m_positionReference.setZero(actuatedDOFs);
+            m_contactWrenches.setZero(12);
+            m_dynamicsRightHandSide.setZero(m_totalDOFs + 12);
+            m_dynamicsSolution.setZero(m_totalDOFs + 12);
+            m_velocityBuffer.setZero(m_totalDOFs);
+        }
+
+        Eigen::Vector3d SimulatedWholeBodyInterface::framePosition(int frameId) const
+        {
+            return m_initialBasePosition + m_frames[frameId].position + m_frameJacobians[frameId].topRows<3>() * m_displacement;
+        }
+
+#pragma mark - Simulation
+
+        void SimulatedWholeBodyInterface::step(double duration)
+        {
+            const int actuatedDOFs = m_totalDOFs - 6;
+            const Eigen::Vector3d gravity(0, 0, -9.81);
+            int steps = static_cast<int>(duration / m_integrationStep + 0.5);
+            for (int i = 0; i < steps; i++) {
+                if (m_torqueControl) {
+                    m_torques = m_commandedTorques;
+                } else {
+                    m_torques = -PositionControlStiffness * (m_displacement.tail(actuatedDOFs) - m_positionReference)
+                    - PositionControlDamping * m_velocity.tail(actuatedDOFs);
+                }
+
+                //M dnu - Jc' f = S' tau - D dq - h,  Jc dnu = -Jc nu / dt (removes the numerical drift)
+                m_dynamicsRightHandSide.head(m_totalDOFs).noalias() = m_mass * m_centerOfMassJacobian.topRows<3>().transpose() * gravity;
+                m_dynamicsRightHandSide.segment(6, actuatedDOFs) += m_torques - JointDamping * m_velocity.tail(actuatedDOFs);
+                m_dynamicsRightHandSide.tail<12>().noalias() = -m_contactsJacobian * m_velocity / m_integrationStep;
+                m_dynamicsSolution = m_constrainedDynamics.solve(m_dynamicsRightHandSide);
+
+                m_velocity += m_integrationStep * m_dynamicsSolution.head(m_totalDOFs);
+                m_displacement += m_integrationStep * m_velocity;
+                m_contactWrenches = m_dynamicsSolution.tail<12>();
+                m_time += m_integrationStep;
+            }
+        }
+
+        double SimulatedWholeBodyInterface::time() const { return m_time; }
+
+        int SimulatedWholeBodyInterface::actuatedDOFs() const { return m_totalDOFs - 6; }
+
+        bool SimulatedWholeBodyInterface::isTorqueControlled() const { return m_torqueControl; }
+
+        Eigen::Vector3d SimulatedWholeBodyInterface::centerOfMassPosition() const
+        {
+            return m_initialBasePosition + m_centerOfMassOffset + m_centerOfMassJacobian.topRows<3>() * m_displacement;
+        }
+
+        const Eigen::VectorXd& SimulatedWholeBodyInterface::jointTorques() const { return m_torques; }
+
+        const Eigen::VectorXd& SimulatedWholeBodyInterface::contactWrenches() const { return m_contactWrenches; }
+
+#pragma mark - wbi::iWholeBodyModel
+
+        const wbi::IDList& SimulatedWholeBodyInterface::getFrameList() { return m_frameList; }
+
+        bool SimulatedWholeBodyInterface::getJointLimits(double *qMin, double *qMax, int joint)
+        {
+            const int actuatedDOFs = m_totalDOFs - 6;
+            if (joint >= actuatedDOFs) return false;
+            int first = joint < 0 ? 0 : joint;
+            int last = joint < 0 ? actuatedDOFs : joint + 1;
+            for (int j = first; j < last; j++) {
+                qMin[j - first] = -JointLimit;
+                qMax[j - first] = JointLimit;
+            }
+            return true;
+        }
+
+        bool SimulatedWholeBodyInterface::computeJacobian(double */*q*/, const wbi::Frame &/*xBase*/, int frameId, double *J, double */*pos*/)
+        {
+            //wbi jacobians are row major
+            Eigen::Map<Eigen::Matrix<double, 6, Eigen::Dynamic, Eigen::RowMajor> > jacobian(J, 6, m_totalDOFs);
+            if (frameId == wbi::wholeBodyInterface::COM_LINK_ID) {
+                jacobian = m_centerOfMassJacobian;
+                return true;
+            }
+            if (frameId < 0 || frameId >= static_cast<int>(m_frames.size())) return false;
+            jacobian = m_frameJacobians[frameId];
+            return true;
+        }
+
+        bool SimulatedWholeBodyInterface::computeDJdq(double */*q*/, const wbi::Frame &/*xBase*/, double */*dq*/, double */*dxB*/, int frameId, double *dJdq, double */*pos*/)
+        {
+            //constant jacobians
+            if (frameId != wbi::wholeBodyInterface::COM_LINK_ID
+                && (frameId < 0 || frameId >= static_cast<int>(m_frames.size()))) return false;
+            Eigen::Map<Eigen::Matrix<double, 6, 1> >(dJdq).setZero();
+            return true;
+        }
+
+        bool SimulatedWholeBodyInterface::forwardKinematics(double */*q*/, const wbi::Frame &/*xBase*/, int frameId, double *x, double */*pos*/)
+        {
+            if (frameId == wbi::wholeBodyInterface::COM_LINK_ID) {
+                rotoTranslation(centerOfMassPosition(), Eigen::Vector3d::Zero(), x);
+                return true;
+            }
+            if (frameId < 0 || frameId >= static_cast<int>(m_frames.size())) return false;
+            rotoTranslation(framePosition(frameId), m_frameJacobians[frameId].bottomRows<3>() * m_displacement, x);
+            return true;
+        }
+
+        bool SimulatedWholeBodyInterface::computeMassMatrix(double */*q*/, const wbi::Frame &/*xBase*/, double *M)
+        {
+            Eigen::Map<Eigen::MatrixXd>(M, m_totalDOFs, m_totalDOFs) = m_massMatrix;
+            return true;
+        }
+
+        bool SimulatedWholeBodyInterface::computeGeneralizedBiasForces(double */*q*/, const wbi::Frame &/*xBase*/, double */*dq*/, double */*dxB*/, double *g, double *h)
+        {
+            //constant mass matrix: no Coriolis and centrifugal terms
+            Eigen::Map<Eigen::VectorXd>(h, m_totalDOFs).noalias() = -m_mass * m_centerOfMassJacobian.topRows<3>().transpose() * Eigen::Map<Eigen::Vector3d>(g);
+            return true;
+        }
+
+        bool SimulatedWholeBodyInterface::computeCentroidalMomentum(double */*q*/, const wbi::Frame &/*xBase*/, double *dq, double *dxB, double *h)
+        {
+            const int actuatedDOFs = m_totalDOFs - 6;
+            m_velocityBuffer.head<6>() = Eigen::Map<Eigen::Matrix<double, 6, 1> >(dxB);
+            m_velocityBuffer.tail(actuatedDOFs) = Eigen::Map<Eigen::VectorXd>(dq, actuatedDOFs);
+            //the base rows of M nu are the momentum w.r.t. the base origin: move the angular part to the CoM
+            Eigen::Matrix<double, 6, 1> baseMomentum = m_massMatrix.topRows<6>() * m_velocityBuffer;
+            Eigen::Vector3d centerOfMass = centerOfMassPosition() - (m_initialBasePosition + m_displacement.head<3>());
+            Eigen::Map<Eigen::Matrix<double, 6, 1> > momentum(h);
+            momentum.head<3>() = baseMomentum.head<3>();
+            momentum.tail<3>() = baseMomentum.tail<3>() - centerOfMass.cross(baseMomentum.head<3>());
+            return true;
+        }
+
+#pragma mark - wbi::iWholeBodyStates
+
+        bool SimulatedWholeBodyInterface::getEstimates(const wbi::EstimateType et, double *data, double /*time*/, bool /*blocking*/)
+        {
+            const int actuatedDOFs = m_totalDOFs - 6;
+            switch (et) {
+                case wbi::ESTIMATE_JOINT_POS:
+                    Eigen::Map<Eigen::VectorXd>(data, actuatedDOFs) = m_displacement.tail(actuatedDOFs);
+                    return true;
+                case wbi::ESTIMATE_JOINT_VEL:
+                    Eigen::Map<Eigen::VectorXd>(data, actuatedDOFs) = m_velocity.tail(actuatedDOFs);
+                    return true;
+                case wbi::ESTIMATE_BASE_POS: {
+                    //serialization of the homogeneous transformation (row major)
+                    Eigen::Map<Eigen::Matrix<double, 4, 4, Eigen::RowMajor> > frame(data);
+                    Eigen::Vector3d rotation = m_displacement.segment<3>(3);
+                    double angle = rotation.norm();
+                    frame.setIdentity();
+                    if (angle > 0) {
+                        frame.topLeftCorner<3, 3>() = Eigen::AngleAxisd(angle, rotation / angle).toRotationMatrix();
+                    }
+                    frame.topRightCorner<3, 1>() = m_initialBasePosition + m_displacement.head<3>();
+                    return true;
+                }
+                case wbi::ESTIMATE_BASE_VEL: {
+                    Eigen::Map<Eigen::Matrix<double, 6, 1> > velocity(data);
+                    velocity = m_velocity.head<6>();
+                    return true;
+                }
+                default:
+                    return false;
+            }
+        }
+
+#pragma mark - wbi::iWholeBodyActuators
+
+        bool SimulatedWholeBodyInterface::setControlMode(wbi::ControlMode controlMode, double *ref, int joint)
+        {
+            //all the joints together
+            if (joint >= 0) return false;
+            const int actuatedDOFs = m_totalDOFs - 6;
+            if (controlMode == wbi::CTRL_MODE_TORQUE) {
+                m_torqueControl = true;
+                if (ref) m_commandedTorques = Eigen::Map<Eigen::VectorXd>(ref, actuatedDOFs);
+                else m_commandedTorques = m_torques;
+                return true;
+            }
+            if (controlMode == wbi::CTRL_MODE_POS) {
+                m_torqueControl = false;
+                if (ref) m_positionReference = Eigen::Map<Eigen::VectorXd>(ref, actuatedDOFs);
+                else m_positionReference = m_displacement.tail(actuatedDOFs);
+                return true;
+            }
+            return false;
+        }
+
+        bool SimulatedWholeBodyInterface::setControlReference(double *ref, int joint)
+        {
+            const int actuatedDOFs = m_totalDOFs - 6;
+            if (joint >= actuatedDOFs) return false;
+            if (joint >= 0) {
+                if (m_torqueControl) m_commandedTorques(joint) = ref[0];
+                else m_positionReference(joint) = ref[0];
+                return true;
+            }
+            if (m_torqueControl) m_commandedTorques = Eigen::Map<Eigen::VectorXd>(ref, actuatedDOFs);
+            else m_positionReference = Eigen::Map<Eigen::VectorXd>(ref, actuatedDOFs);
+            return true;
+        }
+    }
+}
@@ -0,0 +1,142 @@
+/**
+ * Copyright (C) 2016 CoDyCo
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found at
+ * http://www.robotcub.org/icub/license/gpl.txt
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+#ifndef SIMULATEDWHOLEBODYINTERFACE_H
+#define SIMULATEDWHOLEBODYINTERFACE_H
+
+#include <yarpWholeBodyInterface/yarpWholeBodyInterface.h>
+#include <wbi/wbiUtil.h>
+#include <Eigen/Core>
+#include <Eigen/LU>
+#include <string>
+#include <vector>
+
+namespace codyco {
+    namespace torquebalancing {
+
+        /** @brief In process, deterministic robot for closed loop tests of the controller.
+         *
+         * Floating base humanoid with 25 joints (torso 3, arms 5, legs 6, in the iCub order) standing
+         * on its feet, whose kinematics is linearized around the zero joints configuration:
+         * the jacobians and the mass matrix are constant, and the soles are rigidly attached to the ground.
+         * At each integration step the constrained dynamics
+         * \f[ M \dot{\nu} + h = S^\top \tau + J_c^\top f, \quad J_c \dot{\nu} = 0 \f]
+         * is solved for the accelerations and the contact wrenches, then the state is integrated
+         * with the semi-implicit Euler method.
+         * In position control mode the joints are held by a stiff PD controller.
+         *
+         * The class is a yarpWholeBodyInterface (as required by the controller and by the reference
+         * readers) but it never calls its init(), thus no device and no port are opened.
+         * The model methods describe the current state of the simulation: their joints and base
+         * arguments are ignored. Frames: l_sole, r_sole, l_hand, r_hand.
+         * @note this class is not thread safe: use it from a single thread.
+         */
+        class SimulatedWholeBodyInterface : public yarpWbi::yarpWholeBodyInterface {
+        public:
+            SimulatedWholeBodyInterface();
+            virtual ~SimulatedWholeBodyInterface();
+
+            /** Integrates the dynamics for the specified duration with the last torques.
+             * @param duration simulated time in seconds
+             */
+            void step(double duration);
+
+            double time() const;
+            int actuatedDOFs() const;
+            bool isTorqueControlled() const;
+            Eigen::Vector3d centerOfMassPosition() const;
+            const Eigen::VectorXd& jointTorques() const; /*!< torques applied in the last step */
+            const Eigen::VectorXd& contactWrenches() const; /*!< 12: l_sole and r_sole wrenches of the last integration step */
+
+#pragma mark - wbi::iWholeBodyModel
+            virtual const wbi::IDList& getFrameList();
+            virtual bool getJointLimits(double *qMin, double *qMax, int joint = -1);
+            virtual bool computeJacobian(double *q, const wbi::Frame &xBase, int frameId, double *J, double *pos = 0);
+            virtual bool computeDJdq(double *q, const wbi::Frame &xBase, double *dq, double *dxB, int frameId, double *dJdq, double *pos = 0);
+            virtual bool forwardKinematics(double *q, const wbi::Frame &xBase, int frameId, double *x, double *pos = 0);
+            virtual bool computeMassMatrix(double *q, const wbi::Frame &xBase, double *M);
+            virtual bool computeGeneralizedBiasForces(double *q, const wbi::Frame &xBase, double *dq, double *dxB, double *g, double *h);
+            virtual bool computeCentroidalMomentum(double *q, const wbi::Frame &xBase, double *dq, double *dxB, double *h);
+
+#pragma mark - wbi::iWholeBodyStates
+            virtual bool getEstimates(const wbi::EstimateType et, double *data, double time = -1.0, bool blocking = true);
+
+#pragma mark - wbi::iWholeBodyActuators
+            virtual bool setControlMode(wbi::ControlMode controlMode, double *ref = 0, int joint = -1);
+            virtual bool setControlReference(double *ref, int joint = -1);
+
+        private:
+            typedef Eigen::Matrix<double, 6, Eigen::Dynamic> FrameJacobian;
+
+            struct Joint {
+                int parent; /*!< -1 for the base */
+                Eigen::Vector3d axis;
+                Eigen::Vector3d position; /*!< w.r.t. the base, zero configuration */
+            };
+
+            struct Body {
+                int joint; /*!< last joint moving the body, -1 for the base */
+                double mass;
+                Eigen::Vector3d centerOfMass; /*!< w.r.t. the base, zero configuration */
+                double inertia; /*!< rotational inertia (isotropic) */
+            };
+
+            struct PointFrame {
+                int joint;
+                Eigen::Vector3d position; /*!< w.r.t. the base, zero configuration */
+            };
+
+            int addJoint(int parent, const Eigen::Vector3d& axis, const Eigen::Vector3d& position);
+            void addFrame(const std::string& name, int joint, const Eigen::Vector3d& position);
+            FrameJacobian pointJacobian(int joint, const Eigen::Vector3d& position) const;
+            void buildModel();
+            Eigen::Vector3d framePosition(int frameId) const;
+
+            std::vector<Joint> m_joints;
+            std::vector<Body> m_bodies;
+            std::vector<PointFrame> m_frames;
+            wbi::IDList m_frameList;
+            int m_totalDOFs;
+            double m_mass;
+            Eigen::Vector3d m_initialBasePosition;
+
+            //constant model
+            std::vector<FrameJacobian> m_frameJacobians;
+            FrameJacobian m_centerOfMassJacobian;
+            Eigen::Vector3d m_centerOfMassOffset; /*!< w.r.t. the base, zero configuration */
+            Eigen::MatrixXd m_massMatrix;
+            Eigen::Matrix<double, 12, Eigen::Dynamic> m_contactsJacobian;
+            Eigen::PartialPivLU<Eigen::MatrixXd> m_constrainedDynamics; /*!< [M -Jc'; Jc 0] */
+
+            //state: displacement from the zero configuration (base position, base rotation vector, joints) and velocity
+            double m_time;
+            double m_integrationStep;
+            Eigen::VectorXd m_displacement;
+            Eigen::VectorXd m_velocity;
+            bool m_torqueControl;
+            Eigen::VectorXd m_torques;
+            Eigen::VectorXd m_commandedTorques;
+            Eigen::VectorXd m_positionReference;
+            Eigen::VectorXd m_contactWrenches;
+
+            //buffers
+            Eigen::VectorXd m_dynamicsRightHandSide;
+            Eigen::VectorXd m_dynamicsSolution;
+            Eigen::VectorXd m_velocityBuffer;
+        };
+    }
+}
+
+#endif /* end of include guard: SIMULATEDWHOLEBODYINTERFACE_H */
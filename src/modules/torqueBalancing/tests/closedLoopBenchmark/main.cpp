@@ -0,0 +1,291 @@
+/**
+ * Copyright (C) 2016 CoDyCo
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found at
+ * http://www.robotcub.org/icub/license/gpl.txt
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+/*
+ * Closed loop benchmark of the TorqueBalancingController, without robot or simulator.
+ *
+ * The controller and the CoM and posture reference generators (configured as in the module)
+ * control a SimulatedWholeBodyInterface standing on its feet for the specified simulated time,
+ * as fast as possible: at each tick the generators are stepped with the simulated time,
+ * then the controller cycle runs and the simulation is integrated for one period.
+ * The CoM reference moves sideways on a sinusoid (with its velocity and acceleration as feedforward).
+ *
+ * The simulated robot is linearized: its jacobians and mass matrix are constant and dJdq is zero,
+ * so the benchmark does not cover the model computations nor the nonlinear terms of a real robot.
+ *
+ * Reported: compute time of the controller cycle (median, 99th percentile, maximum), heap allocations
+ * in the controller cycle (glibc only), CoM tracking error, torque saturation events (joints at the
+ * saturation limit in a tick) and minimum normal force on the feet.
+ * The heap allocations are a lower bound: only malloc, calloc and realloc are counted, while
+ * posix_memalign, memalign and the aligned operator new are not.
+ * The benchmark fails if the controller stops, if the maximum CoM error exceeds maxCOMError or
+ * if the feet are pulled (negative normal force). The compute time depends on the load of the machine:
+ * the 99th percentile is checked against maxTickDuration only with --checkTiming, otherwise it is reported.
+ *
+ * Parameters: --duration (simulated s, default 5.0), --period (ms, default 10),
+ *             --comAmplitude (m, default 0.02), --comFrequency (Hz, default 0.25),
+ *             --torqueLimit (Nm, default 30), --forceDistributionQP (0/1, default 0),
+ *             --maxCOMError (m, default 0.01), --maxTickDuration (s, default 0.01), --checkTiming
+ */
+
+#include "SimulatedWholeBodyInterface.h"
+#include "TorqueBalancingController.h"
+#include "ReferenceGenerator.h"
+#include "ReferenceGeneratorInputReaderImpl.h"
+#include "Reference.h"
+
+#include <yarp/os/Property.h>
+#include <yarp/os/Time.h>
+#include <yarp/os/LogStream.h>
+
+#include <Eigen/Core>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <string>
+#include <vector>
+
+#if defined(__GLIBC__)
+//count the heap allocations (Eigen and operator new use malloc) while the flag is set
+namespace {
+    volatile long allocationsCounterEnabled = 0;
+    volatile long allocationsCounter = 0;
+
+    inline void countAllocation()
+    {
+        if (allocationsCounterEnabled) __sync_add_and_fetch(&allocationsCounter, 1);
+    }
+}
+
+extern "C" {
+    void *__libc_malloc(size_t size);
+    void *__libc_calloc(size_t count, size_t size);
+    void *__libc_realloc(void *pointer, size_t size);
+
+    void *malloc(size_t size) throw()
+    {
+        countAllocation();
+        return __libc_malloc(size);
+    }
+
+    void *calloc(size_t count, size_t size) throw()
+    {
+        countAllocation();
+        return __libc_calloc(count, size);
+    }
+
+    void *realloc(void *pointer, size_t size) throw()
+    {
+        countAllocation();
+        return __libc_realloc(pointer, size);
+    }
+}
+#define CLOSEDLOOPBENCHMARK_COUNTS_ALLOCATIONS 1
+#endif
+
+namespace {
+
+    void setAllocationsCounting(bool enabled)
+    {
+#ifdef CLOSEDLOOPBENCHMARK_COUNTS_ALLOCATIONS
+        if (enabled) allocationsCounter = 0;
+        allocationsCounterEnabled = enabled ? 1 : 0;
+#endif
+    }
+
+    long countedAllocations()
+    {
+#ifdef CLOSEDLOOPBENCHMARK_COUNTS_ALLOCATIONS
+        return allocationsCounter;
+#else
+        return -1;
+#endif
+    }
+
+    double percentile(const std::vector<double>& sortedSamples, double fraction)
+    {
+        if (sortedSamples.empty()) return 0;
+        std::size_t index = static_cast<std::size_t>(std::ceil(fraction * sortedSamples.size()));
+        if (index > 0) index--;
+        return sortedSamples[std::min(index, sortedSamples.size() - 1)];
+    }
+}
+
+int main(int argc, char **argv)
+{
+    using namespace codyco::torquebalancing;
+
+    yarp::os::Property options;
+    options.fromCommand(argc, argv);
+
+    const double duration = options.check("duration", yarp::os::Value(5.0)).asDouble();
+    const int period = options.check("period", yarp::os::Value(10)).asInt();
+    const double comAmplitude = options.check("comAmplitude", yarp::os::Value(0.02)).asDouble();
+    const double comFrequency = options.check("comFrequency", yarp::os::Value(0.25)).asDouble();
+    const double torqueLimit = options.check("torqueLimit", yarp::os::Value(30.0)).asDouble();
+    const bool forceDistributionQP = options.check("forceDistributionQP", yarp::os::Value(0)).asInt() != 0;
+    const double maxCOMError = options.check("maxCOMError", yarp::os::Value(0.01)).asDouble();
+    const double maxTickDuration = options.check("maxTickDuration", yarp::os::Value(0.01)).asDouble();
+    const bool checkTiming = options.check("checkTiming");
+
+    if (duration <= 0 || period <= 0 || torqueLimit <= 0) {
+        yError("Invalid parameters");
+        return EXIT_FAILURE;
+    }
+
+    SimulatedWholeBodyInterface robot;
+    const int actuatedDOFs = robot.actuatedDOFs();
+    const double periodInSeconds = period * 1e-3;
+
+    //references and generators, as in the module
+    ControllerReferences references(actuatedDOFs);
+    COMReader comReader(robot, actuatedDOFs);
+    ReferenceGenerator comGenerator(period, references.desiredCOMAcceleration(), comReader, "com pid");
+    comGenerator.setAllGains(Eigen::VectorXd::Constant(3, 50.0), Eigen::VectorXd::Constant(3, 2 * std::sqrt(50.0)), Eigen::VectorXd::Zero(3));
+    VoidReader postureReader(actuatedDOFs);
+    ReferenceGenerator postureGenerator(period, references.desiredJointsConfiguration(), postureReader, "qdes");
+    postureGenerator.setProportionalGains(Eigen::VectorXd::Constant(actuatedDOFs, 1.0));
+    postureGenerator.setSignalReference(Eigen::VectorXd::Zero(actuatedDOFs));
+
+    TorqueBalancingController controller(period, references, robot, actuatedDOFs);
+    std::vector<std::string> contacts;
+    contacts.push_back("l_sole");
+    contacts.push_back("r_sole");
+    TorqueBalancingControllerParameters parameters(actuatedDOFs);
+    parameters.centroidalMomentumGain = 1;
+    parameters.impedanceGains.setConstant(20);
+    parameters.torqueSaturationLimit.setConstant(torqueLimit);
+    QPSolverSettings qpSettings;
+    qpSettings.maxTime = 0.2 * periodInSeconds;
+    if (!controller.setInitialConstraintSet(contacts) || !controller.setParameters(parameters)) {
+        yError("Could not configure the controller");
+        return EXIT_FAILURE;
+    }
+    controller.setForceDistributionQP(forceDistributionQP, ContactForceLimits(), qpSettings);
+    //the controller cycle is run by this thread
+    if (!controller.threadInit()) {
+        yError("Could not initialize the controller");
+        return EXIT_FAILURE;
+    }
+
+    const Eigen::VectorXd initialCOM = robot.centerOfMassPosition();
+    Eigen::VectorXd comReference(3), comVelocityReference(3), comAccelerationReference(3);
+    comGenerator.setSignalReference(initialCOM);
+    comGenerator.setActiveState(true);
+    postureGenerator.setActiveState(true);
+    controller.setActiveState(true);
+
+    const int ticks = static_cast<int>(duration / periodInSeconds + 0.5);
+    std::vector<double> tickDurations;
+    tickDurations.reserve(ticks);
+    long totalAllocations = 0, maximumAllocations = 0, ticksWithAllocations = 0;
+    double comErrorMaximum = 0, comErrorSquaredSum = 0;
+    long saturationEvents = 0;
+    double minimumNormalForce = std::numeric_limits<double>::max();
+    bool stopped = false;
+
+    for (int tick = 0; tick < ticks; tick++) {
+        //sinusoidal CoM reference along y
+        double time = robot.time();
+        double phase = 2 * M_PI * comFrequency * time;
+        double omega = 2 * M_PI * comFrequency;
+        comReference = initialCOM;
+        comReference(1) += comAmplitude * std::sin(phase);
+        comVelocityReference.setZero();
+        comVelocityReference(1) = comAmplitude * omega * std::cos(phase);
+        comAccelerationReference.setZero();
+        comAccelerationReference(1) = -comAmplitude * omega * omega * std::sin(phase);
+        comGenerator.setAllReferences(comReference, comVelocityReference, comAccelerationReference);
+        comGenerator.step(time);
+        postureGenerator.step(time);
+
+        setAllocationsCounting(true);
+        double start = yarp::os::Time::now();
+        controller.run();
+        tickDurations.push_back(yarp::os::Time::now() - start);
+        setAllocationsCounting(false);
+
+        long allocations = countedAllocations();
+        if (allocations > 0) {
+            totalAllocations += allocations;
+            maximumAllocations = std::max(maximumAllocations, allocations);
+            ticksWithAllocations++;
+        }
+
+        if (!controller.isActiveState() || !robot.isTorqueControlled()) {
+            yError("The controller stopped at %lf s", time);
+            stopped = true;
+            break;
+        }
+
+        robot.step(periodInSeconds);
+
+        //error w.r.t. the reference of the end of the period
+        double endPhase = 2 * M_PI * comFrequency * robot.time();
+        comReference = initialCOM;
+        comReference(1) += comAmplitude * std::sin(endPhase);
+        double comError = (robot.centerOfMassPosition() - comReference).norm();
+        comErrorMaximum = std::max(comErrorMaximum, comError);
+        comErrorSquaredSum += comError * comError;
+
+        const Eigen::VectorXd& torques = robot.jointTorques();
+        for (int joint = 0; joint < torques.size(); joint++) {
+            if (std::abs(torques(joint)) >= torqueLimit * (1 - 1e-9)) saturationEvents++;
+        }
+        minimumNormalForce = std::min(minimumNormalForce, std::min(robot.contactWrenches()(2), robot.contactWrenches()(8)));
+    }
+
+    //threadInit was called by this thread
+    controller.threadRelease();
+
+    const int executedTicks = tickDurations.size();
+    std::vector<double> sortedDurations(tickDurations);
+    std::sort(sortedDurations.begin(), sortedDurations.end());
+
+    yInfo("Closed loop benchmark: %d ticks of %d ms (%.2f s simulated), %d joints, force distribution QP %s",
+          executedTicks, period, executedTicks * periodInSeconds, actuatedDOFs, forceDistributionQP ? "on" : "off");
+    yInfo("Linearized robot: constant jacobians and mass matrix, zero dJdq");
+    yInfo("Cycle compute time [ms]: p50 %.3f p99 %.3f max %.3f", 1e3 * percentile(sortedDurations, 0.5),
+          1e3 * percentile(sortedDurations, 0.99), sortedDurations.empty() ? 0 : 1e3 * sortedDurations.back());
+    if (countedAllocations() >= 0) {
+        yInfo("Heap allocations per cycle (malloc, calloc and realloc only, lower bound): mean %.1f max %ld (%ld cycles allocating)",
+              executedTicks > 0 ? static_cast<double>(totalAllocations) / executedTicks : 0, maximumAllocations, ticksWithAllocations);
+    } else {
+        yInfo("Heap allocations per cycle: not available on this platform");
+    }
+    yInfo("CoM error [mm]: rms %.3f max %.3f", executedTicks > 0 ? 1e3 * std::sqrt(comErrorSquaredSum / executedTicks) : 0, 1e3 * comErrorMaximum);
+    yInfo("Torque saturation events: %ld. Minimum normal force on the feet: %.2f N", saturationEvents, minimumNormalForce);
+
+    bool ok = !stopped && executedTicks == ticks;
+    if (comErrorMaximum > maxCOMError) {
+        yError("Maximum CoM error %g m (max %g m)", comErrorMaximum, maxCOMError);
+        ok = false;
+    }
+    if (minimumNormalForce < 0) {
+        yError("The feet are pulled: minimum normal force %g N", minimumNormalForce);
+        ok = false;
+    }
+    if (percentile(sortedDurations, 0.99) > maxTickDuration) {
+        if (checkTiming) {
+            yError("99th percentile of the cycle compute time %g s (max %g s)", percentile(sortedDurations, 0.99), maxTickDuration);
+            ok = false;
+        } else {
+            yWarning("99th percentile of the cycle compute time %g s (max %g s)", percentile(sortedDurations, 0.99), maxTickDuration);
+        }
+    }
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,276 @@
+/**
+ * Copyright (C) 2016 CoDyCo
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found at
+ * http://www.robotcub.org/icub/license/gpl.txt
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+/*
+ * Equivalence of the registered contacts with the former two feet implementation of the controller.
+ *
+ * The controller runs in closed loop on the SimulatedWholeBodyInterface (see closedLoopBenchmark)
+ * with the CoM acceleration reference moving sideways. At each tick its output torques and desired
+ * feet forces are compared with the ones of the two feet implementation (the contact forces and
+ * torques computations as they were before the contacts were registered by name), evaluated on the
+ * same state of the robot. Configurations:
+ *  - l_sole and r_sole, both active;
+ *  - l_sole, r_sole and l_hand, with l_hand initially inactive: same as the two feet;
+ *  - l_sole and r_sole, with r_sole initially inactive: same as the two feet with the right foot inactive.
+ *
+ * Parameters: --duration (simulated s for each configuration, default 1.0), --period (ms, default 10),
+ *             --tolerance (relative error on torques and forces, default 1e-6)
+ */
+
+#include "SimulatedWholeBodyInterface.h"
+#include "TorqueBalancingController.h"
+#include "Reference.h"
+#include "config.h"
+
+#include <codyco/MathUtils.h>
+#include <wbi/wbiUtil.h>
+#include <yarp/os/Property.h>
+#include <yarp/os/LogStream.h>
+
+#include <Eigen/Core>
+#include <Eigen/LU>
+#include <Eigen/SVD>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace {
+    using namespace codyco::torquebalancing;
+
+    /* Contact forces (12, l_sole and r_sole) and torques of the two feet implementation */
+    void twoFeetReference(SimulatedWholeBodyInterface& robot,
+                          bool leftFootActive, bool rightFootActive,
+                          const Eigen::VectorXd& desiredCOMAcceleration,
+                          const Eigen::VectorXd& desiredJointsConfiguration,
+                          const TorqueBalancingControllerParameters& parameters,
+                          Eigen::VectorXd& desiredFeetForces,
+                          Eigen::VectorXd& torques)
+    {
+        using namespace Eigen;
+        namespace math = codyco::math;
+
+        const int actuatedDOFs = robot.actuatedDOFs();
+        const int totalDOFs = actuatedDOFs + 6;
+        int leftFoot = -1, rightFoot = -1;
+        robot.getFrameList().idToIndex("l_sole", leftFoot);
+        robot.getFrameList().idToIndex("r_sole", rightFoot);
+
+        //state
+        VectorXd jointPositions(actuatedDOFs), jointVelocities(actuatedDOFs);
+        VectorXd baseVelocity(6), world2BaseFrameSerialization(16);
+        wbi::Frame world2BaseFrame;
+        robot.getEstimates(wbi::ESTIMATE_JOINT_POS, jointPositions.data());
+        robot.getEstimates(wbi::ESTIMATE_JOINT_VEL, jointVelocities.data());
+        robot.getEstimates(wbi::ESTIMATE_BASE_POS, world2BaseFrameSerialization.data());
+        wbi::frameFromSerialization(world2BaseFrameSerialization.data(), world2BaseFrame);
+        robot.getEstimates(wbi::ESTIMATE_BASE_VEL, baseVelocity.data());
+
+        //model: both feet in one 12 rows jacobian, zero rows for an inactive foot
+        Matrix<double, Dynamic, Dynamic, RowMajor> contactsJacobian = Matrix<double, Dynamic, Dynamic, RowMajor>::Zero(12, totalDOFs);
+        VectorXd contactsDJacobianDq = VectorXd::Zero(12);
+        Matrix<double, 7, 1> leftFootPosition, rightFootPosition, rotoTranslation;
+        if (leftFootActive) {
+            robot.computeJacobian(jointPositions.data(), world2BaseFrame, leftFoot, contactsJacobian.row(0).data());
+            robot.computeDJdq(jointPositions.data(), world2BaseFrame, jointVelocities.data(), baseVelocity.data(), leftFoot, contactsDJacobianDq.head(6).data());
+        }
+        if (rightFootActive) {
+            robot.computeJacobian(jointPositions.data(), world2BaseFrame, rightFoot, contactsJacobian.row(6).data());
+            robot.computeDJdq(jointPositions.data(), world2BaseFrame, jointVelocities.data(), baseVelocity.data(), rightFoot, contactsDJacobianDq.tail(6).data());
+        }
+        robot.forwardKinematics(jointPositions.data(), world2BaseFrame, wbi::wholeBodyInterface::COM_LINK_ID, rotoTranslation.data());
+        Vector3d centerOfMassPosition = rotoTranslation.head<3>();
+        robot.forwardKinematics(jointPositions.data(), world2BaseFrame, leftFoot, leftFootPosition.data());
+        robot.forwardKinematics(jointPositions.data(), world2BaseFrame, rightFoot, rightFootPosition.data());
+
+        MatrixXd massMatrix(totalDOFs, totalDOFs);
+        robot.computeMassMatrix(jointPositions.data(), world2BaseFrame, massMatrix.data());
+        VectorXd centroidalMomentum(6);
+        robot.computeCentroidalMomentum(jointPositions.data(), world2BaseFrame, jointVelocities.data(), baseVelocity.data(), centroidalMomentum.data());
+        double gravity[3] = {0, 0, -9.81};
+        VectorXd generalizedBiasForces(totalDOFs), gravityBiasTorques(totalDOFs);
+        VectorXd jointsZero = VectorXd::Zero(actuatedDOFs), baseZero = VectorXd::Zero(6);
+        robot.computeGeneralizedBiasForces(jointPositions.data(), world2BaseFrame, jointVelocities.data(), baseVelocity.data(), gravity, generalizedBiasForces.data());
+        robot.computeGeneralizedBiasForces(jointPositions.data(), world2BaseFrame, jointsZero.data(), baseZero.data(), gravity, gravityBiasTorques.data());
+
+        //contact forces
+        double mass = massMatrix(0, 0);
+        VectorXd gravityForce = VectorXd::Zero(6);
+        gravityForce(2) = -mass * 9.81;
+        MatrixXd centroidalForceMatrix = MatrixXd::Zero(6, 12);
+        if (leftFootActive) {
+            centroidalForceMatrix.block<3, 3>(0, 0).setIdentity();
+            centroidalForceMatrix.block<3, 3>(3, 3).setIdentity();
+            math::skewSymmentricMatrixFrom3DVector(leftFootPosition.head<3>() - centerOfMassPosition, centroidalForceMatrix.block<3, 3>(3, 0));
+        }
+        if (rightFootActive) {
+            centroidalForceMatrix.block<3, 3>(0, 6).setIdentity();
+            centroidalForceMatrix.block<3, 3>(3, 9).setIdentity();
+            math::skewSymmentricMatrixFrom3DVector(rightFootPosition.head<3>() - centerOfMassPosition, centroidalForceMatrix.block<3, 3>(3, 6));
+        }
+        VectorXd desiredCentroidalMomentum(6);
+        desiredCentroidalMomentum.head<3>() = mass * desiredCOMAcceleration;
+        desiredCentroidalMomentum.tail<3>() = -parameters.centroidalMomentumGain * centroidalMomentum.tail<3>();
+        VectorXd esaVector = desiredCentroidalMomentum - gravityForce;
+
+        MatrixXd nullSpaceOfCentroidalForceMatrix = MatrixXd::Zero(12, 12);
+        desiredFeetForces.setZero(12);
+        if (leftFootActive ^ rightFootActive) {
+            PartialPivLU<MatrixXd> lu(centroidalForceMatrix.block<6, 6>(0, leftFootActive ? 0 : 6));
+            desiredFeetForces.segment(leftFootActive ? 0 : 6, 6) = lu.solve(esaVector);
+        } else {
+            JacobiSVD<MatrixXd> svd(6, 12, ComputeThinU | ComputeThinV);
+            MatrixXd pseudoInverseOfCentroidalForceMatrix(12, 6);
+            math::pseudoInverse(centroidalForceMatrix, svd, pseudoInverseOfCentroidalForceMatrix, PseudoInverseTolerance);
+            desiredFeetForces = pseudoInverseOfCentroidalForceMatrix * esaVector;
+            nullSpaceOfCentroidalForceMatrix.setIdentity();
+            nullSpaceOfCentroidalForceMatrix -= pseudoInverseOfCentroidalForceMatrix * centroidalForceMatrix;
+        }
+
+        //torques
+        MatrixXd torquesSelector = MatrixXd::Zero(totalDOFs, actuatedDOFs);
+        torquesSelector.bottomRows(actuatedDOFs).setIdentity();
+        MatrixXd JcMInv = contactsJacobian * massMatrix.inverse();
+        MatrixXd JcMInvJct = JcMInv * contactsJacobian.transpose();
+        MatrixXd JcMInvTorqueSelector = JcMInv * torquesSelector;
+        MatrixXd jointProjectedBaseAccelerations = massMatrix.block(6, 0, actuatedDOFs, 6) * massMatrix.topLeftCorner<6, 6>().inverse();
+
+        JacobiSVD<MatrixXd> svdOfJcMInvSt(12, actuatedDOFs, ComputeThinU | ComputeThinV);
+        MatrixXd pseudoInverseOfJcMInvSt(actuatedDOFs, 12);
+        math::pseudoInverse(JcMInvTorqueSelector, svdOfJcMInvSt, pseudoInverseOfJcMInvSt, PseudoInverseTolerance);
+        MatrixXd JcNullSpaceProjector = MatrixXd::Identity(actuatedDOFs, actuatedDOFs) - pseudoInverseOfJcMInvSt * JcMInvTorqueSelector;
+
+        MatrixXd mult_f_tau0 = jointProjectedBaseAccelerations * contactsJacobian.leftCols(6).transpose() - contactsJacobian.rightCols(actuatedDOFs).transpose();
+        VectorXd torques0 = gravityBiasTorques.tail(actuatedDOFs) - parameters.impedanceGains.asDiagonal() * (jointPositions - desiredJointsConfiguration) - jointProjectedBaseAccelerations * generalizedBiasForces.head<6>();
+        MatrixXd mult_f_tau = -pseudoInverseOfJcMInvSt * JcMInvJct + JcNullSpaceProjector * mult_f_tau0;
+        VectorXd n_tau = pseudoInverseOfJcMInvSt * (JcMInv * generalizedBiasForces - contactsDJacobianDq) + JcNullSpaceProjector * torques0;
+
+        JacobiSVD<MatrixXd> svdOfTauN0_f(actuatedDOFs, 12, ComputeFullU | ComputeFullV);
+        MatrixXd pseudoInverseOfTauN0_f(12, actuatedDOFs);
+        math::pseudoInverse(mult_f_tau * nullSpaceOfCentroidalForceMatrix, svdOfTauN0_f, pseudoInverseOfTauN0_f, PseudoInverseTolerance, ComputeFullV | ComputeFullU);
+
+        torques = (MatrixXd::Identity(actuatedDOFs, actuatedDOFs) - mult_f_tau * nullSpaceOfCentroidalForceMatrix * pseudoInverseOfTauN0_f) * (n_tau + mult_f_tau * desiredFeetForces);
+    }
+
+    double relativeError(const Eigen::VectorXd& value, const Eigen::VectorXd& expected)
+    {
+        return (value - expected).norm() / std::max(1.0, expected.norm());
+    }
+
+    /* Runs the controller with the specified contacts and compares it with the two feet implementation.
+     * @return the maximum relative error on torques and feet forces, negative if the controller stopped */
+    double compareWithTwoFeet(const std::vector<std::string>& contacts,
+                              const std::vector<bool>& initiallyActive,
+                              bool leftFootActive, bool rightFootActive,
+                              int period, double duration)
+    {
+        SimulatedWholeBodyInterface robot;
+        const int actuatedDOFs = robot.actuatedDOFs();
+        const double periodInSeconds = period * 1e-3;
+
+        ControllerReferences references(actuatedDOFs);
+        Eigen::VectorXd desiredJointsConfiguration = Eigen::VectorXd::Zero(actuatedDOFs);
+        references.desiredJointsConfiguration().setValue(desiredJointsConfiguration);
+
+        TorqueBalancingController controller(period, references, robot, actuatedDOFs);
+        TorqueBalancingControllerParameters parameters(actuatedDOFs);
+        parameters.centroidalMomentumGain = 1;
+        parameters.impedanceGains.setConstant(20);
+        //no saturation: the torques are compared before the saturation anyway
+        parameters.torqueSaturationLimit.setConstant(1e6);
+        if (!controller.setInitialConstraintSet(contacts, initiallyActive) || !controller.setParameters(parameters)
+            || !controller.threadInit()) {
+            yError("Could not configure the controller");
+            return -1;
+        }
+        controller.setActiveState(true);
+
+        TorqueBalancingControllerMonitoredVariables variables(actuatedDOFs);
+        Eigen::VectorXd desiredCOMAcceleration(3), expectedFeetForces(12), expectedTorques(actuatedDOFs);
+        double maximumError = 0;
+        const int ticks = static_cast<int>(duration / periodInSeconds + 0.5);
+        for (int tick = 0; tick < ticks; tick++) {
+            desiredCOMAcceleration.setZero();
+            desiredCOMAcceleration(1) = 0.05 * std::sin(2 * M_PI * 0.5 * robot.time());
+            references.desiredCOMAcceleration().setValue(desiredCOMAcceleration);
+
+            controller.run();
+            if (!controller.isActiveState()) {
+                yError("The controller stopped at %lf s", robot.time());
+                return -1;
+            }
+            controller.readMonitoredVariables(variables);
+            twoFeetReference(robot, leftFootActive, rightFootActive, desiredCOMAcceleration,
+                             desiredJointsConfiguration, parameters, expectedFeetForces, expectedTorques);
+
+            maximumError = std::max(maximumError, relativeError(variables.outputTorques, expectedTorques));
+            maximumError = std::max(maximumError, relativeError(variables.desiredFeetForces, expectedFeetForces));
+
+            robot.step(periodInSeconds);
+        }
+        controller.threadRelease();
+        return maximumError;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    yarp::os::Property options;
+    options.fromCommand(argc, argv);
+
+    const double duration = options.check("duration", yarp::os::Value(1.0)).asDouble();
+    const int period = options.check("period", yarp::os::Value(10)).asInt();
+    const double tolerance = options.check("tolerance", yarp::os::Value(1e-6)).asDouble();
+    if (duration <= 0 || period <= 0 || tolerance <= 0) {
+        yError("Invalid parameters");
+        return EXIT_FAILURE;
+    }
+
+    std::vector<std::string> feet;
+    feet.push_back("l_sole");
+    feet.push_back("r_sole");
+    std::vector<std::string> feetAndHand(feet);
+    feetAndHand.push_back("l_hand");
+
+    std::vector<bool> bothFeetActive(2, true);
+    std::vector<bool> handInactive(3, true);
+    handInactive[2] = false;
+    std::vector<bool> rightFootInactive(2, true);
+    rightFootInactive[1] = false;
+
+    bool ok = true;
+    const double bothFeetError = compareWithTwoFeet(feet, bothFeetActive, true, true, period, duration);
+    const double handError = compareWithTwoFeet(feetAndHand, handInactive, true, true, period, duration);
+    const double leftFootError = compareWithTwoFeet(feet, rightFootInactive, true, false, period, duration);
+
+    yInfo("Contacts equivalence test: relative error w.r.t. the two feet implementation: both feet %g,"
+          " both feet and inactive hand %g, left foot only %g", bothFeetError, handError, leftFootError);
+
+    if (bothFeetError < 0 || bothFeetError > tolerance) {
+        yError("The two feet contacts differ from the two feet implementation");
+        ok = false;
+    }
+    if (handError < 0 || handError > tolerance) {
+        yError("An inactive contact changes the output of the controller");
+        ok = false;
+    }
+    if (leftFootError < 0 || leftFootError > tolerance) {
+        yError("An initially inactive foot differs from the two feet implementation with the foot inactive");
+        ok = false;
+    }
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,210 @@
+/**
+ * Copyright (C) 2016 CoDyCo
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found at
+ * http://www.robotcub.org/icub/license/gpl.txt
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+/*
+ * Test of the gains hot swap of a ReferenceGenerator.
+ *
+ * A loop thread steps a generator (signal and signal derivative equal to one, zero references)
+ * every millisecond, while a tuner thread, with the same role of the RPC thread of the module,
+ * continuously sets the k-th gains set: proportional gains k and derivative gains -k, so that the
+ * output of the generator is zero only if the gains used in a step belong to the same set.
+ * A monitor thread reads the monitored variables of the generator as the module does.
+ * The test fails if a monitored output is not zero or if a new gains set is not adopted by the next step.
+ * The step duration depends on the load of the machine: the maximum is checked against maxStepDuration
+ * only with --checkTiming, otherwise it is reported.
+ *
+ * Parameters: --duration (s, default 2.0), --size (default 25), --maxStepDuration (s, default 0.005), --checkTiming
+ */
+
+#include "ReferenceGenerator.h"
+#include "Reference.h"
+
+#include <yarp/os/Property.h>
+#include <yarp/os/RateThread.h>
+#include <yarp/os/Thread.h>
+#include <yarp/os/Time.h>
+#include <yarp/os/LogStream.h>
+
+#include <Eigen/Core>
+
+#include <cstdlib>
+
+namespace {
+
+    class ConstantSignal : public codyco::torquebalancing::ReferenceGeneratorInputReader {
+    public:
+        explicit ConstantSignal(int size) : m_signal(Eigen::VectorXd::Ones(size)) {}
+        virtual const Eigen::VectorXd& getSignal(long context = 0) { return m_signal; }
+        virtual const Eigen::VectorXd& getSignalDerivative(long context = 0) { return m_signal; }
+        virtual int signalSize() const { return m_signal.size(); }
+    private:
+        Eigen::VectorXd m_signal;
+    };
+
+    /* Steps the generator as TorqueBalancingController::run() with synchronousReferences */
+    class Loop : public yarp::os::RateThread {
+    public:
+        explicit Loop(codyco::torquebalancing::ReferenceGenerator& generator)
+        : RateThread(1)
+        , m_generator(generator)
+        , m_nrOfSteps(0)
+        , m_maxStepDuration(0) {}
+
+        virtual void run()
+        {
+            double now = yarp::os::Time::now();
+            m_generator.step(now);
+            double duration = yarp::os::Time::now() - now;
+            if (duration > m_maxStepDuration) m_maxStepDuration = duration;
+            m_nrOfSteps++;
+        }
+
+        unsigned long nrOfSteps() const { return m_nrOfSteps; }
+        double maxStepDuration() const { return m_maxStepDuration; }
+
+    private:
+        codyco::torquebalancing::ReferenceGenerator& m_generator;
+        unsigned long m_nrOfSteps;
+        double m_maxStepDuration;
+    };
+
+    class Tuner : public yarp::os::Thread {
+    public:
+        Tuner(codyco::torquebalancing::ReferenceGenerator& generator, int size)
+        : m_generator(generator)
+        , m_proportionalGains(size)
+        , m_derivativeGains(size)
+        , m_integralGains(Eigen::VectorXd::Zero(size))
+        , m_nrOfSets(0) {}
+
+        virtual void run()
+        {
+            while (!isStopping()) {
+                m_nrOfSets++;
+                m_proportionalGains.setConstant(m_nrOfSets);
+                m_derivativeGains.setConstant(-static_cast<double>(m_nrOfSets));
+                m_generator.setAllGains(m_proportionalGains, m_derivativeGains, m_integralGains, m_nrOfSets);
+            }
+        }
+
+        unsigned long nrOfSets() const { return m_nrOfSets; }
+
+    private:
+        codyco::torquebalancing::ReferenceGenerator& m_generator;
+        Eigen::VectorXd m_proportionalGains;
+        Eigen::VectorXd m_derivativeGains;
+        Eigen::VectorXd m_integralGains;
+        unsigned long m_nrOfSets;
+    };
+
+    class Monitor : public yarp::os::Thread {
+    public:
+        Monitor(codyco::torquebalancing::ReferenceGenerator& generator, int size)
+        : m_generator(generator)
+        , m_variables(size, size)
+        , m_nrOfReads(0)
+        , m_nrOfErrors(0) {}
+
+        virtual void run()
+        {
+            while (!isStopping()) {
+                m_generator.readMonitoredVariables(m_variables);
+                m_nrOfReads++;
+                if (!m_variables.computedReference.isZero(0)) {
+                    if (m_nrOfErrors == 0) {
+                        yError("Inconsistent gains: output from %g to %g",
+                               m_variables.computedReference.minCoeff(), m_variables.computedReference.maxCoeff());
+                    }
+                    m_nrOfErrors++;
+                }
+                yarp::os::Time::delay(0.0001);
+            }
+        }
+
+        unsigned long nrOfReads() const { return m_nrOfReads; }
+        unsigned long nrOfErrors() const { return m_nrOfErrors; }
+
+    private:
+        codyco::torquebalancing::ReferenceGenerator& m_generator;
+        codyco::torquebalancing::ReferenceGeneratorMonitoredVariables m_variables;
+        unsigned long m_nrOfReads;
+        unsigned long m_nrOfErrors;
+    };
+}
+
+int main(int argc, char **argv)
+{
+    using namespace codyco::torquebalancing;
+
+    yarp::os::Property options;
+    options.fromCommand(argc, argv);
+
+    const double duration = options.check("duration", yarp::os::Value(2.0)).asDouble();
+    const int size = options.check("size", yarp::os::Value(25)).asInt();
+    const double maxStepDuration = options.check("maxStepDuration", yarp::os::Value(0.005)).asDouble();
+    const bool checkTiming = options.check("checkTiming");
+
+    if (duration <= 0 || size <= 0 || maxStepDuration <= 0) {
+        yError("Invalid parameters");
+        return EXIT_FAILURE;
+    }
+
+    Reference reference(size);
+    ConstantSignal signal(size);
+    ReferenceGenerator generator(1, reference, signal, "tuned");
+    generator.setActiveState(true);
+    //error and error derivative equal to one
+    generator.setAllReferences(Eigen::VectorXd::Zero(size), Eigen::VectorXd::Zero(size), Eigen::VectorXd::Zero(size));
+
+    Loop loop(generator);
+    Tuner tuner(generator, size);
+    Monitor monitor(generator, size);
+    bool ok = loop.start() && monitor.start() && tuner.start();
+
+    yarp::os::Time::delay(duration);
+
+    tuner.stop();
+    yarp::os::Time::delay(0.01);
+    loop.stop();
+    monitor.stop();
+
+    //a new set is adopted by the next step: output -1 with proportional gains 1 and derivative gains 0
+    const unsigned long nrOfSets = tuner.nrOfSets();
+    bool sequenceKept = generator.gains().proportionalGains(0) == nrOfSets;
+    generator.setAllGains(Eigen::VectorXd::Ones(size), Eigen::VectorXd::Zero(size), Eigen::VectorXd::Zero(size));
+    generator.step(yarp::os::Time::now());
+    ReferenceGeneratorMonitoredVariables lastVariables(size, size);
+    generator.readMonitoredVariables(lastVariables);
+
+    yInfo("Gains hot swap test: %lu gains sets, %lu steps (max duration %.3f ms), %lu reads, %lu inconsistent outputs",
+          tuner.nrOfSets(), loop.nrOfSteps(), 1e3 * loop.maxStepDuration(), monitor.nrOfReads(), monitor.nrOfErrors());
+
+    if (!ok || tuner.nrOfSets() == 0 || loop.nrOfSteps() == 0 || monitor.nrOfReads() == 0) {
+        yError("The threads did not run");
+        return EXIT_FAILURE;
+    }
+    if (!sequenceKept || (lastVariables.computedReference.array() != -1).any()) {
+        yError("The last gains set was not adopted");
+        return EXIT_FAILURE;
+    }
+    if (loop.maxStepDuration() > maxStepDuration) {
+        if (checkTiming) {
+            yError("Maximum step duration %g s (max %g s)", loop.maxStepDuration(), maxStepDuration);
+            return EXIT_FAILURE;
+        }
+        yWarning("Maximum step duration %g s (max %g s)", loop.maxStepDuration(), maxStepDuration);
+    }
+    return monitor.nrOfErrors() == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,209 @@
+/**
+ * Copyright (C) 2016 CoDyCo
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found at
+ * http://www.robotcub.org/icub/license/gpl.txt
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+/*
+ * Benchmark of the MinimumJerkTrajectoryGenerator against the iCub::ctrl::minJerkTrajGen
+ * based implementation it replaces (including the Eigen <-> yarp conversions it required).
+ *
+ * Both generators track a set point that changes every retargetPeriod samples, and
+ * all the computed values (position, velocity, acceleration) are read at every sample.
+ * The benchmark fails if the native generator does not reach the last set point
+ * at the end of the trajectory, or if a trajectory started at rest does not match
+ * the closed form minimum jerk position, velocity and acceleration.
+ *
+ * Parameters: --iterations (default 100000), --size (default 25), --duration (s, default 1.0),
+ *             --sampleTime (s, default 0.01), --retargetPeriod (samples, default 50)
+ */
+
+#include "MinimumJerkTrajectoryGenerator.h"
+
+#include <iCub/ctrl/minJerkCtrl.h>
+#include <yarp/os/Property.h>
+#include <yarp/os/Time.h>
+#include <yarp/os/LogStream.h>
+#include <yarp/sig/Vector.h>
+
+#include <Eigen/Core>
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace {
+
+    /* Same conversions and calls done by the previous implementation of MinimumJerkTrajectoryGenerator */
+    class MinJerkTrajGenWrapper {
+    public:
+        MinJerkTrajGenWrapper(int size, double sampleTime, double duration)
+        : m_generator(size, sampleTime, duration)
+        , m_reference(size)
+        , m_initialValue(size)
+        , m_position(size)
+        , m_velocity(size)
+        , m_acceleration(size) {}
+
+        void computeReference(const Eigen::VectorXd& setPoint, const Eigen::VectorXd& currentValue, bool initFilter)
+        {
+            for (int i = 0; i < setPoint.size(); i++) {
+                m_reference(i) = setPoint(i);
+                m_initialValue(i) = currentValue(i);
+            }
+            if (initFilter) {
+                m_generator.init(m_initialValue);
+            }
+        }
+
+        void update()
+        {
+            m_generator.computeNextValues(m_reference);
+            const yarp::sig::Vector &position = m_generator.getPos();
+            const yarp::sig::Vector &velocity = m_generator.getVel();
+            const yarp::sig::Vector &acceleration = m_generator.getAcc();
+            for (int i = 0; i < m_position.size(); i++) {
+                m_position(i) = position(i);
+                m_velocity(i) = velocity(i);
+                m_acceleration(i) = acceleration(i);
+            }
+        }
+
+        const Eigen::VectorXd& position() const { return m_position; }
+
+    private:
+        iCub::ctrl::minJerkTrajGen m_generator;
+        yarp::sig::Vector m_reference;
+        yarp::sig::Vector m_initialValue;
+        Eigen::VectorXd m_position;
+        Eigen::VectorXd m_velocity;
+        Eigen::VectorXd m_acceleration;
+    };
+
+    /* Maximum error of a trajectory from rest with respect to the closed form quintic */
+    double closedFormError(codyco::torquebalancing::MinimumJerkTrajectoryGenerator& generator,
+                           const Eigen::VectorXd& initialValue,
+                           const Eigen::VectorXd& setPoint, double sampleTime, double duration)
+    {
+        const Eigen::VectorXd distance = setPoint - initialValue;
+        generator.computeReference(setPoint, initialValue, 0, true);
+
+        double error = 0;
+        for (double time = 0; time < duration + 10 * sampleTime; time += sampleTime) {
+            generator.updateTrajectoryForCurrentTime(time);
+            const double s = std::min(time / duration, 1.0);
+            const double s2 = s * s;
+            const double s3 = s2 * s;
+            const Eigen::VectorXd position = initialValue + (10 * s3 - 15 * s3 * s + 6 * s3 * s2) * distance;
+            const Eigen::VectorXd velocity = ((30 * s2 - 60 * s3 + 30 * s2 * s2) / duration) * distance;
+            const Eigen::VectorXd acceleration = ((60 * s - 180 * s2 + 120 * s3) / (duration * duration)) * distance;
+            error = std::max(error, (generator.getComputedValue() - position).cwiseAbs().maxCoeff());
+            error = std::max(error, (generator.getComputedDerivativeValue() - velocity).cwiseAbs().maxCoeff());
+            error = std::max(error, (generator.getComputedSecondDerivativeValue() - acceleration).cwiseAbs().maxCoeff());
+        }
+        return error;
+    }
+
+    void randomSetPoint(Eigen::VectorXd& setPoint)
+    {
+        for (int i = 0; i < setPoint.size(); i++) {
+            setPoint(i) = (2.0 * std::rand()) / RAND_MAX - 1.0;
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    using namespace codyco::torquebalancing;
+
+    yarp::os::Property options;
+    options.fromCommand(argc, argv);
+
+    const int iterations = options.check("iterations", yarp::os::Value(100000)).asInt();
+    const int size = options.check("size", yarp::os::Value(25)).asInt();
+    const double duration = options.check("duration", yarp::os::Value(1.0)).asDouble();
+    const double sampleTime = options.check("sampleTime", yarp::os::Value(0.01)).asDouble();
+    const int retargetPeriod = options.check("retargetPeriod", yarp::os::Value(50)).asInt();
+
+    if (iterations <= 0 || size <= 0 || duration <= 0 || sampleTime <= 0 || retargetPeriod <= 0) {
+        yError("Invalid parameters");
+        return EXIT_FAILURE;
+    }
+
+    Eigen::VectorXd initialValue = Eigen::VectorXd::Zero(size);
+    Eigen::VectorXd setPoint(size);
+    //checksums, so that the computed values are not optimized away
+    double nativeChecksum = 0;
+    double wrapperChecksum = 0;
+
+    //Native implementation
+    MinimumJerkTrajectoryGenerator native(size);
+    native.initializeTimeParameters(sampleTime, duration);
+    native.computeReference(initialValue, initialValue, 0, true);
+
+    std::srand(0);
+    double start = yarp::os::Time::now();
+    for (int i = 0; i < iterations; i++) {
+        double time = i * sampleTime;
+        if (i % retargetPeriod == 0) {
+            randomSetPoint(setPoint);
+            native.computeReference(setPoint, initialValue, time, false);
+        }
+        native.updateTrajectoryForCurrentTime(time + sampleTime);
+        nativeChecksum += native.getComputedValue()(0)
+                        + native.getComputedDerivativeValue()(0)
+                        + native.getComputedSecondDerivativeValue()(0);
+    }
+    double nativeTime = yarp::os::Time::now() - start;
+
+    //Previous implementation
+    MinJerkTrajGenWrapper wrapper(size, sampleTime, duration);
+    wrapper.computeReference(initialValue, initialValue, true);
+
+    std::srand(0);
+    start = yarp::os::Time::now();
+    for (int i = 0; i < iterations; i++) {
+        if (i % retargetPeriod == 0) {
+            randomSetPoint(setPoint);
+            wrapper.computeReference(setPoint, initialValue, false);
+        }
+        wrapper.update();
+        wrapperChecksum += wrapper.position()(0);
+    }
+    double wrapperTime = yarp::os::Time::now() - start;
+
+    yInfo("MinimumJerkTrajectoryGenerator benchmark: %d iterations, size %d", iterations, size);
+    yInfo("native:             %g us per sample (checksum %g)", 1e6 * nativeTime / iterations, nativeChecksum);
+    yInfo("minJerkTrajGen:     %g us per sample (checksum %g)", 1e6 * wrapperTime / iterations, wrapperChecksum);
+    yInfo("speedup:            %g", nativeTime > 0 ? wrapperTime / nativeTime : 0.0);
+
+    //The native generator must reach the set point exactly at the end of the trajectory
+    native.updateTrajectoryForCurrentTime(iterations * sampleTime + duration);
+    double error = (native.getComputedValue() - setPoint).cwiseAbs().maxCoeff();
+    if (error > 1e-9 || native.getComputedDerivativeValue().cwiseAbs().maxCoeff() > 1e-9
+        || native.getComputedSecondDerivativeValue().cwiseAbs().maxCoeff() > 1e-9) {
+        yError("Set point not reached at the end of the trajectory (error %g)", error);
+        return EXIT_FAILURE;
+    }
+
+    //From rest, position, velocity and acceleration follow the closed form quintic
+    MinimumJerkTrajectoryGenerator fromRest(size);
+    fromRest.initializeTimeParameters(sampleTime, duration);
+    randomSetPoint(initialValue);
+    randomSetPoint(setPoint);
+    error = closedFormError(fromRest, initialValue, setPoint, sampleTime, duration);
+    yInfo("closed form error:  %g", error);
+    if (error > 1e-9) {
+        yError("The trajectory from rest differs from the closed form minimum jerk (error %g)", error);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
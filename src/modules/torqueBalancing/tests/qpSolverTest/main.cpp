@@ -0,0 +1,145 @@
+/**
+ * Copyright (C) 2016 CoDyCo
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found at
+ * http://www.robotcub.org/icub/license/gpl.txt
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+/*
+ * Test of the QPSolver used for the contact forces distribution.
+ *
+ * Solves a sequence of slowly varying random problems with the size of the two feet problem
+ * (12 variables, 22 constraints, as the controller does at each cycle) and compares the solutions
+ * with the ones of a solver with tight tolerances and no warm start.
+ * The test fails if a solve allocates memory (the test is compiled with EIGEN_RUNTIME_NO_MALLOC),
+ * if a solve does not converge, if a solution violates the constraints or is far from the optimal cost,
+ * if the warm started solves do not need fewer iterations than the cold ones, or if an invalid
+ * problem is not detected.
+ *
+ * Parameters: --problems (default 50), --variables (default 12), --constraints (default 22)
+ */
+
+#include "QPSolver.h"
+
+#include <yarp/os/Property.h>
+#include <yarp/os/LogStream.h>
+
+#include <Eigen/Core>
+
+#include <cstdlib>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+namespace {
+
+    double cost(const Eigen::MatrixXd& hessian, const Eigen::VectorXd& gradient, const Eigen::VectorXd& x)
+    {
+        return 0.5 * x.dot(hessian * x) + gradient.dot(x);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    using namespace codyco::torquebalancing;
+
+    yarp::os::Property options;
+    options.fromCommand(argc, argv);
+
+    const int problems = options.check("problems", yarp::os::Value(50)).asInt();
+    const int variables = options.check("variables", yarp::os::Value(12)).asInt();
+    const int constraints = options.check("constraints", yarp::os::Value(22)).asInt();
+
+    if (problems <= 0 || variables <= 0 || constraints <= 0) {
+        yError("Invalid parameters");
+        return EXIT_FAILURE;
+    }
+
+    std::srand(1);
+    //as in the controller: momentum error plus regularization, one sided constraints feasible in zero
+    Eigen::MatrixXd momentumMatrix = Eigen::MatrixXd::Random(6, variables);
+    Eigen::MatrixXd hessian = momentumMatrix.transpose() * momentumMatrix;
+    hessian.diagonal().array() += 1e-2;
+    Eigen::MatrixXd constraintsMatrix = Eigen::MatrixXd::Random(constraints, variables);
+    Eigen::VectorXd lowerBounds = Eigen::VectorXd::Constant(constraints, -std::numeric_limits<double>::max());
+    Eigen::VectorXd upperBounds = 10 * (Eigen::VectorXd::Random(constraints).array() + 1.5);
+    Eigen::VectorXd unconstrainedSolution = 100 * Eigen::VectorXd::Random(variables);
+    Eigen::VectorXd gradient(variables);
+
+    QPSolver solver(variables, constraints);
+    QPSolverSettings settings;
+    settings.maxIterations = 1000;
+    solver.setSettings(settings);
+
+    QPSolver referenceSolver(variables, constraints);
+    QPSolverSettings referenceSettings;
+    referenceSettings.maxIterations = 100000;
+    referenceSettings.absoluteTolerance = referenceSettings.relativeTolerance = 1e-9;
+    referenceSolver.setSettings(referenceSettings);
+
+    Eigen::VectorXd solution(variables), referenceSolution(variables);
+    int failures = 0;
+    int coldIterations = 0;
+    double warmIterations = 0;
+    double maxViolation = 0, maxCostError = 0;
+
+    for (int problem = 0; problem < problems; problem++) {
+        gradient = -hessian * unconstrainedSolution;
+
+        Eigen::internal::set_is_malloc_allowed(false);
+        QPSolverStatus status = solver.solve(hessian, gradient, constraintsMatrix, lowerBounds, upperBounds, solution);
+        Eigen::internal::set_is_malloc_allowed(true);
+        if (problem == 0) coldIterations = solver.iterations();
+        else warmIterations += solver.iterations();
+
+        referenceSolver.resetWarmStart();
+        QPSolverStatus referenceStatus = referenceSolver.solve(hessian, gradient, constraintsMatrix, lowerBounds, upperBounds, referenceSolution);
+
+        if (status != QPSolverStatusSolved || referenceStatus != QPSolverStatusSolved) {
+            yError("Problem %d not solved (status %d, reference status %d)", problem, status, referenceStatus);
+            failures++;
+        }
+
+        //tolerances of the default settings (relative to the magnitude of the problem)
+        double violation = (constraintsMatrix * solution - upperBounds).maxCoeff() / upperBounds.maxCoeff();
+        double referenceCost = cost(hessian, gradient, referenceSolution);
+        double costError = std::abs(cost(hessian, gradient, solution) - referenceCost) / std::max(1.0, std::abs(referenceCost));
+        maxViolation = std::max(maxViolation, violation);
+        maxCostError = std::max(maxCostError, costError);
+        if (violation > 1e-2 || costError > 1e-2) {
+            yError("Problem %d: constraints violation %g, relative cost error %g", problem, violation, costError);
+            failures++;
+        }
+
+        //slowly varying problem, as in the control loop
+        unconstrainedSolution += Eigen::VectorXd::Random(variables);
+    }
+    if (problems > 1) warmIterations /= problems - 1;
+
+    yInfo("QP solver test: %d problems, %d iterations cold, %.1f iterations warm started. Max violation %g, max cost error %g",
+          problems, coldIterations, warmIterations, maxViolation, maxCostError);
+
+    if (problems > 1 && warmIterations >= coldIterations) {
+        yError("The warm start does not reduce the iterations");
+        failures++;
+    }
+
+    //not positive definite hessian: the solution must not be modified
+    Eigen::MatrixXd invalidHessian = -hessian;
+    solution.setZero();
+    if (solver.solve(invalidHessian, gradient, constraintsMatrix, lowerBounds, upperBounds, solution) != QPSolverStatusInvalidProblem
+        || !solution.isZero()) {
+        yError("Invalid problem not detected");
+        failures++;
+    }
+
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,198 @@
+/**
+ * Copyright (C) 2016 CoDyCo
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found at
+ * http://www.robotcub.org/icub/license/gpl.txt
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+/*
+ * Benchmark of the reference pipeline of the torqueBalancing module.
+ *
+ * A consumer thread, with the same role of the TorqueBalancingController, reads at each cycle
+ * the reference computed by two ReferenceGenerators (sizes 3 and 25, as the CoM and posture ones),
+ * with all the threads at the same period. The age of the reference read by the consumer
+ * (end-to-end latency) is measured when the generators run in their own threads (default
+ * configuration of the module) and when they are stepped synchronously by the consumer
+ * (synchronousReferences option). The standard deviation of the latency is the phase jitter.
+ * The benchmark fails if the maximum latency in the synchronous configuration exceeds
+ * maxSynchronousLatency.
+ *
+ * Parameters: --period (ms, default 10), --duration (s, default 2.0 for each configuration),
+ *             --maxSynchronousLatency (s, default 0.002)
+ */
+
+#include "ReferenceGenerator.h"
+#include "Reference.h"
+
+#include <yarp/os/Property.h>
+#include <yarp/os/RateThread.h>
+#include <yarp/os/Time.h>
+#include <yarp/os/LogStream.h>
+
+#include <Eigen/Core>
+
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+namespace {
+
+    class ConstantSignal : public codyco::torquebalancing::ReferenceGeneratorInputReader {
+    public:
+        explicit ConstantSignal(int size) : m_signal(Eigen::VectorXd::Ones(size)), m_derivative(Eigen::VectorXd::Zero(size)) {}
+        virtual const Eigen::VectorXd& getSignal(long context = 0) { return m_signal; }
+        virtual const Eigen::VectorXd& getSignalDerivative(long context = 0) { return m_derivative; }
+        virtual int signalSize() const { return m_signal.size(); }
+    private:
+        Eigen::VectorXd m_signal;
+        Eigen::VectorXd m_derivative;
+    };
+
+    /* Reads the references as TorqueBalancingController::run() */
+    class Consumer : public yarp::os::RateThread {
+    public:
+        Consumer(int period, codyco::torquebalancing::Reference& com, codyco::torquebalancing::Reference& posture)
+        : RateThread(period)
+        , m_com(com)
+        , m_posture(posture)
+        , m_comValue(com.valueSize())
+        , m_postureValue(posture.valueSize())
+        , m_samples(0)
+        , m_sum(0)
+        , m_squaredSum(0)
+        , m_maximum(0) {}
+
+        void setSynchronousGenerators(const std::vector<codyco::torquebalancing::ReferenceGenerator*>& generators)
+        {
+            m_generators = generators;
+        }
+
+        virtual void run()
+        {
+            if (!m_generators.empty()) {
+                double now = yarp::os::Time::now();
+                for (std::vector<codyco::torquebalancing::ReferenceGenerator*>::iterator generator = m_generators.begin();
+                     generator != m_generators.end(); ++generator) {
+                    (*generator)->step(now);
+                }
+            }
+
+            if (!m_com.isValid()) return;
+            double timestamp = 0;
+            m_com.readValue(m_comValue, 0, &timestamp);
+            m_posture.readValue(m_postureValue);
+            double latency = yarp::os::Time::now() - timestamp;
+            m_samples++;
+            m_sum += latency;
+            m_squaredSum += latency * latency;
+            if (latency > m_maximum) m_maximum = latency;
+        }
+
+        int samples() const { return m_samples; }
+        double mean() const { return m_samples > 0 ? m_sum / m_samples : 0; }
+        double stdDeviation() const
+        {
+            double variance = m_samples > 0 ? m_squaredSum / m_samples - mean() * mean() : 0;
+            return variance > 0 ? std::sqrt(variance) : 0;
+        }
+        double maximum() const { return m_maximum; }
+
+    private:
+        codyco::torquebalancing::Reference& m_com;
+        codyco::torquebalancing::Reference& m_posture;
+        Eigen::VectorXd m_comValue;
+        Eigen::VectorXd m_postureValue;
+        std::vector<codyco::torquebalancing::ReferenceGenerator*> m_generators;
+        int m_samples;
+        double m_sum;
+        double m_squaredSum;
+        double m_maximum;
+    };
+
+    bool runConfiguration(bool synchronous, int period, double duration, Consumer*& result,
+                          codyco::torquebalancing::Reference& com, codyco::torquebalancing::Reference& posture,
+                          ConstantSignal& comSignal, ConstantSignal& postureSignal)
+    {
+        using namespace codyco::torquebalancing;
+        ReferenceGenerator comGenerator(period, com, comSignal, "com pid");
+        ReferenceGenerator postureGenerator(period, posture, postureSignal, "qdes");
+        comGenerator.setProportionalGains(Eigen::VectorXd::Constant(comSignal.signalSize(), 1.0));
+        postureGenerator.setProportionalGains(Eigen::VectorXd::Constant(postureSignal.signalSize(), 1.0));
+        comGenerator.setActiveState(true);
+        postureGenerator.setActiveState(true);
+
+        result = new Consumer(period, com, posture);
+        bool ok = true;
+        if (synchronous) {
+            std::vector<ReferenceGenerator*> generators;
+            generators.push_back(&comGenerator);
+            generators.push_back(&postureGenerator);
+            result->setSynchronousGenerators(generators);
+        } else {
+            //same order of the module: generators first, then the controller
+            ok = comGenerator.start() && postureGenerator.start();
+        }
+        ok = ok && result->start();
+
+        yarp::os::Time::delay(duration);
+
+        result->stop();
+        comGenerator.stop();
+        postureGenerator.stop();
+        return ok;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    using namespace codyco::torquebalancing;
+
+    yarp::os::Property options;
+    options.fromCommand(argc, argv);
+
+    const int period = options.check("period", yarp::os::Value(10)).asInt();
+    const double duration = options.check("duration", yarp::os::Value(2.0)).asDouble();
+    const double maxSynchronousLatency = options.check("maxSynchronousLatency", yarp::os::Value(0.002)).asDouble();
+
+    if (period <= 0 || duration <= 0) {
+        yError("Invalid parameters");
+        return EXIT_FAILURE;
+    }
+
+    Reference com(3);
+    Reference posture(25);
+    ConstantSignal comSignal(3);
+    ConstantSignal postureSignal(25);
+
+    Consumer *threaded = 0;
+    Consumer *synchronous = 0;
+    bool ok = runConfiguration(false, period, duration, threaded, com, posture, comSignal, postureSignal);
+    ok = runConfiguration(true, period, duration, synchronous, com, posture, comSignal, postureSignal) && ok;
+
+    yInfo("Reference pipeline benchmark: period %d ms", period);
+    yInfo("%-22s %12s %12s %12s %8s", "", "latency (ms)", "jitter (ms)", "max (ms)", "samples");
+    yInfo("%-22s %12.3f %12.3f %12.3f %8d", "generator threads", 1e3 * threaded->mean(),
+          1e3 * threaded->stdDeviation(), 1e3 * threaded->maximum(), threaded->samples());
+    yInfo("%-22s %12.3f %12.3f %12.3f %8d", "synchronous", 1e3 * synchronous->mean(),
+          1e3 * synchronous->stdDeviation(), 1e3 * synchronous->maximum(), synchronous->samples());
+
+    if (!ok || threaded->samples() == 0 || synchronous->samples() == 0) {
+        yError("The threads did not run");
+        ok = false;
+    } else if (synchronous->maximum() > maxSynchronousLatency) {
+        yError("Maximum latency of the synchronous pipeline %g s (max %g s)", synchronous->maximum(), maxSynchronousLatency);
+        ok = false;
+    }
+
+    delete threaded;
+    delete synchronous;
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,153 @@
+/**
+ * Copyright (C) 2016 CoDyCo
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found at
+ * http://www.robotcub.org/icub/license/gpl.txt
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+/*
+ * Stress test of the concurrent access to a Reference.
+ *
+ * A writer thread sets the value k (in all the elements) at its k-th call of setValue,
+ * every updatePeriod seconds (0 for writing as fast as possible), while several reader
+ * threads continuously read the value. The test fails if a reader gets a torn value
+ * (elements written by different calls of setValue), a value not matching the returned
+ * sequence number, or a sequence number smaller than the previous one.
+ *
+ * Parameters: --duration (s, default 2.0), --updatePeriod (s, default 0.001),
+ *             --size (default 64), --readers (default 2)
+ */
+
+#include "Reference.h"
+
+#include <yarp/os/Property.h>
+#include <yarp/os/Thread.h>
+#include <yarp/os/Time.h>
+#include <yarp/os/LogStream.h>
+
+#include <Eigen/Core>
+
+#include <cstdlib>
+#include <vector>
+
+namespace {
+
+    class Writer : public yarp::os::Thread {
+    public:
+        Writer(codyco::torquebalancing::Reference& reference, double updatePeriod)
+        : m_reference(reference)
+        , m_updatePeriod(updatePeriod)
+        , m_value(reference.valueSize())
+        , m_nrOfWrites(0) {}
+
+        unsigned long nrOfWrites() const { return m_nrOfWrites; }
+
+        virtual void run()
+        {
+            while (!isStopping()) {
+                m_value.setConstant(++m_nrOfWrites);
+                m_reference.setValue(m_value);
+                if (m_updatePeriod > 0) yarp::os::Time::delay(m_updatePeriod);
+            }
+        }
+
+    private:
+        codyco::torquebalancing::Reference& m_reference;
+        double m_updatePeriod;
+        Eigen::VectorXd m_value;
+        unsigned long m_nrOfWrites;
+    };
+
+    class Reader : public yarp::os::Thread {
+    public:
+        Reader(const codyco::torquebalancing::Reference& reference)
+        : m_reference(reference)
+        , m_value(reference.valueSize())
+        , m_nrOfReads(0)
+        , m_nrOfErrors(0) {}
+
+        unsigned long nrOfReads() const { return m_nrOfReads; }
+        unsigned long nrOfErrors() const { return m_nrOfErrors; }
+
+        virtual void run()
+        {
+            unsigned long previousSequenceNumber = 0;
+            while (!isStopping()) {
+                unsigned long sequenceNumber = 0;
+                m_reference.readValue(m_value, &sequenceNumber);
+                m_nrOfReads++;
+
+                bool torn = (m_value.array() != m_value(0)).any();
+                if (torn || m_value(0) != sequenceNumber || sequenceNumber < previousSequenceNumber) {
+                    if (m_nrOfErrors == 0) {
+                        yError("Inconsistent read: sequence number %lu (previous %lu), value from %g to %g",
+                               sequenceNumber, previousSequenceNumber, m_value.minCoeff(), m_value.maxCoeff());
+                    }
+                    m_nrOfErrors++;
+                }
+                previousSequenceNumber = sequenceNumber;
+            }
+        }
+
+    private:
+        const codyco::torquebalancing::Reference& m_reference;
+        Eigen::VectorXd m_value;
+        unsigned long m_nrOfReads;
+        unsigned long m_nrOfErrors;
+    };
+}
+
+int main(int argc, char **argv)
+{
+    yarp::os::Property options;
+    options.fromCommand(argc, argv);
+
+    const double duration = options.check("duration", yarp::os::Value(2.0)).asDouble();
+    const double updatePeriod = options.check("updatePeriod", yarp::os::Value(0.001)).asDouble();
+    const int size = options.check("size", yarp::os::Value(64)).asInt();
+    const int nrOfReaders = options.check("readers", yarp::os::Value(2)).asInt();
+
+    if (duration <= 0 || updatePeriod < 0 || size <= 0 || nrOfReaders <= 0) {
+        yError("Invalid parameters");
+        return EXIT_FAILURE;
+    }
+
+    codyco::torquebalancing::Reference reference(size);
+    //the initial value (zero) corresponds to the sequence number 0
+    Writer writer(reference, updatePeriod);
+    std::vector<Reader*> readers;
+    for (int i = 0; i < nrOfReaders; i++) {
+        readers.push_back(new Reader(reference));
+        readers.back()->start();
+    }
+    writer.start();
+
+    yarp::os::Time::delay(duration);
+
+    writer.stop();
+    unsigned long nrOfReads = 0;
+    unsigned long nrOfErrors = 0;
+    for (int i = 0; i < nrOfReaders; i++) {
+        readers[i]->stop();
+        nrOfReads += readers[i]->nrOfReads();
+        nrOfErrors += readers[i]->nrOfErrors();
+        delete readers[i];
+    }
+
+    yInfo("Reference stress test: %lu writes (%g per second), %lu reads by %d readers, %lu inconsistent reads",
+          writer.nrOfWrites(), writer.nrOfWrites() / duration, nrOfReads, nrOfReaders, nrOfErrors);
+
+    if (writer.nrOfWrites() == 0 || nrOfReads == 0) {
+        yError("No value written or read");
+        return EXIT_FAILURE;
+    }
+    return nrOfErrors == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
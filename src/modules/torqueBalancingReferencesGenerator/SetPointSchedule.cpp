@@ -0,0 +1,55 @@
+/**
+ * Copyright (C) 2016 CoDyCo
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found at
+ * http://www.robotcub.org/icub/license/gpl.txt
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+#include "SetPointSchedule.h"
+
+SetPointSchedule::SetPointSchedule(): m_valueSize(0), m_cursor(-1) {}
+
+void SetPointSchedule::reset(int valueSize)
+{
+    m_valueSize = valueSize;
+    m_times.clear();
+    m_values.clear();
+    m_cursor = -1;
+}
+
+bool SetPointSchedule::addSetPoint(double time, const double * value)
+{
+    if (!m_times.empty() && time <= m_times.back())
+    {
+        return false;
+    }
+    m_times.push_back(time);
+    m_values.insert(m_values.end(), value, value + m_valueSize);
+    return true;
+}
+
+const double * SetPointSchedule::valueAt(double time)
+{
+    // the time went back: restart from the beginning
+    if (m_cursor >= 0 && time <= m_times[m_cursor])
+    {
+        m_cursor = -1;
+    }
+    while (m_cursor + 1 < static_cast<int>(m_times.size()) && time > m_times[m_cursor + 1])
+    {
+        m_cursor++;
+    }
+    return m_cursor < 0 ? 0 : &m_values[m_cursor * m_valueSize];
+}
+
+int SetPointSchedule::size() const { return static_cast<int>(m_times.size()); }
+
+int SetPointSchedule::valueSize() const { return m_valueSize; }
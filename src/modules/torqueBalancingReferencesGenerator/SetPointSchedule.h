@@ -0,0 +1,67 @@
+/**
+ * Copyright (C) 2016 CoDyCo
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found at
+ * http://www.robotcub.org/icub/license/gpl.txt
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+#ifndef SETPOINTSCHEDULE_H
+#define SETPOINTSCHEDULE_H
+
+#include <vector>
+
+/**
+ * Table of set points indexed by time.
+ *
+ * The i-th set point is active for times in (time_i, time_i+1], the last one
+ * for times greater than its time. The times and the values are stored in two
+ * contiguous arrays, and the active set point is found by advancing a cursor:
+ * when the schedule is queried at increasing times, as in a periodic loop,
+ * each query costs O(1) and never allocates memory.
+ */
+class SetPointSchedule
+{
+public:
+    SetPointSchedule();
+
+    /**
+     * Remove all the set points.
+     * @param valueSize number of elements of each set point.
+     */
+    void reset(int valueSize);
+
+    /**
+     * Add a set point at the end of the schedule.
+     * @param time time from which the set point is active (it must be greater than the time of the previous set point).
+     * @param value valueSize elements of the set point.
+     * @return false if the time is not strictly increasing, true otherwise.
+     */
+    bool addSetPoint(double time, const double * value);
+
+    /**
+     * Return the set point active at the specified time.
+     * @param time query time.
+     * @return a pointer to the valueSize elements of the active set point,
+     *         0 if the time precedes (or is equal to) the time of the first set point.
+     */
+    const double * valueAt(double time);
+
+    int size() const;
+    int valueSize() const;
+
+private:
+    int m_valueSize;
+    std::vector<double> m_times;
+    std::vector<double> m_values;
+    int m_cursor; // index of the active set point, -1 before the first one
+};
+
+#endif /* end of include guard: SETPOINTSCHEDULE_H */
@@ -31,7 +31,6 @@
 
 #include <yarp/sig/Vector.h>
 #include <yarp/sig/Matrix.h>
-#include <yarp/math/Math.h>
 #include <Eigen/LU>
 
 #include <vector>
@@ -40,68 +39,105 @@ double TorqueBalancingReferencesGenerator::getPeriod () { return period; }
 
 bool TorqueBalancingReferencesGenerator::updateModule ()
 {
-    using namespace yarp::math;
     double    t = yarp::os::Time::now();
-    if (t-t0 < timeoutBeforeStreamingRefs)
+    computeReferences(t-t0);
+    streamReferences(t);
+    return true;
+}
+
+void TorqueBalancingReferencesGenerator::computeReferences (double time)
+{
+    if (time < timeoutBeforeStreamingRefs)
     {    
         comDes = com0 ;
         qDes = q0;
-        
-        
+        return;
     }
-    else
+
+    if (changeComWithSetPoints)
     {
-        if (changeComWithSetPoints)
-        {
-            for (int i = 0 ; i < comTimeAndSetPoints.size()-1; i++)
-            {
-                if ((t-t0) > comTimeAndSetPoints[i].time && (t-t0) <= comTimeAndSetPoints[i+1].time )
-                {
-                    comDes = comTimeAndSetPoints[i].comDes;
-                    break;
-                }
-                if ((t-t0) > comTimeAndSetPoints[comTimeAndSetPoints.size()-1].time )
-                {
-                    comDes = comTimeAndSetPoints[comTimeAndSetPoints.size()-1].comDes;
-                }
-            }
-        }
-        else
+        // before the first set point the last reference is kept
+        const double * setPoint = comSchedule.valueAt(time);
+        if (setPoint)
         {
-            comDes = com0 + amplitudeOfOscillation*sin(2*M_PI*frequencyOfOscillation*(t-t0-timeoutBeforeStreamingRefs))*directionOfOscillation;
-            DcomDes =  2*M_PI*frequencyOfOscillation*amplitudeOfOscillation*cos(2*M_PI*frequencyOfOscillation*(t-t0-timeoutBeforeStreamingRefs))*directionOfOscillation;
-            DDcomDes = -2*M_PI*frequencyOfOscillation*2*M_PI*frequencyOfOscillation*amplitudeOfOscillation*sin(2*M_PI*frequencyOfOscillation*(t-t0-timeoutBeforeStreamingRefs))*directionOfOscillation;
+            for (int i = 0; i < 3; i++) comDes[i] = setPoint[i];
         }
-        
-        if (changePostural)
+    }
+    else
+    {
+        // the compiler computes the sine and the cosine of the same phase with a single sincos
+        double phase = oscillationPulsation*(time-timeoutBeforeStreamingRefs);
+        double sinPhase = sin(phase);
+        double cosPhase = cos(phase);
+        for (int i = 0; i < 3; i++)
         {
-            qDes = q0;
-            for (int i = 0 ; i < postures.size()-1; i++)
-            {
-                if ((t-t0) > postures[i].time && (t-t0) <= postures[i+1].time )
-                {
-                    qDes = postures[i].qDes;
-                    break;
-                }
-                if ((t-t0) > postures[postures.size()-1].time )
-                {
-                    qDes = postures[postures.size()-1].qDes;
-                }
-            }
+            comDes[i]   = com0[i] + sinPhase*oscillationPositionAmplitude[i];
+            DcomDes[i]  = cosPhase*oscillationVelocityAmplitude[i];
+            DDcomDes[i] = -sinPhase*oscillationAccelerationAmplitude[i];
         }
     }
-    
+
+    if (changePostural)
+    {
+        // before the first set point the initial posture is streamed
+        const double * posture = postureSchedule.valueAt(time);
+        if (!posture) posture = q0.data();
+        for (size_t j = 0; j < qDes.size(); j++) qDes[j] = posture[j];
+    }
+}
+
+void TorqueBalancingReferencesGenerator::streamReferences (double timestamp)
+{
+    referencesStamp.update(timestamp);
+
     yarp::sig::Vector& output = portForStreamingComDes.prepare();
     output.resize(9);
     output.setSubvector(0,comDes);
     output.setSubvector(3,DcomDes);
     output.setSubvector(6,DDcomDes);
+    portForStreamingComDes.setEnvelope(referencesStamp);
     portForStreamingComDes.write();
 
     yarp::sig::Vector& output2 = portForStreamingQdes.prepare();
     output2 = qDes;
+    portForStreamingQdes.setEnvelope(referencesStamp);
     portForStreamingQdes.write();
-    
+}
+
+bool TorqueBalancingReferencesGenerator::compileReferences ()
+{
+    comSchedule.reset(3);
+    for (size_t i = 0; i < comTimeAndSetPoints.size(); i++)
+    {
+        if (!comSchedule.addSetPoint(comTimeAndSetPoints[i].time, comTimeAndSetPoints[i].comDes.data()))
+        {
+            std::cerr << "[ERR] the time of com set point " << i << " (" << comTimeAndSetPoints[i].time
+                      << ") is not greater than the time of the previous one" << std::endl;
+            return false;
+        }
+    }
+
+    postureSchedule.reset(q0.size());
+    for (size_t i = 0; i < postures.size(); i++)
+    {
+        if (!postureSchedule.addSetPoint(postures[i].time, postures[i].qDes.data()))
+        {
+            std::cerr << "[ERR] the time of posture " << i << " (" << postures[i].time
+                      << ") is not greater than the time of the previous one" << std::endl;
+            return false;
+        }
+    }
+
+    oscillationPulsation = 2*M_PI*frequencyOfOscillation;
+    oscillationPositionAmplitude.resize(3);
+    oscillationVelocityAmplitude.resize(3);
+    oscillationAccelerationAmplitude.resize(3);
+    for (int i = 0; i < 3; i++)
+    {
+        oscillationPositionAmplitude[i]     = amplitudeOfOscillation*directionOfOscillation[i];
+        oscillationVelocityAmplitude[i]     = oscillationPulsation*oscillationPositionAmplitude[i];
+        oscillationAccelerationAmplitude[i] = oscillationPulsation*oscillationVelocityAmplitude[i];
+    }
     return true;
 }
 
@@ -189,6 +225,7 @@ bool TorqueBalancingReferencesGenerator::configure (yarp::os::ResourceFinder &rf
     DcomDes.resize(3, 0.0);
     DDcomDes.resize(3, 0.0);
     m_robot->getEstimates(wbi::ESTIMATE_JOINT_POS, q0.data());
+    qDes = q0;
     
     double world2BaseFrameSerialization[16];
     double rotoTranslationVector[7];
@@ -199,6 +236,11 @@ bool TorqueBalancingReferencesGenerator::configure (yarp::os::ResourceFinder &rf
     com0[0] = rotoTranslationVector[0];    
     com0[1] = rotoTranslationVector[1];
     com0[2] = rotoTranslationVector[2];
+
+    if (!compileReferences())
+    {
+        return false;
+    }
     
     timeoutBeforeStreamingRefs = rf.check("timeoutBeforeStreamingRefs", Value(20), "Looking for robot name").asDouble();
 
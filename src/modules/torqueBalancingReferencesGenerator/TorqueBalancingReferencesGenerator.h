@@ -29,8 +29,11 @@
 #include <yarp/os/BufferedPort.h>
 #include <yarp/os/Bottle.h>
 #include <yarp/os/Time.h>
+#include <yarp/os/Stamp.h>
 #include <stdio.h>
 
+#include "SetPointSchedule.h"
+
 
 
 namespace wbi {
@@ -83,6 +86,19 @@ private:
     std::vector<Postures> postures;
     
     std::vector<ComTimeAndSetPoints> comTimeAndSetPoints;
+
+    // set points compiled in time-indexed tables, queried at each cycle
+    SetPointSchedule comSchedule;
+    SetPointSchedule postureSchedule;
+
+    // precomputed coefficients of the sinusoidal reference of the center of mass
+    double            oscillationPulsation;
+    yarp::sig::Vector oscillationPositionAmplitude;
+    yarp::sig::Vector oscillationVelocityAmplitude;
+    yarp::sig::Vector oscillationAccelerationAmplitude;
+
+    // sequence number and computation time of the streamed references
+    yarp::os::Stamp referencesStamp;
     
     yarp::os::BufferedPort<yarp::sig::Vector> portForStreamingComDes;
     yarp::os::BufferedPort<yarp::sig::Vector> portForStreamingQdes;;
@@ -101,6 +117,10 @@ private:
                         double actuatedDOFs, bool & changePostural, bool & changeComWithSetPoints, 
                         double & amplitudeOfOscillation, 
                         double & frequencyOfOscillation,yarp::sig::Vector & directionOfOscillation  ); 
+
+    bool compileReferences();
+    void computeReferences(double time);
+    void streamReferences(double timestamp);
 public:
     virtual double getPeriod ();
     virtual bool  updateModule ();
@@ -22,6 +22,7 @@
 #include <yarp/os/Searchable.h>
 #include <yarp/dev/all.h>
 #include <yarp/sig/Vector.h>
+#include <yarp/sig/Matrix.h>
 #include <iCub/ctrl/neuralNetworks.h>
 
 namespace codyco {
@@ -31,10 +32,61 @@ namespace codyco {
     protected:
         iCub::ctrl::ff2LayNN_tansig_purelin net;
 
+        // batch evaluation: the scaling of inputs and outputs is folded into the weights,
+        // the candidates are the rows of preallocated row-major matrices
+        bool batchConfigured;
+        int maxCandidates;
+        int numCandidates;
+        double maxRowDifference;
+        yarp::sig::Matrix inputWeights;     // hidden x 7
+        yarp::sig::Vector inputBiases;
+        yarp::sig::Matrix outputWeights;    // outputs x hidden
+        yarp::sig::Vector outputBiases;
+        yarp::sig::Matrix candidates;       // maxCandidates x 7
+        yarp::sig::Matrix hidden;           // maxCandidates x hidden
+        yarp::sig::Matrix predictions;      // maxCandidates x outputs
+
+        bool configureBatch(yarp::os::Property &options);
+
     public:
-        bool configure(yarp::os::Property &options);
+        Predictor();
+
+        /**
+         * Configures the network from its description. The batch
+         * evaluation can hold up to maxCandidates candidates, made of
+         * blobs whose rows differ at most by maxRowDifference pixels.
+         */
+        bool configure(yarp::os::Property &options, const int maxCandidates=64,
+                       const double maxRowDifference=20.0);
 
         yarp::sig::Vector predict(const yarp::sig::Vector &head, yarp::os::Bottle *imdLeft, yarp::os::Bottle *imdRight);
+
+        /**
+         * True if the batch evaluation is available, i.e. the
+         * network description could be read with the expected
+         * structure (7 inputs, 3 outputs).
+         */
+        bool isBatchAvailable() const;
+
+        /**
+         * Fills the candidates with the pairs of a left and a right
+         * blob that can be the same object (up to maxCandidates), in
+         * the order of the blobs. The eyes are aligned, so the
+         * projections of a point lie on about the same row: the pairs
+         * whose rows differ more than maxRowDifference are discarded.
+         * Returns the number of candidates.
+         */
+        int setCandidates(const yarp::sig::Vector &head, yarp::os::Bottle *imdLeft, yarp::os::Bottle *imdRight);
+
+        /**
+         * Evaluates all the candidates with one forward pass and
+         * returns the index of the one whose prediction is the
+         * closest to reference (in the output frame of the
+         * network), -1 if there are no candidates. The prediction
+         * is copied in prediction, which must have the size of the
+         * network output. No memory is allocated.
+         */
+        int predictClosest(const yarp::sig::Vector &reference, yarp::sig::Vector &prediction);
     };
 
 
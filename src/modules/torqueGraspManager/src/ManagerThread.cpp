@@ -371,10 +371,27 @@ namespace codyco {
                 T(1,3)=x[1];
                 T(2,3)=x[2];
 
-                Vector netout=pred.predict(head,imdTargetLeft,imdTargetRight);
-                netout.push_back(1.0);
-                targetPos=(T*netout).subVector(0,2);
-                newTarget=true;
+                Vector netout;
+                if (pred.isBatchAvailable() && (state!=STATE_IDLE))
+                {
+                    // rank all the pairs of blobs: the closest to the current target wins.
+                    // In idle there is no target to follow yet: the first blobs are used
+                    Vector ref=SE3inv(T)*cat(targetPos,1.0);
+                    netout.resize(3);
+                    pred.setCandidates(head,imdTargetLeft,imdTargetRight);
+                    newTarget=pred.predictClosest(ref,netout)>=0;
+                }
+                else
+                {
+                    netout=pred.predict(head,imdTargetLeft,imdTargetRight);
+                    newTarget=true;
+                }
+
+                if (newTarget)
+                {
+                    netout.push_back(1.0);
+                    targetPos=(T*netout).subVector(0,2);
+                }
             }
         }
         else if (Bottle *targetPosNew=inportTrackTarget.read(false))
@@ -1305,7 +1322,10 @@ namespace codyco {
             options.fromConfigFile(rf.findFile(bGeneral.check("network",Value("network.ini"),
                                                               "Getting network data").asString().c_str()));
 
-            if (!pred.configure(options))
+            if (!pred.configure(options,bGeneral.check("network_candidates",Value(64),
+                                                       "Getting maximum number of network candidates").asInt(),
+                                bGeneral.check("network_max_row_difference",Value(20.0),
+                                               "Getting maximum row difference of the network candidates").asDouble()))
                 return false;
         }
 
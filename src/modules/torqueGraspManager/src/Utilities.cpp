@@ -3,23 +3,142 @@
 #include <yarp/os/Property.h>
 #include <yarp/os/Bottle.h>
 #include <yarp/sig/Vector.h>
+#include <yarp/sig/Matrix.h>
+
+#include <gsl/gsl_matrix.h>
+#include <gsl/gsl_blas.h>
+
+#include <cmath>
+#include <cstdio>
 
 using namespace yarp::os;
 using namespace yarp::sig;
 
+#define PREDICTOR_INPUTS    7
+
+namespace {
+
+    bool readList(Property &options, const char *key, const int size, Vector &values)
+    {
+        Bottle *list=options.find(key).asList();
+        if ((list==NULL) || (list->size()!=size))
+            return false;
+
+        values.resize(size);
+        for (int i=0; i<size; i++)
+            values[i]=list->get(i).asDouble();
+
+        return true;
+    }
+
+    bool readIndexedList(Property &options, const char *prefix, const int index, const int size, Vector &values)
+    {
+        char key[64];
+        sprintf(key,"%s_%d",prefix,index+1);
+        return readList(options,key,size,values);
+    }
+
+    // scale and offset of the linear map from the range x to the range y
+    bool readMapping(Property &options, const char *prefixX, const char *prefixY, const int index,
+                     double &scale, double &offset)
+    {
+        Vector x,y;
+        if (!readIndexedList(options,prefixX,index,2,x) || !readIndexedList(options,prefixY,index,2,y))
+            return false;
+
+        if (x[1]==x[0])
+            return false;
+
+        scale=(y[1]-y[0])/(x[1]-x[0]);
+        offset=y[0]-scale*x[0];
+        return true;
+    }
+}
+
 namespace codyco {
 
-    bool Predictor::configure(Property &options)
+    Predictor::Predictor() : batchConfigured(false), maxCandidates(0), numCandidates(0),
+                             maxRowDifference(0.0) { }
+
+    bool Predictor::configure(Property &options, const int maxCandidates,
+                              const double maxRowDifference)
     {
         if (net.configure(options))
         {
             net.printStructure();
+
+            this->maxCandidates=maxCandidates>0?maxCandidates:0;
+            this->maxRowDifference=maxRowDifference;
+            batchConfigured=configureBatch(options);
+            if (!batchConfigured)
+                fprintf(stdout,"Batch evaluation of the network not available\n");
+
             return true;
         }
         else
             return false;
     }
 
+    bool Predictor::configureBatch(Property &options)
+    {
+        const int numInputs=options.check("numInputNodes",Value(0)).asInt();
+        const int numHidden=options.check("numHiddenNodes",Value(0)).asInt();
+        const int numOutputs=options.check("numOutputNodes",Value(0)).asInt();
+        if ((numInputs!=PREDICTOR_INPUTS) || (numHidden<=0) || (numOutputs!=3) || (maxCandidates==0))
+            return false;
+
+        // inputs: the network sees scale*x+offset, folded into the first layer
+        Vector inputScale(numInputs), inputOffset(numInputs);
+        for (int i=0; i<numInputs; i++)
+            if (!readMapping(options,"inMinMaxX","inMinMaxY",i,inputScale[i],inputOffset[i]))
+                return false;
+
+        if (!readList(options,"b1",numHidden,inputBiases))
+            return false;
+
+        inputWeights.resize(numHidden,numInputs);
+        Vector row;
+        for (int i=0; i<numHidden; i++)
+        {
+            if (!readIndexedList(options,"IW",i,numInputs,row))
+                return false;
+
+            for (int j=0; j<numInputs; j++)
+            {
+                inputWeights(i,j)=row[j]*inputScale[j];
+                inputBiases[i]+=row[j]*inputOffset[j];
+            }
+        }
+
+        // outputs: the network produces the scaled output, mapped back into the second layer
+        if (!readList(options,"b2",numOutputs,outputBiases))
+            return false;
+
+        outputWeights.resize(numOutputs,numHidden);
+        for (int i=0; i<numOutputs; i++)
+        {
+            double scale,offset;
+            if (!readMapping(options,"outMinMaxY","outMinMaxX",i,scale,offset) ||
+                !readIndexedList(options,"LW",i,numHidden,row))
+                return false;
+
+            for (int j=0; j<numHidden; j++)
+                outputWeights(i,j)=scale*row[j];
+            outputBiases[i]=scale*outputBiases[i]+offset;
+        }
+
+        candidates.resize(maxCandidates,numInputs);
+        hidden.resize(maxCandidates,numHidden);
+        predictions.resize(maxCandidates,numOutputs);
+        numCandidates=0;
+        return true;
+    }
+
+    bool Predictor::isBatchAvailable() const
+    {
+        return batchConfigured;
+    }
+
     Vector Predictor::predict(const Vector &head, Bottle *imdLeft, Bottle *imdRight)
     {
         Bottle *firstBlobLeft=imdLeft->get(0).asList();
@@ -37,6 +156,105 @@ namespace codyco {
         return net.predict(in);
     }
 
+    int Predictor::setCandidates(const Vector &head, Bottle *imdLeft, Bottle *imdRight)
+    {
+        numCandidates=0;
+        if (!batchConfigured || (imdLeft==NULL) || (imdRight==NULL))
+            return 0;
+
+        for (int l=0; l<imdLeft->size(); l++)
+        {
+            Bottle *blobLeft=imdLeft->get(l).asList();
+            if ((blobLeft==NULL) || (blobLeft->size()<2))
+                continue;
+
+            for (int r=0; r<imdRight->size(); r++)
+            {
+                Bottle *blobRight=imdRight->get(r).asList();
+                if ((blobRight==NULL) || (blobRight->size()<2))
+                    continue;
+
+                // epipolar constraint of the aligned eyes
+                if (fabs(blobLeft->get(1).asDouble()-blobRight->get(1).asDouble())>maxRowDifference)
+                    continue;
+
+                if (numCandidates>=maxCandidates)
+                    return numCandidates;
+
+                // same layout of the input of predict()
+                double *in=candidates.data()+numCandidates*PREDICTOR_INPUTS;
+                in[0]=head[3];
+                in[1]=head[4];
+                in[2]=head[5];
+                in[3]=blobLeft->get(0).asDouble();
+                in[4]=blobLeft->get(1).asDouble();
+                in[5]=blobRight->get(0).asDouble();
+                in[6]=blobRight->get(1).asDouble();
+                numCandidates++;
+            }
+        }
+
+        return numCandidates;
+    }
+
+    int Predictor::predictClosest(const Vector &reference, Vector &prediction)
+    {
+        const int numOutputs=predictions.cols();
+        if (!batchConfigured || (numCandidates==0) || (reference.length()<numOutputs) ||
+            (prediction.length()!=numOutputs))
+            return -1;
+
+        const int numHidden=hidden.cols();
+
+        // hidden=tansig(candidates*IW'+b1), predictions=hidden*LW'+b2: the biases
+        // are copied in the rows and the products accumulated on them
+        for (int i=0; i<numCandidates; i++)
+        {
+            double *h=hidden.data()+i*numHidden;
+            double *y=predictions.data()+i*numOutputs;
+            for (int j=0; j<numHidden; j++)
+                h[j]=inputBiases[j];
+            for (int j=0; j<numOutputs; j++)
+                y[j]=outputBiases[j];
+        }
+
+        gsl_matrix_view in=gsl_matrix_view_array(candidates.data(),numCandidates,PREDICTOR_INPUTS);
+        gsl_matrix_view hid=gsl_matrix_view_array(hidden.data(),numCandidates,numHidden);
+        gsl_matrix_view out=gsl_matrix_view_array(predictions.data(),numCandidates,numOutputs);
+        gsl_matrix_const_view iw=gsl_matrix_const_view_array(inputWeights.data(),numHidden,PREDICTOR_INPUTS);
+        gsl_matrix_const_view lw=gsl_matrix_const_view_array(outputWeights.data(),numOutputs,numHidden);
+
+        gsl_blas_dgemm(CblasNoTrans,CblasTrans,1.0,&in.matrix,&iw.matrix,1.0,&hid.matrix);
+
+        double *h=hidden.data();
+        for (int i=0; i<numCandidates*numHidden; i++)
+            h[i]=tanh(h[i]);
+
+        gsl_blas_dgemm(CblasNoTrans,CblasTrans,1.0,&hid.matrix,&lw.matrix,1.0,&out.matrix);
+
+        int best=-1;
+        double bestDistance=0.0;
+        for (int i=0; i<numCandidates; i++)
+        {
+            const double *y=predictions.data()+i*numOutputs;
+            double distance=0.0;
+            for (int j=0; j<numOutputs; j++)
+                distance+=(y[j]-reference[j])*(y[j]-reference[j]);
+
+            if ((best<0) || (distance<bestDistance))
+            {
+                best=i;
+                bestDistance=distance;
+            }
+        }
+
+        const double *y=predictions.data()+best*numOutputs;
+        for (int j=0; j<numOutputs; j++)
+            prediction[j]=y[j];
+
+        return best;
+    }
+
     void myReport::report(const SearchReport& report, const char *context)
     {
         std::string ctx=context;
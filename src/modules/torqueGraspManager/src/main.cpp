@@ -51,7 +51,8 @@ gaze.
 Furthermore, there exists a second modality that enables to
 estimate the 3-d object position using stereo vision that needs
 to be calibrated in advance relying on a feed-forward neural
-network.
+network. All the pairs of left and right blobs are evaluated
+at once and the one closest to the current target is selected.
 
 \section lib_sec Libraries
 - ctrlLib.
@@ -122,6 +123,10 @@ idle_tmo        5.0
 use_network off
 // NN configuration file
 network         network.ini
+// maximum number of pairs of left and right blobs evaluated by the NN
+network_candidates 64
+// maximum difference of the rows of a left and a right blob to pair them [pixels]
+network_max_row_difference 20.0
 
 [torso]
 // joint switch (min **) (max **) [deg]; 'min', 'max' optional
@@ -177,6 +177,27 @@ local /${name}/r_foot_ft_sensor
 remote /${robot}/right_foot/analog:o
 ~~~
  
+\section host_sec Host mode
+To run the estimation for several robots (for example several simulated robots on the same machine)
+in a single process, list the robots in the `instances` parameter:
+~~~
+# Robots for which the estimation is performed. For each of them, the configuration
+# files are loaded again setting ${robot} to the name of the robot and ${name} to ${name}/robot,
+# and the ports of the wholeBodyDynamicsDevice are opened with the /${name}/robot prefix
+# (use ${name} also in the port names in the WBD_OUTPUT_EXTERNAL_WRENCH_PORTS group of the device configuration).
+instances (icubSim1,icubSim2,icubSim3)
+# Number of threads running the estimations (optional, default 0).
+# If 0, each instance runs the estimation in its own thread.
+# Otherwise, the instances are distributed on the specified number of threads.
+estimationThreads 2
+# Period of the estimation threads (optional, default 10)
+estimationPeriodInMs 10
+~~~
+Each instance parses the model file and keeps two copies of the model, in the estimator and in the
+calibration thread, because iDynTree::ExtWrenchesAndJointTorquesEstimator stores the model by value
+(the gravity compensation helper refers to the model of the estimator).
+The increase of resident memory due to each instance is printed when the instance is opened (on Linux).
+
 \section tested_os_sec Tested OS
 Linux
 
@@ -186,6 +207,7 @@ Linux
 
 #include <yarp/os/LogStream.h>
 #include <yarp/os/Property.h>
+#include <yarp/os/RateThread.h>
 #include <yarp/os/RFModule.h>
 
 #include <yarp/dev/PolyDriver.h>
@@ -194,49 +216,111 @@ Linux
 
 #include <vector>
 
+#include <cstdio>
 #include <cstdlib>
 
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
 using namespace yarp::dev;
 using namespace yarp::os;
 
 /************************************************************************/
-class wholeBodyDynamics3Module: public RFModule
+/**
+ * Resident memory of the process in bytes, or -1 if it is not available.
+ */
+static double residentMemoryInBytes()
 {
-protected:
+#ifdef __linux__
+    FILE * statm = fopen("/proc/self/statm","r");
+    if( !statm )
+    {
+        return -1.0;
+    }
+
+    long totalPages = 0;
+    long residentPages = 0;
+    int nrOfReadFields = fscanf(statm,"%ld %ld",&totalPages,&residentPages);
+    fclose(statm);
+
+    if( nrOfReadFields != 2 )
+    {
+        return -1.0;
+    }
+
+    return static_cast<double>(residentPages)*sysconf(_SC_PAGESIZE);
+#else
+    return -1.0;
+#endif
+}
+
+/************************************************************************/
+/**
+ * A wholeBodyDynamics device with the devices attached to it.
+ */
+struct wholeBodyDynamicsInstance
+{
+    std::string name;
     PolyDriver wholeBodyDynamicsDevice;
     IMultipleWrapper* iwrap;
+    RateThread* estimationLoop;
     PolyDriverList usedDevices;
 
+    wholeBodyDynamicsInstance(): iwrap(0), estimationLoop(0) {}
+};
+
+/************************************************************************/
+/**
+ * Thread running the estimation of a group of wholeBodyDynamics devices
+ * (opened with enableEstimationThread set to false), one after the other.
+ */
+class wholeBodyDynamicsEstimationWorker: public RateThread
+{
+protected:
+    std::vector<RateThread*> estimationLoops;
+
 public:
-    /************************************************************************/
-    bool configure(ResourceFinder &rf)
+    wholeBodyDynamicsEstimationWorker(int periodInMs): RateThread(periodInMs) {}
+
+    void addEstimationLoop(RateThread* estimationLoop)
     {
-        // Check required data
-        if( !rf.check("wholeBodyDynamicsDevice")
-            || !rf.check("devices") || !(rf.find("devices").isList()) )
+        estimationLoops.push_back(estimationLoop);
+    }
+
+    void run()
+    {
+        for(size_t i=0; i < estimationLoops.size(); i++)
         {
-            yError() << "wholeBodyDynamics3 : missing required parameters wholeBodyDynamicsDevice and devices";
-            return false;
+            estimationLoops[i]->run();
         }
+    }
+};
 
+/************************************************************************/
+class wholeBodyDynamics3Module: public RFModule
+{
+protected:
+    std::vector<wholeBodyDynamicsInstance*> instances;
+    std::vector<wholeBodyDynamicsEstimationWorker*> workers;
 
+    /************************************************************************/
+    bool openInstance(wholeBodyDynamicsInstance* instance,
+                      Searchable & config,
+                      Property & wholeBodyDynamicsDeviceOptions)
+    {
         // Open the wholeBodyDynamics device, then get all other devices and
         // pass them to the attachAll method
-        Property wholeBodyDynamicsDeviceOptions;
-        wholeBodyDynamicsDeviceOptions.fromConfigFile(rf.findFile("wholeBodyDynamicsDevice"));
-
-
-        // Open all devices
-        bool ok = wholeBodyDynamicsDevice.open(wholeBodyDynamicsDeviceOptions);
-        ok = ok && wholeBodyDynamicsDevice.view(iwrap);
+        bool ok = instance->wholeBodyDynamicsDevice.open(wholeBodyDynamicsDeviceOptions);
+        ok = ok && instance->wholeBodyDynamicsDevice.view(instance->iwrap);
 
         if( !ok )
         {
-            yError() << "wholeBodyDynamics3 : error in open wholeBodyDynamicsDevice";
+            yError() << "wholeBodyDynamics3 : error in open wholeBodyDynamicsDevice" << instance->name;
             return false;
         }
 
-        Bottle * devices = rf.find("devices").asList();
+        Bottle * devices = config.find("devices").asList();
 
         for(int dev=0; dev < devices->size(); dev++)
         {
@@ -245,51 +329,211 @@ public:
             // Open the property
             PolyDriver * devPD = new PolyDriver();
 
-            bool ok = devPD->open(rf.findGroup(devKey));
+            bool ok = devPD->open(config.findGroup(devKey));
 
             if( !ok || !(devPD->isValid()) )
             {
-                yError() << "wholeBodyDynamics3 : error in opening device " << devKey;
-                this->close();
+                yError() << "wholeBodyDynamics3 : error in opening device " << devKey << " of " << instance->name;
+                delete devPD;
                 return false;
             }
 
             // Add to PolyDriverList
-            usedDevices.push(devPD,devKey.c_str());
+            instance->usedDevices.push(devPD,devKey.c_str());
         }
 
         // Attach the sensors devices to the wholeBodyDynamics
-        ok = iwrap->attachAll(usedDevices);
+        ok = instance->iwrap->attachAll(instance->usedDevices);
 
         if( !ok )
         {
-            yError() << "wholeBodyDynamics3 : error in attachAll";
+            yError() << "wholeBodyDynamics3 : error in attachAll of " << instance->name;
             return false;
         }
 
         return true;
     }
 
-
     /************************************************************************/
-    bool close()
+    void closeInstance(wholeBodyDynamicsInstance* instance)
     {
         // Call detach all from wholeBodyDynamics
-        iwrap->detachAll();
+        if( instance->iwrap )
+        {
+            instance->iwrap->detachAll();
+        }
 
         // Close wholeBodyDynamicsDevice
-        wholeBodyDynamicsDevice.close();
+        instance->wholeBodyDynamicsDevice.close();
 
         // Close all other devices
-        for(int dev = 0; dev < usedDevices.size(); dev++)
+        for(int dev = 0; dev < instance->usedDevices.size(); dev++)
+        {
+            if( instance->usedDevices[dev]->poly )
+            {
+                instance->usedDevices[dev]->poly->close();
+                delete instance->usedDevices[dev]->poly;
+                instance->usedDevices[dev]->poly = 0;
+            }
+        }
+    }
+
+    /************************************************************************/
+    bool configureHost(ResourceFinder &rf)
+    {
+        Bottle * instancesNames = rf.find("instances").asList();
+        std::string name = rf.check("name",Value("wholeBodyDynamics")).asString();
+        int nrOfWorkers = rf.check("estimationThreads",Value(0)).asInt();
+        int periodInMs = rf.check("estimationPeriodInMs",Value(10)).asInt();
+
+        if( nrOfWorkers < 0 || periodInMs <= 0 )
+        {
+            yError() << "wholeBodyDynamics3 : estimationThreads should be non negative and estimationPeriodInMs positive";
+            return false;
+        }
+
+        std::string configFile = rf.findFileByName(rf.check("from",Value("wholeBodyDynamics3.ini")).asString());
+
+        for(int w=0; w < nrOfWorkers; w++)
+        {
+            workers.push_back(new wholeBodyDynamicsEstimationWorker(periodInMs));
+        }
+
+        for(int inst=0; inst < instancesNames->size(); inst++)
         {
-            if( usedDevices[dev]->poly )
+            wholeBodyDynamicsInstance * instance = new wholeBodyDynamicsInstance();
+            instance->name = instancesNames->get(inst).asString();
+            instances.push_back(instance);
+
+            // The configuration of each instance is obtained by loading again the configuration
+            // files, using the name of the instance as robot and a separate namespace for the ports
+            Property env;
+            env.put("robot",instance->name);
+            env.put("name",name+"/"+instance->name);
+
+            Property instanceConfig;
+            instanceConfig.fromConfigFile(configFile,env);
+
+            Property wholeBodyDynamicsDeviceOptions;
+            wholeBodyDynamicsDeviceOptions.fromConfigFile(rf.findFile("wholeBodyDynamicsDevice"),env);
+            wholeBodyDynamicsDeviceOptions.put("portPrefix","/"+name+"/"+instance->name);
+            if( nrOfWorkers > 0 )
             {
-                usedDevices[dev]->poly->close();
-                delete usedDevices[dev]->poly;
-                usedDevices[dev]->poly = 0;
+                wholeBodyDynamicsDeviceOptions.put("enableEstimationThread",Value(false));
             }
+
+            double memoryBeforeOpen = residentMemoryInBytes();
+
+            bool ok = openInstance(instance,instanceConfig,wholeBodyDynamicsDeviceOptions);
+
+            double memoryAfterOpen = residentMemoryInBytes();
+            if( ok && memoryBeforeOpen >= 0.0 && memoryAfterOpen >= 0.0 )
+            {
+                yInfo() << "wholeBodyDynamics3 : instance" << instance->name << "increased the resident memory by"
+                        << (memoryAfterOpen-memoryBeforeOpen)/(1024.0*1024.0) << "MB";
+            }
+
+            if( ok && nrOfWorkers > 0 )
+            {
+                ok = instance->wholeBodyDynamicsDevice.view(instance->estimationLoop);
+                if( !ok )
+                {
+                    yError() << "wholeBodyDynamics3 : the estimation of " << instance->name << " can not be run by estimation threads";
+                }
+                else
+                {
+                    // The thread of the device is not started, but its period is the nominal one of the estimation
+                    instance->estimationLoop->setRate(periodInMs);
+                }
+            }
+
+            if( !ok )
+            {
+                this->close();
+                return false;
+            }
+
+            // The instances are distributed on the estimation threads
+            if( nrOfWorkers > 0 )
+            {
+                workers[inst % nrOfWorkers]->addEstimationLoop(instance->estimationLoop);
+            }
+        }
+
+        for(size_t w=0; w < workers.size(); w++)
+        {
+            if( !workers[w]->start() )
+            {
+                yError() << "wholeBodyDynamics3 : error in starting estimation thread " << w;
+                this->close();
+                return false;
+            }
+        }
+
+        yInfo() << "wholeBodyDynamics3 : running " << instances.size() << " instances of wholeBodyDynamicsDevice on "
+                << (workers.size() > 0 ? workers.size() : instances.size()) << " threads";
+
+        return true;
+    }
+
+public:
+    /************************************************************************/
+    bool configure(ResourceFinder &rf)
+    {
+        // Check required data
+        if( !rf.check("wholeBodyDynamicsDevice")
+            || !rf.check("devices") || !(rf.find("devices").isList()) )
+        {
+            yError() << "wholeBodyDynamics3 : missing required parameters wholeBodyDynamicsDevice and devices";
+            return false;
+        }
+
+        // Host mode: several instances of the estimation in the same process
+        if( rf.check("instances") )
+        {
+            if( !rf.find("instances").isList() )
+            {
+                yError() << "wholeBodyDynamics3 : instances is present, but it is not a list";
+                return false;
+            }
+
+            return configureHost(rf);
+        }
+
+        wholeBodyDynamicsInstance * instance = new wholeBodyDynamicsInstance();
+        instance->name = rf.check("name",Value("wholeBodyDynamics")).asString();
+        instances.push_back(instance);
+
+        Property wholeBodyDynamicsDeviceOptions;
+        wholeBodyDynamicsDeviceOptions.fromConfigFile(rf.findFile("wholeBodyDynamicsDevice"));
+
+        if( !openInstance(instance,rf,wholeBodyDynamicsDeviceOptions) )
+        {
+            this->close();
+            return false;
+        }
+
+        return true;
+    }
+
+
+    /************************************************************************/
+    bool close()
+    {
+        // Stop the estimation threads before closing the devices
+        for(size_t w=0; w < workers.size(); w++)
+        {
+            workers[w]->stop();
+            delete workers[w];
+        }
+        workers.clear();
+
+        for(size_t inst=0; inst < instances.size(); inst++)
+        {
+            closeInstance(instances[inst]);
+            delete instances[inst];
         }
+        instances.clear();
 
         return true;
     }